@@ -1,6 +1,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 
@@ -13,21 +15,13 @@
 
 #define HCI_TIMEOUT 1000
 
-static int bdaddr_was_set = 0;
-static bdaddr_t original_bdaddr;
-static char original_name[HCI_MAX_NAME_LENGTH];
-static uint8_t original_class[3];
-static uint8_t original_scan_enable;
-static uint8_t original_iac[MAX_IAC_LAP][3];
-static uint8_t original_iac_num;
-static uint8_t original_simple_pairing_mode;
-
-static bdaddr_t wiimote_baddr;
 static const char wiimote_name[] = "Nintendo RVL-CNT-01";
 static const uint32_t wiimote_class = 0x002504;
 static const uint8_t wiimote_iac[3] = { 0x00, 0x8B, 0x9E };
 
-static const uint32_t nintendo_ouis[66] =
+#define NINTENDO_OUI_COUNT 66
+
+static const uint32_t nintendo_ouis[NINTENDO_OUI_COUNT] =
 {
   0xECC40D, 0xE84ECE, 0xE0F6B5, 0xE0E751, 0xE00C7F, 0xDC68EB, 0xD86BF7, 0xD4F057,
   0xCCFB65, 0xCC9E00, 0xB8AE6E, 0xB88AEC, 0xB87826, 0xA4C0E1, 0xA45C27, 0xA438CC,
@@ -40,7 +34,7 @@ static const uint32_t nintendo_ouis[66] =
   0x001656, 0x0009BF
 };
 
-int hci_read_scan_enable(int dd, uint8_t * enabled, int to)
+static int bluez_read_scan_enable(int dd, uint8_t * enabled, int to)
 {
   struct {
     uint8_t status;
@@ -69,7 +63,7 @@ int hci_read_scan_enable(int dd, uint8_t * enabled, int to)
   return 0;
 }
 
-int hci_write_scan_enable(int dd, uint8_t enabled, int to)
+static int bluez_write_scan_enable(int dd, uint8_t enabled, int to)
 {
   struct {
     uint8_t enabled;
@@ -104,14 +98,116 @@ int hci_write_scan_enable(int dd, uint8_t enabled, int to)
   return 0;
 }
 
-int set_up_device_address(int dd, int device_id)
+static int bluez_dev_down(int dd, int device_id)
+{
+  return ioctl(dd, HCIDEVDOWN, device_id);
+}
+
+static int bluez_dev_up(int dd, int device_id)
+{
+  return ioctl(dd, HCIDEVUP, device_id);
+}
+
+const struct hci_ops hci_ops_bluez =
+{
+  .open_dev = hci_open_dev,
+  .close_dev = hci_close_dev,
+  .devinfo = hci_devinfo,
+  .dev_down = bluez_dev_down,
+  .dev_up = bluez_dev_up,
+
+  .read_bd_addr = hci_read_bd_addr,
+  .write_bd_addr = set_device_bdaddr,
+  .read_local_version = hci_read_local_version,
+  .read_local_name = hci_read_local_name,
+  .write_local_name = hci_write_local_name,
+  .read_class_of_dev = hci_read_class_of_dev,
+  .write_class_of_dev = hci_write_class_of_dev,
+  .read_scan_enable = bluez_read_scan_enable,
+  .write_scan_enable = bluez_write_scan_enable,
+  .read_current_iac_lap = hci_read_current_iac_lap,
+  .write_current_iac_lap = hci_write_current_iac_lap,
+  .read_simple_pairing_mode = hci_read_simple_pairing_mode,
+  .write_simple_pairing_mode = hci_write_simple_pairing_mode,
+
+  .inquiry = hci_inquiry,
+  .read_remote_name = hci_read_remote_name
+};
+
+void adapter_init(struct adapter * adapter, const struct hci_ops * hci)
+{
+  memset(adapter, 0, sizeof(struct adapter));
+
+  adapter->hci = (hci != NULL) ? hci : &hci_ops_bluez;
+  adapter->device_id = 0;
+}
+
+int adapter_select(struct adapter * adapter, const char * dev_str)
+{
+  struct hci_dev_info di;
+  bdaddr_t bdaddr;
+  const char * index_str;
+  int device_id;
+
+  if (dev_str == NULL || *dev_str == '\0')
+  {
+    dev_str = "0";
+  }
+
+  //accept "<n>", "hci<n>" or the adapter's address
+  index_str = (strncmp(dev_str, "hci", 3) == 0) ? dev_str + 3 : dev_str;
+
+  if (*index_str != '\0' && strspn(index_str, "0123456789") == strlen(index_str))
+  {
+    device_id = atoi(index_str);
+
+    if (adapter->hci->devinfo(device_id, &di) < 0)
+    {
+      fprintf(stderr, "No such device hci%d\n", device_id);
+      return -1;
+    }
+
+    adapter->device_id = device_id;
+    return 0;
+  }
+
+  if (bachk(dev_str) < 0)
+  {
+    fprintf(stderr, "Invalid device: %s\n", dev_str);
+    return -1;
+  }
+
+  str2ba(dev_str, &bdaddr);
+
+  for (device_id = 0; device_id < HCI_MAX_DEV; device_id++)
+  {
+    if (adapter->hci->devinfo(device_id, &di) < 0)
+    {
+      continue;
+    }
+
+    if (!bacmp(&di.bdaddr, &bdaddr))
+    {
+      adapter->device_id = device_id;
+      return 0;
+    }
+  }
+
+  fprintf(stderr, "No device with address %s\n", dev_str);
+  return -1;
+}
+
+static int set_up_device_address(struct adapter * adapter, int dd)
 {
   int ret, i;
   uint32_t uap;
   struct hci_dev_info di;
   struct hci_version ver;
+  const struct hci_ops * hci = adapter->hci;
+  int device_id = adapter->device_id;
+  bdaddr_t wiimote_bdaddr;
 
-  ret = hci_devinfo(device_id, &di);
+  ret = hci->devinfo(device_id, &di);
   if (ret < 0)
   {
     fprintf(stderr, "Can't get device info for hci%d: %s (%d)\n",
@@ -121,7 +217,7 @@ int set_up_device_address(int dd, int device_id)
 
   if (!bacmp(&di.bdaddr, BDADDR_ANY))
   {
-    ret = hci_read_bd_addr(dd, &original_bdaddr, HCI_TIMEOUT);
+    ret = hci->read_bd_addr(dd, &adapter->original_bdaddr, HCI_TIMEOUT);
     if (ret < 0)
     {
       fprintf(stderr, "Can't read address for hci%d: %s (%d)\n",
@@ -131,10 +227,12 @@ int set_up_device_address(int dd, int device_id)
   }
   else
   {
-    bacpy(&original_bdaddr, &di.bdaddr);
+    bacpy(&adapter->original_bdaddr, &di.bdaddr);
   }
 
-  ret = hci_read_local_version(dd, &ver, HCI_TIMEOUT);
+  bacpy(&adapter->bdaddr, &adapter->original_bdaddr);
+
+  ret = hci->read_local_version(dd, &ver, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't read version info for hci%d: %s (%d)\n",
@@ -143,9 +241,9 @@ int set_up_device_address(int dd, int device_id)
   }
 
   //check if bdaddr already has a Nintendo OUI (e.g. it was manually set)
-  uap = (original_bdaddr.b[5] << 16) | (original_bdaddr.b[4] << 8) |
-    original_bdaddr.b[3];
-  for (i = 0; i < sizeof(nintendo_ouis); i++)
+  uap = (adapter->original_bdaddr.b[5] << 16) | (adapter->original_bdaddr.b[4] << 8) |
+    adapter->original_bdaddr.b[3];
+  for (i = 0; i < NINTENDO_OUI_COUNT; i++)
   {
     if (nintendo_ouis[i] == uap)
     {
@@ -153,12 +251,12 @@ int set_up_device_address(int dd, int device_id)
     }
   }
 
-  bacpy(&wiimote_baddr, &original_bdaddr);
-  wiimote_baddr.b[5] = (nintendo_ouis[65] >> 16) & 0xFF;
-  wiimote_baddr.b[4] = (nintendo_ouis[65] >> 8) & 0xFF;
-  wiimote_baddr.b[3] = (nintendo_ouis[65]) & 0xFF;
+  bacpy(&wiimote_bdaddr, &adapter->original_bdaddr);
+  wiimote_bdaddr.b[5] = (nintendo_ouis[65] >> 16) & 0xFF;
+  wiimote_bdaddr.b[4] = (nintendo_ouis[65] >> 8) & 0xFF;
+  wiimote_bdaddr.b[3] = (nintendo_ouis[65]) & 0xFF;
 
-  ret = set_device_bdaddr(dd, &ver, &wiimote_baddr);
+  ret = hci->write_bd_addr(dd, &ver, &wiimote_bdaddr);
   if (ret < 0)
   {
     printf("Failed to set device address\n");
@@ -167,16 +265,17 @@ int set_up_device_address(int dd, int device_id)
     return -1;
   }
 
-  bdaddr_was_set = 1;
+  adapter->bdaddr_was_set = 1;
+  bacpy(&adapter->bdaddr, &wiimote_bdaddr);
 
-  ret = ioctl(dd, HCIDEVDOWN, device_id);
+  ret = hci->dev_down(dd, device_id);
   if (ret < 0)
   {
     fprintf(stderr, "Can't down device hci%d: %s (%d)\n",
       device_id, strerror(errno), errno);
   }
 
-  ret = ioctl(dd, HCIDEVUP, device_id);
+  ret = hci->dev_up(dd, device_id);
   if (ret < 0)
   {
     fprintf(stderr, "Can't init device hci%d: %s (%d)\n",
@@ -186,24 +285,26 @@ int set_up_device_address(int dd, int device_id)
   return 0;
 }
 
-int restore_device_address(int dd, int device_id)
+static int restore_device_address(struct adapter * adapter, int dd)
 {
   int ret;
   struct hci_version ver;
+  const struct hci_ops * hci = adapter->hci;
+  int device_id = adapter->device_id;
 
-  if (bdaddr_was_set == 0)
+  if (adapter->bdaddr_was_set == 0)
   {
     return 0;
   }
 
-  ret = hci_read_local_version(dd, &ver, 1000);
+  ret = hci->read_local_version(dd, &ver, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't read version info: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = set_device_bdaddr(dd, &ver, &original_bdaddr);
+  ret = hci->write_bd_addr(dd, &ver, &adapter->original_bdaddr);
   if (ret < 0)
   {
     printf("Failed to restore device address\n");
@@ -211,15 +312,18 @@ int restore_device_address(int dd, int device_id)
       bt_compidtostr(ver.manufacturer), ver.manufacturer);
     return -1;
   }
+
+  adapter->bdaddr_was_set = 0;
+  bacpy(&adapter->bdaddr, &adapter->original_bdaddr);
   
-  ret = ioctl(dd, HCIDEVDOWN, device_id);
+  ret = hci->dev_down(dd, device_id);
   if (ret < 0)
   {
     fprintf(stderr, "Can't down device hci%d: %s (%d)\n",
       device_id, strerror(errno), errno);
   }
 
-  ret = ioctl(dd, HCIDEVUP, device_id);
+  ret = hci->dev_up(dd, device_id);
   if (ret < 0)
   {
     fprintf(stderr, "Can't init device hci%d: %s (%d)\n",
@@ -229,18 +333,18 @@ int restore_device_address(int dd, int device_id)
   return 0;
 }
 
-int set_up_device_name(int dd)
+static int set_up_device_name(struct adapter * adapter, int dd)
 {
   int ret;
 
-  ret = hci_read_local_name(dd, HCI_MAX_NAME_LENGTH, original_name, HCI_TIMEOUT);
+  ret = adapter->hci->read_local_name(dd, HCI_MAX_NAME_LENGTH, adapter->original_name, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't read device name: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = hci_write_local_name(dd, wiimote_name, HCI_TIMEOUT);
+  ret = adapter->hci->write_local_name(dd, wiimote_name, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't write device name: %s (%d)\n", strerror(errno), errno);
@@ -250,11 +354,11 @@ int set_up_device_name(int dd)
   return 0;
 }
 
-int restore_device_name(int dd)
+static int restore_device_name(struct adapter * adapter, int dd)
 {
   int ret;
 
-  ret = hci_write_local_name(dd, original_name, HCI_TIMEOUT);
+  ret = adapter->hci->write_local_name(dd, adapter->original_name, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't restore device name: %s (%d)\n", strerror(errno), errno);
@@ -264,18 +368,18 @@ int restore_device_name(int dd)
   return 0;
 }
 
-int set_up_device_class(int dd)
+static int set_up_device_class(struct adapter * adapter, int dd)
 {
   int ret;
 
-  ret = hci_read_class_of_dev(dd, original_class, HCI_TIMEOUT);
+  ret = adapter->hci->read_class_of_dev(dd, adapter->original_class, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't read device class: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = hci_write_class_of_dev(dd, wiimote_class, HCI_TIMEOUT);
+  ret = adapter->hci->write_class_of_dev(dd, wiimote_class, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't write device class: %s (%d)\n", strerror(errno), errno);
@@ -285,16 +389,16 @@ int set_up_device_class(int dd)
   return 0;
 }
 
-int restore_device_class(int dd)
+static int restore_device_class(struct adapter * adapter, int dd)
 {
   int ret;
 
   uint32_t class_int = 0;
-  class_int |= original_class[0];
-  class_int |= original_class[1] << 8;
-  class_int |= original_class[2] << 16;
+  class_int |= adapter->original_class[0];
+  class_int |= adapter->original_class[1] << 8;
+  class_int |= adapter->original_class[2] << 16;
 
-  ret = hci_write_class_of_dev(dd, class_int, HCI_TIMEOUT);
+  ret = adapter->hci->write_class_of_dev(dd, class_int, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't restore device class: %s (%d)\n", strerror(errno), errno);
@@ -304,32 +408,34 @@ int restore_device_class(int dd)
   return 0;
 }
 
-int set_up_device_inquiry(int dd)
+static int set_up_device_inquiry(struct adapter * adapter, int dd)
 {
   int ret;
+  const struct hci_ops * hci = adapter->hci;
 
-  ret = hci_read_scan_enable(dd, &original_scan_enable, HCI_TIMEOUT);
+  ret = hci->read_scan_enable(dd, &adapter->original_scan_enable, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't read scan enable: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = hci_write_scan_enable(dd, SCAN_INQUIRY | SCAN_PAGE, HCI_TIMEOUT);
+  ret = hci->write_scan_enable(dd, SCAN_INQUIRY | SCAN_PAGE, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't write scan enable: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = hci_read_current_iac_lap(dd, &original_iac_num, (uint8_t *)original_iac, HCI_TIMEOUT);
+  ret = hci->read_current_iac_lap(dd, &adapter->original_iac_num,
+    (uint8_t *)adapter->original_iac, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't read iac: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = hci_write_current_iac_lap(dd, 1, (uint8_t *)wiimote_iac, HCI_TIMEOUT);
+  ret = hci->write_current_iac_lap(dd, 1, (uint8_t *)wiimote_iac, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't write iac: %s (%d)\n", strerror(errno), errno);
@@ -339,18 +445,20 @@ int set_up_device_inquiry(int dd)
   return 0;
 }
 
-int restore_device_inquiry(int dd)
+static int restore_device_inquiry(struct adapter * adapter, int dd)
 {
   int ret;
+  const struct hci_ops * hci = adapter->hci;
 
-  ret = hci_write_scan_enable(dd, original_scan_enable, HCI_TIMEOUT);
+  ret = hci->write_scan_enable(dd, adapter->original_scan_enable, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't restore scan enable: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = hci_write_current_iac_lap(dd, original_iac_num, (uint8_t *)original_iac, HCI_TIMEOUT);
+  ret = hci->write_current_iac_lap(dd, adapter->original_iac_num,
+    (uint8_t *)adapter->original_iac, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't restore iac: %s (%d)\n", strerror(errno), errno);
@@ -360,18 +468,18 @@ int restore_device_inquiry(int dd)
   return 0;
 }
 
-int set_up_simple_pairing_mode(int dd)
+static int set_up_simple_pairing_mode(struct adapter * adapter, int dd)
 {
   int ret;
 
-  ret = hci_read_simple_pairing_mode(dd, &original_simple_pairing_mode, HCI_TIMEOUT);
+  ret = adapter->hci->read_simple_pairing_mode(dd, &adapter->original_simple_pairing_mode, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't read simple pairing mode: %s (%d)\n", strerror(errno), errno);
     return -1;
   }
 
-  ret = hci_write_simple_pairing_mode(dd, 0, HCI_TIMEOUT);
+  ret = adapter->hci->write_simple_pairing_mode(dd, 0, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't write simple pairing mode: %s (%d)\n", strerror(errno), errno);
@@ -381,11 +489,11 @@ int set_up_simple_pairing_mode(int dd)
   return 0;
 }
 
-int restore_simple_pairing_mode(int dd)
+static int restore_simple_pairing_mode(struct adapter * adapter, int dd)
 {
   int ret;
 
-  ret = hci_write_simple_pairing_mode(dd, original_simple_pairing_mode, HCI_TIMEOUT);
+  ret = adapter->hci->write_simple_pairing_mode(dd, adapter->original_simple_pairing_mode, HCI_TIMEOUT);
   if (ret < 0)
   {
     fprintf(stderr, "Can't restore simple pairing mode: %s (%d)\n", strerror(errno), errno);
@@ -395,11 +503,31 @@ int restore_simple_pairing_mode(int dd)
   return 0;
 }
 
-int set_up_device(char * dev_str)
+//puts back the settings changed by the first steps of a failed set up
+static void undo_set_up(struct adapter * adapter, int dd, int steps)
+{
+  if (steps > 2)
+  {
+    restore_device_inquiry(adapter, dd);
+  }
+  if (steps > 1)
+  {
+    restore_device_class(adapter, dd);
+  }
+  if (steps > 0)
+  {
+    restore_device_name(adapter, dd);
+  }
+
+  restore_device_address(adapter, dd);
+}
+
+int set_up_device(struct adapter * adapter)
 {
-  int device_id = 0, dd, ret;
+  int device_id = adapter->device_id, dd, ret;
+  const struct hci_ops * hci = adapter->hci;
 
-  dd = hci_open_dev(device_id);
+  dd = hci->open_dev(device_id);
   if (dd < 0)
   {
     fprintf(stderr, "Can't open device hci%d: %s (%d)\n",
@@ -407,53 +535,64 @@ int set_up_device(char * dev_str)
     return -1;
   }
 
-  ret = set_up_device_address(dd, device_id);
+  ret = set_up_device_address(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to set device address\n");
+    printf("Failed to set device address on hci%d\n", device_id);
     printf("Warning: device address must have a Nintendo OUI\n");
   }
 
-  ret = set_up_device_name(dd);
+  ret = set_up_device_name(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to set device name\n");
-    hci_close_dev(dd);
+    printf("Failed to set device name on hci%d\n", device_id);
+    undo_set_up(adapter, dd, 0);
+    hci->close_dev(dd);
     return -1;
   }
 
-  ret = set_up_device_class(dd);
+  ret = set_up_device_class(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to set device class\n");
-    hci_close_dev(dd);
+    printf("Failed to set device class on hci%d\n", device_id);
+    undo_set_up(adapter, dd, 1);
+    hci->close_dev(dd);
     return -1;
   }
 
-  ret = set_up_device_inquiry(dd);
+  ret = set_up_device_inquiry(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to set device inquiry settings\n");
-    hci_close_dev(dd);
+    printf("Failed to set device inquiry settings on hci%d\n", device_id);
+    undo_set_up(adapter, dd, 2);
+    hci->close_dev(dd);
     return -1;
   }
   
-  ret = set_up_simple_pairing_mode(dd);
+  ret = set_up_simple_pairing_mode(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to set simple pairing mode\n");
+    printf("Failed to set simple pairing mode on hci%d\n", device_id);
     printf("Warning: make sure secure simple pairing mode is disabled\n");
   }
 
-  hci_close_dev(dd);
+  hci->close_dev(dd);
+
+  adapter->is_set_up = 1;
   return 0;
 }
 
-int restore_device()
+int restore_device(struct adapter * adapter)
 {
-  int device_id = 0, dd, ret;
+  int device_id = adapter->device_id, dd, ret;
+  const struct hci_ops * hci = adapter->hci;
 
-  dd = hci_open_dev(device_id);
+  if (!adapter->is_set_up)
+  {
+    return 0;
+  }
+
+  dd = hci->open_dev(device_id);
   if (dd < 0)
   {
     fprintf(stderr, "Can't open device hci%d: %s (%d)\n",
@@ -461,54 +600,173 @@ int restore_device()
     return -1;
   }
 
-  ret = restore_device_address(dd, device_id);
+  ret = restore_device_address(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to restore device address\n");
+    printf("Failed to restore device address on hci%d\n", device_id);
   }
 
-  ret = restore_device_name(dd);
+  ret = restore_device_name(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to restore device name\n");
-    hci_close_dev(dd);
+    printf("Failed to restore device name on hci%d\n", device_id);
+    hci->close_dev(dd);
     return -1;
   }
 
-  ret = restore_device_class(dd);
+  ret = restore_device_class(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to restore device class\n");
-    hci_close_dev(dd);
+    printf("Failed to restore device class on hci%d\n", device_id);
+    hci->close_dev(dd);
     return -1;
   }
 
-  ret = restore_device_inquiry(dd);
+  ret = restore_device_inquiry(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to restore device inquiry settings\n");
-    hci_close_dev(dd);
+    printf("Failed to restore device inquiry settings on hci%d\n", device_id);
+    hci->close_dev(dd);
     return -1;
   }
 
-  ret = restore_simple_pairing_mode(dd);
+  ret = restore_simple_pairing_mode(adapter, dd);
   if (ret < 0)
   {
-    printf("Failed to restore simple pairing mode\n");
-    hci_close_dev(dd);
+    printf("Failed to restore simple pairing mode on hci%d\n", device_id);
+    hci->close_dev(dd);
     return -1;
   }
 
-  hci_close_dev(dd);
+  hci->close_dev(dd);
+
+  adapter->is_set_up = 0;
   return 0;
 }
 
-int power_off_host(const bdaddr_t * host_bdaddr)
+struct adapter_job
+{
+  pthread_t thread;
+  struct adapter * adapter;
+  int (*fn)(struct adapter * adapter);
+  int started;
+  int result;
+};
+
+static void * adapter_job_run(void * arg)
+{
+  struct adapter_job * job = (struct adapter_job *)arg;
+
+  job->result = job->fn(job->adapter);
+
+  return NULL;
+}
+
+//runs fn on every distinct adapter at once, HCI commands block for a while
+static int for_each_adapter_parallel(struct adapter * adapters, int count,
+  int (*fn)(struct adapter * adapter))
+{
+  struct adapter_job * jobs;
+  int i, j, ret = 0;
+
+  jobs = (struct adapter_job *)calloc(count, sizeof(struct adapter_job));
+  if (jobs == NULL)
+  {
+    return -1;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    jobs[i].adapter = &adapters[i];
+    jobs[i].fn = fn;
+
+    //adapters may be shared between controllers, only handle each once
+    for (j = 0; j < i; j++)
+    {
+      if (adapters[j].device_id == adapters[i].device_id)
+      {
+        break;
+      }
+    }
+    if (j < i)
+    {
+      continue;
+    }
+
+    if (pthread_create(&jobs[i].thread, NULL, adapter_job_run, &jobs[i]) == 0)
+    {
+      jobs[i].started = 1;
+    }
+    else
+    {
+      jobs[i].result = fn(&adapters[i]);
+    }
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    if (jobs[i].started)
+    {
+      pthread_join(jobs[i].thread, NULL);
+    }
+
+    if (jobs[i].result < 0)
+    {
+      ret = -1;
+    }
+  }
+
+  free(jobs);
+
+  return ret;
+}
+
+static void adapter_copy_shared(struct adapter * adapters, int count)
+{
+  int i, j;
+
+  //duplicates of an adapter take on the state of its first occurrence
+  for (i = 0; i < count; i++)
+  {
+    for (j = 0; j < i; j++)
+    {
+      if (adapters[j].device_id == adapters[i].device_id)
+      {
+        adapters[i] = adapters[j];
+        adapters[i].is_set_up = 0;
+        break;
+      }
+    }
+  }
+}
+
+int set_up_devices(struct adapter * adapters, int count)
+{
+  int ret;
+
+  ret = for_each_adapter_parallel(adapters, count, set_up_device);
+  adapter_copy_shared(adapters, count);
+
+  if (ret < 0)
+  {
+    restore_devices(adapters, count);
+  }
+
+  return ret;
+}
+
+int restore_devices(struct adapter * adapters, int count)
+{
+  return for_each_adapter_parallel(adapters, count, restore_device);
+}
+
+int power_off_host(struct adapter * adapter, const bdaddr_t * host_bdaddr)
 {
   int ret, dd;
   struct hci_conn_info_req * cr;
   
-  dd = hci_open_dev(hci_get_route((bdaddr_t *)host_bdaddr));
+  //the adapter the host is connected through, not whichever routes to it
+  dd = adapter->hci->open_dev(adapter->device_id);
   if (dd < 0)
   {
     return dd;
@@ -521,13 +779,13 @@ int power_off_host(const bdaddr_t * host_bdaddr)
   ret = ioctl(dd, HCIGETCONNINFO, (unsigned long)cr);
   if (ret)
   {
-    hci_close_dev(dd);
+    adapter->hci->close_dev(dd);
     free(cr);
     return ret;
   }
   
   ret = hci_disconnect(dd, cr->conn_info->handle, HCI_OE_POWER_OFF, HCI_TIMEOUT);
-  hci_close_dev(dd);
+  adapter->hci->close_dev(dd);
   free(cr);
 
   if (ret)
@@ -538,12 +796,12 @@ int power_off_host(const bdaddr_t * host_bdaddr)
   return 0;
 }
 
-int get_device_bdaddr(int device_id, bdaddr_t * out_bdaddr)
+int get_device_bdaddr(struct adapter * adapter, bdaddr_t * out_bdaddr)
 {
   int ret;
   struct hci_dev_info di;
 
-  ret = hci_devinfo(device_id, &di);
+  ret = adapter->hci->devinfo(adapter->device_id, &di);
   if (ret < 0)
   {
     return ret;
@@ -554,15 +812,16 @@ int get_device_bdaddr(int device_id, bdaddr_t * out_bdaddr)
   return 0;
 }
 
-int find_wiimote(bdaddr_t * out_bdaddr)
+int find_wiimote(struct adapter * adapter, bdaddr_t * out_bdaddr)
 {
-  int device_id = 0, dd;
+  int device_id = adapter->device_id, dd;
   int max_rsp, num_rsp;
   inquiry_info *ii = NULL;
   int i, len, flags;
   char name[248] = { 0 };
+  const struct hci_ops * hci = adapter->hci;
 
-  dd = hci_open_dev(device_id);
+  dd = hci->open_dev(device_id);
   if (dd < 0)
   {
     fprintf(stderr, "Can't open device hci%d: %s (%d)\n",
@@ -575,16 +834,18 @@ int find_wiimote(bdaddr_t * out_bdaddr)
   flags = IREQ_CACHE_FLUSH;
   ii = (inquiry_info*)malloc(max_rsp * sizeof(inquiry_info));
 
-  num_rsp = hci_inquiry(device_id, len, max_rsp, (uint8_t *)wiimote_iac, &ii, flags);
+  num_rsp = hci->inquiry(device_id, len, max_rsp, (uint8_t *)wiimote_iac, &ii, flags);
   if (num_rsp < 0)
   {
     fprintf(stderr, "HCI inquiry failed\n");
+    free(ii);
+    hci->close_dev(dd);
     return -1;
   }
 
   for (i = 0; i < num_rsp; i++)
   {
-    hci_read_remote_name(dd, &(ii+i)->bdaddr, sizeof(name), name, 0);
+    hci->read_remote_name(dd, &(ii+i)->bdaddr, sizeof(name), name, 0);
 
     if (!strncmp(name, wiimote_name, sizeof(wiimote_name) - 1))
     {
@@ -594,7 +855,7 @@ int find_wiimote(bdaddr_t * out_bdaddr)
   }
 
   free(ii);
-  hci_close_dev(dd);
+  hci->close_dev(dd);
 
   return 0;
-}
\ No newline at end of file
+}
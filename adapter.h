@@ -1,10 +1,74 @@
 #ifndef ADAPTER_H
 #define ADAPTER_H
 
-int set_up_device(char * dev_str);
-int restore_device();
-int power_off_host(const bdaddr_t * host_bdaddr);
-int get_device_bdaddr(int device_id, bdaddr_t * out_bdaddr);
-int find_wiimote(bdaddr_t * out_bdaddr);
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+
+/*
+ * HCI operations used by the adapter code. The default table calls into
+ * libbluetooth; tests substitute their own to run without a radio.
+ */
+struct hci_ops
+{
+  int (*open_dev)(int device_id);
+  int (*close_dev)(int dd);
+  int (*devinfo)(int device_id, struct hci_dev_info * di);
+  int (*dev_down)(int dd, int device_id);
+  int (*dev_up)(int dd, int device_id);
+
+  int (*read_bd_addr)(int dd, bdaddr_t * bdaddr, int to);
+  int (*write_bd_addr)(int dd, const struct hci_version * ver, const bdaddr_t * bdaddr);
+  int (*read_local_version)(int dd, struct hci_version * ver, int to);
+  int (*read_local_name)(int dd, int len, char * name, int to);
+  int (*write_local_name)(int dd, const char * name, int to);
+  int (*read_class_of_dev)(int dd, uint8_t * cls, int to);
+  int (*write_class_of_dev)(int dd, uint32_t cls, int to);
+  int (*read_scan_enable)(int dd, uint8_t * enabled, int to);
+  int (*write_scan_enable)(int dd, uint8_t enabled, int to);
+  int (*read_current_iac_lap)(int dd, uint8_t * num_iac, uint8_t * lap, int to);
+  int (*write_current_iac_lap)(int dd, uint8_t num_iac, uint8_t * lap, int to);
+  int (*read_simple_pairing_mode)(int dd, uint8_t * mode, int to);
+  int (*write_simple_pairing_mode)(int dd, uint8_t mode, int to);
+
+  int (*inquiry)(int device_id, int len, int num_rsp, const uint8_t * lap,
+    inquiry_info ** ii, long flags);
+  int (*read_remote_name)(int dd, const bdaddr_t * bdaddr, int len, char * name, int to);
+};
+
+extern const struct hci_ops hci_ops_bluez;
+
+/*
+ * One local Bluetooth adapter along with the settings it had before it was
+ * set up to look like a Wiimote, so each one can be restored on its own.
+ */
+struct adapter
+{
+  const struct hci_ops * hci;
+  int device_id;
+  bdaddr_t bdaddr; //address in use after set up
+
+  int is_set_up;
+  int bdaddr_was_set;
+  bdaddr_t original_bdaddr;
+  char original_name[HCI_MAX_NAME_LENGTH];
+  uint8_t original_class[3];
+  uint8_t original_scan_enable;
+  uint8_t original_iac[MAX_IAC_LAP][3];
+  uint8_t original_iac_num;
+  uint8_t original_simple_pairing_mode;
+};
+
+void adapter_init(struct adapter * adapter, const struct hci_ops * hci);
+int adapter_select(struct adapter * adapter, const char * dev_str);
+
+int set_up_device(struct adapter * adapter);
+int restore_device(struct adapter * adapter);
+int set_up_devices(struct adapter * adapters, int count);
+int restore_devices(struct adapter * adapters, int count);
+
+int power_off_host(struct adapter * adapter, const bdaddr_t * host_bdaddr);
+int get_device_bdaddr(struct adapter * adapter, bdaddr_t * out_bdaddr);
+int find_wiimote(struct adapter * adapter, bdaddr_t * out_bdaddr);
 
 #endif /* ADAPTER_H */
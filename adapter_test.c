@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+
+#include "adapter.h"
+#include "test.h"
+
+// In-memory stand-ins for local adapters, the hci_ops below act on these
+// instead of a radio. Device descriptors are device_id + FAKE_DD_BASE.
+
+#define FAKE_DEV_COUNT 3
+#define FAKE_DD_BASE 100
+
+struct fake_dev
+{
+  bdaddr_t bdaddr;
+  char name[HCI_MAX_NAME_LENGTH];
+  uint32_t class;
+  uint8_t scan_enable;
+  uint8_t iac[MAX_IAC_LAP][3];
+  uint8_t iac_num;
+  uint8_t simple_pairing_mode;
+
+  int open_count;
+  int bdaddr_writes;
+  int fail_write_name;
+};
+
+static struct fake_dev fake_devs[FAKE_DEV_COUNT];
+
+static struct fake_dev * fake_dev_for(int dd)
+{
+  int device_id = dd - FAKE_DD_BASE;
+
+  if (device_id < 0 || device_id >= FAKE_DEV_COUNT)
+  {
+    return NULL;
+  }
+
+  return &fake_devs[device_id];
+}
+
+static void fake_reset()
+{
+  int i;
+
+  memset(fake_devs, 0, sizeof(fake_devs));
+
+  for (i = 0; i < FAKE_DEV_COUNT; i++)
+  {
+    str2ba("00:1A:7D:DA:71:10", &fake_devs[i].bdaddr);
+    fake_devs[i].bdaddr.b[0] = i;
+    snprintf(fake_devs[i].name, sizeof(fake_devs[i].name), "laptop-%d", i);
+    fake_devs[i].class = 0x0c010c;
+    fake_devs[i].scan_enable = SCAN_PAGE;
+    fake_devs[i].iac_num = 1;
+    fake_devs[i].iac[0][0] = 0x33;
+    fake_devs[i].iac[0][1] = 0x8B;
+    fake_devs[i].iac[0][2] = 0x9E;
+    fake_devs[i].simple_pairing_mode = 1;
+  }
+}
+
+static int fake_open_dev(int device_id)
+{
+  if (device_id < 0 || device_id >= FAKE_DEV_COUNT)
+  {
+    errno = ENODEV;
+    return -1;
+  }
+
+  fake_devs[device_id].open_count++;
+  return device_id + FAKE_DD_BASE;
+}
+
+static int fake_close_dev(int dd)
+{
+  return 0;
+}
+
+static int fake_devinfo(int device_id, struct hci_dev_info * di)
+{
+  if (device_id < 0 || device_id >= FAKE_DEV_COUNT)
+  {
+    errno = ENODEV;
+    return -1;
+  }
+
+  memset(di, 0, sizeof(struct hci_dev_info));
+  di->dev_id = device_id;
+  bacpy(&di->bdaddr, &fake_devs[device_id].bdaddr);
+
+  return 0;
+}
+
+static int fake_dev_down(int dd, int device_id)
+{
+  return 0;
+}
+
+static int fake_dev_up(int dd, int device_id)
+{
+  return 0;
+}
+
+static int fake_read_bd_addr(int dd, bdaddr_t * bdaddr, int to)
+{
+  bacpy(bdaddr, &fake_dev_for(dd)->bdaddr);
+  return 0;
+}
+
+static int fake_write_bd_addr(int dd, const struct hci_version * ver, const bdaddr_t * bdaddr)
+{
+  struct fake_dev * dev = fake_dev_for(dd);
+
+  bacpy(&dev->bdaddr, bdaddr);
+  dev->bdaddr_writes++;
+  return 0;
+}
+
+static int fake_read_local_version(int dd, struct hci_version * ver, int to)
+{
+  memset(ver, 0, sizeof(struct hci_version));
+  ver->manufacturer = 10;
+  return 0;
+}
+
+static int fake_read_local_name(int dd, int len, char * name, int to)
+{
+  strncpy(name, fake_dev_for(dd)->name, len);
+  return 0;
+}
+
+static int fake_write_local_name(int dd, const char * name, int to)
+{
+  struct fake_dev * dev = fake_dev_for(dd);
+
+  if (dev->fail_write_name)
+  {
+    errno = EIO;
+    return -1;
+  }
+
+  strncpy(dev->name, name, sizeof(dev->name) - 1);
+  return 0;
+}
+
+static int fake_read_class_of_dev(int dd, uint8_t * cls, int to)
+{
+  uint32_t class = fake_dev_for(dd)->class;
+
+  cls[0] = class & 0xff;
+  cls[1] = (class >> 8) & 0xff;
+  cls[2] = (class >> 16) & 0xff;
+  return 0;
+}
+
+static int fake_write_class_of_dev(int dd, uint32_t cls, int to)
+{
+  fake_dev_for(dd)->class = cls;
+  return 0;
+}
+
+static int fake_read_scan_enable(int dd, uint8_t * enabled, int to)
+{
+  *enabled = fake_dev_for(dd)->scan_enable;
+  return 0;
+}
+
+static int fake_write_scan_enable(int dd, uint8_t enabled, int to)
+{
+  fake_dev_for(dd)->scan_enable = enabled;
+  return 0;
+}
+
+static int fake_read_current_iac_lap(int dd, uint8_t * num_iac, uint8_t * lap, int to)
+{
+  struct fake_dev * dev = fake_dev_for(dd);
+
+  *num_iac = dev->iac_num;
+  memcpy(lap, dev->iac, dev->iac_num * 3);
+  return 0;
+}
+
+static int fake_write_current_iac_lap(int dd, uint8_t num_iac, uint8_t * lap, int to)
+{
+  struct fake_dev * dev = fake_dev_for(dd);
+
+  dev->iac_num = num_iac;
+  memcpy(dev->iac, lap, num_iac * 3);
+  return 0;
+}
+
+static int fake_read_simple_pairing_mode(int dd, uint8_t * mode, int to)
+{
+  *mode = fake_dev_for(dd)->simple_pairing_mode;
+  return 0;
+}
+
+static int fake_write_simple_pairing_mode(int dd, uint8_t mode, int to)
+{
+  fake_dev_for(dd)->simple_pairing_mode = mode;
+  return 0;
+}
+
+static int fake_inquiry(int device_id, int len, int num_rsp, const uint8_t * lap,
+  inquiry_info ** ii, long flags)
+{
+  return 0;
+}
+
+static int fake_read_remote_name(int dd, const bdaddr_t * bdaddr, int len, char * name, int to)
+{
+  return -1;
+}
+
+static const struct hci_ops hci_ops_fake =
+{
+  .open_dev = fake_open_dev,
+  .close_dev = fake_close_dev,
+  .devinfo = fake_devinfo,
+  .dev_down = fake_dev_down,
+  .dev_up = fake_dev_up,
+
+  .read_bd_addr = fake_read_bd_addr,
+  .write_bd_addr = fake_write_bd_addr,
+  .read_local_version = fake_read_local_version,
+  .read_local_name = fake_read_local_name,
+  .write_local_name = fake_write_local_name,
+  .read_class_of_dev = fake_read_class_of_dev,
+  .write_class_of_dev = fake_write_class_of_dev,
+  .read_scan_enable = fake_read_scan_enable,
+  .write_scan_enable = fake_write_scan_enable,
+  .read_current_iac_lap = fake_read_current_iac_lap,
+  .write_current_iac_lap = fake_write_current_iac_lap,
+  .read_simple_pairing_mode = fake_read_simple_pairing_mode,
+  .write_simple_pairing_mode = fake_write_simple_pairing_mode,
+
+  .inquiry = fake_inquiry,
+  .read_remote_name = fake_read_remote_name
+};
+
+static int is_original(int device_id)
+{
+  struct fake_dev * dev = &fake_devs[device_id];
+  char name[HCI_MAX_NAME_LENGTH];
+  bdaddr_t bdaddr;
+
+  snprintf(name, sizeof(name), "laptop-%d", device_id);
+  str2ba("00:1A:7D:DA:71:10", &bdaddr);
+  bdaddr.b[0] = device_id;
+
+  return !bacmp(&dev->bdaddr, &bdaddr) && !strcmp(dev->name, name) &&
+    dev->class == 0x0c010c && dev->scan_enable == SCAN_PAGE &&
+    dev->iac_num == 1 && dev->iac[0][0] == 0x33 &&
+    dev->simple_pairing_mode == 1;
+}
+
+static int looks_like_wiimote(int device_id)
+{
+  struct fake_dev * dev = &fake_devs[device_id];
+
+  return !strcmp(dev->name, "Nintendo RVL-CNT-01") && dev->class == 0x002504 &&
+    dev->scan_enable == (SCAN_INQUIRY | SCAN_PAGE) &&
+    dev->iac_num == 1 && dev->iac[0][0] == 0x00 &&
+    dev->simple_pairing_mode == 0 &&
+    dev->bdaddr.b[5] == 0x00 && dev->bdaddr.b[4] == 0x09 && dev->bdaddr.b[3] == 0xBF;
+}
+
+static void test_select()
+{
+  struct adapter adapter;
+  char straddr[18];
+
+  fake_reset();
+  adapter_init(&adapter, &hci_ops_fake);
+
+  CHECK(adapter_select(&adapter, NULL) == 0 && adapter.device_id == 0);
+  CHECK(adapter_select(&adapter, "1") == 0 && adapter.device_id == 1);
+  CHECK(adapter_select(&adapter, "hci2") == 0 && adapter.device_id == 2);
+
+  ba2str(&fake_devs[1].bdaddr, straddr);
+  CHECK(adapter_select(&adapter, straddr) == 0 && adapter.device_id == 1);
+
+  CHECK(adapter_select(&adapter, "hci7") < 0);
+  CHECK(adapter_select(&adapter, "hci") < 0);
+  CHECK(adapter_select(&adapter, "bogus") < 0);
+  CHECK(adapter_select(&adapter, "11:22:33:44:55:66") < 0);
+}
+
+static void test_round_trip()
+{
+  struct adapter adapter;
+
+  fake_reset();
+  adapter_init(&adapter, &hci_ops_fake);
+  adapter_select(&adapter, "hci1");
+
+  CHECK(set_up_device(&adapter) == 0);
+  CHECK(adapter.is_set_up);
+  CHECK(looks_like_wiimote(1));
+  CHECK(!bacmp(&adapter.bdaddr, &fake_devs[1].bdaddr));
+  CHECK(is_original(0) && is_original(2));
+
+  CHECK(restore_device(&adapter) == 0);
+  CHECK(!adapter.is_set_up);
+  CHECK(is_original(1));
+
+  //restoring twice is harmless
+  CHECK(restore_device(&adapter) == 0);
+  CHECK(is_original(1));
+}
+
+static void test_nintendo_address_kept()
+{
+  struct adapter adapter;
+
+  fake_reset();
+  str2ba("00:17:AB:01:02:03", &fake_devs[0].bdaddr);
+
+  adapter_init(&adapter, &hci_ops_fake);
+  CHECK(set_up_device(&adapter) == 0);
+  CHECK(fake_devs[0].bdaddr_writes == 0);
+  CHECK(restore_device(&adapter) == 0);
+  CHECK(fake_devs[0].bdaddr_writes == 0);
+}
+
+static void test_parallel()
+{
+  struct adapter adapters[4];
+  const char * devs[4] = { "hci0", "hci1", "hci2", "hci1" };
+  int i;
+
+  fake_reset();
+  for (i = 0; i < 4; i++)
+  {
+    adapter_init(&adapters[i], &hci_ops_fake);
+    adapter_select(&adapters[i], devs[i]);
+  }
+
+  CHECK(set_up_devices(adapters, 4) == 0);
+  for (i = 0; i < FAKE_DEV_COUNT; i++)
+  {
+    CHECK(looks_like_wiimote(i));
+  }
+
+  //a shared adapter is set up once and its twin sees the same address
+  CHECK(fake_devs[1].open_count == 1);
+  CHECK(!bacmp(&adapters[3].bdaddr, &adapters[1].bdaddr));
+
+  CHECK(restore_devices(adapters, 4) == 0);
+  for (i = 0; i < FAKE_DEV_COUNT; i++)
+  {
+    CHECK(is_original(i));
+  }
+  CHECK(fake_devs[1].open_count == 2);
+}
+
+static void test_parallel_failure()
+{
+  struct adapter adapters[FAKE_DEV_COUNT];
+  int i;
+
+  fake_reset();
+  fake_devs[2].fail_write_name = 1;
+
+  for (i = 0; i < FAKE_DEV_COUNT; i++)
+  {
+    adapter_init(&adapters[i], &hci_ops_fake);
+    adapters[i].device_id = i;
+  }
+
+  //one adapter failing leaves every adapter as it was
+  CHECK(set_up_devices(adapters, FAKE_DEV_COUNT) < 0);
+  for (i = 0; i < FAKE_DEV_COUNT; i++)
+  {
+    CHECK(!adapters[i].is_set_up);
+    CHECK(is_original(i));
+  }
+}
+
+//the host is powered off through its own adapter, there is no connection to
+//it in the fake so only the open is seen
+static void test_power_off()
+{
+  struct adapter adapter;
+  bdaddr_t host_bdaddr;
+
+  fake_reset();
+  adapter_init(&adapter, &hci_ops_fake);
+  adapter_select(&adapter, "hci2");
+  str2ba("00:19:1D:00:00:01", &host_bdaddr);
+
+  CHECK(power_off_host(&adapter, &host_bdaddr) < 0);
+  CHECK(fake_devs[2].open_count == 1);
+  CHECK(fake_devs[0].open_count == 0 && fake_devs[1].open_count == 0);
+}
+
+int main(int argc, char *argv[])
+{
+  test_select();
+  test_round_trip();
+  test_nintendo_address_kept();
+  test_parallel();
+  test_parallel_failure();
+  test_power_off();
+
+  return test_result("all adapter checks passed");
+}
@@ -1,259 +1,599 @@
 #include "input.h"
 
-#include "SDL/SDL.h"
+#include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "motion.h"
 
-int ir_up, ir_down, ir_left, ir_right,
-    steer_left, steer_right,
-    nunchuk_up, nunchuk_down, nunchuk_left, nunchuk_right,
-    classic_left_stick_up, classic_left_stick_down, classic_left_stick_left, classic_left_stick_right,
-    motionplus_up, motionplus_down, motionplus_left, motionplus_right, motionplus_slow;
-extern int show_reports;
-
 static const double pointer_margin = 0.5;
-float pointer_x = 0.5;
-float pointer_y = 0.5;
 
-int input_update(struct wiimote_state *state, struct input_source const * source)
+//report bits for each button, zero for buttons handled elsewhere
+static const uint16_t wiimote_button_bits[] =
 {
-  struct input_event event;
+  [INPUT_BUTTON_HOME] = WIIMOTE_BUTTON_HOME,
+  [INPUT_BUTTON_WIIMOTE_UP] = WIIMOTE_BUTTON_UP,
+  [INPUT_BUTTON_WIIMOTE_DOWN] = WIIMOTE_BUTTON_DOWN,
+  [INPUT_BUTTON_WIIMOTE_LEFT] = WIIMOTE_BUTTON_LEFT,
+  [INPUT_BUTTON_WIIMOTE_RIGHT] = WIIMOTE_BUTTON_RIGHT,
+  [INPUT_BUTTON_WIIMOTE_A] = WIIMOTE_BUTTON_A,
+  [INPUT_BUTTON_WIIMOTE_B] = WIIMOTE_BUTTON_B,
+  [INPUT_BUTTON_WIIMOTE_1] = WIIMOTE_BUTTON_ONE,
+  [INPUT_BUTTON_WIIMOTE_2] = WIIMOTE_BUTTON_TWO,
+  [INPUT_BUTTON_WIIMOTE_PLUS] = WIIMOTE_BUTTON_PLUS,
+  [INPUT_BUTTON_WIIMOTE_MINUS] = WIIMOTE_BUTTON_MINUS,
+};
 
-  float pointer_delta_x = 0, pointer_delta_y = 0;
+static const uint16_t classic_button_bits[] =
+{
+  [INPUT_BUTTON_CLASSIC_UP] = CLASSIC_BUTTON_UP,
+  [INPUT_BUTTON_CLASSIC_DOWN] = CLASSIC_BUTTON_DOWN,
+  [INPUT_BUTTON_CLASSIC_LEFT] = CLASSIC_BUTTON_LEFT,
+  [INPUT_BUTTON_CLASSIC_RIGHT] = CLASSIC_BUTTON_RIGHT,
+  [INPUT_BUTTON_CLASSIC_A] = CLASSIC_BUTTON_A,
+  [INPUT_BUTTON_CLASSIC_B] = CLASSIC_BUTTON_B,
+  [INPUT_BUTTON_CLASSIC_X] = CLASSIC_BUTTON_X,
+  [INPUT_BUTTON_CLASSIC_Y] = CLASSIC_BUTTON_Y,
+  [INPUT_BUTTON_CLASSIC_L] = CLASSIC_BUTTON_LTRIGGER,
+  [INPUT_BUTTON_CLASSIC_R] = CLASSIC_BUTTON_RTRIGGER,
+  [INPUT_BUTTON_CLASSIC_ZL] = CLASSIC_BUTTON_LZ,
+  [INPUT_BUTTON_CLASSIC_ZR] = CLASSIC_BUTTON_RZ,
+  [INPUT_BUTTON_CLASSIC_PLUS] = CLASSIC_BUTTON_PLUS,
+  [INPUT_BUTTON_CLASSIC_MINUS] = CLASSIC_BUTTON_MINUS,
+};
 
-  /* Loop through waiting messages and process them */
+//the default mappings reach as far as the digital motions, sticks that
+//aren't driven by a motion get their whole range
+static const struct input_axis_config default_axis_configs[INPUT_ANALOG_AXIS_COUNT] =
+{
+  [INPUT_ANALOG_AXIS_NUNCHUK_X] = { 0.05f, 1.0f, 28, 128, 228 },
+  [INPUT_ANALOG_AXIS_NUNCHUK_Y] = { 0.05f, 1.0f, 28, 128, 228 },
+  [INPUT_ANALOG_AXIS_CLASSIC_LS_X] = { 0.05f, 1.0f, 2, 32, 62 },
+  [INPUT_ANALOG_AXIS_CLASSIC_LS_Y] = { 0.05f, 1.0f, 2, 32, 62 },
+  [INPUT_ANALOG_AXIS_CLASSIC_RS_X] = { 0.05f, 1.0f, 0, 15, 31 },
+  [INPUT_ANALOG_AXIS_CLASSIC_RS_Y] = { 0.05f, 1.0f, 0, 15, 31 },
+  [INPUT_ANALOG_AXIS_CLASSIC_LT] = { 0.0f, 1.0f, 0, 0, 31 },
+  [INPUT_ANALOG_AXIS_CLASSIC_RT] = { 0.0f, 1.0f, 0, 0, 31 },
+  [INPUT_ANALOG_AXIS_MOTIONPLUS_YAW] = { 0.0f, 1.0f, 0, 0x1F7F, 0x3FFF },
+  [INPUT_ANALOG_AXIS_MOTIONPLUS_ROLL] = { 0.0f, 1.0f, 0, 0x1F7F, 0x3FFF },
+  [INPUT_ANALOG_AXIS_MOTIONPLUS_PITCH] = { 0.0f, 1.0f, 0, 0x1F7F, 0x3FFF },
+};
 
-  while (source->poll_event(&event))
+//largest value each axis field holds
+static const uint16_t axis_wire_max[INPUT_ANALOG_AXIS_COUNT] =
+{
+  [INPUT_ANALOG_AXIS_NUNCHUK_X] = 0xFF,
+  [INPUT_ANALOG_AXIS_NUNCHUK_Y] = 0xFF,
+  [INPUT_ANALOG_AXIS_CLASSIC_LS_X] = 0x3F,
+  [INPUT_ANALOG_AXIS_CLASSIC_LS_Y] = 0x3F,
+  [INPUT_ANALOG_AXIS_CLASSIC_RS_X] = 0x1F,
+  [INPUT_ANALOG_AXIS_CLASSIC_RS_Y] = 0x1F,
+  [INPUT_ANALOG_AXIS_CLASSIC_LT] = 0x1F,
+  [INPUT_ANALOG_AXIS_CLASSIC_RT] = 0x1F,
+  [INPUT_ANALOG_AXIS_MOTIONPLUS_YAW] = 0x3FFF,
+  [INPUT_ANALOG_AXIS_MOTIONPLUS_ROLL] = 0x3FFF,
+  [INPUT_ANALOG_AXIS_MOTIONPLUS_PITCH] = 0x3FFF,
+};
+
+#define AXIS_CENTER_INDEX (INPUT_AXIS_STEPS / 2)
+
+static int axis_index(float value)
+{
+  //NaN rests
+  if (value != value)
+  {
+    return AXIS_CENTER_INDEX;
+  }
+
+  value = fmaxf(-1.0f, fminf(1.0f, value));
+  return lrintf((value + 1.0f) * AXIS_CENTER_INDEX);
+}
+
+static void build_axis_lut(struct input_axis_map * map, enum input_analog_axis axis)
+{
+  struct input_axis_config const * config = &map->configs[axis];
+  float value, travel;
+  int i;
+
+  for (i = 0; i < INPUT_AXIS_LUT_SIZE; i++)
+  {
+    value = (float)(i - AXIS_CENTER_INDEX) / AXIS_CENTER_INDEX;
+
+    travel = fabsf(value);
+    if (travel <= config->deadzone)
+    {
+      travel = 0.0f;
+    }
+    else
+    {
+      travel = powf((travel - config->deadzone) / (1.0f - config->deadzone), config->curve);
+    }
+
+    if (value < 0)
+    {
+      map->luts[axis][i] = lrintf(config->center - travel * (config->center - config->min));
+    }
+    else
+    {
+      map->luts[axis][i] = lrintf(config->center + travel * (config->max - config->center));
+    }
+  }
+}
+
+void input_axis_map_init(struct input_axis_map * map)
+{
+  int i;
+
+  memcpy(map->configs, default_axis_configs, sizeof(map->configs));
+  for (i = 0; i < INPUT_ANALOG_AXIS_COUNT; i++)
+  {
+    build_axis_lut(map, i);
+  }
+}
+
+int input_set_axis_config(struct input_axis_map * map, enum input_analog_axis axis,
+  struct input_axis_config const * config)
+{
+  if ((unsigned)axis >= INPUT_ANALOG_AXIS_COUNT ||
+    !(config->deadzone >= 0.0f && config->deadzone < 1.0f) || !(config->curve > 0.0f) ||
+    config->min < 0 || config->min > config->center || config->center > config->max ||
+    config->max > axis_wire_max[axis])
+  {
+    return -1;
+  }
+
+  map->configs[axis] = *config;
+  build_axis_lut(map, axis);
+  return 0;
+}
+
+void input_get_axis_config(struct input_axis_map const * map, enum input_analog_axis axis,
+  struct input_axis_config * config)
+{
+  *config = map->configs[axis];
+}
+
+int input_axis_wire_value(struct input_axis_map const * map, enum input_analog_axis axis, float value)
+{
+  return map->luts[axis][axis_index(value)];
+}
+
+// Wire value of an axis, the digital motions push it further by offset
+static int axis_wire_value(struct input_state const * input, enum input_analog_axis axis, int offset)
+{
+  int value = input->axis_map->luts[axis][input->axis[axis]] + offset;
+
+  return (value < 0) ? 0 : (value > axis_wire_max[axis]) ? axis_wire_max[axis] : value;
+}
+
+#define SAMPLE(Input, Index) (&(Input)->samples[((Input)->sample_head + (Index)) % INPUT_SAMPLES])
+
+void input_init(struct input_state * input, struct input_axis_map const * axis_map)
+{
+  int i;
+
+  memset(input, 0, sizeof(struct input_state));
+  input->axis_map = axis_map;
+
+  input->pointer_x = 0.5;
+  input->pointer_y = 0.5;
+
+  for (i = 0; i < INPUT_ANALOG_AXIS_COUNT; i++)
+  {
+    input->axis[i] = AXIS_CENTER_INDEX;
+  }
+
+  memcpy(input->samples[0].axis, input->axis, sizeof(input->axis));
+  input->sample_count = 1;
+}
+
+// The sample a stamped event changes, a copy of the newest one at its time
+static struct input_sample * push_sample(struct input_state * input, uint64_t time_us)
+{
+  struct input_sample * last = SAMPLE(input, input->sample_count - 1), * next;
+
+  //stamps older than the newest sample count as its time
+  if (time_us < last->time_us)
   {
-    switch (event.type)
+    time_us = last->time_us;
+  }
+
+  //the sample the last tick left off at stays put, a full ring folds the
+  //event into the newest sample
+  if (input->sample_count > 1 && (time_us == last->time_us || input->sample_count == INPUT_SAMPLES))
+  {
+    last->time_us = time_us;
+    return last;
+  }
+
+  next = SAMPLE(input, input->sample_count);
+  *next = *last;
+  next->time_us = time_us;
+  input->sample_count++;
+  return next;
+}
+
+// Moves the first sample up to time_us, interpolating between the samples
+// on either side, and drops the samples passed
+static void sample_at(struct input_state * input, uint64_t time_us)
+{
+  struct input_sample * from, * to;
+  float dx, dy, f;
+  int i, k;
+
+  if (time_us < SAMPLE(input, 0)->time_us)
+  {
+    time_us = SAMPLE(input, 0)->time_us;
+  }
+
+  for (k = 0; k + 1 < input->sample_count && SAMPLE(input, k + 1)->time_us <= time_us; k++)
+  {
+  }
+
+  from = SAMPLE(input, k);
+  dx = from->pointer_dx;
+  dy = from->pointer_dy;
+
+  if (k + 1 < input->sample_count)
+  {
+    to = SAMPLE(input, k + 1);
+    f = (float)(time_us - from->time_us) / (to->time_us - from->time_us);
+
+    dx += f * (to->pointer_dx - from->pointer_dx);
+    dy += f * (to->pointer_dy - from->pointer_dy);
+    for (i = 0; i < INPUT_ANALOG_AXIS_COUNT; i++)
+    {
+      from->axis[i] += lrintf(f * ((int)to->axis[i] - from->axis[i]));
+    }
+  }
+
+  input->sample_head = (input->sample_head + k) % INPUT_SAMPLES;
+  input->sample_count -= k;
+
+  //later samples move on from here
+  for (i = 0; i < input->sample_count; i++)
+  {
+    SAMPLE(input, i)->pointer_dx -= dx;
+    SAMPLE(input, i)->pointer_dy -= dy;
+  }
+  from->pointer_dx = 0;
+  from->pointer_dy = 0;
+  from->time_us = time_us;
+
+  input->pointer_delta_x += dx;
+  input->pointer_delta_y += dy;
+  memcpy(input->axis, from->axis, sizeof(input->axis));
+}
+
+int input_process_event(struct wiimote_state *state, struct input_state * input,
+  struct input_event const * event)
+{
+  switch (event->type)
+  {
+  case INPUT_EVENT_TYPE_EMULATOR_CONTROL:
+    switch (event->emulator_control_event.control)
     {
-    case INPUT_EVENT_TYPE_EMULATOR_CONTROL:
-      switch (event.emulator_control_event.control)
+    case INPUT_EMULATOR_CONTROL_QUIT:
+      return -1;
+    case INPUT_EMULATOR_CONTROL_POWER_OFF:
+      return -2;
+    case INPUT_EMULATOR_CONTROL_TOGGLE_REPORTS:
+      input->show_reports = !input->show_reports;
+      break;
+    }
+    break;
+  case INPUT_EVENT_TYPE_HOTPLUG:
+    switch (event->hotplug_event.extension)
+    {
+    case Nunchuk:
+      reset_input_nunchuk(&state->usr.nunchuk);
+      reset_input_ir(state->usr.ir_object);
+      break;
+    case Classic:
+      reset_input_classic(&state->usr.classic);
+      reset_input_ir(state->usr.ir_object);
+      break;
+    case BalanceBoard:
+      reset_input_ir(state->usr.ir_object);
+      break;
+    case NoExtension:
+      reset_input_ir(state->usr.ir_object);
+      input->pointer_x = 0.5;
+      input->pointer_y = 0.5;
+      break;
+    default:
+      goto invalid;
+    }
+
+    state->usr.connected_extension_type = event->hotplug_event.extension;
+  invalid:
+    break;
+  case INPUT_EVENT_TYPE_BUTTON: {
+    bool pressed = event->button_event.pressed;
+    enum input_button button = event->button_event.button;
+
+    if (button < sizeof(wiimote_button_bits) / sizeof(wiimote_button_bits[0]) &&
+      wiimote_button_bits[button] != 0)
+    {
+      if (pressed)
       {
-      case INPUT_EMULATOR_CONTROL_QUIT:
-        return -1;
-      case INPUT_EMULATOR_CONTROL_POWER_OFF:
-        return -2;
-      case INPUT_EMULATOR_CONTROL_TOGGLE_REPORTS:
-        show_reports = (show_reports + 1) % 2;
-        break;
+        state->usr.buttons |= wiimote_button_bits[button];
       }
-      break;
-    case INPUT_EVENT_TYPE_HOTPLUG:
-      switch (event.hotplug_event.extension)
+      else
       {
-      case Nunchuk:
-        reset_input_nunchuk(&state->usr.nunchuk);
-        reset_input_ir(state->usr.ir_object);
-        break;
-      case Classic:
-        reset_input_classic(&state->usr.classic);
-        reset_input_ir(state->usr.ir_object);
-        break;
-      case BalanceBoard:
-        reset_input_ir(state->usr.ir_object);
-        break;
-      case NoExtension:
-        reset_input_ir(state->usr.ir_object);
-        pointer_x = 0.5;
-        pointer_y = 0.5;
-        break;
-      default:
-        goto invalid;
+        state->usr.buttons &= ~wiimote_button_bits[button];
       }
-
-      state->usr.connected_extension_type = event.hotplug_event.extension;
-    invalid:
-      break;
-    case INPUT_EVENT_TYPE_BUTTON: {
-      bool pressed = event.button_event.pressed;
-      switch (event.button_event.button)
+    }
+    else if (button < sizeof(classic_button_bits) / sizeof(classic_button_bits[0]) &&
+      classic_button_bits[button] != 0)
+    {
+      //active low
+      if (pressed)
       {
-      case INPUT_BUTTON_HOME:
-        state->usr.home = pressed;
-        break;
-
-      case INPUT_BUTTON_WIIMOTE_UP:
-        state->usr.up = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_DOWN:
-        state->usr.down = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_LEFT:
-        state->usr.left = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_RIGHT:
-        state->usr.right = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_A:
-        state->usr.a = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_B:
-        state->usr.b = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_1:
-        state->usr.one = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_2:
-        state->usr.two = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_PLUS:
-        state->usr.plus = pressed;
-        break;
-      case INPUT_BUTTON_WIIMOTE_MINUS:
-        state->usr.minus = pressed;
+        state->usr.classic.buttons &= ~classic_button_bits[button];
+      }
+      else
+      {
+        state->usr.classic.buttons |= classic_button_bits[button];
+      }
+    }
+    else if (button == INPUT_BUTTON_NUNCHUK_C)
+    {
+      state->usr.nunchuk.c = pressed;
+    }
+    else if (button == INPUT_BUTTON_NUNCHUK_Z)
+    {
+      state->usr.nunchuk.z = pressed;
+    }
+    else
+    {
+      printf("warning: button %d not handled by input_process_event\n", button);
+    }
+    break;
+  }
+  case INPUT_EVENT_TYPE_ANALOG_MOTION: {
+    bool moving = event->analog_motion_event.moving;
+    switch (event->analog_motion_event.motion)
+    {
+      case INPUT_ANALOG_MOTION_POINTER:
+        if (event->timestamp_us != 0)
+        {
+          struct input_sample * sample = push_sample(input, event->timestamp_us);
+          sample->pointer_dx += event->analog_motion_event.delta_x;
+          sample->pointer_dy += event->analog_motion_event.delta_y;
+        }
+        else
+        {
+          input->pointer_delta_x += event->analog_motion_event.delta_x;
+          input->pointer_delta_y += event->analog_motion_event.delta_y;
+        }
+        break;
+      case INPUT_ANALOG_MOTION_IR_UP:
+        input->ir_up = moving;
+        break;
+      case INPUT_ANALOG_MOTION_IR_DOWN:
+        input->ir_down = moving;
+        break;
+      case INPUT_ANALOG_MOTION_IR_LEFT:
+        input->ir_left = moving;
+        break;
+      case INPUT_ANALOG_MOTION_IR_RIGHT:
+        input->ir_right = moving;
         break;
 
-      case INPUT_BUTTON_NUNCHUK_C:
-        state->usr.nunchuk.c = pressed;
+      case INPUT_ANALOG_MOTION_STEER_LEFT:
+        input->steer_left = moving;
         break;
-      case INPUT_BUTTON_NUNCHUK_Z:
-        state->usr.nunchuk.z = pressed;
+      case INPUT_ANALOG_MOTION_STEER_RIGHT:
+        input->steer_right = moving;
         break;
 
-      case INPUT_BUTTON_CLASSIC_UP:
-        state->usr.classic.up = pressed;
+      case INPUT_ANALOG_MOTION_NUNCHUK_UP:
+        input->nunchuk_up = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_DOWN:
-        state->usr.classic.down = pressed;
+      case INPUT_ANALOG_MOTION_NUNCHUK_DOWN:
+        input->nunchuk_down = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_LEFT:
-        state->usr.classic.left = pressed;
+      case INPUT_ANALOG_MOTION_NUNCHUK_LEFT:
+        input->nunchuk_left = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_RIGHT:
-        state->usr.classic.right = pressed;
+      case INPUT_ANALOG_MOTION_NUNCHUK_RIGHT:
+        input->nunchuk_right = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_A:
-        state->usr.classic.a = pressed;
-        break;
-      case INPUT_BUTTON_CLASSIC_B:
-        state->usr.classic.b = pressed;
-        break;
-      case INPUT_BUTTON_CLASSIC_X:
-        state->usr.classic.x = pressed;
+
+      case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_UP:
+        input->classic_left_stick_up = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_Y:
-        state->usr.classic.y = pressed;
+      case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_DOWN:
+        input->classic_left_stick_down = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_L:
-        state->usr.classic.ltrigger = pressed;
+      case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_LEFT:
+        input->classic_left_stick_left = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_R:
-        state->usr.classic.rtrigger = pressed;
+      case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_RIGHT:
+        input->classic_left_stick_right = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_ZL:
-        state->usr.classic.lz = pressed;
+
+      case INPUT_ANALOG_MOTION_MOTIONPLUS_UP:
+        input->motionplus_up = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_ZR:
-        state->usr.classic.rz = pressed;
+      case INPUT_ANALOG_MOTION_MOTIONPLUS_DOWN:
+        input->motionplus_down = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_PLUS:
-        state->usr.classic.plus = pressed;
+      case INPUT_ANALOG_MOTION_MOTIONPLUS_LEFT:
+        input->motionplus_left = moving;
         break;
-      case INPUT_BUTTON_CLASSIC_MINUS:
-        state->usr.classic.minus = pressed;
+      case INPUT_ANALOG_MOTION_MOTIONPLUS_RIGHT:
+        input->motionplus_right = moving;
         break;
-      default:
-        printf("warning: button %d not handled by input_update\n", event.button_event.button);
+      case INPUT_ANALOG_MOTION_MOTIONPLUS_SLOW:
+        input->motionplus_slow = moving;
         break;
-      }
-      break;
     }
-    case INPUT_EVENT_TYPE_ANALOG_MOTION: {
-      bool moving = event.analog_motion_event.moving;
-      switch (event.analog_motion_event.motion)
-      {
-        case INPUT_ANALOG_MOTION_POINTER:
-          pointer_delta_x = event.analog_motion_event.delta_x;
-          pointer_delta_y = event.analog_motion_event.delta_y;
-          break;
-        case INPUT_ANALOG_MOTION_IR_UP:
-          ir_up = moving;
-          break;
-        case INPUT_ANALOG_MOTION_IR_DOWN:
-          ir_down = moving;
-          break;
-        case INPUT_ANALOG_MOTION_IR_LEFT:
-          ir_left = moving;
-          break;
-        case INPUT_ANALOG_MOTION_IR_RIGHT:
-          ir_right = moving;
-          break;
-
-        case INPUT_ANALOG_MOTION_STEER_LEFT:
-          steer_left = moving;
-          break;
-        case INPUT_ANALOG_MOTION_STEER_RIGHT:
-          steer_right = moving;
-          break;
-
-        case INPUT_ANALOG_MOTION_NUNCHUK_UP:
-          nunchuk_up = moving;
-          break;
-        case INPUT_ANALOG_MOTION_NUNCHUK_DOWN:
-          nunchuk_down = moving;
-          break;
-        case INPUT_ANALOG_MOTION_NUNCHUK_LEFT:
-          nunchuk_left = moving;
-          break;
-        case INPUT_ANALOG_MOTION_NUNCHUK_RIGHT:
-          nunchuk_right = moving;
-          break;
-
-        case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_UP:
-          classic_left_stick_up = moving;
-          break;
-        case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_DOWN:
-          classic_left_stick_down = moving;
-          break;
-        case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_LEFT:
-          classic_left_stick_left = moving;
-          break;
-        case INPUT_ANALOG_MOTION_CLASSIC_LEFT_STICK_RIGHT:
-          classic_left_stick_right = moving;
-          break;
-
-        case INPUT_ANALOG_MOTION_MOTIONPLUS_UP:
-          motionplus_up = moving;
-          break;
-        case INPUT_ANALOG_MOTION_MOTIONPLUS_DOWN:
-          motionplus_down = moving;
-          break;
-        case INPUT_ANALOG_MOTION_MOTIONPLUS_LEFT:
-          motionplus_left = moving;
-          break;
-        case INPUT_ANALOG_MOTION_MOTIONPLUS_RIGHT:
-          motionplus_right = moving;
-          break;
-        case INPUT_ANALOG_MOTION_MOTIONPLUS_SLOW:
-          motionplus_slow = moving;
-          break;
-      }
+    break;
+  }
+  case INPUT_EVENT_TYPE_ANALOG_AXIS: {
+    enum input_analog_axis axis = event->analog_axis_event.axis;
+    int i, index = axis_index(event->analog_axis_event.value);
+
+    if ((unsigned)axis >= INPUT_ANALOG_AXIS_COUNT)
+    {
       break;
     }
-    default:
+
+    if (event->timestamp_us != 0)
+    {
+      push_sample(input, event->timestamp_us)->axis[axis] = index;
       break;
     }
+
+    //unstamped, so it holds from now on
+    input->axis[axis] = index;
+    for (i = 0; i < input->sample_count; i++)
+    {
+      SAMPLE(input, i)->axis[axis] = index;
+    }
+    break;
+  }
+  default:
+    break;
   }
 
-  pointer_delta_x += ir_right * 0.004 - ir_left * 0.004;
-  pointer_delta_y += ir_up * 0.004 - ir_down * 0.004;
+  return 0;
+}
+
+static void tick(struct wiimote_state *state, struct input_state * input, uint64_t sample_time_us)
+{
+  sample_at(input, sample_time_us);
 
-  pointer_x = fmax(-pointer_margin, fmin(1.0 + pointer_margin, pointer_x + pointer_delta_x));
-  pointer_y = fmax(-pointer_margin, fmin(1.0 + pointer_margin, pointer_y + pointer_delta_y));
+  float pointer_delta_x = input->pointer_delta_x + input->ir_right * 0.004 - input->ir_left * 0.004;
+  float pointer_delta_y = input->pointer_delta_y + input->ir_up * 0.004 - input->ir_down * 0.004;
 
-  set_motion_state(state, pointer_x, pointer_y);
+  input->pointer_delta_x = 0;
+  input->pointer_delta_y = 0;
 
-  state->usr.nunchuk.x = 128 + nunchuk_right * 100 - nunchuk_left * 100;
-  state->usr.nunchuk.y = 128 + nunchuk_up * 100 - nunchuk_down * 100;
+  input->pointer_x = fmax(-pointer_margin, fmin(1.0 + pointer_margin, input->pointer_x + pointer_delta_x));
+  input->pointer_y = fmax(-pointer_margin, fmin(1.0 + pointer_margin, input->pointer_y + pointer_delta_y));
 
-  state->usr.classic.ls_x = 32 + classic_left_stick_right * 30 - classic_left_stick_left * 30;
-  state->usr.classic.ls_y = 32 + classic_left_stick_up * 30 - classic_left_stick_down * 30;
+  set_motion_state(state, input->pointer_x, input->pointer_y);
 
-  state->usr.motionplus.pitch_left = 0x1F7F + motionplus_down * 800 * (1 + !motionplus_slow) - motionplus_up * 800 * (1 + !motionplus_slow);
-  state->usr.motionplus.yaw_down = 0x1F7F + motionplus_left * 800 * (1 + !motionplus_slow) - motionplus_right * 800 * (1 + !motionplus_slow);
-  state->usr.motionplus.pitch_slow = motionplus_slow;
-  state->usr.motionplus.yaw_slow = motionplus_slow;
+  state->usr.nunchuk.x = axis_wire_value(input, INPUT_ANALOG_AXIS_NUNCHUK_X,
+    input->nunchuk_right * 100 - input->nunchuk_left * 100);
+  state->usr.nunchuk.y = axis_wire_value(input, INPUT_ANALOG_AXIS_NUNCHUK_Y,
+    input->nunchuk_up * 100 - input->nunchuk_down * 100);
 
-  return 0;
+  state->usr.classic.ls_x = axis_wire_value(input, INPUT_ANALOG_AXIS_CLASSIC_LS_X,
+    input->classic_left_stick_right * 30 - input->classic_left_stick_left * 30);
+  state->usr.classic.ls_y = axis_wire_value(input, INPUT_ANALOG_AXIS_CLASSIC_LS_Y,
+    input->classic_left_stick_up * 30 - input->classic_left_stick_down * 30);
+  state->usr.classic.rs_x = axis_wire_value(input, INPUT_ANALOG_AXIS_CLASSIC_RS_X, 0);
+  state->usr.classic.rs_y = axis_wire_value(input, INPUT_ANALOG_AXIS_CLASSIC_RS_Y, 0);
+  state->usr.classic.lt = axis_wire_value(input, INPUT_ANALOG_AXIS_CLASSIC_LT, 0);
+  state->usr.classic.rt = axis_wire_value(input, INPUT_ANALOG_AXIS_CLASSIC_RT, 0);
+
+  int motionplus_speed = 800 * (1 + !input->motionplus_slow);
+  state->usr.motionplus.pitch_left = axis_wire_value(input, INPUT_ANALOG_AXIS_MOTIONPLUS_PITCH,
+    input->motionplus_down * motionplus_speed - input->motionplus_up * motionplus_speed);
+  state->usr.motionplus.yaw_down = axis_wire_value(input, INPUT_ANALOG_AXIS_MOTIONPLUS_YAW,
+    input->motionplus_left * motionplus_speed - input->motionplus_right * motionplus_speed);
+  state->usr.motionplus.roll_left = axis_wire_value(input, INPUT_ANALOG_AXIS_MOTIONPLUS_ROLL, 0);
+  state->usr.motionplus.pitch_slow = input->motionplus_slow;
+  state->usr.motionplus.yaw_slow = input->motionplus_slow;
+}
+
+void input_tick(struct wiimote_state *state, struct input_state * input)
+{
+  tick(state, input, SAMPLE(input, input->sample_count - 1)->time_us);
+}
+
+void input_tick_at(struct wiimote_state *state, struct input_state * input, uint64_t now_us)
+{
+  tick(state, input, (now_us > input->sample_delay_us) ? now_us - input->sample_delay_us : 0);
+}
+
+// Hands the source each player's rumble, LEDs and reporting mode if they
+// changed since it was last given them
+static void give_feedback(struct wiimote_state * const states[],
+  struct input_state * const inputs[], int count, struct input_source const * source)
+{
+  struct input_feedback feedback;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    feedback.rumble = states[i]->sys.rumble;
+    feedback.leds = states[i]->sys.led_1 | states[i]->sys.led_2 << 1 |
+      states[i]->sys.led_3 << 2 | states[i]->sys.led_4 << 3;
+    //interleaved reports switch halves on every report
+    feedback.reporting_mode = (states[i]->sys.reporting_mode == 0x3f) ? 0x3e : states[i]->sys.reporting_mode;
+
+    if (inputs[i]->feedback_given && feedback.rumble == inputs[i]->feedback.rumble &&
+      feedback.leds == inputs[i]->feedback.leds &&
+      feedback.reporting_mode == inputs[i]->feedback.reporting_mode)
+    {
+      continue;
+    }
+
+    inputs[i]->feedback = feedback;
+    inputs[i]->feedback_given = true;
+    source->feedback(i, &feedback);
+  }
+}
+
+int input_update_players_at(struct wiimote_state * const states[],
+  struct input_state * const inputs[], int count, struct input_source const * source,
+  uint64_t now_us)
+{
+  struct input_event event;
+  int i, result;
+
+  /* Loop through waiting messages and hand them to their player */
+
+  event.player = 0;
+  event.timestamp_us = 0;
+  while (source->poll_event(&event))
+  {
+    if (event.player >= 0 && event.player < count)
+    {
+      result = input_process_event(states[event.player], inputs[event.player], &event);
+      if (result)
+      {
+        return result;
+      }
+    }
+
+    event.player = 0;
+    event.timestamp_us = 0;
+  }
+
+  if (source->update_players != NULL)
+  {
+    result = source->update_players(states, count);
+  }
+  else
+  {
+    for (i = 0; i < count; i++)
+    {
+      input_tick_at(states[i], inputs[i], now_us);
+    }
+    result = 0;
+  }
+
+  if (source->feedback != NULL)
+  {
+    give_feedback(states, inputs, count, source);
+  }
+
+  return result;
+}
+
+int input_update_players(struct wiimote_state * const states[],
+  struct input_state * const inputs[], int count, struct input_source const * source)
+{
+  return input_update_players_at(states, inputs, count, source, wm_clock_monotonic(NULL));
+}
+
+int input_update(struct wiimote_state *state, struct input_state * input,
+  struct input_source const * source)
+{
+  return input_update_players(&state, &input, 1, source);
 }
@@ -12,6 +12,7 @@ enum input_event_type
     INPUT_EVENT_TYPE_HOTPLUG,
     INPUT_EVENT_TYPE_BUTTON,
     INPUT_EVENT_TYPE_ANALOG_MOTION,
+    INPUT_EVENT_TYPE_ANALOG_AXIS,
 };
 
 enum input_emulator_control
@@ -110,23 +111,177 @@ struct input_analog_motion_event
     enum input_analog_motion motion;
 };
 
+enum input_analog_axis
+{
+    INPUT_ANALOG_AXIS_NUNCHUK_X,
+    INPUT_ANALOG_AXIS_NUNCHUK_Y,
+
+    INPUT_ANALOG_AXIS_CLASSIC_LS_X,
+    INPUT_ANALOG_AXIS_CLASSIC_LS_Y,
+    INPUT_ANALOG_AXIS_CLASSIC_RS_X,
+    INPUT_ANALOG_AXIS_CLASSIC_RS_Y,
+    INPUT_ANALOG_AXIS_CLASSIC_LT,
+    INPUT_ANALOG_AXIS_CLASSIC_RT,
+
+    INPUT_ANALOG_AXIS_MOTIONPLUS_YAW,
+    INPUT_ANALOG_AXIS_MOTIONPLUS_ROLL,
+    INPUT_ANALOG_AXIS_MOTIONPLUS_PITCH,
+
+    INPUT_ANALOG_AXIS_COUNT
+};
+
+// Absolute position of an axis: -1 to 1 for sticks (right and up positive)
+// and MotionPlus rates (positive raises the wire value), 0 to 1 for triggers
+struct input_analog_axis_event
+{
+    float value;
+    enum input_analog_axis axis;
+};
+
+// How an axis value becomes a wire value. Values within the dead zone read as
+// the centre, the rest of the travel is raised to the curve exponent and
+// scaled to min or max.
+struct input_axis_config
+{
+    float deadzone; // fraction of the travel, 0 to 1
+    float curve; // 1 is linear
+    int min, center, max; // wire values at -1, 0 and 1
+};
+
+// Axis values are quantized to this many steps across -1 to 1, the lookup
+// tables hold one wire value per step
+#define INPUT_AXIS_STEPS 1024
+#define INPUT_AXIS_LUT_SIZE (INPUT_AXIS_STEPS + 1)
+
+// The mapping of every axis with its lookup tables. Owned by the caller and
+// only read while reports are built, so one map can be shared by many
+// controllers and threads as long as it isn't changed meanwhile.
+struct input_axis_map
+{
+    struct input_axis_config configs[INPUT_ANALOG_AXIS_COUNT];
+    uint16_t luts[INPUT_ANALOG_AXIS_COUNT][INPUT_AXIS_LUT_SIZE];
+};
+
+#define INPUT_MAX_PLAYERS 4
+
 struct input_event
 {
     enum input_event_type type;
+    int player; // 0-based controller slot the event is meant for
+    // When it happened, microseconds of CLOCK_MONOTONIC; 0 applies the event
+    // on the next tick
+    uint64_t timestamp_us;
     union {
         struct input_emulator_control_event emulator_control_event;
         struct input_hotplug_event hotplug_event;
         struct input_button_event button_event;
         struct input_analog_motion_event analog_motion_event;
+        struct input_analog_axis_event analog_axis_event;
     };
 };
 
+// What the host last set on a controller, for sources that can pass it on
+struct input_feedback
+{
+    bool rumble;
+    uint8_t leds; // bit 0 is LED 1
+    uint8_t reporting_mode; // 0x3e for both halves of the interleaved mode
+};
+
 struct input_source
 {
     void (*unload)(void);
     bool (*poll_event)(struct input_event *event);
+    // Optional: sources that keep whole controller states write them here
+    // after the events, instead of the per-player input_tick
+    int (*update_players)(struct wiimote_state * const states[], int count);
+    // Optional: blocks until poll_event may have something or timeout_ms
+    // passes, for sources polled on their own thread
+    void (*wait_event)(int timeout_ms);
+    // Optional: given a player's feedback at the end of an update that
+    // changed it, so at most once per report
+    void (*feedback)(int player, struct input_feedback const *feedback);
 };
 
-int input_update(struct wiimote_state * state, struct input_source const * source);
+// Timestamped pointer and axis positions, kept until the reports pass them
+#define INPUT_SAMPLES 32
+
+struct input_sample
+{
+    uint64_t time_us;
+    // Pointer movement from the first sample on
+    float pointer_dx;
+    float pointer_dy;
+    uint16_t axis[INPUT_ANALOG_AXIS_COUNT];
+};
+
+// Per-controller input tracking (held motions, pointer position)
+struct input_state
+{
+    bool ir_up, ir_down, ir_left, ir_right;
+    bool steer_left, steer_right;
+    bool nunchuk_up, nunchuk_down, nunchuk_left, nunchuk_right;
+    bool classic_left_stick_up, classic_left_stick_down,
+         classic_left_stick_left, classic_left_stick_right;
+    bool motionplus_up, motionplus_down, motionplus_left, motionplus_right,
+         motionplus_slow;
+
+    float pointer_x;
+    float pointer_y;
+    float pointer_delta_x;
+    float pointer_delta_y;
+
+    // Lookup table index of the last value of each axis
+    uint16_t axis[INPUT_ANALOG_AXIS_COUNT];
+    struct input_axis_map const * axis_map;
+
+    // samples[sample_head] is where the last tick left off, the others are
+    // stamped events still ahead of it, in time order
+    struct input_sample samples[INPUT_SAMPLES];
+    int sample_head, sample_count;
+    // How far behind the send time reports look, so that they fall between
+    // two samples instead of past the last one
+    uint64_t sample_delay_us;
+
+    // The feedback last given to the source
+    struct input_feedback feedback;
+    bool feedback_given;
+
+    bool show_reports;
+};
+
+// axis_map has to outlive the input state
+void input_init(struct input_state * input, struct input_axis_map const * axis_map);
+
+// Fills in the default mapping of every axis
+void input_axis_map_init(struct input_axis_map * map);
+// Replaces the mapping of an axis for every player using the map, rebuilding
+// its lookup table. Returns -1 for an unknown axis or a config out of range.
+int input_set_axis_config(struct input_axis_map * map, enum input_analog_axis axis,
+    struct input_axis_config const * config);
+void input_get_axis_config(struct input_axis_map const * map, enum input_analog_axis axis,
+    struct input_axis_config * config);
+// Wire value of an axis value under the map
+int input_axis_wire_value(struct input_axis_map const * map, enum input_analog_axis axis, float value);
+
+int input_process_event(struct wiimote_state * state, struct input_state * input,
+    struct input_event const * event);
+// Updates the controller state with every event processed so far
+void input_tick(struct wiimote_state * state, struct input_state * input);
+// Updates the controller state for a report sent at now_us: stamped pointer
+// and axis events are interpolated at now_us - sample_delay_us, later ones
+// wait for a later report
+void input_tick_at(struct wiimote_state * state, struct input_state * input, uint64_t now_us);
+
+// Polls the source and routes each event to its player's controller, then
+// ticks every player for reports sent at now_us
+int input_update_players_at(struct wiimote_state * const states[],
+    struct input_state * const inputs[], int count, struct input_source const * source,
+    uint64_t now_us);
+// The same for reports sent now on CLOCK_MONOTONIC
+int input_update_players(struct wiimote_state * const states[],
+    struct input_state * const inputs[], int count, struct input_source const * source);
+int input_update(struct wiimote_state * state, struct input_state * input,
+    struct input_source const * source);
 
 #endif
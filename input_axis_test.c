@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "wiimote.h"
+#include "input.h"
+#include "test.h"
+
+// Drives every analog axis through input_process_event and input_tick and
+// checks the wire values against the axis mappings: defaults, dead zone,
+// curve and calibration, and the digital motions on top.
+
+static struct wiimote_state state;
+static struct input_state input;
+static struct input_axis_map axis_map;
+
+static void send_axis(enum input_analog_axis axis, float value)
+{
+  struct input_event event;
+
+  memset(&event, 0, sizeof(event));
+  event.type = INPUT_EVENT_TYPE_ANALOG_AXIS;
+  event.analog_axis_event.axis = axis;
+  event.analog_axis_event.value = value;
+  CHECK(input_process_event(&state, &input, &event) == 0);
+}
+
+static void send_motion(enum input_analog_motion motion, bool moving)
+{
+  struct input_event event;
+
+  memset(&event, 0, sizeof(event));
+  event.type = INPUT_EVENT_TYPE_ANALOG_MOTION;
+  event.analog_motion_event.motion = motion;
+  event.analog_motion_event.moving = moving;
+  CHECK(input_process_event(&state, &input, &event) == 0);
+}
+
+//at rest the tick writes what reset_input_* does
+static void test_rest()
+{
+  struct wiimote_state reset;
+
+  wiimote_init(&reset);
+  input_tick(&state, &input);
+
+  CHECK(state.usr.nunchuk.x == reset.usr.nunchuk.x);
+  CHECK(state.usr.nunchuk.y == reset.usr.nunchuk.y);
+  CHECK(state.usr.classic.ls_x == reset.usr.classic.ls_x);
+  CHECK(state.usr.classic.ls_y == reset.usr.classic.ls_y);
+  CHECK(state.usr.classic.rs_x == reset.usr.classic.rs_x);
+  CHECK(state.usr.classic.rs_y == reset.usr.classic.rs_y);
+  CHECK(state.usr.classic.lt == reset.usr.classic.lt);
+  CHECK(state.usr.classic.rt == reset.usr.classic.rt);
+  CHECK(state.usr.motionplus.yaw_down == reset.usr.motionplus.yaw_down);
+  CHECK(state.usr.motionplus.roll_left == reset.usr.motionplus.roll_left);
+  CHECK(state.usr.motionplus.pitch_left == reset.usr.motionplus.pitch_left);
+
+  wiimote_destroy(&reset);
+}
+
+//full travel reaches as far as the digital motions, which still add on top
+static void test_defaults()
+{
+  send_axis(INPUT_ANALOG_AXIS_NUNCHUK_X, 1.0f);
+  send_axis(INPUT_ANALOG_AXIS_NUNCHUK_Y, -1.0f);
+  send_axis(INPUT_ANALOG_AXIS_CLASSIC_LS_X, -1.0f);
+  send_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_Y, 1.0f);
+  send_axis(INPUT_ANALOG_AXIS_CLASSIC_LT, 0.5f);
+  send_axis(INPUT_ANALOG_AXIS_CLASSIC_RT, -1.0f);
+  send_axis(INPUT_ANALOG_AXIS_MOTIONPLUS_ROLL, 1.0f);
+  input_tick(&state, &input);
+
+  CHECK(state.usr.nunchuk.x == 228);
+  CHECK(state.usr.nunchuk.y == 28);
+  CHECK(state.usr.classic.ls_x == 2);
+  CHECK(state.usr.classic.rs_y == 31);
+  CHECK(state.usr.classic.lt == 16);
+  CHECK(state.usr.classic.rt == 0);
+  CHECK(state.usr.motionplus.roll_left == 0x3FFF);
+
+  //values past the ends are held there, NaN rests
+  send_axis(INPUT_ANALOG_AXIS_NUNCHUK_X, 7.0f);
+  send_axis(INPUT_ANALOG_AXIS_NUNCHUK_Y, NAN);
+  send_motion(INPUT_ANALOG_MOTION_NUNCHUK_RIGHT, true);
+  input_tick(&state, &input);
+  CHECK(state.usr.nunchuk.x == 255);
+  CHECK(state.usr.nunchuk.y == 128);
+
+  send_axis(INPUT_ANALOG_AXIS_NUNCHUK_X, -0.5f);
+  input_tick(&state, &input);
+  CHECK(state.usr.nunchuk.x == input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, -0.5f) + 100);
+  send_motion(INPUT_ANALOG_MOTION_NUNCHUK_RIGHT, false);
+
+  send_axis(INPUT_ANALOG_AXIS_MOTIONPLUS_PITCH, -1.0f);
+  send_motion(INPUT_ANALOG_MOTION_MOTIONPLUS_UP, true);
+  input_tick(&state, &input);
+  CHECK(state.usr.motionplus.pitch_left == 0);
+  send_motion(INPUT_ANALOG_MOTION_MOTIONPLUS_UP, false);
+
+  //unknown axes are ignored
+  send_axis(INPUT_ANALOG_AXIS_COUNT, 1.0f);
+}
+
+static void test_config()
+{
+  struct input_axis_config config = { 0.2f, 2.0f, 40, 120, 200 }, bad, saved;
+  struct input_axis_map other;
+  int i, last;
+
+  input_get_axis_config(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, &saved);
+  CHECK(input_set_axis_config(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, &config) == 0);
+
+  //dead zone, then the curve from its edge
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, 0.0f) == 120);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, 0.19f) == 120);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, -0.19f) == 120);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, 0.6f) == 140);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, -0.6f) == 100);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, 1.0f) == 200);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, -1.0f) == 40);
+
+  //the mapping never runs backwards
+  last = 0;
+  for (i = -1000; i <= 1000; i++)
+  {
+    int value = input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, i / 1000.0f);
+    CHECK(value >= last);
+    last = value;
+  }
+
+  send_axis(INPUT_ANALOG_AXIS_NUNCHUK_X, 0.6f);
+  input_tick(&state, &input);
+  CHECK(state.usr.nunchuk.x == 140);
+
+  //other axes keep their mapping, and other maps all of theirs
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_Y, 1.0f) == 228);
+  input_axis_map_init(&other);
+  CHECK(input_axis_wire_value(&other, INPUT_ANALOG_AXIS_NUNCHUK_X, 1.0f) == 228);
+
+  bad = config;
+  bad.max = 256;
+  CHECK(input_set_axis_config(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, &bad) == -1);
+  bad = config;
+  bad.center = 30;
+  CHECK(input_set_axis_config(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, &bad) == -1);
+  bad = config;
+  bad.deadzone = 1.0f;
+  CHECK(input_set_axis_config(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, &bad) == -1);
+  bad = config;
+  bad.curve = 0.0f;
+  CHECK(input_set_axis_config(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, &bad) == -1);
+  CHECK(input_set_axis_config(&axis_map, INPUT_ANALOG_AXIS_COUNT, &config) == -1);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, 1.0f) == 200);
+
+  CHECK(input_set_axis_config(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, &saved) == 0);
+  CHECK(input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_NUNCHUK_X, 1.0f) == 228);
+}
+
+int main(int argc, char *argv[])
+{
+  wiimote_init(&state);
+  input_axis_map_init(&axis_map);
+  input_init(&input, &axis_map);
+
+  test_rest();
+  test_defaults();
+  test_config();
+
+  wiimote_destroy(&state);
+
+  return test_result("analog axes passed");
+}
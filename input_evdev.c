@@ -0,0 +1,656 @@
+//linux/input.h has its own struct input_event
+#define input_event evdev_event
+#include <linux/input.h>
+#undef input_event
+
+#include "input_evdev.h"
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROGRAM_NAME "wmemulator"
+
+//events translated but not handed out yet, at most four per evdev event or one
+//per binding of an unplugged device
+#define PENDING_EVENTS 128
+#define READ_EVENTS (PENDING_EVENTS / 4)
+
+//an axis driving motions counts as pushed past this much of its range from the centre,
+//and as released below the lower mark
+#define AXIS_PRESS 0.5f
+#define AXIS_RELEASE 0.25f
+
+//pointer movement per relative mouse count
+#define POINTER_SCALE_X (1.0f / 1024.0f)
+#define POINTER_SCALE_Y (1.0f / 768.0f)
+
+#define BUTTON(Key, Button) \
+  { EV_KEY, Key, INPUT_EVENT_TYPE_BUTTON, INPUT_EVDEV_NONE, INPUT_BUTTON_##Button }
+#define HAT(Axis, Negative, Positive) \
+  { EV_ABS, Axis, INPUT_EVENT_TYPE_BUTTON, INPUT_BUTTON_##Negative, INPUT_BUTTON_##Positive }
+#define MOTION_KEY(Key, Motion) \
+  { EV_KEY, Key, INPUT_EVENT_TYPE_ANALOG_MOTION, INPUT_EVDEV_NONE, INPUT_ANALOG_MOTION_##Motion }
+#define STICK(Axis, Negative, Positive) \
+  { EV_ABS, Axis, INPUT_EVENT_TYPE_ANALOG_MOTION, INPUT_ANALOG_MOTION_##Negative, INPUT_ANALOG_MOTION_##Positive }
+#define TRIGGER(Axis, Motion) \
+  { EV_ABS, Axis, INPUT_EVENT_TYPE_ANALOG_MOTION, INPUT_EVDEV_NONE, INPUT_ANALOG_MOTION_##Motion }
+#define AXIS(Axis, Analog, Flags) \
+  { EV_ABS, Axis, INPUT_EVENT_TYPE_ANALOG_AXIS, Flags, INPUT_ANALOG_AXIS_##Analog }
+
+static const struct input_evdev_binding gamepad_bindings[] =
+{
+  BUTTON(BTN_SOUTH, WIIMOTE_A),
+  BUTTON(BTN_EAST, WIIMOTE_B),
+  BUTTON(BTN_NORTH, WIIMOTE_1),
+  BUTTON(BTN_WEST, WIIMOTE_2),
+  BUTTON(BTN_START, WIIMOTE_PLUS),
+  BUTTON(BTN_SELECT, WIIMOTE_MINUS),
+  BUTTON(BTN_MODE, HOME),
+  BUTTON(BTN_TL, NUNCHUK_C),
+  BUTTON(BTN_TR, NUNCHUK_Z),
+  BUTTON(BTN_DPAD_UP, WIIMOTE_UP),
+  BUTTON(BTN_DPAD_DOWN, WIIMOTE_DOWN),
+  BUTTON(BTN_DPAD_LEFT, WIIMOTE_LEFT),
+  BUTTON(BTN_DPAD_RIGHT, WIIMOTE_RIGHT),
+  HAT(ABS_HAT0X, WIIMOTE_LEFT, WIIMOTE_RIGHT),
+  HAT(ABS_HAT0Y, WIIMOTE_UP, WIIMOTE_DOWN),
+  //the left stick is the nunchuk's and the classic's, the right one points
+  //and is the classic's right stick, the triggers steer or are the classic's
+  AXIS(ABS_X, NUNCHUK_X, 0),
+  AXIS(ABS_X, CLASSIC_LS_X, 0),
+  AXIS(ABS_Y, NUNCHUK_Y, INPUT_EVDEV_AXIS_INVERT),
+  AXIS(ABS_Y, CLASSIC_LS_Y, INPUT_EVDEV_AXIS_INVERT),
+  STICK(ABS_RX, IR_LEFT, IR_RIGHT),
+  AXIS(ABS_RX, CLASSIC_RS_X, 0),
+  STICK(ABS_RY, IR_UP, IR_DOWN),
+  AXIS(ABS_RY, CLASSIC_RS_Y, INPUT_EVDEV_AXIS_INVERT),
+  TRIGGER(ABS_Z, STEER_LEFT),
+  AXIS(ABS_Z, CLASSIC_LT, INPUT_EVDEV_AXIS_TRIGGER),
+  TRIGGER(ABS_RZ, STEER_RIGHT),
+  AXIS(ABS_RZ, CLASSIC_RT, INPUT_EVDEV_AXIS_TRIGGER),
+};
+
+//the keys of the SDL keyboard input in its IR and nunchuk layout
+static const struct input_evdev_binding keyboard_bindings[] =
+{
+  BUTTON(KEY_A, WIIMOTE_A),
+  BUTTON(KEY_D, WIIMOTE_B),
+  BUTTON(KEY_Q, NUNCHUK_C),
+  BUTTON(KEY_E, NUNCHUK_Z),
+  BUTTON(KEY_1, WIIMOTE_1),
+  BUTTON(KEY_2, WIIMOTE_2),
+  BUTTON(KEY_3, WIIMOTE_MINUS),
+  BUTTON(KEY_4, WIIMOTE_PLUS),
+  BUTTON(KEY_H, HOME),
+  BUTTON(KEY_KP8, WIIMOTE_UP),
+  BUTTON(KEY_KP2, WIIMOTE_DOWN),
+  BUTTON(KEY_KP4, WIIMOTE_LEFT),
+  BUTTON(KEY_KP6, WIIMOTE_RIGHT),
+  BUTTON(BTN_LEFT, WIIMOTE_A),
+  BUTTON(BTN_RIGHT, WIIMOTE_B),
+  MOTION_KEY(KEY_UP, IR_UP),
+  MOTION_KEY(KEY_DOWN, IR_DOWN),
+  MOTION_KEY(KEY_LEFT, IR_LEFT),
+  MOTION_KEY(KEY_RIGHT, IR_RIGHT),
+  MOTION_KEY(KEY_T, STEER_LEFT),
+  MOTION_KEY(KEY_Y, STEER_RIGHT),
+};
+
+#undef BUTTON
+#undef HAT
+#undef MOTION_KEY
+#undef STICK
+#undef TRIGGER
+#undef AXIS
+
+#define BINDINGS(Table) Table, sizeof(Table) / sizeof(Table[0])
+
+//first fit wins, tables for particular devices go before the generic ones
+static const struct input_evdev_mapping mappings[] =
+{
+  { NULL, BTN_GAMEPAD, BINDINGS(gamepad_bindings) },
+  { NULL, 0, BINDINGS(keyboard_bindings) },
+};
+
+#undef BINDINGS
+
+struct evdev_device
+{
+  int fd;
+  int player;
+  char name[64];
+  const struct input_evdev_mapping *mapping;
+
+  //index + 1 of the first binding of the code in the mapping, 0 for none
+  uint8_t key_binding[KEY_CNT];
+  uint8_t abs_binding[ABS_CNT];
+
+  //keys held down, to let go of if the device is unplugged
+  unsigned long key_down[KEY_CNT / (8 * sizeof(long)) + 1];
+
+  //uploaded FF_RUMBLE effect, -1 if the device can't rumble
+  int rumble_effect;
+  bool rumbling;
+
+  int32_t abs_min[ABS_CNT];
+  int32_t abs_max[ABS_CNT];
+  int8_t abs_direction[ABS_CNT]; //-1, 0 or 1, pushed which way
+};
+
+static struct evdev_device devices[INPUT_EVDEV_MAX_DEVICES];
+static int device_count;
+static int epoll_fd = -1;
+//feedback writes to the devices from the emulator thread while they are read
+//and closed on the source's, this keeps an fd open while it is written
+static pthread_mutex_t device_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct input_event pending[PENDING_EVENTS];
+static int pending_head, pending_count;
+
+static bool has_bit(const unsigned long *bits, int bit)
+{
+  return (bits[bit / (8 * sizeof(long))] >> (bit % (8 * sizeof(long)))) & 1;
+}
+
+static void set_bit(unsigned long *bits, int bit, bool on)
+{
+  unsigned long mask = 1UL << (bit % (8 * sizeof(long)));
+
+  if (on)
+  {
+    bits[bit / (8 * sizeof(long))] |= mask;
+  }
+  else
+  {
+    bits[bit / (8 * sizeof(long))] &= ~mask;
+  }
+}
+
+static const struct input_evdev_mapping * find_mapping(struct evdev_device *device)
+{
+  unsigned long keys[KEY_CNT / (8 * sizeof(long)) + 1];
+  int i;
+
+  memset(keys, 0, sizeof(keys));
+  ioctl(device->fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys);
+
+  for (i = 0; i < sizeof(mappings) / sizeof(mappings[0]); i++)
+  {
+    if (mappings[i].name != NULL && strstr(device->name, mappings[i].name) == NULL)
+    {
+      continue;
+    }
+    if (mappings[i].required_key != 0 && !has_bit(keys, mappings[i].required_key))
+    {
+      continue;
+    }
+    return &mappings[i];
+  }
+
+  return NULL;
+}
+
+// Uploads a rumble effect to play while the host has rumble on
+static void set_up_rumble(struct evdev_device *device)
+{
+  unsigned long ff[FF_CNT / (8 * sizeof(long)) + 1];
+  struct ff_effect effect;
+
+  device->rumble_effect = -1;
+
+  memset(ff, 0, sizeof(ff));
+  if (ioctl(device->fd, EVIOCGBIT(EV_FF, sizeof(ff)), ff) < 0 || !has_bit(ff, FF_RUMBLE))
+  {
+    return;
+  }
+
+  memset(&effect, 0, sizeof(effect));
+  effect.type = FF_RUMBLE;
+  effect.id = -1;
+  effect.u.rumble.strong_magnitude = 0xc000;
+  effect.u.rumble.weak_magnitude = 0xc000;
+  //until it is stopped
+  effect.replay.length = 0;
+  if (ioctl(device->fd, EVIOCSFF, &effect) < 0)
+  {
+    printf(PROGRAM_NAME ": can't set up rumble for %s\n", device->name);
+    return;
+  }
+
+  device->rumble_effect = effect.id;
+}
+
+static int open_device(struct evdev_device *device, char const *path, int player)
+{
+  const struct input_evdev_binding *binding;
+  struct input_absinfo absinfo;
+  struct epoll_event epoll_event;
+  int i, clock_id;
+
+  memset(device, 0, sizeof(struct evdev_device));
+  device->player = player;
+
+  //writable for rumble, if allowed
+  device->fd = open(path, O_RDWR | O_NONBLOCK);
+  if (device->fd == -1 && (errno == EACCES || errno == EPERM))
+  {
+    device->fd = open(path, O_RDONLY | O_NONBLOCK);
+  }
+  if (device->fd == -1)
+  {
+    printf(PROGRAM_NAME ": can't open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  if (ioctl(device->fd, EVIOCGNAME(sizeof(device->name) - 1), device->name) < 0)
+  {
+    printf(PROGRAM_NAME ": %s is not an input device\n", path);
+    close(device->fd);
+    return -1;
+  }
+
+  //event times on the clock the reports are scheduled on
+  clock_id = CLOCK_MONOTONIC;
+  if (ioctl(device->fd, EVIOCSCLOCKID, &clock_id))
+  {
+    printf(PROGRAM_NAME ": can't use monotonic event times for %s\n", path);
+  }
+
+  device->mapping = find_mapping(device);
+  if (device->mapping == NULL)
+  {
+    printf(PROGRAM_NAME ": no mapping for %s (%s)\n", path, device->name);
+    close(device->fd);
+    return -1;
+  }
+
+  for (i = 0; i < device->mapping->binding_count; i++)
+  {
+    binding = &device->mapping->bindings[i];
+
+    if (binding->type == EV_KEY && binding->code < KEY_CNT && !device->key_binding[binding->code])
+    {
+      device->key_binding[binding->code] = i + 1;
+    }
+    else if (binding->type == EV_ABS && binding->code < ABS_CNT && !device->abs_binding[binding->code] &&
+      ioctl(device->fd, EVIOCGABS(binding->code), &absinfo) == 0 &&
+      absinfo.maximum > absinfo.minimum)
+    {
+      device->abs_binding[binding->code] = i + 1;
+      device->abs_min[binding->code] = absinfo.minimum;
+      device->abs_max[binding->code] = absinfo.maximum;
+    }
+  }
+
+  set_up_rumble(device);
+
+  epoll_event.events = EPOLLIN;
+  epoll_event.data.ptr = device;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, device->fd, &epoll_event))
+  {
+    perror(PROGRAM_NAME);
+    close(device->fd);
+    return -1;
+  }
+
+  printf("%s (%s) controls player %d\n", path, device->name, player + 1);
+  return 0;
+}
+
+int input_evdev_init(char const * const paths[], int count)
+{
+  int i;
+
+  if (count > INPUT_EVDEV_MAX_DEVICES)
+  {
+    printf(PROGRAM_NAME ": at most %d input devices\n", INPUT_EVDEV_MAX_DEVICES);
+    return -1;
+  }
+
+  epoll_fd = epoll_create1(0);
+  if (epoll_fd == -1)
+  {
+    perror(PROGRAM_NAME);
+    return -1;
+  }
+
+  device_count = 0;
+  pending_head = 0;
+  pending_count = 0;
+
+  for (i = 0; i < count; i++)
+  {
+    if (open_device(&devices[device_count], paths[i], i % INPUT_MAX_PLAYERS))
+    {
+      return -1;
+    }
+    device_count++;
+  }
+
+  return 0;
+}
+
+static void input_evdev_unload(void)
+{
+  int i;
+
+  for (i = 0; i < device_count; i++)
+  {
+    if (devices[i].fd >= 0)
+    {
+      close(devices[i].fd);
+    }
+  }
+  device_count = 0;
+
+  if (epoll_fd >= 0)
+  {
+    close(epoll_fd);
+    epoll_fd = -1;
+  }
+}
+
+//time of the evdev event being translated
+static uint64_t event_time_us;
+
+static struct input_event * push_event(struct evdev_device *device, uint8_t event_type)
+{
+  struct input_event *event = &pending[(pending_head + pending_count++) % PENDING_EVENTS];
+
+  memset(event, 0, sizeof(struct input_event));
+  event->type = event_type;
+  event->player = device->player;
+  event->timestamp_us = event_time_us;
+  return event;
+}
+
+static void push_binding(struct evdev_device *device, uint8_t event_type, uint8_t id, bool on)
+{
+  struct input_event *event;
+
+  if (id == INPUT_EVDEV_NONE)
+  {
+    return;
+  }
+
+  event = push_event(device, event_type);
+  if (event_type == INPUT_EVENT_TYPE_BUTTON)
+  {
+    event->button_event.button = id;
+    event->button_event.pressed = on;
+  }
+  else
+  {
+    event->analog_motion_event.motion = id;
+    event->analog_motion_event.moving = on;
+  }
+}
+
+static void push_axis(struct evdev_device *device, const struct input_evdev_binding *binding,
+  int32_t value)
+{
+  int32_t min = device->abs_min[binding->code], max = device->abs_max[binding->code];
+  float position = (float)(value - min) / (max - min);
+  struct input_event *event;
+
+  if (binding->negative & INPUT_EVDEV_AXIS_INVERT)
+  {
+    position = 1.0f - position;
+  }
+  if (!(binding->negative & INPUT_EVDEV_AXIS_TRIGGER))
+  {
+    position = 2.0f * position - 1.0f;
+  }
+
+  event = push_event(device, INPUT_EVENT_TYPE_ANALOG_AXIS);
+  event->analog_axis_event.axis = binding->positive;
+  event->analog_axis_event.value = position;
+}
+
+//axis position from -1 to 1, then which way it is pushed
+static void translate_abs(struct evdev_device *device, const struct input_evdev_binding *binding,
+  int32_t value)
+{
+  int32_t min = device->abs_min[binding->code], max = device->abs_max[binding->code];
+  float position = 2.0f * (value - min) / (max - min) - 1.0f;
+  int8_t direction = device->abs_direction[binding->code];
+  int8_t next = direction;
+
+  if (binding->event_type == INPUT_EVENT_TYPE_ANALOG_AXIS)
+  {
+    push_axis(device, binding, value);
+    return;
+  }
+
+  if (position >= AXIS_PRESS)
+  {
+    next = 1;
+  }
+  else if (position <= -AXIS_PRESS)
+  {
+    next = -1;
+  }
+  else if (position > -AXIS_RELEASE && position < AXIS_RELEASE)
+  {
+    next = 0;
+  }
+
+  if (next == direction)
+  {
+    return;
+  }
+
+  //a hat can jump straight from one side to the other
+  if (direction != 0)
+  {
+    push_binding(device, binding->event_type,
+      direction > 0 ? binding->positive : binding->negative, false);
+  }
+  if (next != 0)
+  {
+    push_binding(device, binding->event_type,
+      next > 0 ? binding->positive : binding->negative, true);
+  }
+
+  device->abs_direction[binding->code] = next;
+}
+
+static void translate(struct evdev_device *device, const struct evdev_event *ev)
+{
+  const struct input_evdev_binding *binding, *end;
+  struct input_event *event;
+
+  end = device->mapping->bindings + device->mapping->binding_count;
+  event_time_us = (uint64_t)ev->input_event_sec * 1000000 + ev->input_event_usec;
+
+  switch (ev->type)
+  {
+    case EV_KEY:
+      //autorepeat isn't a new press
+      if (ev->code < KEY_CNT && device->key_binding[ev->code] && ev->value != 2)
+      {
+        set_bit(device->key_down, ev->code, ev->value);
+        binding = &device->mapping->bindings[device->key_binding[ev->code] - 1];
+        for (; binding < end && binding->type == EV_KEY && binding->code == ev->code; binding++)
+        {
+          push_binding(device, binding->event_type, binding->positive, ev->value);
+        }
+      }
+      break;
+    case EV_ABS:
+      if (ev->code < ABS_CNT && device->abs_binding[ev->code])
+      {
+        binding = &device->mapping->bindings[device->abs_binding[ev->code] - 1];
+        for (; binding < end && binding->type == EV_ABS && binding->code == ev->code; binding++)
+        {
+          translate_abs(device, binding, ev->value);
+        }
+      }
+      break;
+    case EV_REL:
+      if (ev->code == REL_X || ev->code == REL_Y)
+      {
+        event = push_event(device, INPUT_EVENT_TYPE_ANALOG_MOTION);
+        event->analog_motion_event.motion = INPUT_ANALOG_MOTION_POINTER;
+        if (ev->code == REL_X)
+        {
+          event->analog_motion_event.delta_x = ev->value * POINTER_SCALE_X;
+        }
+        else
+        {
+          event->analog_motion_event.delta_y = -ev->value * POINTER_SCALE_Y;
+        }
+      }
+      break;
+  }
+}
+
+// Lets go of every key, held motion and axis of an unplugged device, so
+// nothing stays pressed
+static void release_device(struct evdev_device *device)
+{
+  const struct input_evdev_binding *binding;
+  struct input_event *event;
+  int8_t direction;
+  int i;
+
+  //on the next tick
+  event_time_us = 0;
+
+  for (i = 0; i < device->mapping->binding_count; i++)
+  {
+    binding = &device->mapping->bindings[i];
+
+    if (binding->type == EV_KEY)
+    {
+      if (binding->code < KEY_CNT && has_bit(device->key_down, binding->code))
+      {
+        push_binding(device, binding->event_type, binding->positive, false);
+      }
+    }
+    else if (binding->code < ABS_CNT && device->abs_binding[binding->code])
+    {
+      direction = device->abs_direction[binding->code];
+      if (binding->event_type == INPUT_EVENT_TYPE_ANALOG_AXIS)
+      {
+        //sticks at the centre, triggers at rest
+        event = push_event(device, INPUT_EVENT_TYPE_ANALOG_AXIS);
+        event->analog_axis_event.axis = binding->positive;
+      }
+      else if (direction != 0)
+      {
+        push_binding(device, binding->event_type,
+          direction > 0 ? binding->positive : binding->negative, false);
+      }
+    }
+  }
+
+  memset(device->key_down, 0, sizeof(device->key_down));
+  memset(device->abs_direction, 0, sizeof(device->abs_direction));
+}
+
+static void read_device(struct evdev_device *device)
+{
+  struct evdev_event evs[READ_EVENTS];
+  ssize_t len;
+  int i;
+
+  len = read(device->fd, evs, sizeof(evs));
+  if (len < 0)
+  {
+    if (errno == ENODEV)
+    {
+      printf(PROGRAM_NAME ": %s unplugged\n", device->name);
+      release_device(device);
+      pthread_mutex_lock(&device_lock);
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device->fd, NULL);
+      close(device->fd);
+      device->fd = -1;
+      pthread_mutex_unlock(&device_lock);
+    }
+    return;
+  }
+
+  for (i = 0; i < len / sizeof(struct evdev_event); i++)
+  {
+    translate(device, &evs[i]);
+  }
+}
+
+static bool input_evdev_poll_event(struct input_event *event)
+{
+  struct epoll_event ready[INPUT_EVDEV_MAX_DEVICES];
+  int i, count;
+
+  //one read per ready device fills the queue, more waits for the next poll
+  while (pending_count == 0)
+  {
+    count = epoll_wait(epoll_fd, ready, INPUT_EVDEV_MAX_DEVICES, 0);
+    if (count <= 0)
+    {
+      return false;
+    }
+
+    for (i = 0; i < count && pending_count == 0; i++)
+    {
+      read_device((struct evdev_device *)ready[i].data.ptr);
+    }
+  }
+
+  *event = pending[pending_head];
+  pending_head = (pending_head + 1) % PENDING_EVENTS;
+  pending_count--;
+  return true;
+}
+
+static void input_evdev_wait_event(int timeout_ms)
+{
+  struct epoll_event ready;
+
+  //level triggered, the next poll sees the same devices ready
+  if (pending_count == 0)
+  {
+    epoll_wait(epoll_fd, &ready, 1, timeout_ms);
+  }
+}
+
+//the host's rumble plays on the player's devices that can rumble
+static void input_evdev_feedback(int player, struct input_feedback const *feedback)
+{
+  struct evdev_event play;
+  int i;
+
+  pthread_mutex_lock(&device_lock);
+  for (i = 0; i < device_count; i++)
+  {
+    if (devices[i].player != player || devices[i].fd < 0 || devices[i].rumble_effect < 0 ||
+      devices[i].rumbling == feedback->rumble)
+    {
+      continue;
+    }
+
+    memset(&play, 0, sizeof(play));
+    play.type = EV_FF;
+    play.code = devices[i].rumble_effect;
+    play.value = feedback->rumble;
+    if (write(devices[i].fd, &play, sizeof(play)) == sizeof(play))
+    {
+      devices[i].rumbling = feedback->rumble;
+    }
+  }
+  pthread_mutex_unlock(&device_lock);
+}
+
+struct input_source input_source_evdev = {
+  .unload = input_evdev_unload,
+  .poll_event = input_evdev_poll_event,
+  .wait_event = input_evdev_wait_event,
+  .feedback = input_evdev_feedback
+};
@@ -0,0 +1,50 @@
+#ifndef INPUT_EVDEV_H
+#define INPUT_EVDEV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "input.h"
+
+/*
+ * Input straight from /dev/input/event* devices, no window or X server
+ * needed. Each device drives the next player and gets the first mapping
+ * table that fits it: a table names the evdev keys and absolute axes it
+ * uses and the button, motions or analog axis each one turns into. Relative
+ * X and Y (mice) always move the pointer.
+ */
+
+#define INPUT_EVDEV_MAX_DEVICES 8
+
+//no button or motion for that direction
+#define INPUT_EVDEV_NONE 0xff
+
+//flags in negative for analog axis bindings
+#define INPUT_EVDEV_AXIS_INVERT 0x01 //the device counts the other way
+#define INPUT_EVDEV_AXIS_TRIGGER 0x02 //rests at the minimum, 0 to 1
+
+// Bindings of the same code sit next to each other in a table, each one is
+// applied
+struct input_evdev_binding
+{
+  uint16_t type; //EV_KEY or EV_ABS
+  uint16_t code;
+  uint8_t event_type; //INPUT_EVENT_TYPE_BUTTON, _ANALOG_MOTION or _ANALOG_AXIS
+  uint8_t negative; //below the axis centre, axis flags, unused for keys
+  uint8_t positive; //above the axis centre, the analog axis, or the key
+};
+
+struct input_evdev_mapping
+{
+  const char *name; //matched against the device name, NULL for any
+  uint16_t required_key; //the device must have it, 0 for none
+  const struct input_evdev_binding *bindings;
+  int binding_count;
+};
+
+// Opens the devices and assigns them to players in order, returns -1 if
+// one can't be used
+int input_evdev_init(char const * const paths[], int count);
+
+extern struct input_source input_source_evdev;
+
+#endif
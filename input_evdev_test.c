@@ -0,0 +1,340 @@
+#define input_event evdev_event
+#include <linux/input.h>
+#include <linux/uinput.h>
+#undef input_event
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+
+#include "input_evdev.h"
+#include "test.h"
+
+// Creates virtual devices through /dev/uinput, a gamepad and a keyboard
+// with a mouse, opens their event nodes with the evdev source and checks
+// the events each input turns into. Needs access to /dev/uinput; without
+// it the test is skipped.
+
+static int create_device(const char * name, const int * keys, int key_count,
+  const int * axes, int axis_count, bool mouse, char * path, size_t path_size)
+{
+  struct uinput_setup setup;
+  struct uinput_abs_setup abs;
+  char sysname[64], dir_path[128];
+  struct dirent * entry;
+  DIR * dir;
+  int fd, i;
+
+  fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+  if (fd == -1)
+  {
+    return -1;
+  }
+
+  ioctl(fd, UI_SET_EVBIT, EV_KEY);
+  for (i = 0; i < key_count; i++)
+  {
+    ioctl(fd, UI_SET_KEYBIT, keys[i]);
+  }
+
+  if (axis_count > 0)
+  {
+    ioctl(fd, UI_SET_EVBIT, EV_ABS);
+  }
+  for (i = 0; i < axis_count; i++)
+  {
+    memset(&abs, 0, sizeof(abs));
+    abs.code = axes[i];
+    if (axes[i] == ABS_HAT0X || axes[i] == ABS_HAT0Y)
+    {
+      abs.absinfo.minimum = -1;
+      abs.absinfo.maximum = 1;
+    }
+    else if (axes[i] == ABS_Z || axes[i] == ABS_RZ)
+    {
+      abs.absinfo.maximum = 255;
+    }
+    else
+    {
+      abs.absinfo.minimum = -32768;
+      abs.absinfo.maximum = 32767;
+    }
+    ioctl(fd, UI_SET_ABSBIT, axes[i]);
+    ioctl(fd, UI_ABS_SETUP, &abs);
+  }
+
+  if (mouse)
+  {
+    ioctl(fd, UI_SET_EVBIT, EV_REL);
+    ioctl(fd, UI_SET_RELBIT, REL_X);
+    ioctl(fd, UI_SET_RELBIT, REL_Y);
+  }
+
+  memset(&setup, 0, sizeof(setup));
+  setup.id.bustype = BUS_VIRTUAL;
+  setup.id.vendor = 0x057e;
+  setup.id.product = 0x0306;
+  snprintf(setup.name, sizeof(setup.name), "%s", name);
+
+  if (ioctl(fd, UI_DEV_SETUP, &setup) || ioctl(fd, UI_DEV_CREATE) ||
+    ioctl(fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  //the event node shows up in sysfs under the device
+  snprintf(dir_path, sizeof(dir_path), "/sys/devices/virtual/input/%s", sysname);
+  path[0] = '\0';
+  for (i = 0; i < 100 && path[0] == '\0'; i++)
+  {
+    dir = opendir(dir_path);
+    while (dir != NULL && (entry = readdir(dir)) != NULL)
+    {
+      if (strncmp(entry->d_name, "event", 5) == 0)
+      {
+        snprintf(path, path_size, "/dev/input/%s", entry->d_name);
+      }
+    }
+    if (dir != NULL)
+    {
+      closedir(dir);
+    }
+    usleep(10000);
+  }
+
+  //give udev a moment to set the node up
+  for (i = 0; i < 100 && access(path, R_OK) != 0; i++)
+  {
+    usleep(10000);
+  }
+
+  return fd;
+}
+
+static void emit(int fd, int type, int code, int value)
+{
+  struct evdev_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.type = type;
+  ev.code = code;
+  ev.value = value;
+  if (write(fd, &ev, sizeof(ev)) != sizeof(ev))
+  {
+    perror("uinput write");
+  }
+}
+
+static void sync_device(int fd)
+{
+  emit(fd, EV_SYN, SYN_REPORT, 0);
+  usleep(5000);
+}
+
+static bool poll_event(struct input_event * event)
+{
+  memset(event, 0, sizeof(struct input_event));
+  return input_source_evdev.poll_event(event);
+}
+
+static void expect_button(enum input_button button, bool pressed, int player)
+{
+  struct input_event event;
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_BUTTON);
+  CHECK(event.button_event.button == button);
+  CHECK(event.button_event.pressed == pressed);
+  CHECK(event.player == player);
+}
+
+static void expect_motion(enum input_analog_motion motion, bool moving, int player)
+{
+  struct input_event event;
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_MOTION);
+  CHECK(event.analog_motion_event.motion == motion);
+  CHECK(event.analog_motion_event.moving == moving);
+  CHECK(event.player == player);
+}
+
+static void expect_axis(enum input_analog_axis axis, float value, int player)
+{
+  struct input_event event;
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_AXIS);
+  CHECK(event.analog_axis_event.axis == axis);
+  CHECK(event.analog_axis_event.value > value - 0.001f && event.analog_axis_event.value < value + 0.001f);
+  CHECK(event.player == player);
+}
+
+int main(int argc, char *argv[])
+{
+  const int gamepad_keys[] = { BTN_SOUTH, BTN_EAST, BTN_NORTH, BTN_WEST, BTN_START,
+    BTN_SELECT, BTN_MODE, BTN_TL, BTN_TR };
+  const int gamepad_axes[] = { ABS_X, ABS_Y, ABS_RX, ABS_RY, ABS_Z, ABS_RZ, ABS_HAT0X, ABS_HAT0Y };
+  const int keyboard_keys[] = { KEY_A, KEY_D, KEY_UP, KEY_H, BTN_LEFT, BTN_RIGHT };
+  char gamepad_path[64], keyboard_path[64];
+  const char * paths[2] = { gamepad_path, keyboard_path };
+  struct input_event event;
+  int gamepad, keyboard, i;
+
+  gamepad = create_device("wmemulator test gamepad", gamepad_keys,
+    sizeof(gamepad_keys) / sizeof(gamepad_keys[0]), gamepad_axes,
+    sizeof(gamepad_axes) / sizeof(gamepad_axes[0]), false, gamepad_path, sizeof(gamepad_path));
+  if (gamepad == -1)
+  {
+    printf("no /dev/uinput, evdev input test skipped\n");
+    return 0;
+  }
+
+  keyboard = create_device("wmemulator test keyboard", keyboard_keys,
+    sizeof(keyboard_keys) / sizeof(keyboard_keys[0]), NULL, 0, true, keyboard_path,
+    sizeof(keyboard_path));
+  CHECK(keyboard != -1);
+
+  if (input_evdev_init(paths, 2))
+  {
+    printf("can't open the virtual devices\n");
+    return 1;
+  }
+  CHECK(!poll_event(&event));
+
+  //buttons, several per sync
+  emit(gamepad, EV_KEY, BTN_SOUTH, 1);
+  emit(gamepad, EV_KEY, BTN_MODE, 1);
+  sync_device(gamepad);
+  expect_button(INPUT_BUTTON_WIIMOTE_A, true, 0);
+  expect_button(INPUT_BUTTON_HOME, true, 0);
+  emit(gamepad, EV_KEY, BTN_SOUTH, 0);
+  sync_device(gamepad);
+  expect_button(INPUT_BUTTON_WIIMOTE_A, false, 0);
+  CHECK(!poll_event(&event));
+
+  //the left stick is an analog axis for the nunchuk and the classic, with
+  //up positive
+  emit(gamepad, EV_ABS, ABS_X, 32767);
+  emit(gamepad, EV_ABS, ABS_Y, -32768);
+  sync_device(gamepad);
+  expect_axis(INPUT_ANALOG_AXIS_NUNCHUK_X, 1.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LS_X, 1.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_NUNCHUK_Y, 1.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LS_Y, 1.0f, 0);
+  emit(gamepad, EV_ABS, ABS_X, -16384);
+  sync_device(gamepad);
+  expect_axis(INPUT_ANALOG_AXIS_NUNCHUK_X, -0.5f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LS_X, -0.5f, 0);
+  CHECK(!poll_event(&event));
+
+  //the right stick points past the press mark, held, back through the dead
+  //zone, and is the classic's right stick all along
+  emit(gamepad, EV_ABS, ABS_RX, 30000);
+  sync_device(gamepad);
+  expect_motion(INPUT_ANALOG_MOTION_IR_RIGHT, true, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_X, 62768.0f / 65535.0f * 2.0f - 1.0f, 0);
+  emit(gamepad, EV_ABS, ABS_RX, 12000);
+  sync_device(gamepad);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_X, 44768.0f / 65535.0f * 2.0f - 1.0f, 0);
+  CHECK(!poll_event(&event));
+  emit(gamepad, EV_ABS, ABS_RX, 1000);
+  sync_device(gamepad);
+  expect_motion(INPUT_ANALOG_MOTION_IR_RIGHT, false, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_X, 33768.0f / 65535.0f * 2.0f - 1.0f, 0);
+
+  //straight across
+  emit(gamepad, EV_ABS, ABS_RY, -32768);
+  sync_device(gamepad);
+  expect_motion(INPUT_ANALOG_MOTION_IR_UP, true, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_Y, 1.0f, 0);
+  emit(gamepad, EV_ABS, ABS_RY, 32767);
+  sync_device(gamepad);
+  expect_motion(INPUT_ANALOG_MOTION_IR_UP, false, 0);
+  expect_motion(INPUT_ANALOG_MOTION_IR_DOWN, true, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_Y, -1.0f, 0);
+
+  //hats are buttons, triggers rest at one end
+  emit(gamepad, EV_ABS, ABS_HAT0X, -1);
+  sync_device(gamepad);
+  expect_button(INPUT_BUTTON_WIIMOTE_LEFT, true, 0);
+  emit(gamepad, EV_ABS, ABS_HAT0X, 1);
+  sync_device(gamepad);
+  expect_button(INPUT_BUTTON_WIIMOTE_LEFT, false, 0);
+  expect_button(INPUT_BUTTON_WIIMOTE_RIGHT, true, 0);
+  emit(gamepad, EV_ABS, ABS_Z, 255);
+  sync_device(gamepad);
+  expect_motion(INPUT_ANALOG_MOTION_STEER_LEFT, true, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LT, 1.0f, 0);
+  emit(gamepad, EV_ABS, ABS_Z, 0);
+  sync_device(gamepad);
+  expect_motion(INPUT_ANALOG_MOTION_STEER_LEFT, false, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LT, 0.0f, 0);
+  CHECK(!poll_event(&event));
+
+  //the keyboard and mouse get the keyboard table and the second player
+  emit(keyboard, EV_KEY, KEY_D, 1);
+  emit(keyboard, EV_KEY, KEY_UP, 1);
+  emit(keyboard, EV_KEY, BTN_LEFT, 1);
+  sync_device(keyboard);
+  expect_button(INPUT_BUTTON_WIIMOTE_B, true, 1);
+  expect_motion(INPUT_ANALOG_MOTION_IR_UP, true, 1);
+  expect_button(INPUT_BUTTON_WIIMOTE_A, true, 1);
+
+  emit(keyboard, EV_REL, REL_X, 512);
+  sync_device(keyboard);
+  CHECK(poll_event(&event));
+  //stamped by the kernel on the monotonic clock
+  CHECK(event.timestamp_us <= wm_clock_monotonic(NULL) &&
+    event.timestamp_us + 1000000 > wm_clock_monotonic(NULL));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_MOTION);
+  CHECK(event.analog_motion_event.motion == INPUT_ANALOG_MOTION_POINTER);
+  CHECK(event.analog_motion_event.delta_x == 0.5f);
+  CHECK(event.player == 1);
+
+  //more events than one read takes come out over several polls
+  for (i = 0; i < 40; i++)
+  {
+    emit(keyboard, EV_KEY, KEY_H, !(i & 1));
+  }
+  sync_device(keyboard);
+  for (i = 0; i < 40; i++)
+  {
+    expect_button(INPUT_BUTTON_HOME, !(i & 1), 1);
+  }
+  CHECK(!poll_event(&event));
+
+  //unplugged, whatever the devices held is let go
+  ioctl(keyboard, UI_DEV_DESTROY);
+  usleep(5000);
+  expect_button(INPUT_BUTTON_WIIMOTE_B, false, 1);
+  expect_button(INPUT_BUTTON_WIIMOTE_A, false, 1);
+  expect_motion(INPUT_ANALOG_MOTION_IR_UP, false, 1);
+  CHECK(!poll_event(&event));
+
+  ioctl(gamepad, UI_DEV_DESTROY);
+  usleep(5000);
+  expect_button(INPUT_BUTTON_HOME, false, 0);
+  expect_button(INPUT_BUTTON_WIIMOTE_RIGHT, false, 0);
+  expect_axis(INPUT_ANALOG_AXIS_NUNCHUK_X, 0.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LS_X, 0.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_NUNCHUK_Y, 0.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LS_Y, 0.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_X, 0.0f, 0);
+  expect_motion(INPUT_ANALOG_MOTION_IR_DOWN, false, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RS_Y, 0.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_LT, 0.0f, 0);
+  expect_axis(INPUT_ANALOG_AXIS_CLASSIC_RT, 0.0f, 0);
+  CHECK(!poll_event(&event));
+
+  input_source_evdev.unload();
+  close(gamepad);
+  close(keyboard);
+
+  return test_result("evdev input passed");
+}
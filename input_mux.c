@@ -0,0 +1,272 @@
+#include "input_mux.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define PROGRAM_NAME "wmemulator"
+
+#define QUEUE_MASK (INPUT_MUX_QUEUE_SIZE - 1)
+
+//buttons, then held motions, then axes
+#define MOTION_FIELDS (INPUT_BUTTON_CLASSIC_MINUS + 1)
+#define AXIS_FIELDS (MOTION_FIELDS + INPUT_ANALOG_MOTION_MOTIONPLUS_SLOW + 1)
+#define FIELDS (AXIS_FIELDS + INPUT_ANALOG_AXIS_COUNT)
+
+#define NO_HOLDER 0xff
+
+struct mux_source
+{
+  struct input_source source;
+  pthread_t thread;
+  bool started;
+};
+
+static struct mux_source sources[INPUT_MUX_MAX_SOURCES];
+static int source_count;
+static atomic_bool stopping;
+
+static struct input_mux_queue queue;
+
+//which source each field of each player belongs to
+static uint8_t holders[INPUT_MAX_PLAYERS][FIELDS];
+
+void input_mux_queue_init(struct input_mux_queue *queue)
+{
+  uint32_t i;
+
+  for (i = 0; i < INPUT_MUX_QUEUE_SIZE; i++)
+  {
+    atomic_init(&queue->cells[i].seq, i);
+  }
+  atomic_init(&queue->tail, 0);
+  queue->head = 0;
+}
+
+bool input_mux_queue_push(struct input_mux_queue *queue, uint8_t source, struct input_event const *event)
+{
+  struct input_mux_cell *cell;
+  uint32_t pos, seq;
+
+  pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  for (;;)
+  {
+    cell = &queue->cells[pos & QUEUE_MASK];
+    seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+    if (seq == pos)
+    {
+      //free, claim it
+      if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+        memory_order_relaxed, memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if ((int32_t)(seq - pos) < 0)
+    {
+      //still holding the event from a lap ago
+      return false;
+    }
+    else
+    {
+      //another producer took it
+      pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    }
+  }
+
+  cell->source = source;
+  cell->event = *event;
+  atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+  return true;
+}
+
+bool input_mux_queue_pop(struct input_mux_queue *queue, uint8_t *source, struct input_event *event)
+{
+  struct input_mux_cell *cell = &queue->cells[queue->head & QUEUE_MASK];
+
+  if (atomic_load_explicit(&cell->seq, memory_order_acquire) != queue->head + 1)
+  {
+    return false;
+  }
+
+  *source = cell->source;
+  *event = cell->event;
+  //free for the next lap
+  atomic_store_explicit(&cell->seq, queue->head + INPUT_MUX_QUEUE_SIZE, memory_order_release);
+  queue->head++;
+  return true;
+}
+
+int input_mux_add(struct input_source const *source)
+{
+  if (source_count == INPUT_MUX_MAX_SOURCES || source->update_players != NULL)
+  {
+    return -1;
+  }
+
+  memset(&sources[source_count], 0, sizeof(struct mux_source));
+  sources[source_count].source = *source;
+  source_count++;
+  return 0;
+}
+
+static void idle(void)
+{
+  struct timespec delay = { 0, INPUT_MUX_IDLE_US * 1000 };
+
+  nanosleep(&delay, NULL);
+}
+
+static void * source_thread(void *arg)
+{
+  struct mux_source *mux_source = arg;
+  struct input_source *source = &mux_source->source;
+  uint8_t index = mux_source - sources;
+  struct input_event event;
+
+  while (!atomic_load_explicit(&stopping, memory_order_relaxed))
+  {
+    //what input_update_players_at leaves before each poll
+    event.player = 0;
+    event.timestamp_us = 0;
+    if (!source->poll_event(&event))
+    {
+      if (source->wait_event != NULL)
+      {
+        source->wait_event(INPUT_MUX_WAIT_MS);
+      }
+      else
+      {
+        idle();
+      }
+      continue;
+    }
+
+    //the emulator is behind, this source waits rather than it
+    while (!input_mux_queue_push(&queue, index, &event))
+    {
+      if (atomic_load_explicit(&stopping, memory_order_relaxed))
+      {
+        return NULL;
+      }
+      idle();
+    }
+  }
+
+  return NULL;
+}
+
+int input_mux_start(void)
+{
+  int i;
+
+  input_mux_queue_init(&queue);
+  memset(holders, NO_HOLDER, sizeof(holders));
+  atomic_store(&stopping, false);
+
+  for (i = 0; i < source_count; i++)
+  {
+    if (pthread_create(&sources[i].thread, NULL, source_thread, &sources[i]))
+    {
+      printf(PROGRAM_NAME ": can't start input thread %d\n", i);
+      return -1;
+    }
+    sources[i].started = true;
+  }
+
+  return 0;
+}
+
+static void input_mux_unload(void)
+{
+  int i;
+
+  atomic_store(&stopping, true);
+  for (i = 0; i < source_count; i++)
+  {
+    if (sources[i].started)
+    {
+      pthread_join(sources[i].thread, NULL);
+      sources[i].started = false;
+    }
+  }
+
+  for (i = 0; i < source_count; i++)
+  {
+    sources[i].source.unload();
+  }
+  source_count = 0;
+}
+
+// Field an event sets and whether it leaves it held, -1 if it isn't one
+static int event_field(struct input_event const *event, bool *held)
+{
+  switch (event->type)
+  {
+    case INPUT_EVENT_TYPE_BUTTON:
+      *held = event->button_event.pressed;
+      return event->button_event.button;
+    case INPUT_EVENT_TYPE_ANALOG_MOTION:
+      //pointer movement adds up from every source
+      if (event->analog_motion_event.motion == INPUT_ANALOG_MOTION_POINTER)
+      {
+        return -1;
+      }
+      *held = event->analog_motion_event.moving;
+      return MOTION_FIELDS + event->analog_motion_event.motion;
+    case INPUT_EVENT_TYPE_ANALOG_AXIS:
+      *held = event->analog_axis_event.value != 0.0f;
+      return AXIS_FIELDS + event->analog_axis_event.axis;
+    default:
+      return -1;
+  }
+}
+
+static bool input_mux_poll_event(struct input_event *event)
+{
+  uint8_t source, *holder;
+  bool held;
+  int field;
+
+  while (input_mux_queue_pop(&queue, &source, event))
+  {
+    field = event_field(event, &held);
+    if (field < 0 || field >= FIELDS || event->player < 0 || event->player >= INPUT_MAX_PLAYERS)
+    {
+      return true;
+    }
+
+    //a source ranked above holds it
+    holder = &holders[event->player][field];
+    if (*holder != NO_HOLDER && *holder < source)
+    {
+      continue;
+    }
+
+    *holder = held ? source : NO_HOLDER;
+    return true;
+  }
+
+  return false;
+}
+
+//every source that takes feedback gets it, on the emulator thread
+static void input_mux_feedback(int player, struct input_feedback const *feedback)
+{
+  int i;
+
+  for (i = 0; i < source_count; i++)
+  {
+    if (sources[i].source.feedback != NULL)
+    {
+      sources[i].source.feedback(player, feedback);
+    }
+  }
+}
+
+struct input_source input_source_mux = {
+  .unload = input_mux_unload,
+  .poll_event = input_mux_poll_event,
+  .feedback = input_mux_feedback
+};
@@ -0,0 +1,61 @@
+#ifndef INPUT_MUX_H
+#define INPUT_MUX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "input.h"
+
+/*
+ * Several input sources at once, each polled on its own thread. The threads
+ * push what their source hands out onto one bounded lock-free queue and
+ * input_source_mux pops it on the emulator thread, so a source that is slow
+ * to poll never holds up a report.
+ *
+ * Sources are ranked by the order they are added, the first highest. A
+ * button, held motion or axis that a source has pressed, moved or pushed
+ * off center belongs to it until it lets go, and lower ranked sources can't
+ * change it meanwhile. Pointer movement and other events always go through.
+ */
+
+#define INPUT_MUX_MAX_SOURCES 4
+//events in flight between the source threads and the emulator, a power of two
+#define INPUT_MUX_QUEUE_SIZE 1024
+//how long a source thread waits for its source before checking for unload
+#define INPUT_MUX_WAIT_MS 50
+//poll interval for sources without wait_event, and retry interval on a full queue
+#define INPUT_MUX_IDLE_US 500
+
+struct input_mux_cell
+{
+  //the position this cell is next written at, one past it once written
+  _Atomic uint32_t seq;
+  uint8_t source;
+  struct input_event event;
+};
+
+// Bounded multi-producer single-consumer queue (Vyukov's): producers claim a
+// position by compare-and-swap on tail, the consumer owns head
+struct input_mux_queue
+{
+  struct input_mux_cell cells[INPUT_MUX_QUEUE_SIZE];
+  _Atomic uint32_t tail __attribute__((aligned(64)));
+  uint32_t head __attribute__((aligned(64)));
+};
+
+void input_mux_queue_init(struct input_mux_queue *queue);
+// Returns false if the queue is full
+bool input_mux_queue_push(struct input_mux_queue *queue, uint8_t source, struct input_event const *event);
+// Returns false if the queue is empty; only ever called from one thread
+bool input_mux_queue_pop(struct input_mux_queue *queue, uint8_t *source, struct input_event *event);
+
+// Adds a source below the ones added before it. Sources that write whole
+// controller states (update_players) can't be merged. Returns -1 if the
+// source can't be added.
+int input_mux_add(struct input_source const *source);
+// Starts a thread per source. Returns -1 if one can't be started.
+int input_mux_start(void);
+
+extern struct input_source input_source_mux;
+
+#endif
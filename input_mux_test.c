@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "wiimote.h"
+#include "input.h"
+#include "input_mux.h"
+#include "test.h"
+
+// Pushes from several threads at once through the queue and checks nothing
+// is lost or reordered per producer, then merges scripted sources through
+// input_source_mux and checks a higher ranked source keeps what it holds and
+// a source that takes long to poll doesn't hold up the others.
+
+#define PRODUCERS 4
+#define PUSHES 200000
+
+static struct input_mux_queue queue;
+
+static void * producer(void *arg)
+{
+  uint8_t source = (uintptr_t)arg;
+  struct input_event event;
+  int i;
+
+  memset(&event, 0, sizeof(event));
+  for (i = 1; i <= PUSHES; i++)
+  {
+    event.timestamp_us = i;
+    while (!input_mux_queue_push(&queue, source, &event))
+    {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void test_queue()
+{
+  pthread_t threads[PRODUCERS];
+  uint64_t last[PRODUCERS] = { 0 };
+  struct input_event event;
+  uint64_t start_us, wall_us;
+  uint8_t source;
+  int i, popped = 0, reordered = 0;
+
+  input_mux_queue_init(&queue);
+  CHECK(!input_mux_queue_pop(&queue, &source, &event));
+
+  start_us = wm_clock_monotonic(NULL);
+  for (i = 0; i < PRODUCERS; i++)
+  {
+    pthread_create(&threads[i], NULL, producer, (void *)(uintptr_t)i);
+  }
+
+  while (popped < PRODUCERS * PUSHES)
+  {
+    if (!input_mux_queue_pop(&queue, &source, &event))
+    {
+      continue;
+    }
+
+    if (source >= PRODUCERS || event.timestamp_us != last[source] + 1)
+    {
+      reordered++;
+    }
+    else
+    {
+      last[source] = event.timestamp_us;
+    }
+    popped++;
+  }
+  wall_us = wm_clock_monotonic(NULL) - start_us;
+
+  for (i = 0; i < PRODUCERS; i++)
+  {
+    pthread_join(threads[i], NULL);
+    CHECK(last[i] == PUSHES);
+  }
+  CHECK(reordered == 0);
+  CHECK(!input_mux_queue_pop(&queue, &source, &event));
+
+  printf("%d producers: %.1f million events/s\n", PRODUCERS,
+    popped / (double)(wall_us ? wall_us : 1));
+
+  //a full queue turns producers away
+  input_mux_queue_init(&queue);
+  for (i = 0; i < INPUT_MUX_QUEUE_SIZE; i++)
+  {
+    CHECK(input_mux_queue_push(&queue, 0, &event));
+  }
+  CHECK(!input_mux_queue_push(&queue, 0, &event));
+  CHECK(input_mux_queue_pop(&queue, &source, &event));
+  CHECK(input_mux_queue_push(&queue, 0, &event));
+}
+
+// Scripted sources: each hands out its events once the test reaches their step
+struct script_event
+{
+  int step;
+  struct input_event event;
+};
+
+static struct script_event scripts[2][8];
+static int script_counts[2], script_indexes[2];
+static atomic_int step;
+static bool unloaded[3];
+
+static bool script_poll(int source, struct input_event *event)
+{
+  struct script_event *next = &scripts[source][script_indexes[source]];
+
+  if (script_indexes[source] == script_counts[source] || next->step > atomic_load(&step))
+  {
+    return false;
+  }
+
+  *event = next->event;
+  script_indexes[source]++;
+  return true;
+}
+
+static bool first_poll(struct input_event *event)
+{
+  return script_poll(0, event);
+}
+
+static bool second_poll(struct input_event *event)
+{
+  return script_poll(1, event);
+}
+
+//every poll takes a tenth of a second
+static bool slow_poll(struct input_event *event)
+{
+  struct timespec delay = { 0, 100000000 };
+
+  nanosleep(&delay, NULL);
+  return false;
+}
+
+static void first_unload(void)
+{
+  unloaded[0] = true;
+}
+
+static void second_unload(void)
+{
+  unloaded[1] = true;
+}
+
+static void slow_unload(void)
+{
+  unloaded[2] = true;
+}
+
+static int update_players(struct wiimote_state * const states[], int count)
+{
+  return 0;
+}
+
+static void script_button(int source, int at_step, enum input_button button, bool pressed)
+{
+  struct script_event *next = &scripts[source][script_counts[source]++];
+
+  memset(next, 0, sizeof(struct script_event));
+  next->step = at_step;
+  next->event.type = INPUT_EVENT_TYPE_BUTTON;
+  next->event.button_event.button = button;
+  next->event.button_event.pressed = pressed;
+}
+
+static void script_axis(int source, int at_step, enum input_analog_axis axis, float value)
+{
+  struct script_event *next = &scripts[source][script_counts[source]++];
+
+  memset(next, 0, sizeof(struct script_event));
+  next->step = at_step;
+  next->event.type = INPUT_EVENT_TYPE_ANALOG_AXIS;
+  next->event.analog_axis_event.axis = axis;
+  next->event.analog_axis_event.value = value;
+}
+
+static void script_pointer(int source, int at_step)
+{
+  struct script_event *next = &scripts[source][script_counts[source]++];
+
+  memset(next, 0, sizeof(struct script_event));
+  next->step = at_step;
+  next->event.type = INPUT_EVENT_TYPE_ANALOG_MOTION;
+  next->event.analog_motion_event.motion = INPUT_ANALOG_MOTION_POINTER;
+  next->event.analog_motion_event.delta_x = 0.1f;
+}
+
+// Waits up to a second for the next event out of the mux
+static bool next_event(struct input_event *event)
+{
+  uint64_t deadline_us = wm_clock_monotonic(NULL) + 1000000;
+
+  do
+  {
+    if (input_source_mux.poll_event(event))
+    {
+      return true;
+    }
+  } while (wm_clock_monotonic(NULL) < deadline_us);
+
+  return false;
+}
+
+static void test_mux()
+{
+  struct input_source first = { first_unload, first_poll };
+  struct input_source second = { second_unload, second_poll };
+  struct input_source slow = { slow_unload, slow_poll };
+  struct input_source snapshots = { slow_unload, slow_poll, update_players };
+  struct input_event event;
+  uint64_t start_us;
+
+  //the first source holds A, the second can't touch it meanwhile
+  script_button(0, 1, INPUT_BUTTON_WIIMOTE_A, true);
+  script_button(1, 2, INPUT_BUTTON_WIIMOTE_A, true);
+  script_button(1, 2, INPUT_BUTTON_WIIMOTE_A, false);
+  script_pointer(1, 2);
+  script_button(0, 3, INPUT_BUTTON_WIIMOTE_A, false);
+  //then the second takes it, and a held axis, which the first can take over
+  script_button(1, 4, INPUT_BUTTON_WIIMOTE_A, true);
+  script_axis(1, 4, INPUT_ANALOG_AXIS_CLASSIC_LT, 0.5f);
+  script_axis(0, 5, INPUT_ANALOG_AXIS_CLASSIC_LT, 1.0f);
+  script_axis(1, 6, INPUT_ANALOG_AXIS_CLASSIC_LT, 0.0f);
+  script_pointer(1, 6);
+
+  CHECK(input_mux_add(&snapshots) == -1);
+  CHECK(input_mux_add(&first) == 0);
+  CHECK(input_mux_add(&second) == 0);
+  CHECK(input_mux_add(&slow) == 0);
+  CHECK(input_mux_start() == 0);
+
+  //nothing yet, and the slow source doesn't make the emulator wait for it
+  start_us = wm_clock_monotonic(NULL);
+  CHECK(!input_source_mux.poll_event(&event));
+  CHECK(wm_clock_monotonic(NULL) - start_us < 10000);
+
+  atomic_store(&step, 1);
+  CHECK(next_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_BUTTON && event.button_event.pressed);
+
+  atomic_store(&step, 2);
+  CHECK(next_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_MOTION);
+
+  atomic_store(&step, 3);
+  CHECK(next_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_BUTTON && !event.button_event.pressed);
+
+  atomic_store(&step, 4);
+  CHECK(next_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_BUTTON && event.button_event.pressed);
+  CHECK(next_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_AXIS && event.analog_axis_event.value == 0.5f);
+
+  atomic_store(&step, 5);
+  CHECK(next_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_AXIS && event.analog_axis_event.value == 1.0f);
+
+  atomic_store(&step, 6);
+  CHECK(next_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_MOTION);
+  CHECK(!input_source_mux.poll_event(&event));
+
+  input_source_mux.unload();
+  CHECK(unloaded[0] && unloaded[1] && unloaded[2]);
+}
+
+int main(int argc, char *argv[])
+{
+  test_queue();
+  test_mux();
+
+  return test_result("merged input passed");
+}
@@ -0,0 +1,219 @@
+#include "input_replay.h"
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGRAM_NAME "wmemulator"
+
+static FILE *record_file;
+static struct input_source record_source;
+
+static struct input_socket_record *records;
+static int record_count, record_index;
+static bool replay_realtime;
+static uint64_t replay_now_us;
+//the first stamp is moved to this time on the replay clock
+static uint64_t replay_base_us;
+
+int input_replay_record_init(char const *path, struct input_source const *source)
+{
+  struct input_replay_header header = { INPUT_REPLAY_MAGIC, htole32(INPUT_REPLAY_VERSION) };
+
+  //whole controller states don't pass through as events
+  if (source->update_players != NULL)
+  {
+    printf(PROGRAM_NAME ": only input sources that send events can be recorded\n");
+    return -1;
+  }
+
+  record_file = fopen(path, "wb");
+  if (record_file == NULL || fwrite(&header, sizeof(header), 1, record_file) != 1)
+  {
+    printf(PROGRAM_NAME ": can't write %s: %s\n", path, strerror(errno));
+    if (record_file != NULL)
+    {
+      fclose(record_file);
+      record_file = NULL;
+    }
+    return -1;
+  }
+
+  record_source = *source;
+  input_source_record.wait_event = source->wait_event;
+  input_source_record.feedback = source->feedback;
+  return 0;
+}
+
+static void input_record_unload(void)
+{
+  if (record_file != NULL && fclose(record_file))
+  {
+    perror(PROGRAM_NAME);
+  }
+  record_file = NULL;
+
+  record_source.unload();
+}
+
+static bool input_record_poll_event(struct input_event *event)
+{
+  struct input_socket_record record;
+
+  if (!record_source.poll_event(event))
+  {
+    return false;
+  }
+
+  if (event->timestamp_us == 0)
+  {
+    event->timestamp_us = wm_clock_monotonic(NULL);
+  }
+
+  input_socket_make_record(event, &record);
+  if (record_file != NULL && fwrite(&record, sizeof(record), 1, record_file) != 1)
+  {
+    printf(PROGRAM_NAME ": can't write the recording, stopped\n");
+    fclose(record_file);
+    record_file = NULL;
+  }
+
+  return true;
+}
+
+int input_replay_init(char const *path, bool realtime)
+{
+  struct input_replay_header header;
+  FILE *file;
+  long size;
+
+  file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    printf(PROGRAM_NAME ": can't read %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+    memcmp(header.magic, INPUT_REPLAY_MAGIC, sizeof(header.magic)) != 0 ||
+    le32toh(header.version) != INPUT_REPLAY_VERSION)
+  {
+    printf(PROGRAM_NAME ": %s is not an input recording\n", path);
+    fclose(file);
+    return -1;
+  }
+
+  if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 ||
+    fseek(file, sizeof(header), SEEK_SET))
+  {
+    printf(PROGRAM_NAME ": can't read %s: %s\n", path, strerror(errno));
+    fclose(file);
+    return -1;
+  }
+
+  //a recording cut off mid record
+  size -= sizeof(header);
+  if (size % sizeof(struct input_socket_record) != 0)
+  {
+    printf(PROGRAM_NAME ": %s ends in a partial record\n", path);
+    fclose(file);
+    return -1;
+  }
+
+  free(records);
+  record_count = size / sizeof(struct input_socket_record);
+  records = malloc(record_count * sizeof(struct input_socket_record) + 1);
+  if (records == NULL ||
+    fread(records, sizeof(struct input_socket_record), record_count, file) != record_count)
+  {
+    printf(PROGRAM_NAME ": can't read %s\n", path);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+
+  record_index = 0;
+  replay_realtime = realtime;
+  replay_base_us = 0;
+  replay_now_us = (record_count > 0) ? le64toh(records[0].timestamp_us) : 0;
+
+  return 0;
+}
+
+uint64_t input_replay_now(void)
+{
+  if (replay_realtime)
+  {
+    //the first stamp is now, the first time anyone asks
+    if (replay_base_us == 0)
+    {
+      replay_base_us = wm_clock_monotonic(NULL);
+    }
+    return (record_count > 0 ? le64toh(records[0].timestamp_us) : 0) +
+      (wm_clock_monotonic(NULL) - replay_base_us);
+  }
+
+  return replay_now_us;
+}
+
+uint64_t input_replay_clock(void *data)
+{
+  return input_replay_now();
+}
+
+void input_replay_advance(uint64_t us)
+{
+  replay_now_us += us;
+}
+
+int input_replay_remaining(void)
+{
+  return record_count - record_index;
+}
+
+uint64_t input_replay_duration_us(void)
+{
+  return (record_count > 0) ?
+    le64toh(records[record_count - 1].timestamp_us) - le64toh(records[0].timestamp_us) : 0;
+}
+
+static void input_replay_unload(void)
+{
+  free(records);
+  records = NULL;
+  record_count = 0;
+  record_index = 0;
+}
+
+static bool input_replay_poll_event(struct input_event *event)
+{
+  uint64_t now = input_replay_now();
+
+  while (record_index < record_count && le64toh(records[record_index].timestamp_us) <= now)
+  {
+    if (input_socket_parse_record(&records[record_index++], event))
+    {
+      //onto the clock the reports are sent on
+      if (replay_realtime)
+      {
+        event->timestamp_us += replay_base_us - le64toh(records[0].timestamp_us);
+      }
+      return true;
+    }
+
+    printf(PROGRAM_NAME ": skipped invalid record %d of the recording\n", record_index - 1);
+  }
+
+  return false;
+}
+
+struct input_source input_source_record = {
+  .unload = input_record_unload,
+  .poll_event = input_record_poll_event
+};
+
+struct input_source input_source_replay = {
+  .unload = input_replay_unload,
+  .poll_event = input_replay_poll_event
+};
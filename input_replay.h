@@ -0,0 +1,54 @@
+#ifndef INPUT_REPLAY_H
+#define INPUT_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "input.h"
+#include "input_socket.h"
+
+/*
+ * Recorded input: a header followed by the events in the order they were
+ * taken, as the binary records of the socket protocol (see input_socket.h),
+ * each stamped with the time it happened. Replaying hands the events out as
+ * the replay clock passes their stamps, so a session can be played back at
+ * its own pace against a real host or run through on a virtual clock as fast
+ * as the reports can be made, the same reports every time.
+ */
+
+#define INPUT_REPLAY_MAGIC "WMRP"
+#define INPUT_REPLAY_VERSION 1
+
+struct input_replay_header
+{
+  char magic[4]; //INPUT_REPLAY_MAGIC
+  uint32_t version; //INPUT_REPLAY_VERSION, little-endian like the records
+} __attribute__((packed));
+
+// Passes the events of source through input_source_record, writing each one
+// to path. Unstamped events are stamped when they are taken. Returns -1 if
+// the file can't be written or the source writes whole controller states
+// (update_players) instead of events.
+int input_replay_record_init(char const *path, struct input_source const *source);
+
+extern struct input_source input_source_record;
+
+// Loads a recording. With realtime the replay clock follows CLOCK_MONOTONIC
+// from the first poll on and the stamps are moved onto it; otherwise it is a
+// virtual clock starting at the first stamp that only input_replay_advance
+// moves. Returns -1 if the file can't be read, isn't a recording or ends in
+// a partial record.
+int input_replay_init(char const *path, bool realtime);
+
+uint64_t input_replay_now(void);
+// input_replay_now as a wm_clock_fn, for wiimote_set_clock
+uint64_t input_replay_clock(void *data);
+void input_replay_advance(uint64_t us);
+
+// Events not handed out yet
+int input_replay_remaining(void);
+// Time from the first stamp to the last
+uint64_t input_replay_duration_us(void);
+
+extern struct input_source input_source_replay;
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "wiimote.h"
+#include "input.h"
+#include "input_replay.h"
+#include "loopback.h"
+#include "test.h"
+
+// Records a scripted source to a file and replays it on the virtual clock,
+// then runs a synthetic ten minute session through one controller and a
+// loopback link twice and checks both runs send the same reports.
+
+static char path[64];
+static struct input_axis_map axis_map;
+
+static struct input_event script[4];
+static int script_count, script_index;
+static bool script_unloaded;
+
+static void script_unload(void)
+{
+  script_unloaded = true;
+}
+
+static bool script_poll_event(struct input_event *event)
+{
+  if (script_index >= script_count)
+  {
+    return false;
+  }
+
+  *event = script[script_index++];
+  return true;
+}
+
+static struct input_source script_source = {
+  .unload = script_unload,
+  .poll_event = script_poll_event
+};
+
+static int script_update_players(struct wiimote_state * const states[], int count)
+{
+  return 0;
+}
+
+static void test_record()
+{
+  struct input_source snapshots = script_source;
+  struct input_event event;
+  int count = 0;
+
+  memset(script, 0, sizeof(script));
+  script[0].type = INPUT_EVENT_TYPE_BUTTON;
+  script[0].player = 1;
+  script[0].timestamp_us = 5000;
+  script[0].button_event.button = INPUT_BUTTON_WIIMOTE_A;
+  script[0].button_event.pressed = true;
+  script[1].type = INPUT_EVENT_TYPE_ANALOG_MOTION;
+  script[1].timestamp_us = 7000;
+  script[1].analog_motion_event.motion = INPUT_ANALOG_MOTION_POINTER;
+  script[1].analog_motion_event.delta_x = 0.25f;
+  script[1].analog_motion_event.delta_y = -0.125f;
+  script[2].type = INPUT_EVENT_TYPE_ANALOG_AXIS;
+  script[2].timestamp_us = 12000;
+  script[2].analog_axis_event.axis = INPUT_ANALOG_AXIS_CLASSIC_RT;
+  script[2].analog_axis_event.value = 0.5f;
+  //unstamped, stamped on the way through
+  script[3].type = INPUT_EVENT_TYPE_HOTPLUG;
+  script[3].hotplug_event.extension = Nunchuk;
+  script_count = 4;
+
+  //states written whole would leave an empty recording
+  snapshots.update_players = script_update_players;
+  CHECK(input_replay_record_init(path, &snapshots) == -1);
+
+  CHECK(input_replay_record_init(path, &script_source) == 0);
+  while (input_source_record.poll_event(&event))
+  {
+    CHECK(event.timestamp_us != 0);
+    count++;
+  }
+  CHECK(count == 4);
+  input_source_record.unload();
+  CHECK(script_unloaded);
+
+  CHECK(input_replay_init(path, false) == 0);
+  CHECK(input_replay_remaining() == 4);
+  CHECK(input_replay_now() == 5000);
+
+  //only what the clock has passed
+  CHECK(input_source_replay.poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_BUTTON && event.player == 1);
+  CHECK(event.timestamp_us == 5000);
+  CHECK(event.button_event.button == INPUT_BUTTON_WIIMOTE_A && event.button_event.pressed);
+  CHECK(!input_source_replay.poll_event(&event));
+
+  input_replay_advance(7000);
+  CHECK(input_source_replay.poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_MOTION && event.timestamp_us == 7000);
+  CHECK(event.analog_motion_event.delta_x == 0.25f && event.analog_motion_event.delta_y == -0.125f);
+  CHECK(input_source_replay.poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_AXIS && event.timestamp_us == 12000);
+  CHECK(event.analog_axis_event.axis == INPUT_ANALOG_AXIS_CLASSIC_RT);
+  CHECK(event.analog_axis_event.value == 0.5f);
+  CHECK(!input_source_replay.poll_event(&event));
+  CHECK(input_replay_remaining() == 1);
+
+  //the stamp taken when it was recorded
+  input_replay_advance(input_replay_duration_us());
+  CHECK(input_source_replay.poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_HOTPLUG && event.hotplug_event.extension == Nunchuk);
+  CHECK(input_replay_remaining() == 0);
+  input_source_replay.unload();
+
+  CHECK(input_replay_init("/nonexistent/recording", false) == -1);
+
+  //cut off mid record
+  CHECK(truncate(path, sizeof(struct input_replay_header) +
+    2 * sizeof(struct input_socket_record) + 5) == 0);
+  CHECK(input_replay_init(path, false) == -1);
+}
+
+static void write_record(FILE *file, struct input_event const *event)
+{
+  struct input_socket_record record;
+
+  input_socket_make_record(event, &record);
+  fwrite(&record, sizeof(record), 1, file);
+}
+
+// Ten minutes of pointer movement at 125 Hz with jittery stamps, the
+// nunchuk stick swept back and forth and a button every half second
+static void write_session()
+{
+  struct input_replay_header header = { INPUT_REPLAY_MAGIC, htole32(INPUT_REPLAY_VERSION) };
+  struct input_event event;
+  uint64_t time_us = 1000000, end_us = time_us + 600 * 1000000ULL;
+  uint32_t seed = 1;
+  int i;
+  FILE *file;
+
+  file = fopen(path, "wb");
+  fwrite(&header, sizeof(header), 1, file);
+
+  memset(&event, 0, sizeof(event));
+  event.type = INPUT_EVENT_TYPE_HOTPLUG;
+  event.timestamp_us = time_us;
+  event.hotplug_event.extension = Nunchuk;
+  write_record(file, &event);
+
+  for (i = 0; time_us < end_us; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    time_us += 7000 + (seed >> 16) % 2000;
+
+    memset(&event, 0, sizeof(event));
+    event.timestamp_us = time_us;
+    event.type = INPUT_EVENT_TYPE_ANALOG_MOTION;
+    event.analog_motion_event.motion = INPUT_ANALOG_MOTION_POINTER;
+    event.analog_motion_event.delta_x = ((int)(seed >> 8) % 200 - 100) / 20000.0f;
+    event.analog_motion_event.delta_y = ((int)(seed >> 4) % 200 - 100) / 20000.0f;
+    write_record(file, &event);
+
+    event.type = INPUT_EVENT_TYPE_ANALOG_AXIS;
+    event.analog_axis_event.axis = INPUT_ANALOG_AXIS_NUNCHUK_X;
+    event.analog_axis_event.value = (i % 250 - 125) / 125.0f;
+    write_record(file, &event);
+
+    if (i % 62 == 0)
+    {
+      memset(&event, 0, sizeof(event));
+      event.timestamp_us = time_us;
+      event.type = INPUT_EVENT_TYPE_BUTTON;
+      event.button_event.button = INPUT_BUTTON_WIIMOTE_A;
+      event.button_event.pressed = (i / 62) % 2 == 0;
+      write_record(file, &event);
+    }
+  }
+
+  fclose(file);
+}
+
+// Replays the recording on its virtual clock at 100 reports/s in mode 0x35
+// and returns a hash of the reports the host gets
+static uint64_t run_session(uint64_t *reports, uint64_t *wall_us)
+{
+  struct wiimote_state state;
+  struct input_state input;
+  struct wiimote_state * states[1] = { &state };
+  struct input_state * inputs[1] = { &input };
+  struct loopback link;
+  uint8_t buf[64];
+  uint8_t set_mode[4] = { 0xa2, 0x12, 0x04, 0x35 };
+  uint64_t hash = 0xcbf29ce484222325ULL, start_us, last_us;
+  ssize_t len;
+  int i;
+
+  CHECK(input_replay_init(path, false) == 0);
+  CHECK(loopback_open(&link) == 0);
+  wiimote_init(&state);
+  wiimote_set_clock(&state, input_replay_clock, NULL);
+  input_init(&input, &axis_map);
+  input.sample_delay_us = 10000;
+  send(link.host_fd, set_mode, sizeof(set_mode), MSG_DONTWAIT);
+
+  *reports = 0;
+  start_us = wm_clock_monotonic(NULL);
+  last_us = input_replay_now() + input_replay_duration_us() + input.sample_delay_us;
+  while (input_replay_remaining() > 0 || input_replay_now() <= last_us)
+  {
+    while ((len = recv(link.device_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      process_report(&state, buf, len);
+    }
+
+    input_update_players_at(states, inputs, 1, &input_source_replay, input_replay_now());
+
+    len = generate_report(&state, buf);
+    if (len > 0)
+    {
+      send(link.device_fd, buf, len, MSG_DONTWAIT);
+    }
+
+    while ((len = recv(link.host_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      for (i = 0; i < len; i++)
+      {
+        hash = (hash ^ buf[i]) * 0x100000001b3ULL;
+      }
+      (*reports)++;
+    }
+
+    input_replay_advance(10000);
+  }
+  *wall_us = wm_clock_monotonic(NULL) - start_us;
+
+  input_source_replay.unload();
+  loopback_close(&link);
+  wiimote_destroy(&state);
+
+  return hash;
+}
+
+static void test_session()
+{
+  uint64_t first, second, reports, wall_us;
+
+  write_session();
+
+  first = run_session(&reports, &wall_us);
+  printf("600 s session replayed in %.3f s, %llu reports\n", wall_us / 1e6,
+    (unsigned long long)reports);
+  CHECK(reports >= 60000);
+  CHECK(wall_us < 600 * 1000000ULL);
+
+  second = run_session(&reports, &wall_us);
+  CHECK(first == second);
+}
+
+int main(int argc, char *argv[])
+{
+  snprintf(path, sizeof(path), "/tmp/input_replay_test.%d", (int)getpid());
+  input_axis_map_init(&axis_map);
+
+  test_record();
+  test_session();
+
+  unlink(path);
+
+  return test_result("input replay passed");
+}
@@ -34,7 +34,8 @@ void input_sdl_init(void)
          "   ,'       `.\n"
          "  ,' t     y '.     0: toggles arrow keys between\n"
          "  V           V        IR/nunchuk/classic/motion plus\n"
-         "                    ESC: quit\n\n");
+         "                    ESC: quit\n"
+         "                  F1-F4: select player\n\n");
 }
 
 static void input_sdl_unload(void)
@@ -49,6 +50,7 @@ int arrow_function = 0;
 bool togglekey0 = 0;
 bool togglekey9 = 0;
 bool shift;
+int player = 0;
 
 static const float mouse_sensitivity = 1.0;
 
@@ -60,6 +62,10 @@ static bool input_sdl_poll_event(struct input_event *out_event)
     return false;
   }
 
+  //SDL 1.2 events carry no time, they are stamped as they are taken
+  out_event->player = player;
+  out_event->timestamp_us = wm_clock_monotonic(NULL);
+
   switch (event.type)
   {
   case SDL_MOUSEMOTION:
@@ -169,6 +175,16 @@ static bool input_sdl_poll_event(struct input_event *out_event)
         out_event->emulator_control_event.control = INPUT_EMULATOR_CONTROL_TOGGLE_REPORTS;
       }
       break;
+    case SDLK_F1:
+    case SDLK_F2:
+    case SDLK_F3:
+    case SDLK_F4:
+      if (event.type == SDL_KEYDOWN)
+      {
+        player = event.key.keysym.sym - SDLK_F1;
+        printf("keyboard and mouse control player %d\n", player + 1);
+      }
+      return false;
     case SDLK_LSHIFT:
       shift = (event.type == SDL_KEYDOWN);
 
@@ -0,0 +1,154 @@
+#include "input_shm.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGRAM_NAME "wmemulator"
+
+static struct input_shm_region *shm_region;
+static uint32_t shm_last_seq[INPUT_MAX_PLAYERS];
+
+struct input_shm_region * input_shm_open(char const *name, bool create)
+{
+  struct input_shm_region *region;
+  int fd, i;
+
+  fd = shm_open(name, O_RDWR | (create ? O_CREAT : 0), 0600);
+  if (fd == -1)
+  {
+    return NULL;
+  }
+
+  if (create && ftruncate(fd, sizeof(struct input_shm_region)))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  region = mmap(NULL, sizeof(struct input_shm_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  if (create && (region->magic != INPUT_SHM_MAGIC || region->version != INPUT_SHM_VERSION))
+  {
+    memset(region, 0, sizeof(struct input_shm_region));
+    region->version = INPUT_SHM_VERSION;
+    region->slot_count = INPUT_MAX_PLAYERS;
+    for (i = 0; i < INPUT_MAX_PLAYERS; i++)
+    {
+      atomic_init(&region->slots[i].seq, 0);
+    }
+    atomic_thread_fence(memory_order_release);
+    region->magic = INPUT_SHM_MAGIC;
+  }
+
+  if (region->magic != INPUT_SHM_MAGIC || region->version != INPUT_SHM_VERSION)
+  {
+    munmap(region, sizeof(struct input_shm_region));
+    return NULL;
+  }
+
+  return region;
+}
+
+void input_shm_close(struct input_shm_region *region)
+{
+  munmap(region, sizeof(struct input_shm_region));
+}
+
+void input_shm_write(struct input_shm_region *region, int player, struct wiimote_state_usr const *usr)
+{
+  struct input_shm_slot *slot = &region->slots[player];
+  uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+  atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  memcpy(&slot->usr, usr, sizeof(struct wiimote_state_usr));
+
+  atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+bool input_shm_read(struct input_shm_region *region, int player, uint32_t *last_seq,
+  struct wiimote_state_usr *usr)
+{
+  struct input_shm_slot *slot = &region->slots[player];
+  struct wiimote_state_usr copy;
+  uint32_t before, after;
+  int i;
+
+  for (i = 0; i < INPUT_SHM_READ_RETRIES; i++)
+  {
+    before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (before == *last_seq)
+    {
+      return false;
+    }
+    if (before & 1)
+    {
+      continue;
+    }
+
+    memcpy(&copy, &slot->usr, sizeof(copy));
+
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    if (before == after)
+    {
+      *usr = copy;
+      *last_seq = before;
+      return true;
+    }
+  }
+
+  //the producer is mid-write every time we look, try again next tick
+  return false;
+}
+
+void input_shm_init(char const *name)
+{
+  shm_region = input_shm_open(name, true);
+  if (shm_region == NULL)
+  {
+    perror(PROGRAM_NAME);
+    exit(1);
+  }
+
+  memset(shm_last_seq, 0, sizeof(shm_last_seq));
+}
+
+static void input_shm_unload(void)
+{
+  input_shm_close(shm_region);
+  shm_region = NULL;
+}
+
+static bool input_shm_poll_event(struct input_event *event)
+{
+  return false;
+}
+
+static int input_shm_update_players(struct wiimote_state * const states[], int count)
+{
+  int i;
+
+  for (i = 0; i < count && i < INPUT_MAX_PLAYERS; i++)
+  {
+    input_shm_read(shm_region, i, &shm_last_seq[i], &states[i]->usr);
+  }
+
+  return 0;
+}
+
+struct input_source input_source_shm = {
+  .unload = input_shm_unload,
+  .poll_event = input_shm_poll_event,
+  .update_players = input_shm_update_players
+};
@@ -0,0 +1,53 @@
+#ifndef INPUT_SHM_H
+#define INPUT_SHM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "input.h"
+
+/*
+ * Shared memory input for producers on the same machine: the region holds
+ * one full controller snapshot per player, each behind a seqlock. The
+ * producer bumps seq to odd, writes the snapshot and bumps it to even again;
+ * the emulator copies a slot whenever its seq has moved and reads the same
+ * even value before and after the copy. No parsing and no syscalls once the
+ * region is mapped.
+ */
+
+#define INPUT_SHM_MAGIC 0x48534d57 //"WMSH"
+#define INPUT_SHM_VERSION 1
+#define INPUT_SHM_READ_RETRIES 64
+
+struct input_shm_slot
+{
+  _Atomic uint32_t seq; //odd while the producer writes, 0 until the first snapshot
+  struct wiimote_state_usr usr;
+} __attribute__((aligned(64)));
+
+struct input_shm_region
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  struct input_shm_slot slots[INPUT_MAX_PLAYERS];
+};
+
+// Maps the named POSIX shared memory region, creating and initializing it
+// when create is set. Returns NULL on failure.
+struct input_shm_region * input_shm_open(char const *name, bool create);
+void input_shm_close(struct input_shm_region *region);
+
+// Producer side: publishes a snapshot for a player
+void input_shm_write(struct input_shm_region *region, int player, struct wiimote_state_usr const *usr);
+
+// Copies the player's snapshot if it changed since last_seq, which is
+// updated. Returns false if there was nothing new or no consistent copy.
+bool input_shm_read(struct input_shm_region *region, int player, uint32_t *last_seq,
+  struct wiimote_state_usr *usr);
+
+void input_shm_init(char const *name);
+
+extern struct input_source input_source_shm;
+
+#endif
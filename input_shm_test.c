@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "wiimote.h"
+#include "input_shm.h"
+#include "test.h"
+
+// A producer thread publishes snapshots as fast as it can while the
+// emulator side pulls them through input_update_players, over and over. Every field of a
+// snapshot is derived from one counter, so a torn copy shows up as fields
+// that disagree.
+
+#define UPDATES 100000
+
+static char shm_name[64];
+static struct input_shm_region *producer_region;
+static struct input_axis_map axis_map;
+static atomic_int producer_stop;
+static uint32_t snapshots_written;
+
+static void fill_snapshot(struct wiimote_state_usr *usr, uint32_t n)
+{
+  int i;
+
+  memset(usr, 0, sizeof(struct wiimote_state_usr));
+  usr->buttons = n & WIIMOTE_BUTTONS_MASK;
+  usr->accel_x = n & 0x3ff;
+  usr->accel_y = (n >> 1) & 0x3ff;
+  usr->accel_z = (n >> 2) & 0x3ff;
+  for (i = 0; i < 4; i++)
+  {
+    usr->ir_object[i].x = (n + i) & 0x3ff;
+    usr->ir_object[i].y = (n >> 3) & 0x3ff;
+  }
+  usr->nunchuk.x = n;
+  usr->classic.rs_x = n >> 8;
+  usr->motionplus.yaw_down = n & 0x3fff;
+  usr->connected_extension_type = Classic;
+}
+
+//checks a snapshot against the counter kept whole in its motionplus yaw
+static int snapshot_consistent(struct wiimote_state_usr const *usr)
+{
+  struct wiimote_state_usr expected;
+  uint32_t n = usr->motionplus.yaw_down;
+
+  fill_snapshot(&expected, n);
+  return memcmp(&expected, usr, sizeof(expected)) == 0;
+}
+
+static void * producer(void *arg)
+{
+  struct wiimote_state_usr usr;
+  uint32_t n;
+
+  for (n = 1; !atomic_load(&producer_stop); n++)
+  {
+    fill_snapshot(&usr, n & 0x3fff);
+    input_shm_write(producer_region, 0, &usr);
+    if (n % 4 == 0)
+    {
+      sched_yield();
+    }
+  }
+  snapshots_written = n - 1;
+
+  return NULL;
+}
+
+static void test_concurrent()
+{
+  struct wiimote_state state;
+  struct wiimote_state * states[1] = { &state };
+  struct input_state input;
+  struct input_state * inputs[1] = { &input };
+  pthread_t thread;
+  int copies = 0, i;
+
+  wiimote_init(&state);
+  input_init(&input, &axis_map);
+
+  pthread_create(&thread, NULL, producer, NULL);
+
+  for (i = 0; i < UPDATES && failures < 5; i++)
+  {
+    memset(&state.usr, 0, sizeof(state.usr));
+    input_update_players(states, inputs, 1, &input_source_shm);
+    if (state.usr.connected_extension_type == Classic)
+    {
+      CHECK(snapshot_consistent(&state.usr));
+      copies++;
+    }
+
+    //the emulator waits for its next tick here, on a single core that lets
+    //the producer run
+    sched_yield();
+  }
+
+  atomic_store(&producer_stop, 1);
+  pthread_join(thread, NULL);
+
+  //the last snapshot is picked up once and then left alone
+  memset(&state.usr, 0, sizeof(state.usr));
+  input_update_players(states, inputs, 1, &input_source_shm);
+  CHECK(state.usr.connected_extension_type != Classic ||
+    state.usr.motionplus.yaw_down == (snapshots_written & 0x3fff));
+  memset(&state.usr, 0, sizeof(state.usr));
+  input_update_players(states, inputs, 1, &input_source_shm);
+  CHECK(state.usr.connected_extension_type != Classic);
+
+  printf("%d consistent snapshots copied in %d updates while %u were written\n", copies,
+    UPDATES, snapshots_written);
+  CHECK(copies > 0);
+
+  wiimote_destroy(&state);
+}
+
+//each slot goes to its own player, empty slots leave their state alone
+static void test_slots()
+{
+  struct wiimote_state a, b;
+  struct wiimote_state * states[2] = { &a, &b };
+  struct input_state input_a, input_b;
+  struct input_state * inputs[2] = { &input_a, &input_b };
+  struct wiimote_state_usr usr;
+  struct input_shm_region *region;
+
+  wiimote_init(&a);
+  wiimote_init(&b);
+  input_init(&input_a, &axis_map);
+  input_init(&input_b, &axis_map);
+
+  region = input_shm_open(shm_name, false);
+  CHECK(region != NULL);
+  CHECK(region->slot_count == INPUT_MAX_PLAYERS);
+
+  fill_snapshot(&usr, 0x123);
+  usr.buttons = WIIMOTE_BUTTON_A;
+  input_shm_write(region, 1, &usr);
+  b.usr.buttons = 0;
+  a.usr.buttons = WIIMOTE_BUTTON_HOME;
+
+  input_update_players(states, inputs, 2, &input_source_shm);
+  CHECK(a.usr.buttons == WIIMOTE_BUTTON_HOME);
+  CHECK(b.usr.buttons == WIIMOTE_BUTTON_A);
+  CHECK(b.usr.nunchuk.x == 0x23);
+
+  //a producer stuck mid-write isn't waited for
+  atomic_fetch_add(&region->slots[1].seq, 1);
+  b.usr.buttons = 0;
+  input_update_players(states, inputs, 2, &input_source_shm);
+  CHECK(b.usr.buttons == 0);
+
+  input_shm_close(region);
+  wiimote_destroy(&a);
+  wiimote_destroy(&b);
+}
+
+int main(int argc, char *argv[])
+{
+  snprintf(shm_name, sizeof(shm_name), "/input_shm_test.%d", (int)getpid());
+  input_axis_map_init(&axis_map);
+
+  input_shm_init(shm_name);
+  producer_region = input_shm_open(shm_name, false);
+  if (producer_region == NULL)
+  {
+    perror("input_shm_open");
+    return 1;
+  }
+
+  test_concurrent();
+  test_slots();
+
+  input_shm_close(producer_region);
+  input_source_shm.unload();
+  shm_unlink(shm_name);
+
+  return test_result("shared memory input passed");
+}
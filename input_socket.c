@@ -1,9 +1,14 @@
+#define _GNU_SOURCE
 #include "input_socket.h"
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <sys/un.h>
+#include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
+#include <endian.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,11 +16,41 @@
 
 #define PROGRAM_NAME "wmemulator"
 
+//datagrams taken from the socket by one recvmmsg
+#define INPUT_SOCKET_BATCH 32
+
+//sender stamps further from the receive time than this aren't trusted
+#define INPUT_SOCKET_MAX_SKEW_US 1000000
+
 static bool input_socket_init_from_addrinfo(struct addrinfo *addrinfo);
 
 static int sock;
-static char buf[512];
-static size_t buf_len;
+
+//the last batch received, handed out in order
+static char batch_bufs[INPUT_SOCKET_BATCH][INPUT_SOCKET_DATAGRAM_SIZE];
+static struct iovec batch_iovecs[INPUT_SOCKET_BATCH];
+static struct mmsghdr batch_msgs[INPUT_SOCKET_BATCH];
+static int batch_count, batch_index;
+//when the batch was received, microseconds of CLOCK_MONOTONIC
+static uint64_t batch_time_us;
+
+//who sent each datagram of the batch
+static struct sockaddr_storage batch_addrs[INPUT_SOCKET_BATCH];
+
+//the datagram being handed out, 0 length once it is used up
+static char *buf;
+static ssize_t buf_len;
+static struct mmsghdr *buf_msg;
+//next binary record of the datagram in buf
+static int record_index;
+
+//clients that asked for feedback and what they were last sent, taken by
+//the emulator thread and the one polling the socket
+static pthread_mutex_t subscriber_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sockaddr_storage subscribers[INPUT_SOCKET_MAX_SUBSCRIBERS];
+static socklen_t subscriber_lens[INPUT_SOCKET_MAX_SUBSCRIBERS];
+static int subscriber_count;
+static struct input_socket_feedback last_feedback[INPUT_MAX_PLAYERS];
 
 void input_socket_init_unix_at_path(char const *path)
 {
@@ -95,161 +130,579 @@ static void input_socket_unload(void)
   {
     perror(PROGRAM_NAME);
   }
+  subscriber_count = 0;
+  memset(last_feedback, 0, sizeof(last_feedback));
 }
 
-static bool input_socket_poll_event(struct input_event *event)
+//largest id each event type accepts
+static const uint8_t record_max_id[] =
 {
-  if (!buf_len)
+  [INPUT_EVENT_TYPE_EMULATOR_CONTROL] = INPUT_EMULATOR_CONTROL_TOGGLE_REPORTS,
+  [INPUT_EVENT_TYPE_HOTPLUG] = NoExtension,
+  [INPUT_EVENT_TYPE_BUTTON] = INPUT_BUTTON_CLASSIC_MINUS,
+  [INPUT_EVENT_TYPE_ANALOG_MOTION] = INPUT_ANALOG_MOTION_MOTIONPLUS_SLOW,
+  [INPUT_EVENT_TYPE_ANALOG_AXIS] = INPUT_ANALOG_AXIS_COUNT - 1,
+};
+
+//records hold floats as little-endian IEEE 754 singles
+static float float_from_le(float value)
+{
+  uint32_t bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  bits = le32toh(bits);
+  memcpy(&value, &bits, sizeof(bits));
+  return value;
+}
+
+static float float_to_le(float value)
+{
+  uint32_t bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  bits = htole32(bits);
+  memcpy(&value, &bits, sizeof(bits));
+  return value;
+}
+
+bool input_socket_parse_record(struct input_socket_record const *record, struct input_event *event)
+{
+  if (record->type >= sizeof(record_max_id) || record->id > record_max_id[record->type] ||
+    record->player >= INPUT_MAX_PLAYERS)
   {
-    buf_len = recv(sock, buf, sizeof(buf) - 1, 0);
-    if (buf_len == -1)
-    {
-      buf_len = 0;
-      if (!(errno == EAGAIN || errno == EWOULDBLOCK))
-      {
-        perror(PROGRAM_NAME);
-      }
-      return false;
-    }
+    return false;
   }
-  buf[buf_len] = '\0';
-  printf("received %d bytes: %s\n", buf_len, buf);
 
-  event->type = INPUT_EVENT_TYPE_BUTTON;
+  event->type = record->type;
+  event->player = record->player;
+  event->timestamp_us = le64toh(record->timestamp_us);
 
-  char event_type_s[32], event_param_s[32];
-  int event_status;
-  if (sscanf(buf, "%32s %d %32s", event_type_s, &event_status, event_param_s) == EOF)
+  switch (record->type)
   {
-    printf(PROGRAM_NAME ": received input in invalid format\n");
+    case INPUT_EVENT_TYPE_EMULATOR_CONTROL:
+      event->emulator_control_event.control = record->id;
+      break;
+    case INPUT_EVENT_TYPE_HOTPLUG:
+      event->hotplug_event.extension = record->status ? record->id : NoExtension;
+      break;
+    case INPUT_EVENT_TYPE_BUTTON:
+      event->button_event.pressed = record->status;
+      event->button_event.button = record->id;
+      break;
+    case INPUT_EVENT_TYPE_ANALOG_MOTION:
+      event->analog_motion_event.moving = record->status;
+      event->analog_motion_event.motion = record->id;
+      event->analog_motion_event.delta_x = float_from_le(record->delta_x);
+      event->analog_motion_event.delta_y = float_from_le(record->delta_y);
+      event->analog_motion_event.delta_z = float_from_le(record->delta_z);
+      break;
+    case INPUT_EVENT_TYPE_ANALOG_AXIS:
+      event->analog_axis_event.axis = record->id;
+      event->analog_axis_event.value = float_from_le(record->delta_x);
+      break;
+  }
+
+  return true;
+}
+
+void input_socket_make_record(struct input_event const *event, struct input_socket_record *record)
+{
+  memset(record, 0, sizeof(struct input_socket_record));
+  record->type = event->type;
+  record->player = event->player;
+  record->timestamp_us = htole64(event->timestamp_us);
+
+  switch (event->type)
+  {
+    case INPUT_EVENT_TYPE_EMULATOR_CONTROL:
+      record->id = event->emulator_control_event.control;
+      break;
+    case INPUT_EVENT_TYPE_HOTPLUG:
+      record->status = event->hotplug_event.extension != NoExtension;
+      record->id = event->hotplug_event.extension;
+      break;
+    case INPUT_EVENT_TYPE_BUTTON:
+      record->status = event->button_event.pressed;
+      record->id = event->button_event.button;
+      break;
+    case INPUT_EVENT_TYPE_ANALOG_MOTION:
+      record->status = event->analog_motion_event.moving;
+      record->id = event->analog_motion_event.motion;
+      record->delta_x = float_to_le(event->analog_motion_event.delta_x);
+      record->delta_y = float_to_le(event->analog_motion_event.delta_y);
+      record->delta_z = float_to_le(event->analog_motion_event.delta_z);
+      break;
+    case INPUT_EVENT_TYPE_ANALOG_AXIS:
+      record->id = event->analog_axis_event.axis;
+      record->delta_x = float_to_le(event->analog_axis_event.value);
+      break;
+  }
+}
+
+// Hands out the binary records of the datagram in buf one per call, invalid
+// ones are skipped
+static bool poll_binary_event(struct input_event *event)
+{
+  struct input_socket_header header;
+  struct input_socket_record record;
+
+  memcpy(&header, buf, sizeof(header));
+  header.count = le16toh(header.count);
+  if (header.version != INPUT_SOCKET_VERSION ||
+    buf_len != sizeof(header) + header.count * sizeof(record))
+  {
+    printf(PROGRAM_NAME ": received binary input with version %d and %d bytes\n",
+      header.version, (int)buf_len);
     buf_len = 0;
     return false;
   }
 
-  if (strcmp(event_type_s, "emulator_control") == 0)
+  while (record_index < header.count)
   {
-    event->type = INPUT_EVENT_TYPE_EMULATOR_CONTROL;
+    memcpy(&record, buf + sizeof(header) + record_index * sizeof(record), sizeof(record));
+    record_index++;
 
-    if (strcmp(event_param_s, "quit") == 0)
+    if (!input_socket_parse_record(&record, event))
     {
-      event->emulator_control_event.control = INPUT_EMULATOR_CONTROL_QUIT;
+      printf(PROGRAM_NAME ": received invalid binary record: type %d id %d player %d\n",
+        record.type, record.id, record.player);
     }
-    else if (strcmp(event_param_s, "power_off") == 0)
+    else
     {
-      event->emulator_control_event.control = INPUT_EMULATOR_CONTROL_POWER_OFF;
+      //a stamp from the sender's CLOCK_MONOTONIC, unless it is missing or off
+      if (event->timestamp_us == 0 || event->timestamp_us > batch_time_us ||
+        batch_time_us - event->timestamp_us >= INPUT_SOCKET_MAX_SKEW_US)
+      {
+        event->timestamp_us = batch_time_us;
+      }
+
+      if (record_index == header.count)
+      {
+        buf_len = 0;
+      }
+      return true;
     }
   }
-  else if (strcmp(event_type_s, "hotplug") == 0)
+
+  buf_len = 0;
+  return false;
+}
+
+// Moves on to the next datagram of the batch, receiving a new batch once
+// this one is used up. Returns false when nothing is waiting.
+static bool next_datagram(void)
+{
+  int i;
+
+  if (batch_index == batch_count)
   {
-    event->type = INPUT_EVENT_TYPE_HOTPLUG;
+    batch_index = 0;
+    memset(batch_msgs, 0, sizeof(batch_msgs));
+    for (i = 0; i < INPUT_SOCKET_BATCH; i++)
+    {
+      //one byte is kept for the terminator of a text command
+      batch_iovecs[i].iov_base = batch_bufs[i];
+      batch_iovecs[i].iov_len = INPUT_SOCKET_DATAGRAM_SIZE - 1;
+      batch_msgs[i].msg_hdr.msg_iov = &batch_iovecs[i];
+      batch_msgs[i].msg_hdr.msg_iovlen = 1;
+      batch_msgs[i].msg_hdr.msg_name = &batch_addrs[i];
+      batch_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
 
-    if (event_status == 0)
+    batch_count = recvmmsg(sock, batch_msgs, INPUT_SOCKET_BATCH, 0, NULL);
+    if (batch_count == -1)
     {
-      event->hotplug_event.extension = NoExtension;
+      batch_count = 0;
+      if (!(errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+        perror(PROGRAM_NAME);
+      }
+      return false;
     }
-    else if (strcmp(event_param_s, "nunchuk") == 0)
+    batch_time_us = wm_clock_monotonic(NULL);
+  }
+
+  buf = batch_bufs[batch_index];
+  buf_len = batch_msgs[batch_index].msg_len;
+  buf_msg = &batch_msgs[batch_index];
+  batch_index++;
+  record_index = 0;
+  return true;
+}
+
+static bool poll_text_event(struct input_event *event);
+
+static bool input_socket_poll_event(struct input_event *event)
+{
+  //datagrams without a valid event are skipped
+  while (buf_len || next_datagram())
+  {
+    if (buf_len >= sizeof(struct input_socket_header) && (uint8_t)buf[0] == INPUT_SOCKET_MAGIC)
     {
-      event->hotplug_event.extension = Nunchuk;
+      if (poll_binary_event(event))
+      {
+        return true;
+      }
     }
-    else if (strcmp(event_param_s, "classic") == 0)
+    else if (buf_len && poll_text_event(event))
     {
-      event->hotplug_event.extension = Classic;
+      return true;
     }
-    else if (strcmp(event_param_s, "balance_board") == 0)
+  }
+
+  return false;
+}
+
+// Names of the text protocol, each table sorted by strcmp for bsearch
+struct input_name
+{
+  char const *name;
+  int value;
+};
+
+#define NAME(Prefix, Name) { #Name, Prefix##Name }
+
+static const struct input_name event_type_names[] =
+{
+  { "analog_axis", INPUT_EVENT_TYPE_ANALOG_AXIS },
+  { "analog_motion", INPUT_EVENT_TYPE_ANALOG_MOTION },
+  { "button", INPUT_EVENT_TYPE_BUTTON },
+  { "emulator_control", INPUT_EVENT_TYPE_EMULATOR_CONTROL },
+  { "hotplug", INPUT_EVENT_TYPE_HOTPLUG },
+};
+
+static const struct input_name emulator_control_names[] =
+{
+  { "power_off", INPUT_EMULATOR_CONTROL_POWER_OFF },
+  { "quit", INPUT_EMULATOR_CONTROL_QUIT },
+  { "toggle_reports", INPUT_EMULATOR_CONTROL_TOGGLE_REPORTS },
+};
+
+static const struct input_name extension_names[] =
+{
+  { "balance_board", BalanceBoard },
+  { "classic", Classic },
+  { "nunchuk", Nunchuk },
+};
+
+static const struct input_name button_names[] =
+{
+  NAME(INPUT_BUTTON_, CLASSIC_A),
+  NAME(INPUT_BUTTON_, CLASSIC_B),
+  NAME(INPUT_BUTTON_, CLASSIC_DOWN),
+  NAME(INPUT_BUTTON_, CLASSIC_L),
+  NAME(INPUT_BUTTON_, CLASSIC_LEFT),
+  NAME(INPUT_BUTTON_, CLASSIC_MINUS),
+  NAME(INPUT_BUTTON_, CLASSIC_PLUS),
+  NAME(INPUT_BUTTON_, CLASSIC_R),
+  NAME(INPUT_BUTTON_, CLASSIC_RIGHT),
+  NAME(INPUT_BUTTON_, CLASSIC_UP),
+  NAME(INPUT_BUTTON_, CLASSIC_X),
+  NAME(INPUT_BUTTON_, CLASSIC_Y),
+  NAME(INPUT_BUTTON_, CLASSIC_ZL),
+  NAME(INPUT_BUTTON_, CLASSIC_ZR),
+  NAME(INPUT_BUTTON_, HOME),
+  NAME(INPUT_BUTTON_, NUNCHUK_C),
+  NAME(INPUT_BUTTON_, NUNCHUK_Z),
+  NAME(INPUT_BUTTON_, WIIMOTE_1),
+  NAME(INPUT_BUTTON_, WIIMOTE_2),
+  NAME(INPUT_BUTTON_, WIIMOTE_A),
+  NAME(INPUT_BUTTON_, WIIMOTE_B),
+  NAME(INPUT_BUTTON_, WIIMOTE_DOWN),
+  NAME(INPUT_BUTTON_, WIIMOTE_LEFT),
+  NAME(INPUT_BUTTON_, WIIMOTE_MINUS),
+  NAME(INPUT_BUTTON_, WIIMOTE_PLUS),
+  NAME(INPUT_BUTTON_, WIIMOTE_RIGHT),
+  NAME(INPUT_BUTTON_, WIIMOTE_UP),
+};
+
+static const struct input_name analog_motion_names[] =
+{
+  NAME(INPUT_ANALOG_MOTION_, CLASSIC_LEFT_STICK_DOWN),
+  NAME(INPUT_ANALOG_MOTION_, CLASSIC_LEFT_STICK_LEFT),
+  NAME(INPUT_ANALOG_MOTION_, CLASSIC_LEFT_STICK_RIGHT),
+  NAME(INPUT_ANALOG_MOTION_, CLASSIC_LEFT_STICK_UP),
+  NAME(INPUT_ANALOG_MOTION_, IR_DOWN),
+  NAME(INPUT_ANALOG_MOTION_, IR_LEFT),
+  NAME(INPUT_ANALOG_MOTION_, IR_RIGHT),
+  NAME(INPUT_ANALOG_MOTION_, IR_UP),
+  NAME(INPUT_ANALOG_MOTION_, MOTIONPLUS_DOWN),
+  NAME(INPUT_ANALOG_MOTION_, MOTIONPLUS_LEFT),
+  NAME(INPUT_ANALOG_MOTION_, MOTIONPLUS_RIGHT),
+  NAME(INPUT_ANALOG_MOTION_, MOTIONPLUS_SLOW),
+  NAME(INPUT_ANALOG_MOTION_, MOTIONPLUS_UP),
+  NAME(INPUT_ANALOG_MOTION_, NUNCHUK_DOWN),
+  NAME(INPUT_ANALOG_MOTION_, NUNCHUK_LEFT),
+  NAME(INPUT_ANALOG_MOTION_, NUNCHUK_RIGHT),
+  NAME(INPUT_ANALOG_MOTION_, NUNCHUK_UP),
+  NAME(INPUT_ANALOG_MOTION_, STEER_LEFT),
+  NAME(INPUT_ANALOG_MOTION_, STEER_RIGHT),
+};
+
+static const struct input_name analog_axis_names[] =
+{
+  NAME(INPUT_ANALOG_AXIS_, CLASSIC_LS_X),
+  NAME(INPUT_ANALOG_AXIS_, CLASSIC_LS_Y),
+  NAME(INPUT_ANALOG_AXIS_, CLASSIC_LT),
+  NAME(INPUT_ANALOG_AXIS_, CLASSIC_RS_X),
+  NAME(INPUT_ANALOG_AXIS_, CLASSIC_RS_Y),
+  NAME(INPUT_ANALOG_AXIS_, CLASSIC_RT),
+  NAME(INPUT_ANALOG_AXIS_, MOTIONPLUS_PITCH),
+  NAME(INPUT_ANALOG_AXIS_, MOTIONPLUS_ROLL),
+  NAME(INPUT_ANALOG_AXIS_, MOTIONPLUS_YAW),
+  NAME(INPUT_ANALOG_AXIS_, NUNCHUK_X),
+  NAME(INPUT_ANALOG_AXIS_, NUNCHUK_Y),
+};
+
+#undef NAME
+
+#define LOOKUP(Table, Name) lookup_name(Table, sizeof(Table) / sizeof(Table[0]), Name)
+
+static int compare_name(const void *key, const void *entry)
+{
+  return strcmp((char const *)key, ((struct input_name const *)entry)->name);
+}
+
+static int lookup_name(struct input_name const *table, size_t count, char const *name)
+{
+  struct input_name const *entry = bsearch(name, table, count, sizeof(struct input_name), compare_name);
+
+  return (entry != NULL) ? entry->value : -1;
+}
+
+int input_socket_lookup_name(enum input_event_type type, char const *name)
+{
+  switch (type)
+  {
+    case INPUT_EVENT_TYPE_EMULATOR_CONTROL:
+      return LOOKUP(emulator_control_names, name);
+    case INPUT_EVENT_TYPE_HOTPLUG:
+      return LOOKUP(extension_names, name);
+    case INPUT_EVENT_TYPE_BUTTON:
+      return LOOKUP(button_names, name);
+    case INPUT_EVENT_TYPE_ANALOG_MOTION:
+      return LOOKUP(analog_motion_names, name);
+    case INPUT_EVENT_TYPE_ANALOG_AXIS:
+      return LOOKUP(analog_axis_names, name);
+    default:
+      return -1;
+  }
+}
+
+// Sends feedback to subscriber i, dropping it if it's gone. Called with
+// subscriber_lock held.
+static void send_feedback(int i, struct input_socket_feedback const *feedback)
+{
+  if (sendto(sock, feedback, sizeof(struct input_socket_feedback), MSG_DONTWAIT,
+    (struct sockaddr *)&subscribers[i], subscriber_lens[i]) == -1 &&
+    (errno == ECONNREFUSED || errno == ENOENT))
+  {
+    subscribers[i] = subscribers[subscriber_count - 1];
+    subscriber_lens[i] = subscriber_lens[subscriber_count - 1];
+    subscriber_count--;
+  }
+}
+
+// "feedback 1" from a client subscribes it, "feedback 0" unsubscribes it
+static void subscribe(bool on)
+{
+  struct sockaddr_storage *address = buf_msg->msg_hdr.msg_name;
+  socklen_t len = buf_msg->msg_hdr.msg_namelen;
+  int i, player;
+
+  //unbound unix sockets can't be answered
+  if (len <= sizeof(sa_family_t))
+  {
+    printf(PROGRAM_NAME ": feedback needs a client socket with an address\n");
+    return;
+  }
+
+  pthread_mutex_lock(&subscriber_lock);
+
+  for (i = 0; i < subscriber_count; i++)
+  {
+    if (subscriber_lens[i] == len && memcmp(&subscribers[i], address, len) == 0)
     {
-      event->hotplug_event.extension = BalanceBoard;
+      break;
     }
-    else
+  }
+
+  if (!on)
+  {
+    if (i < subscriber_count)
     {
-      event->hotplug_event.extension = NoExtension;
+      subscribers[i] = subscribers[subscriber_count - 1];
+      subscriber_lens[i] = subscriber_lens[subscriber_count - 1];
+      subscriber_count--;
     }
   }
-  else if (strcmp(event_type_s, "button") == 0)
-  {
-    event->type = INPUT_EVENT_TYPE_BUTTON;
-    event->button_event.pressed = event_status;
-
-#define CHECK(Button) if (strcmp(event_param_s, #Button) == 0) event->button_event.button = INPUT_BUTTON_##Button
-    CHECK(HOME);
-    else CHECK(WIIMOTE_UP);
-    else CHECK(WIIMOTE_DOWN);
-    else CHECK(WIIMOTE_LEFT);
-    else CHECK(WIIMOTE_RIGHT);
-    else CHECK(WIIMOTE_A);
-    else CHECK(WIIMOTE_B);
-    else CHECK(WIIMOTE_1);
-    else CHECK(WIIMOTE_2);
-    else CHECK(WIIMOTE_PLUS);
-    else CHECK(WIIMOTE_MINUS);
-    else CHECK(NUNCHUK_C);
-    else CHECK(NUNCHUK_Z);
-    else CHECK(CLASSIC_UP);
-    else CHECK(CLASSIC_DOWN);
-    else CHECK(CLASSIC_LEFT);
-    else CHECK(CLASSIC_RIGHT);
-    else CHECK(CLASSIC_A);
-    else CHECK(CLASSIC_B);
-    else CHECK(CLASSIC_X);
-    else CHECK(CLASSIC_Y);
-    else CHECK(CLASSIC_L);
-    else CHECK(CLASSIC_R);
-    else CHECK(CLASSIC_ZL);
-    else CHECK(CLASSIC_ZR);
-    else CHECK(CLASSIC_PLUS);
-    else CHECK(CLASSIC_MINUS);
-#undef CHECK
-    else
+  else if (i == subscriber_count && subscriber_count == INPUT_SOCKET_MAX_SUBSCRIBERS)
+  {
+    printf(PROGRAM_NAME ": at most %d clients can take feedback\n", INPUT_SOCKET_MAX_SUBSCRIBERS);
+  }
+  else
+  {
+    if (i == subscriber_count)
     {
-      printf(PROGRAM_NAME ": received invalid 'button' parameter: %s\n", event_param_s);
-      buf_len = 0;
-      return false;
+      memcpy(&subscribers[i], address, len);
+      subscriber_lens[i] = len;
+      subscriber_count++;
+    }
+
+    //where every player is at
+    for (player = 0; player < INPUT_MAX_PLAYERS; player++)
+    {
+      if (last_feedback[player].magic != 0)
+      {
+        send_feedback(i, &last_feedback[player]);
+      }
     }
   }
-  else if (strcmp(event_type_s, "analog_motion") == 0)
-  {
-    event->type = INPUT_EVENT_TYPE_ANALOG_MOTION;
-    event->analog_motion_event.moving = event_status;
-
-#define CHECK(Motion) if (strcmp(event_param_s, #Motion) == 0) event->analog_motion_event.motion = INPUT_ANALOG_MOTION_##Motion
-    CHECK(IR_UP);
-    else CHECK(IR_DOWN);
-    else CHECK(IR_LEFT);
-    else CHECK(IR_RIGHT);
-    else CHECK(STEER_LEFT);
-    else CHECK(STEER_RIGHT);
-    else CHECK(NUNCHUK_UP);
-    else CHECK(NUNCHUK_DOWN);
-    else CHECK(NUNCHUK_LEFT);
-    else CHECK(NUNCHUK_RIGHT);
-    else CHECK(CLASSIC_LEFT_STICK_UP);
-    else CHECK(CLASSIC_LEFT_STICK_DOWN);
-    else CHECK(CLASSIC_LEFT_STICK_LEFT);
-    else CHECK(CLASSIC_LEFT_STICK_RIGHT);
-    else CHECK(MOTIONPLUS_UP);
-    else CHECK(MOTIONPLUS_DOWN);
-    else CHECK(MOTIONPLUS_LEFT);
-    else CHECK(MOTIONPLUS_RIGHT);
-    else CHECK(MOTIONPLUS_SLOW);
-#undef CHECK
-    else
+
+  pthread_mutex_unlock(&subscriber_lock);
+}
+
+static void input_socket_feedback(int player, struct input_feedback const *feedback)
+{
+  struct input_socket_feedback *message;
+  int i;
+
+  if (player >= INPUT_MAX_PLAYERS)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&subscriber_lock);
+
+  message = &last_feedback[player];
+  message->magic = INPUT_SOCKET_FEEDBACK_MAGIC;
+  message->version = INPUT_SOCKET_VERSION;
+  message->player = player;
+  message->rumble = feedback->rumble;
+  message->leds = feedback->leds;
+  message->reporting_mode = feedback->reporting_mode;
+
+  //from the end, a client that's gone is swapped with the last one
+  for (i = subscriber_count - 1; i >= 0; i--)
+  {
+    send_feedback(i, message);
+  }
+
+  pthread_mutex_unlock(&subscriber_lock);
+}
+
+static bool poll_text_event(struct input_event *event)
+{
+  char event_type_s[32], event_param_s[32] = "";
+  float event_value = 0.0f;
+  int event_status, event_player;
+  int fields, type, value;
+
+  buf[buf_len] = '\0';
+  buf_len = 0;
+  event->timestamp_us = batch_time_us;
+
+  //the status is an axis position for analog_axis, otherwise 0 or 1
+  fields = sscanf(buf, "%31s %f %31s %d", event_type_s, &event_value, event_param_s, &event_player);
+  event_status = event_value != 0.0f;
+  if (fields == EOF)
+  {
+    printf(PROGRAM_NAME ": received input in invalid format\n");
+    return false;
+  }
+
+  if (strcmp(event_type_s, "feedback") == 0)
+  {
+    subscribe(event_status);
+    return false;
+  }
+
+  //optional trailing player number (1-4), defaults to player 1
+  if (fields == 4)
+  {
+    if (event_player < 1 || event_player > INPUT_MAX_PLAYERS)
     {
-      printf(PROGRAM_NAME ": received invalid 'analog_motion' parameter: %s\n", event_param_s);
-      buf_len = 0;
+      printf(PROGRAM_NAME ": received invalid player: %d\n", event_player);
       return false;
     }
+    event->player = event_player - 1;
   }
   else
+  {
+    event->player = 0;
+  }
+
+  type = LOOKUP(event_type_names, event_type_s);
+  if (type < 0)
   {
     printf(PROGRAM_NAME ": received invalid event type: %s\n", event_type_s);
-    buf_len = 0;
     return false;
   }
 
-  buf_len = 0;
-  return true;
+  value = input_socket_lookup_name(type, event_param_s);
+  event->type = type;
+
+  switch (type)
+  {
+    case INPUT_EVENT_TYPE_EMULATOR_CONTROL:
+      if (value < 0)
+      {
+        break;
+      }
+      event->emulator_control_event.control = value;
+      return true;
+
+    case INPUT_EVENT_TYPE_HOTPLUG:
+      //unknown extensions unplug
+      event->hotplug_event.extension = (event_status != 0 && value >= 0) ? value : NoExtension;
+      return true;
+
+    case INPUT_EVENT_TYPE_BUTTON:
+      if (value < 0)
+      {
+        break;
+      }
+      event->button_event.pressed = event_status;
+      event->button_event.button = value;
+      return true;
+
+    case INPUT_EVENT_TYPE_ANALOG_MOTION:
+      if (value < 0)
+      {
+        break;
+      }
+      event->analog_motion_event.moving = event_status;
+      event->analog_motion_event.motion = value;
+      return true;
+
+    case INPUT_EVENT_TYPE_ANALOG_AXIS:
+      if (value < 0)
+      {
+        break;
+      }
+      event->analog_axis_event.value = event_value;
+      event->analog_axis_event.axis = value;
+      return true;
+  }
+
+  printf(PROGRAM_NAME ": received invalid '%s' parameter: %s\n", event_type_s, event_param_s);
+  return false;
+}
+
+static void input_socket_wait_event(int timeout_ms)
+{
+  struct pollfd pfd = { sock, POLLIN, 0 };
+
+  if (batch_index < batch_count || buf_len)
+  {
+    return;
+  }
+  poll(&pfd, 1, timeout_ms);
 }
 
 struct input_source input_source_socket = {
   .unload = input_socket_unload,
-  .poll_event = input_socket_poll_event
+  .poll_event = input_socket_poll_event,
+  .wait_event = input_socket_wait_event,
+  .feedback = input_socket_feedback
 };
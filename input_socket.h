@@ -2,14 +2,80 @@
 #define INPUT_SOCKET_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include "input.h"
 
+/*
+ * Besides the text commands, a datagram may carry binary records: a header
+ * followed by count fixed-size records, all little-endian (floats as IEEE 754
+ * singles). input_socket_make_record and input_socket_parse_record convert
+ * to and from the host's byte order. The first byte can't start a text
+ * command, so both kinds share the socket.
+ */
+
+#define INPUT_SOCKET_MAGIC 0xfe
+#define INPUT_SOCKET_VERSION 1
+#define INPUT_SOCKET_DATAGRAM_SIZE 512
+
+struct input_socket_header
+{
+  uint8_t magic; //INPUT_SOCKET_MAGIC
+  uint8_t version; //INPUT_SOCKET_VERSION
+  uint16_t count; //records that follow
+} __attribute__((packed));
+
+struct input_socket_record
+{
+  uint8_t type; //enum input_event_type
+  uint8_t player; //0-based slot
+  uint8_t status; //pressed, moving, or 0 to unplug
+  uint8_t id; //enum input_button, input_analog_motion, input_analog_axis,
+              //input_emulator_control or wiimote_connected_extension_type, by type
+  float delta_x; //axis value for analog axis records
+  float delta_y;
+  float delta_z;
+  uint64_t timestamp_us; //sender's CLOCK_MONOTONIC, 0 for the time received
+} __attribute__((packed));
+
+#define INPUT_SOCKET_MAX_RECORDS \
+  ((INPUT_SOCKET_DATAGRAM_SIZE - sizeof(struct input_socket_header)) / sizeof(struct input_socket_record))
+
+/*
+ * A client that sends "feedback 1" gets a feedback datagram for each player
+ * the host has set up so far, then another whenever the host changes a
+ * player's rumble, LEDs or reporting mode, until it sends "feedback 0". Over unix sockets the client
+ * has to bind its socket to a path to be answered.
+ */
+
+#define INPUT_SOCKET_FEEDBACK_MAGIC 0xfd
+#define INPUT_SOCKET_MAX_SUBSCRIBERS 8
+
+struct input_socket_feedback
+{
+  uint8_t magic; //INPUT_SOCKET_FEEDBACK_MAGIC
+  uint8_t version; //INPUT_SOCKET_VERSION
+  uint8_t player; //0-based slot
+  uint8_t rumble; //0 or 1
+  uint8_t leds; //bit 0 is LED 1
+  uint8_t reporting_mode; //0x3e for both halves of the interleaved mode
+} __attribute__((packed));
+
 void input_socket_init_unix_at_path(char const *path);
 void input_socket_init_ip_on_port(char const *port);
 void input_socket_init(struct sockaddr *socket_address, socklen_t socket_address_size);
 
+// Event of a binary record, false if the record isn't valid. The stamp is
+// taken as it is.
+bool input_socket_parse_record(struct input_socket_record const *record, struct input_event *event);
+// Binary record of an event
+void input_socket_make_record(struct input_event const *event, struct input_socket_record *record);
+
+// Value of a text protocol name (button, motion, control word or extension)
+// for the event type, -1 if there is none
+int input_socket_lookup_name(enum input_event_type type, char const *name);
+
 extern struct input_source input_source_socket;
 
 #endif
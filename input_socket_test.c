@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <sys/un.h>
+
+#include "wiimote.h"
+#include "input_socket.h"
+#include "test.h"
+
+// Sends text and binary datagrams to the socket input source over a unix
+// socket, one at a time and several before a poll, and checks the events it
+// hands out and the feedback it sends back.
+
+#define SOCKET_PATH "/tmp/input_socket_test.sock"
+#define CLIENT_PATH "/tmp/input_socket_test_client.sock"
+
+static int client;
+static struct sockaddr_un server_address = { .sun_family = AF_UNIX, .sun_path = SOCKET_PATH };
+static struct input_axis_map axis_map;
+
+static void send_datagram(const void * data, size_t len)
+{
+  if (sendto(client, data, len, 0, (struct sockaddr *)&server_address, sizeof(server_address)) != len)
+  {
+    perror("sendto");
+    exit(1);
+  }
+}
+
+static void send_text(const char * text)
+{
+  send_datagram(text, strlen(text));
+}
+
+static void send_records(const struct input_socket_record * records, int count, uint8_t version)
+{
+  uint8_t buf[INPUT_SOCKET_DATAGRAM_SIZE];
+  struct input_socket_header header = { INPUT_SOCKET_MAGIC, version, htole16(count) };
+
+  memcpy(buf, &header, sizeof(header));
+  memcpy(buf + sizeof(header), records, count * sizeof(struct input_socket_record));
+  send_datagram(buf, sizeof(header) + count * sizeof(struct input_socket_record));
+}
+
+static bool poll_event(struct input_event * event)
+{
+  memset(event, 0, sizeof(struct input_event));
+  event->player = -1;
+  return input_source_socket.poll_event(event);
+}
+
+static void test_text()
+{
+  struct input_event event;
+
+  send_text("button 1 WIIMOTE_A 2");
+  CHECK(poll_event(&event));
+  CHECK(event.timestamp_us != 0);
+  CHECK(event.type == INPUT_EVENT_TYPE_BUTTON);
+  CHECK(event.button_event.button == INPUT_BUTTON_WIIMOTE_A);
+  CHECK(event.button_event.pressed);
+  CHECK(event.player == 1);
+
+  send_text("hotplug 1 classic");
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_HOTPLUG);
+  CHECK(event.hotplug_event.extension == Classic);
+  CHECK(event.player == 0);
+
+  send_text("button 1 NOT_A_BUTTON");
+  CHECK(!poll_event(&event));
+  CHECK(!poll_event(&event));
+}
+
+//in enum order
+static const char * const button_names[] =
+{
+  "HOME", "WIIMOTE_UP", "WIIMOTE_DOWN", "WIIMOTE_LEFT", "WIIMOTE_RIGHT", "WIIMOTE_A",
+  "WIIMOTE_B", "WIIMOTE_1", "WIIMOTE_2", "WIIMOTE_PLUS", "WIIMOTE_MINUS", "NUNCHUK_C",
+  "NUNCHUK_Z", "CLASSIC_UP", "CLASSIC_DOWN", "CLASSIC_LEFT", "CLASSIC_RIGHT", "CLASSIC_A",
+  "CLASSIC_B", "CLASSIC_X", "CLASSIC_Y", "CLASSIC_L", "CLASSIC_R", "CLASSIC_ZL", "CLASSIC_ZR",
+  "CLASSIC_PLUS", "CLASSIC_MINUS"
+};
+
+static const char * const analog_motion_names[] =
+{
+  "IR_UP", "IR_DOWN", "IR_LEFT", "IR_RIGHT", NULL, "STEER_LEFT", "STEER_RIGHT",
+  "NUNCHUK_UP", "NUNCHUK_DOWN", "NUNCHUK_LEFT", "NUNCHUK_RIGHT", "CLASSIC_LEFT_STICK_UP",
+  "CLASSIC_LEFT_STICK_DOWN", "CLASSIC_LEFT_STICK_LEFT", "CLASSIC_LEFT_STICK_RIGHT",
+  "MOTIONPLUS_UP", "MOTIONPLUS_DOWN", "MOTIONPLUS_LEFT", "MOTIONPLUS_RIGHT", "MOTIONPLUS_SLOW"
+};
+
+static const char * const analog_axis_names[] =
+{
+  "NUNCHUK_X", "NUNCHUK_Y", "CLASSIC_LS_X", "CLASSIC_LS_Y", "CLASSIC_RS_X", "CLASSIC_RS_Y",
+  "CLASSIC_LT", "CLASSIC_RT", "MOTIONPLUS_YAW", "MOTIONPLUS_ROLL", "MOTIONPLUS_PITCH"
+};
+
+//every name is found, so the tables are sorted
+static void test_names()
+{
+  struct input_event event;
+  int i;
+
+  for (i = 0; i < sizeof(button_names) / sizeof(button_names[0]); i++)
+  {
+    CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_BUTTON, button_names[i]) == i);
+  }
+  CHECK(i == INPUT_BUTTON_CLASSIC_MINUS + 1);
+
+  for (i = 0; i < sizeof(analog_motion_names) / sizeof(analog_motion_names[0]); i++)
+  {
+    if (analog_motion_names[i] != NULL)
+    {
+      CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_ANALOG_MOTION, analog_motion_names[i]) == i);
+    }
+  }
+  CHECK(i == INPUT_ANALOG_MOTION_MOTIONPLUS_SLOW + 1);
+
+  for (i = 0; i < sizeof(analog_axis_names) / sizeof(analog_axis_names[0]); i++)
+  {
+    CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_ANALOG_AXIS, analog_axis_names[i]) == i);
+  }
+  CHECK(i == INPUT_ANALOG_AXIS_COUNT);
+
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_EMULATOR_CONTROL, "quit") == INPUT_EMULATOR_CONTROL_QUIT);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_EMULATOR_CONTROL, "power_off") == INPUT_EMULATOR_CONTROL_POWER_OFF);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_EMULATOR_CONTROL, "toggle_reports") == INPUT_EMULATOR_CONTROL_TOGGLE_REPORTS);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_HOTPLUG, "nunchuk") == Nunchuk);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_HOTPLUG, "classic") == Classic);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_HOTPLUG, "balance_board") == BalanceBoard);
+
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_BUTTON, "IR_UP") == -1);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_BUTTON, "home") == -1);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_BUTTON, "") == -1);
+  CHECK(input_socket_lookup_name(INPUT_EVENT_TYPE_ANALOG_MOTION, "CLASSIC_A") == -1);
+
+  send_text("emulator_control 1 quit 4");
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_EMULATOR_CONTROL);
+  CHECK(event.emulator_control_event.control == INPUT_EMULATOR_CONTROL_QUIT);
+  CHECK(event.player == 3);
+
+  send_text("analog_motion 0 MOTIONPLUS_SLOW");
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_MOTION);
+  CHECK(event.analog_motion_event.motion == INPUT_ANALOG_MOTION_MOTIONPLUS_SLOW);
+  CHECK(!event.analog_motion_event.moving);
+
+  send_text("analog_axis -0.375 CLASSIC_RS_Y 2");
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_AXIS);
+  CHECK(event.analog_axis_event.axis == INPUT_ANALOG_AXIS_CLASSIC_RS_Y);
+  CHECK(event.analog_axis_event.value == -0.375f);
+  CHECK(event.player == 1);
+  send_text("analog_axis 1 IR_UP");
+  CHECK(!poll_event(&event));
+
+  //unknown extensions unplug, unknown control words are dropped
+  send_text("hotplug 1 wheel");
+  CHECK(poll_event(&event));
+  CHECK(event.hotplug_event.extension == NoExtension);
+  send_text("emulator_control 1 reboot");
+  CHECK(!poll_event(&event));
+  send_text("hotplug");
+  CHECK(poll_event(&event));
+  CHECK(event.hotplug_event.extension == NoExtension);
+  send_text("jump 1 HOME");
+  CHECK(!poll_event(&event));
+}
+
+static void test_binary()
+{
+  struct input_socket_record records[INPUT_SOCKET_MAX_RECORDS];
+  struct input_event event;
+  uint64_t sent_us = wm_clock_monotonic(NULL);
+  int i;
+
+  memset(records, 0, sizeof(records));
+  records[0] = (struct input_socket_record){ INPUT_EVENT_TYPE_BUTTON, 0, 1, INPUT_BUTTON_NUNCHUK_Z };
+  records[1] = (struct input_socket_record){ INPUT_EVENT_TYPE_ANALOG_MOTION, 3, 1,
+    INPUT_ANALOG_MOTION_POINTER, 0.25f, -0.5f, 0.0f, 123456 };
+  records[2] = (struct input_socket_record){ INPUT_EVENT_TYPE_HOTPLUG, 2, 1, Nunchuk };
+  records[3] = (struct input_socket_record){ INPUT_EVENT_TYPE_HOTPLUG, 2, 0, Nunchuk };
+  records[4] = (struct input_socket_record){ INPUT_EVENT_TYPE_EMULATOR_CONTROL, 0, 0,
+    INPUT_EMULATOR_CONTROL_POWER_OFF };
+  records[5] = (struct input_socket_record){ INPUT_EVENT_TYPE_ANALOG_AXIS, 1, 0,
+    INPUT_ANALOG_AXIS_CLASSIC_LT, 0.75f, 0.0f, 0.0f, sent_us - 500 };
+  send_records(records, 6, INPUT_SOCKET_VERSION);
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_BUTTON);
+  CHECK(event.button_event.button == INPUT_BUTTON_NUNCHUK_Z);
+  CHECK(event.button_event.pressed);
+  CHECK(event.player == 0);
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_MOTION);
+  CHECK(event.analog_motion_event.motion == INPUT_ANALOG_MOTION_POINTER);
+  CHECK(event.analog_motion_event.moving);
+  CHECK(event.analog_motion_event.delta_x == 0.25f);
+  CHECK(event.analog_motion_event.delta_y == -0.5f);
+  CHECK(event.player == 3);
+  //a stamp that can't be from this clock is replaced by the time received
+  CHECK(event.timestamp_us >= sent_us && event.timestamp_us < sent_us + 1000000);
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_HOTPLUG);
+  CHECK(event.hotplug_event.extension == Nunchuk);
+  CHECK(event.player == 2);
+
+  CHECK(poll_event(&event));
+  CHECK(event.hotplug_event.extension == NoExtension);
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_EMULATOR_CONTROL);
+  CHECK(event.emulator_control_event.control == INPUT_EMULATOR_CONTROL_POWER_OFF);
+
+  CHECK(poll_event(&event));
+  CHECK(event.type == INPUT_EVENT_TYPE_ANALOG_AXIS);
+  CHECK(event.analog_axis_event.axis == INPUT_ANALOG_AXIS_CLASSIC_LT);
+  CHECK(event.analog_axis_event.value == 0.75f);
+  CHECK(event.player == 1);
+  CHECK(event.timestamp_us == sent_us - 500);
+
+  CHECK(!poll_event(&event));
+
+  //invalid records are skipped, the rest of the datagram still counts
+  records[0].type = 9;
+  records[1].player = INPUT_MAX_PLAYERS;
+  records[2] = (struct input_socket_record){ INPUT_EVENT_TYPE_BUTTON, 0, 1,
+    INPUT_BUTTON_CLASSIC_MINUS + 1 };
+  records[3] = (struct input_socket_record){ INPUT_EVENT_TYPE_BUTTON, 1, 0, INPUT_BUTTON_HOME };
+  records[4] = (struct input_socket_record){ INPUT_EVENT_TYPE_ANALOG_AXIS, 0, 0,
+    INPUT_ANALOG_AXIS_COUNT };
+  send_records(records, 5, INPUT_SOCKET_VERSION);
+  CHECK(poll_event(&event));
+  CHECK(event.button_event.button == INPUT_BUTTON_HOME);
+  CHECK(!event.button_event.pressed);
+  CHECK(event.player == 1);
+  CHECK(!poll_event(&event));
+
+  //another version or a short datagram is dropped whole
+  send_records(records + 3, 1, INPUT_SOCKET_VERSION + 1);
+  CHECK(!poll_event(&event));
+  send_datagram(records, 3);
+  CHECK(!poll_event(&event));
+
+  //a full datagram
+  for (i = 0; i < INPUT_SOCKET_MAX_RECORDS; i++)
+  {
+    records[i] = (struct input_socket_record){ INPUT_EVENT_TYPE_ANALOG_MOTION, 0, 1,
+      INPUT_ANALOG_MOTION_POINTER, i, 0.0f, 0.0f, i };
+  }
+  send_records(records, INPUT_SOCKET_MAX_RECORDS, INPUT_SOCKET_VERSION);
+  for (i = 0; i < INPUT_SOCKET_MAX_RECORDS && poll_event(&event); i++)
+  {
+    CHECK(event.analog_motion_event.delta_x == i);
+  }
+  CHECK(i == INPUT_SOCKET_MAX_RECORDS);
+  CHECK(!poll_event(&event));
+
+  //the text protocol still works after binary records
+  send_text("button 0 WIIMOTE_B");
+  CHECK(poll_event(&event));
+  CHECK(event.button_event.button == INPUT_BUTTON_WIIMOTE_B);
+  CHECK(event.player == 0);
+}
+
+//datagrams waiting together are handed out in order, a bad one in between
+//doesn't end the poll
+static void test_batch()
+{
+  const enum input_button expected[] = { INPUT_BUTTON_WIIMOTE_UP, INPUT_BUTTON_WIIMOTE_DOWN,
+    INPUT_BUTTON_WIIMOTE_1, INPUT_BUTTON_WIIMOTE_2 };
+  struct input_socket_record record = { INPUT_EVENT_TYPE_BUTTON, 0, 1, INPUT_BUTTON_WIIMOTE_1 };
+  struct input_event event;
+  int i;
+
+  send_text("button 1 WIIMOTE_UP");
+  send_text("button 1 WIIMOTE_DOWN 3");
+  send_text("button 1 NOT_A_BUTTON");
+  send_datagram("", 0);
+  send_records(&record, 1, INPUT_SOCKET_VERSION);
+  send_text("button 0 WIIMOTE_2");
+
+  for (i = 0; i < 4 && poll_event(&event); i++)
+  {
+    CHECK(event.type == INPUT_EVENT_TYPE_BUTTON);
+    CHECK(event.button_event.button == expected[i]);
+    CHECK(event.player == (i == 1 ? 2 : 0));
+  }
+  CHECK(i == 4);
+  CHECK(!poll_event(&event));
+}
+
+static bool recv_feedback(int fd, struct input_socket_feedback * feedback)
+{
+  return recv(fd, feedback, sizeof(struct input_socket_feedback), MSG_DONTWAIT) ==
+    sizeof(struct input_socket_feedback);
+}
+
+static void test_feedback()
+{
+  struct sockaddr_un client_address = { .sun_family = AF_UNIX, .sun_path = CLIENT_PATH };
+  struct wiimote_state state;
+  struct input_state input;
+  struct wiimote_state * states[1] = { &state };
+  struct input_state * inputs[1] = { &input };
+  struct input_socket_feedback feedback;
+  uint8_t leds_and_rumble[3] = { 0xa2, 0x11, 0x31 };
+  uint8_t rumble_off[3] = { 0xa2, 0x10, 0x00 };
+  uint8_t rumble_on[3] = { 0xa2, 0x10, 0x01 };
+  uint8_t interleaved[4] = { 0xa2, 0x12, 0x05, 0x3e };
+  int bound_client, saved_client = client;
+
+  wiimote_init(&state);
+  input_init(&input, &axis_map);
+
+  //an unbound client can't be answered
+  send_text("feedback 1");
+  CHECK(input_update_players_at(states, inputs, 1, &input_source_socket, 1000) == 0);
+
+  unlink(CLIENT_PATH);
+  bound_client = socket(AF_UNIX, SOCK_DGRAM, 0);
+  CHECK(bind(bound_client, (struct sockaddr *)&client_address, sizeof(client_address)) == 0);
+  client = bound_client;
+
+  //where the player is at, once
+  send_text("feedback 1");
+  input_update_players_at(states, inputs, 1, &input_source_socket, 2000);
+  CHECK(recv_feedback(bound_client, &feedback));
+  CHECK(feedback.magic == INPUT_SOCKET_FEEDBACK_MAGIC && feedback.version == INPUT_SOCKET_VERSION);
+  CHECK(feedback.player == 0 && !feedback.rumble && feedback.leds == 0);
+  CHECK(feedback.reporting_mode == 0x30);
+  input_update_players_at(states, inputs, 1, &input_source_socket, 3000);
+  CHECK(!recv_feedback(bound_client, &feedback));
+
+  //several changes between two updates are sent as one
+  process_report(&state, leds_and_rumble, sizeof(leds_and_rumble));
+  process_report(&state, rumble_off, sizeof(rumble_off));
+  process_report(&state, rumble_on, sizeof(rumble_on));
+  input_update_players_at(states, inputs, 1, &input_source_socket, 4000);
+  CHECK(recv_feedback(bound_client, &feedback));
+  CHECK(feedback.rumble && feedback.leds == 0x3);
+  CHECK(!recv_feedback(bound_client, &feedback));
+
+  //the interleaved mode doesn't flip between its halves
+  process_report(&state, interleaved, sizeof(interleaved));
+  input_update_players_at(states, inputs, 1, &input_source_socket, 5000);
+  CHECK(recv_feedback(bound_client, &feedback));
+  CHECK(feedback.reporting_mode == 0x3e);
+  state.sys.reporting_mode = 0x3f;
+  input_update_players_at(states, inputs, 1, &input_source_socket, 6000);
+  CHECK(!recv_feedback(bound_client, &feedback));
+
+  //subscribing again sends the state again, without sending twice after
+  send_text("feedback 1");
+  input_update_players_at(states, inputs, 1, &input_source_socket, 7000);
+  CHECK(recv_feedback(bound_client, &feedback));
+  CHECK(feedback.rumble && feedback.leds == 0x3);
+  process_report(&state, rumble_off, sizeof(rumble_off));
+  input_update_players_at(states, inputs, 1, &input_source_socket, 8000);
+  CHECK(recv_feedback(bound_client, &feedback));
+  CHECK(!feedback.rumble);
+  CHECK(!recv_feedback(bound_client, &feedback));
+
+  send_text("feedback 0");
+  process_report(&state, rumble_on, sizeof(rumble_on));
+  input_update_players_at(states, inputs, 1, &input_source_socket, 9000);
+  CHECK(!recv_feedback(bound_client, &feedback));
+
+  client = saved_client;
+  close(bound_client);
+  unlink(CLIENT_PATH);
+  wiimote_destroy(&state);
+}
+
+int main(int argc, char *argv[])
+{
+  input_axis_map_init(&axis_map);
+  input_socket_init_unix_at_path(SOCKET_PATH);
+
+  client = socket(AF_UNIX, SOCK_DGRAM, 0);
+  if (client == -1)
+  {
+    perror("socket");
+    return 1;
+  }
+
+  test_text();
+  test_names();
+  test_binary();
+  test_batch();
+  test_feedback();
+
+  close(client);
+  input_source_socket.unload();
+  unlink(SOCKET_PATH);
+
+  return test_result("socket input protocols passed");
+}
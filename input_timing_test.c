@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "wiimote.h"
+#include "input.h"
+#include "test.h"
+
+// Timestamped input: samples are interpolated at the report time, and a
+// pointer moving at constant speed, sent at 125 Hz with jittery arrival and
+// reported at 200 Hz, moves more evenly per report than when every delta
+// arriving before a report is summed.
+
+#define NEAR(a, b) (fabs((a) - (b)) < 1e-4)
+
+static struct wiimote_state state;
+static struct input_state input;
+static struct input_axis_map axis_map;
+
+static void send_pointer(float dx, float dy, uint64_t time_us)
+{
+  struct input_event event;
+
+  memset(&event, 0, sizeof(event));
+  event.type = INPUT_EVENT_TYPE_ANALOG_MOTION;
+  event.timestamp_us = time_us;
+  event.analog_motion_event.motion = INPUT_ANALOG_MOTION_POINTER;
+  event.analog_motion_event.delta_x = dx;
+  event.analog_motion_event.delta_y = dy;
+  input_process_event(&state, &input, &event);
+}
+
+static void send_axis(enum input_analog_axis axis, float value, uint64_t time_us)
+{
+  struct input_event event;
+
+  memset(&event, 0, sizeof(event));
+  event.type = INPUT_EVENT_TYPE_ANALOG_AXIS;
+  event.timestamp_us = time_us;
+  event.analog_axis_event.axis = axis;
+  event.analog_axis_event.value = value;
+  input_process_event(&state, &input, &event);
+}
+
+static void reset(uint64_t sample_delay_us)
+{
+  input_init(&input, &axis_map);
+  input.sample_delay_us = sample_delay_us;
+}
+
+static void test_interpolation()
+{
+  reset(0);
+
+  //the first tick sets where the samples start from
+  input_tick_at(&state, &input, 1000);
+  send_pointer(0.1f, -0.2f, 2000);
+  send_axis(INPUT_ANALOG_AXIS_CLASSIC_LT, 1.0f, 3000);
+  CHECK(input.sample_count == 3);
+
+  //half way to the pointer sample, a quarter of the way to the trigger
+  input_tick_at(&state, &input, 1500);
+  CHECK(NEAR(input.pointer_x, 0.55));
+  CHECK(NEAR(input.pointer_y, 0.4));
+  CHECK(state.usr.classic.lt == 0);
+
+  input_tick_at(&state, &input, 2000);
+  CHECK(NEAR(input.pointer_x, 0.6));
+  CHECK(NEAR(input.pointer_y, 0.3));
+  CHECK(input.sample_count == 2);
+
+  input_tick_at(&state, &input, 2500);
+  CHECK(state.usr.classic.lt == input_axis_wire_value(&axis_map, INPUT_ANALOG_AXIS_CLASSIC_LT, 0.5f));
+  CHECK(NEAR(input.pointer_x, 0.6));
+
+  //past the last sample everything is in
+  input_tick_at(&state, &input, 9000);
+  CHECK(state.usr.classic.lt == 31);
+  CHECK(input.sample_count == 1);
+
+  //time doesn't run back, late stamps apply on the next tick
+  input_tick_at(&state, &input, 5000);
+  send_pointer(0.1f, 0.0f, 4000);
+  input_tick_at(&state, &input, 9000);
+  CHECK(NEAR(input.pointer_x, 0.7));
+
+  //unstamped events don't wait
+  send_axis(INPUT_ANALOG_AXIS_CLASSIC_RT, 1.0f, 20000);
+  send_axis(INPUT_ANALOG_AXIS_CLASSIC_LT, 0.0f, 0);
+  input_tick_at(&state, &input, 9000);
+  CHECK(state.usr.classic.lt == 0);
+  CHECK(state.usr.classic.rt == 0);
+  input_tick(&state, &input);
+  CHECK(state.usr.classic.lt == 0);
+  CHECK(state.usr.classic.rt == 31);
+}
+
+static void test_delay()
+{
+  reset(10000);
+
+  input_tick_at(&state, &input, 100000);
+  send_pointer(0.1f, 0.0f, 95000);
+  send_pointer(0.1f, 0.0f, 100000);
+
+  //ten milliseconds back is half way between the first tick and the first
+  //sample
+  input_tick_at(&state, &input, 102500);
+  CHECK(NEAR(input.pointer_x, 0.55));
+  input_tick_at(&state, &input, 107500);
+  CHECK(NEAR(input.pointer_x, 0.65));
+  input_tick_at(&state, &input, 110000);
+  CHECK(NEAR(input.pointer_x, 0.7));
+}
+
+//a full ring folds new events into its newest sample
+static void test_full()
+{
+  int i;
+
+  reset(0);
+  input_tick_at(&state, &input, 1);
+  for (i = 0; i < 2 * INPUT_SAMPLES; i++)
+  {
+    send_pointer(0.001f, 0.0f, 10 + i);
+  }
+  CHECK(input.sample_count == INPUT_SAMPLES);
+  input_tick_at(&state, &input, 1000);
+  CHECK(NEAR(input.pointer_x, 0.5 + 2 * INPUT_SAMPLES * 0.001));
+}
+
+// Standard deviation of the pointer movement per report, against the
+// movement at constant speed
+static double pointer_jitter(bool stamped, uint64_t sample_delay_us)
+{
+  const uint64_t send_period_us = 8000, report_period_us = 5000;
+  const double speed = 0.04; //per second
+  const int reports = 400;
+  uint64_t sent_us = 1000000, report_us = sent_us, arrival_us;
+  double last_x, step, sum = 0.0, sum_squares = 0.0;
+  uint32_t seed = 1;
+  int i, n = 0;
+
+  reset(sample_delay_us);
+  input_tick_at(&state, &input, report_us);
+  last_x = input.pointer_x;
+
+  //each movement arrives 0-4 ms after it is sent
+  arrival_us = sent_us + send_period_us;
+  for (i = 0; i < reports; i++)
+  {
+    report_us += report_period_us;
+
+    while (arrival_us <= report_us)
+    {
+      sent_us += send_period_us;
+      send_pointer(speed * send_period_us / 1e6, 0.0f, stamped ? sent_us : 0);
+
+      seed = seed * 1103515245 + 12345;
+      arrival_us = sent_us + send_period_us + (seed >> 16) % 4000;
+    }
+
+    input_tick_at(&state, &input, report_us);
+
+    //after the pipeline has filled
+    if (i >= 10)
+    {
+      step = input.pointer_x - last_x - speed * report_period_us / 1e6;
+      sum += step;
+      sum_squares += step * step;
+      n++;
+    }
+    last_x = input.pointer_x;
+  }
+
+  return sqrt(fmax(0.0, sum_squares / n - (sum / n) * (sum / n)));
+}
+
+static void test_jitter()
+{
+  double summed = pointer_jitter(false, 0);
+  double latest = pointer_jitter(true, 0);
+  double interpolated = pointer_jitter(true, 12000);
+
+  printf("pointer jitter per report: %.3g summed, %.3g latest sample, %.3g interpolated\n",
+    summed, latest, interpolated);
+  CHECK(interpolated < summed / 4);
+}
+
+int main(int argc, char *argv[])
+{
+  wiimote_init(&state);
+  input_axis_map_init(&axis_map);
+
+  test_interpolation();
+  test_delay();
+  test_full();
+  test_jitter();
+
+  wiimote_destroy(&state);
+
+  return test_result("timestamped input passed");
+}
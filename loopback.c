@@ -0,0 +1,36 @@
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "loopback.h"
+
+int loopback_open(struct loopback * link)
+{
+  int fds[2];
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, fds) < 0)
+  {
+    link->device_fd = -1;
+    link->host_fd = -1;
+    return -1;
+  }
+
+  link->device_fd = fds[0];
+  link->host_fd = fds[1];
+
+  return 0;
+}
+
+void loopback_close(struct loopback * link)
+{
+  if (link->device_fd >= 0)
+  {
+    close(link->device_fd);
+  }
+  if (link->host_fd >= 0)
+  {
+    close(link->host_fd);
+  }
+
+  link->device_fd = -1;
+  link->host_fd = -1;
+}
@@ -0,0 +1,18 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+/*
+ * In-process stand-in for an L2CAP channel between an emulated controller
+ * and a host. Uses a connected pair of SOCK_SEQPACKET sockets so every
+ * report keeps its boundaries, like it would over Bluetooth.
+ */
+struct loopback
+{
+  int device_fd;
+  int host_fd;
+};
+
+int loopback_open(struct loopback * link);
+void loopback_close(struct loopback * link);
+
+#endif /* LOOPBACK_H */
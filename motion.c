@@ -18,7 +18,7 @@ static const double cam_near = 0.5;
 static const uint16_t accelerometer_zero = 0x85 << 2;
 static const uint16_t accelerometer_unit = 0x6C;
 
-void look_at_pointer(mat4 * wiimote_mat, float pointer_x, float pointer_y)
+static void look_at_pointer(mat4 * wiimote_mat, float pointer_x, float pointer_y)
 {
   vec3 pointer_world = {
     (pointer_x - 0.5) * screen_width,
@@ -46,7 +46,7 @@ void look_at_pointer(mat4 * wiimote_mat, float pointer_x, float pointer_y)
   wiimote_mat->v3 = (vec4){ 0.0, 0.0, 0.0, 1.0 };
 }
 
-void make_cam_projection_mat(mat4 * proj_mat)
+static void make_cam_projection_mat(mat4 * proj_mat)
 {
   double near = cam_near;
   double far = cam_far;
@@ -65,7 +65,7 @@ void make_cam_projection_mat(mat4 * proj_mat)
   proj_mat->v3 = (vec4){ 0.0, 0.0, -2.0 * far * near / (far - near), 0.0 };
 }
 
-void set_accelerometer(struct wiimote_state * state, const mat4 * wiimote_mat)
+static void set_accelerometer(struct wiimote_state * state, const mat4 * wiimote_mat)
 {
   vec3 accel = { 0, -1.0, 0 };
   mat3 accel_m;
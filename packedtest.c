@@ -2,71 +2,247 @@
 #include <stdlib.h>
 #include <string.h>
 
-struct report_buttons
+#include "wm_layout.h"
+#include "test.h"
+
+// Checks the report layout tables: that they are well formed, that packing
+// gives the bytes the Wii expects and that unpacking gives the values back.
+
+#define MAX_LAYOUT_BYTES 32
+
+//value bits that a layout stores somewhere
+static void covered_bits(const struct wm_layout * layout, uint32_t * covered)
+{
+  int i;
+
+  memset(covered, 0, layout->value_count * sizeof(uint32_t));
+
+  for (i = 0; i < layout->field_count; i++)
+  {
+    const struct wm_field * field = &layout->fields[i];
+
+    covered[field->value] |= ((1u << field->width) - 1) << field->value_shift;
+  }
+}
+
+static void test_tables()
+{
+  int l, i;
+
+  for (l = 0; l < wm_layout_count; l++)
+  {
+    const struct wm_layout * layout = wm_layouts[l];
+    uint8_t used[MAX_LAYOUT_BYTES];
+    uint32_t covered[WM_LAYOUT_MAX_VALUES];
+
+    memset(used, 0, sizeof(used));
+    CHECK(layout->value_count <= WM_LAYOUT_MAX_VALUES);
+
+    for (i = 0; i < layout->field_count; i++)
+    {
+      const struct wm_field * field = &layout->fields[i];
+      uint8_t bits = ((1u << field->width) - 1) << field->shift;
+
+      if (field->width < 1 || field->shift + field->width > 8 ||
+        field->byte >= MAX_LAYOUT_BYTES || field->value >= layout->value_count ||
+        field->value_shift + field->width > 32)
+      {
+        printf("%s field %d is malformed\n", layout->name, i);
+        failures++;
+        continue;
+      }
+
+      if (used[field->byte] & bits)
+      {
+        printf("%s field %d overlaps another field\n", layout->name, i);
+        failures++;
+      }
+      used[field->byte] |= bits;
+    }
+
+    //two fields of one value must not store the same value bits either
+    memset(covered, 0, sizeof(covered));
+    for (i = 0; i < layout->field_count; i++)
+    {
+      const struct wm_field * field = &layout->fields[i];
+      uint32_t bits = ((1u << field->width) - 1) << field->value_shift;
+
+      if (field->value < layout->value_count)
+      {
+        if (covered[field->value] & bits)
+        {
+          printf("%s field %d repeats value bits\n", layout->name, i);
+          failures++;
+        }
+        covered[field->value] |= bits;
+      }
+    }
+
+    for (i = 0; i < layout->value_count; i++)
+    {
+      if (covered[i] == 0)
+      {
+        printf("%s value %s has no fields\n", layout->name, layout->value_names[i]);
+        failures++;
+      }
+    }
+  }
+}
+
+static void test_buttons()
 {
-  int left:1;
-  int right:1;
-  int down:1;
-  int up:1;
-  int plus:1;
-  int unused0:3;
-
-  int two:1;
-  int one:1;
-  int b:1;
-  int a:1;
-  int minus:1;
-  int unused1:2;
-  int home:1;
-} __attribute__((packed));
-
-int main (int argc, char *argv[])
+  uint8_t buf[2];
+  uint32_t buttons;
+
+  //right, up, two, b
+  memset(buf, 0, sizeof(buf));
+  buttons = 0x0002 | 0x0008 | 0x0100 | 0x0400;
+  wm_pack(&wm_layout_buttons, buf, &buttons);
+  CHECK(buf[0] == 0x0a && buf[1] == 0x05);
+
+  //plus, left, a, home
+  memset(buf, 0, sizeof(buf));
+  buttons = 0x0010 | 0x0001 | 0x0800 | 0x8000;
+  wm_pack(&wm_layout_buttons, buf, &buttons);
+  CHECK(buf[0] == 0x11 && buf[1] == 0x88);
+
+  //accelerometer bits in the same bytes are left alone
+  memset(buf, 0x60, sizeof(buf));
+  buttons = 0;
+  wm_pack(&wm_layout_buttons, buf, &buttons);
+  CHECK(buf[0] == 0x60 && buf[1] == 0x60);
+}
+
+static void test_known_bytes()
 {
-  struct report_buttons rpt;
-
-  memset((void *)&rpt, 0, sizeof(rpt));
-
-  rpt.right = 1;
-  rpt.up = 1;
-  rpt.two = 1;
-  rpt.b = 1;
-
-  unsigned char buf[2];
-
-  buf[0] = (rpt.left & 0x1) |
-  ((rpt.right & 0x1) << 1) |
-  ((rpt.down & 0x1) << 2) |
-  ((rpt.up & 0x1) << 3) |
-  ((rpt.plus & 0x1) << 4);
-  buf[1] = (rpt.two & 0x1) |
-  ((rpt.one & 0x1) << 1) |
-  ((rpt.b & 0x1) << 2) |
-  ((rpt.a & 0x1) << 3) |
-  ((rpt.minus & 0x1) << 4) |
-  ((rpt.home & 0x1) << 7);
-
-  unsigned char * bytes = (unsigned char *)&rpt;
-
-  printf("Expecting %02x %02x: %02x %02x\n", buf[0], buf[1], bytes[0], bytes[1]);
-
-  memset((void *)&rpt, 0, sizeof(rpt));
-
-  rpt.plus = 1;
-  rpt.left = 1;
-  rpt.a = 1;
-  rpt.home = 1;
-
-  buf[0] = (rpt.left & 0x1) |
-  ((rpt.right & 0x1) << 1) |
-  ((rpt.down & 0x1) << 2) |
-  ((rpt.up & 0x1) << 3) |
-  ((rpt.plus & 0x1) << 4);
-  buf[1] = (rpt.two & 0x1) |
-  ((rpt.one & 0x1) << 1) |
-  ((rpt.b & 0x1) << 2) |
-  ((rpt.a & 0x1) << 3) |
-  ((rpt.minus & 0x1) << 4) |
-  ((rpt.home & 0x1) << 7);
-
-  printf("Expecting %02x %02x: %02x %02x\n", buf[0], buf[1], bytes[0], bytes[1]);
+  uint32_t values[WM_LAYOUT_MAX_VALUES];
+  uint8_t buf[MAX_LAYOUT_BYTES];
+
+  memset(buf, 0, sizeof(buf));
+  values[WM_ACCELEROMETER_X] = 0x201;
+  values[WM_ACCELEROMETER_Y] = 0x102;
+  values[WM_ACCELEROMETER_Z] = 0x3fe;
+  wm_pack(&wm_layout_accelerometer, buf, values);
+  CHECK(buf[0] == 0x20 && buf[1] == 0x60 && buf[2] == 0x80 && buf[3] == 0x40 && buf[4] == 0xff);
+
+  //c pressed, z released, both active low
+  memset(buf, 0, sizeof(buf));
+  memset(values, 0, sizeof(values));
+  values[WM_NUNCHUK_C] = 1;
+  values[WM_NUNCHUK_Z] = 0;
+  values[WM_NUNCHUK_ACCEL_Z] = 0x3;
+  wm_pack(&wm_layout_nunchuk, buf, values);
+  CHECK(buf[5] == 0xc1);
+
+  memset(buf, 0, sizeof(buf));
+  memset(values, 0, sizeof(values));
+  values[WM_MOTIONPLUS_YAW] = 0x1f34;
+  values[WM_MOTIONPLUS_YAW_SLOW] = 1;
+  values[WM_MOTIONPLUS_EXT] = 1;
+  values[WM_MOTIONPLUS_DATA] = 1;
+  wm_pack(&wm_layout_motionplus, buf, values);
+  CHECK(buf[0] == 0x34 && buf[3] == (0x1f << 2 | 0x02) && buf[4] == 0x01 && buf[5] == 0x02);
+
+  //read 6 bytes of register a400fa (extension id)
+  const uint8_t read[] = { 0x04, 0xa4, 0x00, 0xfa, 0x00, 0x06 };
+  wm_unpack(&wm_layout_mem_read, read, values);
+  CHECK(values[WM_MEM_READ_RUMBLE] == 0);
+  CHECK(values[WM_MEM_READ_SOURCE] == 1);
+  CHECK(values[WM_MEM_READ_OFFSET] == 0xa400fa);
+  CHECK(values[WM_MEM_READ_SIZE] == 6);
+
+  memset(buf, 0, sizeof(buf));
+  values[WM_MEM_RESP_ERROR] = 0x7;
+  values[WM_MEM_RESP_SIZE] = 0xf;
+  values[WM_MEM_RESP_ADDR] = 0x00fa;
+  wm_pack(&wm_layout_mem_resp, buf, values);
+  CHECK(buf[2] == 0xf7 && buf[3] == 0x00 && buf[4] == 0xfa);
+}
+
+static void test_round_trip()
+{
+  uint32_t values[WM_LAYOUT_MAX_VALUES], unpacked[WM_LAYOUT_MAX_VALUES];
+  uint32_t covered[WM_LAYOUT_MAX_VALUES];
+  uint8_t buf[MAX_LAYOUT_BYTES];
+  int l, i, round;
+
+  srand(1234);
+
+  for (l = 0; l < wm_layout_count; l++)
+  {
+    const struct wm_layout * layout = wm_layouts[l];
+
+    covered_bits(layout, covered);
+
+    for (round = 0; round < 1000; round++)
+    {
+      for (i = 0; i < layout->value_count; i++)
+      {
+        values[i] = ((uint32_t)rand() << 16) ^ rand();
+      }
+
+      memset(buf, 0, sizeof(buf));
+      wm_pack(layout, buf, values);
+      wm_unpack(layout, buf, unpacked);
+
+      for (i = 0; i < layout->value_count; i++)
+      {
+        if (unpacked[i] != (values[i] & covered[i]))
+        {
+          printf("%s value %s: packed %x, unpacked %x\n", layout->name,
+            layout->value_names[i], values[i] & covered[i], unpacked[i]);
+          failures++;
+          return;
+        }
+      }
+    }
+  }
+}
+
+//the generated straight-line functions must agree with the tables
+#define CHECK_GENERATED(report, name) \
+  do \
+  { \
+    memset(table_buf, 0x5a, sizeof(table_buf)); \
+    memset(generated_buf, 0x5a, sizeof(generated_buf)); \
+    wm_pack(&wm_layout_##name, table_buf, values); \
+    wm_pack_##name(generated_buf, values); \
+    CHECK(memcmp(table_buf, generated_buf, sizeof(table_buf)) == 0); \
+    wm_unpack(&wm_layout_##name, table_buf, table_values); \
+    wm_unpack_##name(table_buf, generated_values); \
+    CHECK(memcmp(table_values, generated_values, WM_##report##_VALUES * sizeof(uint32_t)) == 0); \
+  } while (0);
+
+static void test_generated()
+{
+  uint32_t values[WM_LAYOUT_MAX_VALUES];
+  uint32_t table_values[WM_LAYOUT_MAX_VALUES], generated_values[WM_LAYOUT_MAX_VALUES];
+  uint8_t table_buf[MAX_LAYOUT_BYTES], generated_buf[MAX_LAYOUT_BYTES];
+  int i, round;
+
+  srand(4321);
+
+  for (round = 0; round < 100; round++)
+  {
+    for (i = 0; i < WM_LAYOUT_MAX_VALUES; i++)
+    {
+      values[i] = ((uint32_t)rand() << 16) ^ rand();
+    }
+
+    WM_LAYOUTS(CHECK_GENERATED)
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  char passed[64];
+
+  test_tables();
+  test_buttons();
+  test_known_bytes();
+  test_round_trip();
+  test_generated();
+
+  snprintf(passed, sizeof(passed), "all %d report layouts passed", wm_layout_count);
+  return test_result(passed);
 }
@@ -13,7 +13,6 @@
  * moves on. This bare minimum implementation provides the expected responses.
  */
 
-static int state = -1;
 static uint32_t sdp_record_handle;
 static const uint32_t wiimote_hid_record_handle = 0x10000;
 
@@ -118,23 +117,28 @@ static const uint8_t attributes[463] =
     0x0C, 0x80, 0x09, 0x02, 0x0D, 0x28, 0x00, 0x09, 0x02, 0x0E, 0x28, 0x00
 };
 
-void sdp_recv_data(uint8_t * buf, int32_t len)
+void sdp_init(struct sdp_state * sdp)
+{
+    sdp->response = -1;
+}
+
+void sdp_recv_data(struct sdp_state * sdp, uint8_t * buf, int32_t len)
 {
     struct sdp_pdu * header = (struct sdp_pdu *)buf;
     
     //use the transaction id to determine the response to send
-    state = header->transaction_id >> 8;
+    sdp->response = header->transaction_id >> 8;
 }
 
-int32_t sdp_get_data(uint8_t * buf)
+int32_t sdp_get_data(struct sdp_state * sdp, uint8_t * buf)
 {
     int32_t len = 0;
 
-    if (state >= 0)
+    if (sdp->response >= 0)
     {
         const uint8_t * arr;
         
-        switch (state)
+        switch (sdp->response)
         {
             case 0:
                 arr = resp0;
@@ -160,7 +164,7 @@ int32_t sdp_get_data(uint8_t * buf)
 
         memcpy(buf, arr, len);
         
-        state = -1;
+        sdp->response = -1;
     }
 
     return len;
@@ -8,8 +8,14 @@ struct sdp_pdu
     uint8_t data[];
 } __attribute__((packed));
 
-void sdp_recv_data(uint8_t * buf, int32_t len);
-int32_t sdp_get_data(uint8_t * buf);
+struct sdp_state
+{
+    int response; //index of the pending response, -1 if none
+};
+
+void sdp_init(struct sdp_state * sdp);
+void sdp_recv_data(struct sdp_state * sdp, uint8_t * buf, int32_t len);
+int32_t sdp_get_data(struct sdp_state * sdp, uint8_t * buf);
 
 int register_wiimote_sdp_record();
 int unregister_wiimote_sdp_record();
@@ -0,0 +1,36 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+/*
+ * Checks shared by the test programs. A failed CHECK is printed and counted
+ * and the test carries on; main ends with test_result.
+ */
+static int failures = 0;
+
+#define CHECK(cond) \
+  do \
+  { \
+    if (!(cond)) \
+    { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+// Prints how many checks failed, or passed if none did, and returns the
+// exit status
+static inline int test_result(const char * passed)
+{
+  if (failures > 0)
+  {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+
+  printf("%s\n", passed);
+  return 0;
+}
+
+#endif /* TEST_H */
@@ -36,12 +36,12 @@ typedef struct
   vec4 v3;
 } mat4;
 
-double vec3_len(const vec3 * vec)
+static inline double vec3_len(const vec3 * vec)
 {
   return sqrt(vec->x * vec->x + vec->y * vec->y + vec->z * vec->z);
 }
 
-void vec3_normalize(vec3 * vec)
+static inline void vec3_normalize(vec3 * vec)
 {
   double len = vec3_len(vec);
   vec->x /= len;
@@ -49,14 +49,14 @@ void vec3_normalize(vec3 * vec)
   vec->z /= len;
 }
 
-void vec3_cross(vec3 * out, const vec3 * first, const vec3 * second)
+static inline void vec3_cross(vec3 * out, const vec3 * first, const vec3 * second)
 {
   out->x = first->y * second->z - first->z * second->y;
   out->y = first->z * second->x - first->x * second->z;
   out->z = first->x * second->y - first->y * second->x;
 }
 
-void mat4_make_translation(mat4 * mat, const vec3 * translate)
+static inline void mat4_make_translation(mat4 * mat, const vec3 * translate)
 {
   mat->v0 = (vec4){ 1.0, 0.0, 0.0, 0.0 };
   mat->v1 = (vec4){ 0.0, 1.0, 0.0, 0.0 };
@@ -64,7 +64,7 @@ void mat4_make_translation(mat4 * mat, const vec3 * translate)
   mat->v3 = (vec4){ translate->x, translate->y, translate->z, 1.0 };
 }
 
-void mat4_mult(mat4 * a, const mat4 * b)
+static inline void mat4_mult(mat4 * a, const mat4 * b)
 {
   double a11 = a->v0.x, a12 = a->v1.x, a13 = a->v2.x, a14 = a->v3.x;
   double a21 = a->v0.y, a22 = a->v1.y, a23 = a->v2.y, a24 = a->v3.y;
@@ -97,7 +97,7 @@ void mat4_mult(mat4 * a, const mat4 * b)
   a->v3.w = a41 * b14 + a42 * b24 + a43 * b34 + a44 * b44;
 }
 
-void mat4_invert(mat4 * m)
+static inline void mat4_invert(mat4 * m)
 {
   double n11 = m->v0.x, n21 = m->v0.y, n31 = m->v0.z, n41 = m->v0.w,
     n12 = m->v1.x, n22 = m->v1.y, n32 = m->v1.z, n42 = m->v1.w,
@@ -139,7 +139,7 @@ void mat4_invert(mat4 * m)
   m->v3.w = (n12 * n23 * n31 - n13 * n22 * n31 + n13 * n21 * n32 - n11 * n23 * n32 - n12 * n21 * n33 + n11 * n22 * n33) * detInv;
 }
 
-void vec4_apply_mat4(vec4 * vec, const mat4 * mat)
+static inline void vec4_apply_mat4(vec4 * vec, const mat4 * mat)
 {
   double x = vec->x, y = vec->y, z = vec->z, w = vec->w;
 
@@ -149,7 +149,7 @@ void vec4_apply_mat4(vec4 * vec, const mat4 * mat)
   vec->w = mat->v0.w * x + mat->v1.w * y + mat->v2.w * z + mat->v3.w * w;
 }
 
-void vec3_apply_mat3(vec3 * vec, const mat3 * mat)
+static inline void vec3_apply_mat3(vec3 * vec, const mat3 * mat)
 {
   double x = vec->x, y = vec->y, z = vec->z;
 
@@ -158,7 +158,7 @@ void vec3_apply_mat3(vec3 * vec, const mat3 * mat)
   vec->z = mat->v0.z * x + mat->v1.z * y + mat->v2.z * z;
 }
 
-void vec4_multiply_scalar(vec4 * vec, double scalar)
+static inline void vec4_multiply_scalar(vec4 * vec, double scalar)
 {
   vec->x *= scalar;
   vec->y *= scalar;
@@ -166,7 +166,7 @@ void vec4_multiply_scalar(vec4 * vec, double scalar)
   vec->w *= scalar;
 }
 
-void vec4_add_scalar(vec4 * vec, double scalar)
+static inline void vec4_add_scalar(vec4 * vec, double scalar)
 {
   vec->x += scalar;
   vec->y += scalar;
@@ -174,21 +174,21 @@ void vec4_add_scalar(vec4 * vec, double scalar)
   vec->w += scalar;
 }
 
-void vec3_multiply_scalar(vec3 * vec, double scalar)
+static inline void vec3_multiply_scalar(vec3 * vec, double scalar)
 {
   vec->x *= scalar;
   vec->y *= scalar;
   vec->z *= scalar;
 }
 
-void vec3_add_scalar(vec3 * vec, double scalar)
+static inline void vec3_add_scalar(vec3 * vec, double scalar)
 {
   vec->x += scalar;
   vec->y += scalar;
   vec->z += scalar;
 }
 
-void mat3_invert(mat3 * m)
+static inline void mat3_invert(mat3 * m)
 {
   double n11 = m->v0.x, n21 = m->v0.y, n31 = m->v0.z,
     n12 = m->v1.x, n22 = m->v1.y, n32 = m->v1.z,
@@ -220,7 +220,7 @@ void mat3_invert(mat3 * m)
   m->v2.z = (n22 * n11 - n21 * n12) * detInv;
 }
 
-void mat3_transpose(mat3 * m)
+static inline void mat3_transpose(mat3 * m)
 {
   double tmp;
   tmp = m->v0.y; m->v0.y = m->v1.x; m->v1.x = tmp;
@@ -228,31 +228,31 @@ void mat3_transpose(mat3 * m)
   tmp = m->v1.z; m->v1.z = m->v2.y; m->v2.y = tmp;
 }
 
-void mat3_from_mat4(mat3 * out, const mat4 * mat)
+static inline void mat3_from_mat4(mat3 * out, const mat4 * mat)
 {
   out->v0 = (vec3){ mat->v0.x, mat->v0.y, mat->v0.z };
   out->v1 = (vec3){ mat->v1.x, mat->v1.y, mat->v1.z };
   out->v2 = (vec3){ mat->v2.x, mat->v2.y, mat->v2.z };
 }
 
-void vec3_print(const vec3 * vec)
+static inline void vec3_print(const vec3 * vec)
 {
   printf("%f %f %f\n", vec->x, vec->y, vec->z);
 }
 
-void vec4_print(const vec4 * vec)
+static inline void vec4_print(const vec4 * vec)
 {
   printf("%f %f %f %f\n", vec->x, vec->y, vec->z, vec->w);
 }
 
-void mat3_print(const mat3 * mat)
+static inline void mat3_print(const mat3 * mat)
 {
   printf("%f %f %f\n", mat->v0.x, mat->v1.x, mat->v2.x);
   printf("%f %f %f\n", mat->v0.y, mat->v1.y, mat->v2.y);
   printf("%f %f %f\n", mat->v0.z, mat->v1.z, mat->v2.z);
 }
 
-void mat4_print(const mat4 * mat)
+static inline void mat4_print(const mat4 * mat)
 {
   printf("%f %f %f %f\n", mat->v0.x, mat->v1.x, mat->v2.x, mat->v3.x);
   printf("%f %f %f %f\n", mat->v0.y, mat->v1.y, mat->v2.y, mat->v3.y);
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+
+#include "adapter.h"
+
+// Scripted stand-in for a Wii, used by vhci_test.sh. Connects to the
+// emulator the way a Wii does after syncing, asks for continuous reports
+// and measures how long the connection took and how many reports arrive.
+
+#define PSM_SDP 1
+#define PSM_CTRL 0x11
+#define PSM_INT 0x13
+
+#define SDP_REQUESTS 5
+
+static uint64_t time_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t)1000000 + ts.tv_nsec / 1000;
+}
+
+int l2cap_connect(bdaddr_t device_bdaddr, bdaddr_t bdaddr, int psm)
+{
+  int fd;
+  struct sockaddr_l2 addr;
+
+  fd = socket(AF_BLUETOOTH, SOCK_SEQPACKET, BTPROTO_L2CAP);
+  if (fd < 0)
+  {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.l2_family = AF_BLUETOOTH;
+  addr.l2_bdaddr = device_bdaddr;
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.l2_family = AF_BLUETOOTH;
+  addr.l2_psm    = htobs(psm);
+  addr.l2_bdaddr = bdaddr;
+
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+//walks through each canned SDP response by transaction id, like the Wii does
+int query_sdp(bdaddr_t device_bdaddr, bdaddr_t bdaddr)
+{
+  int fd, i;
+  unsigned char req[] = { 0x06, 0x00, 0x00, 0x00, 0x00 };
+  unsigned char buf[256];
+  ssize_t len;
+  struct pollfd pfd;
+
+  fd = l2cap_connect(device_bdaddr, bdaddr, PSM_SDP);
+  if (fd < 0)
+  {
+    printf("can't connect to sdp psm: %s\n", strerror(errno));
+    return -1;
+  }
+
+  for (i = 0; i < SDP_REQUESTS; i++)
+  {
+    req[2] = i;
+    if (send(fd, req, sizeof(req), 0) < 0)
+    {
+      printf("sdp send failed: %s\n", strerror(errno));
+      close(fd);
+      return -1;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 1000) <= 0)
+    {
+      printf("no sdp response %d\n", i);
+      close(fd);
+      return -1;
+    }
+
+    len = recv(fd, buf, sizeof(buf), 0);
+    if (len < 5 || buf[0] != 0x07)
+    {
+      printf("bad sdp response %d (%d bytes)\n", i, (int)len);
+      close(fd);
+      return -1;
+    }
+  }
+
+  close(fd);
+
+  return 0;
+}
+
+void print_usage(char *argv0)
+{
+  printf("usage: %s [ -H <host-dev> ] [ -t <seconds> ] [ -m <min-reports/s> ] [ -s ] <emulator-bdaddr | emulator-dev>\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  struct adapter host_adapter, emu_adapter;
+  const char * host_dev_str = NULL;
+  bdaddr_t host_device_bdaddr, emu_bdaddr;
+  int seconds = 5, query = 0;
+  double min_rate = 0;
+
+  int ctrl_fd, int_fd;
+  unsigned char buf[32];
+  //data reporting mode: continuous, core buttons and accelerometer
+  const unsigned char set_mode[] = { 0xa2, 0x12, 0x04, 0x31 };
+  ssize_t len;
+  struct pollfd pfd;
+
+  uint64_t start_ts, connect_ts, end_ts, last_ts, gap, max_gap = 0;
+  int reports = 0, bad = 0, opt;
+  double rate;
+
+  while ((opt = getopt(argc, argv, "H:t:m:s")) != -1)
+  {
+    switch (opt)
+    {
+      case 'H':
+        host_dev_str = optarg;
+        break;
+      case 't':
+        seconds = atoi(optarg);
+        break;
+      case 'm':
+        min_rate = atof(optarg);
+        break;
+      case 's':
+        query = 1;
+        break;
+      default:
+        print_usage(*argv);
+        return 1;
+    }
+  }
+
+  if (optind >= argc || seconds <= 0)
+  {
+    print_usage(*argv);
+    return 1;
+  }
+
+  adapter_init(&host_adapter, NULL);
+  if (adapter_select(&host_adapter, host_dev_str) < 0 ||
+    get_device_bdaddr(&host_adapter, &host_device_bdaddr) < 0)
+  {
+    printf("failed to find host Bluetooth adapter\n");
+    return 1;
+  }
+
+  //the emulator may change its adapter's address, so it can be named by device
+  if (bachk(argv[optind]) >= 0)
+  {
+    str2ba(argv[optind], &emu_bdaddr);
+  }
+  else
+  {
+    adapter_init(&emu_adapter, NULL);
+    if (adapter_select(&emu_adapter, argv[optind]) < 0 ||
+      get_device_bdaddr(&emu_adapter, &emu_bdaddr) < 0)
+    {
+      printf("failed to find emulator Bluetooth adapter\n");
+      return 1;
+    }
+  }
+
+  start_ts = time_us();
+
+  if (query && query_sdp(host_device_bdaddr, emu_bdaddr) < 0)
+  {
+    return 1;
+  }
+
+  ctrl_fd = l2cap_connect(host_device_bdaddr, emu_bdaddr, PSM_CTRL);
+  if (ctrl_fd < 0)
+  {
+    printf("can't connect to ctrl psm: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int_fd = l2cap_connect(host_device_bdaddr, emu_bdaddr, PSM_INT);
+  if (int_fd < 0)
+  {
+    printf("can't connect to int psm: %s\n", strerror(errno));
+    close(ctrl_fd);
+    return 1;
+  }
+
+  connect_ts = time_us();
+
+  if (send(int_fd, set_mode, sizeof(set_mode), 0) < 0)
+  {
+    printf("can't set reporting mode: %s\n", strerror(errno));
+    close(int_fd);
+    close(ctrl_fd);
+    return 1;
+  }
+
+  last_ts = connect_ts;
+  end_ts = connect_ts + seconds * (uint64_t)1000000;
+
+  pfd.fd = int_fd;
+  pfd.events = POLLIN;
+
+  while (time_us() < end_ts)
+  {
+    if (poll(&pfd, 1, 100) < 0)
+    {
+      break;
+    }
+
+    if (pfd.revents & (POLLERR | POLLHUP))
+    {
+      printf("emulator dropped the connection\n");
+      break;
+    }
+
+    if (!(pfd.revents & POLLIN))
+    {
+      continue;
+    }
+
+    len = recv(int_fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (len <= 0)
+    {
+      continue;
+    }
+
+    //acks and status reports come first, only count data reports
+    if (buf[0] != 0xa1)
+    {
+      bad++;
+    }
+    else if (buf[1] == 0x31)
+    {
+      if (len != 7)
+      {
+        bad++;
+      }
+      else
+      {
+        reports++;
+
+        gap = time_us() - last_ts;
+        if (reports > 1 && gap > max_gap)
+        {
+          max_gap = gap;
+        }
+        last_ts = time_us();
+      }
+    }
+  }
+
+  close(int_fd);
+  close(ctrl_fd);
+
+  rate = reports / (double)seconds;
+
+  printf("connect_ms %.1f reports %d reports_per_sec %.1f max_gap_ms %.1f bad %d\n",
+    (connect_ts - start_ts) / 1000.0, reports, rate, max_gap / 1000.0, bad);
+
+  if (reports == 0 || bad > 0 || rate < min_rate)
+  {
+    return 1;
+  }
+
+  return 0;
+}
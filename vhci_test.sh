@@ -0,0 +1,116 @@
+#!/bin/sh
+
+# Runs wmemulator against a scripted host (vhci_host) over two virtual
+# controllers created through the kernel's /dev/vhci driver, so the L2CAP,
+# SDP and adapter set up code can be checked without any radios. BlueZ's
+# btvirt provides the controller side of /dev/vhci and links the two
+# controllers together. Must be run as root from the project directory.
+#
+# usage: ./vhci_test.sh [ <seconds> [ <min-reports/s> ] ]
+#
+# Set SDP=1 when wmemulator was built with its own SDP server
+# (CUSTOM_BUILD=1), otherwise a bluetoothd must be running to hold the
+# Wiimote's SDP record.
+
+RUN_SECONDS=${1:-5}
+MIN_RATE=${2:-50}
+BTVIRT=${BTVIRT:-btvirt}
+SOCK=/tmp/wmemulator-vhci.sock
+LOG=/tmp/wmemulator-vhci.log
+
+BTVIRT_PID=
+EMU_PID=
+
+fail()
+{
+  echo "vhci_test: $*"
+  exit 1
+}
+
+cleanup()
+{
+  if [ -n "$EMU_PID" ]; then
+    kill -INT "$EMU_PID" 2>/dev/null
+    wait "$EMU_PID" 2>/dev/null
+  fi
+  if [ -n "$BTVIRT_PID" ]; then
+    kill "$BTVIRT_PID" 2>/dev/null
+    wait "$BTVIRT_PID" 2>/dev/null
+  fi
+  rm -f "$SOCK"
+}
+
+list_devices()
+{
+  ls /sys/class/bluetooth 2>/dev/null | grep '^hci[0-9]*$'
+}
+
+device_name()
+{
+  hciconfig "$1" name 2>/dev/null | sed -n "s/.*Name: '\(.*\)'.*/\1/p"
+}
+
+[ "$(id -u)" -eq 0 ] || fail "must be run as root"
+[ -x ./wmemulator ] || fail "build wmemulator first"
+[ -x ./vhci_host ] || fail "build vhci_host first (make vhci_host)"
+command -v "$BTVIRT" >/dev/null || fail "$BTVIRT not found (BlueZ emulator tools)"
+command -v hciconfig >/dev/null || fail "hciconfig not found"
+
+[ -c /dev/vhci ] || modprobe hci_vhci 2>/dev/null
+[ -c /dev/vhci ] || fail "/dev/vhci is not available"
+
+trap cleanup EXIT INT TERM
+
+BEFORE=$(list_devices)
+
+"$BTVIRT" -l2 >/dev/null 2>&1 &
+BTVIRT_PID=$!
+
+NEW=
+for i in $(seq 50); do
+  NEW=$(list_devices | grep -vxF "$BEFORE" | head -n 2)
+  [ "$(echo "$NEW" | grep -c hci)" -eq 2 ] && break
+  sleep 0.1
+done
+[ "$(echo "$NEW" | grep -c hci)" -eq 2 ] || fail "virtual controllers did not appear"
+
+EMU_DEV=$(echo "$NEW" | sed -n 1p)
+HOST_DEV=$(echo "$NEW" | sed -n 2p)
+
+hciconfig "$EMU_DEV" up || fail "can't bring up $EMU_DEV"
+hciconfig "$HOST_DEV" up || fail "can't bring up $HOST_DEV"
+
+ORIGINAL_NAME=$(device_name "$EMU_DEV")
+
+echo "vhci_test: emulator on $EMU_DEV, host on $HOST_DEV"
+
+./wmemulator -d "$EMU_DEV" pair unix "$SOCK" >"$LOG" 2>&1 &
+EMU_PID=$!
+
+for i in $(seq 100); do
+  grep -q "listening for connections" "$LOG" && break
+  kill -0 "$EMU_PID" 2>/dev/null || break
+  sleep 0.1
+done
+if ! grep -q "listening for connections" "$LOG"; then
+  cat "$LOG"
+  fail "emulator did not start listening"
+fi
+
+[ "$(device_name "$EMU_DEV")" = "Nintendo RVL-CNT-01" ] || fail "$EMU_DEV was not set up as a Wiimote"
+
+./vhci_host -H "$HOST_DEV" -t "$RUN_SECONDS" -m "$MIN_RATE" ${SDP:+-s} "$EMU_DEV"
+RESULT=$?
+
+kill -INT "$EMU_PID"
+wait "$EMU_PID"
+EMU_PID=
+
+[ "$(device_name "$EMU_DEV")" = "$ORIGINAL_NAME" ] || fail "$EMU_DEV was not restored"
+
+if [ "$RESULT" -ne 0 ]; then
+  cat "$LOG"
+  fail "scripted host failed"
+fi
+
+echo "vhci_test: passed"
@@ -1,25 +1,61 @@
 #include "wiimote.h"
 
 #include "wm_reports.h"
+#include "wm_wmp.h"
+#include "wm_read_cache.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <arpa/inet.h>
+#include <stddef.h>
 
-int tries = 0;
+//a core data report (buttons, accelerometer, ir) should only need the first
+//two cache lines of the state
+_Static_assert(offsetof(struct wiimote_state, usr.ir_object) +
+  sizeof(((struct wiimote_state *)0)->usr.ir_object) <= 128,
+  "hot wiimote_state fields spill past two cache lines");
 
-static uint8_t classic_calibration[16] =
+static const uint8_t classic_calibration[16] =
 {
   // 0xF8, 0x04, 0x7A, 0xF8, 0x04, 0x7A, 0xF8, 0x04, 0x7A, 0xF8, 0x04, 0x7A, 0x00, 0x00, 0x00, 0x00
   0xE1, 0x19, 0x7C, 0xEF, 0x22, 0x7C, 0xE6, 0x1E, 0x85, 0xDE, 0x15, 0x8B, 0x0E, 0x22, 0x8F, 0xE4
 };
 
-static uint8_t nunchuk_calibration[16] =
+static const uint8_t nunchuk_calibration[16] =
 {
   0x81, 0x80, 0x7F, 0x22, 0xB5, 0xB3, 0xB3, 0x03, 0x00, 0x00, 0x7C, 0x00, 0x00, 0x83, 0x14, 0x69
 };
 
+void wiimote_start_timer(struct wiimote_state *state, struct wm_timer * timer, uint64_t delay_us)
+{
+  wm_timer_start(&state->sys.timers->wheel, timer, delay_us);
+  state->sys.timers_armed = 1;
+}
+
+void wiimote_set_clock(struct wiimote_state *state, wm_clock_fn clock, void * clock_data)
+{
+  wm_timer_wheel_set_clock(&state->sys.timers->wheel, clock, clock_data);
+}
+
+void wiimote_run_timers(struct wiimote_state *state)
+{
+  wm_timer_wheel_run(&state->sys.timers->wheel);
+  state->sys.timers_armed = (state->sys.timers->wheel.armed > 0);
+}
+
+void wiimote_set_read_cache(struct wiimote_state *state, struct wm_read_cache * cache)
+{
+  int region;
+
+  state->sys.read_cache = cache;
+
+  //whatever it prepared was for another state
+  for (region = 0; region < WM_READ_REGIONS; region++)
+  {
+    wm_read_cache_invalidate(state, region);
+  }
+}
+
 int process_report(struct wiimote_state *state, const uint8_t * buf, int len)
 {
   struct report_data * data = (struct report_data *)buf;
@@ -31,22 +67,28 @@ int process_report(struct wiimote_state *state, const uint8_t * buf, int len)
   {
     case 0x11: //player LEDs
     {
-      struct report_leds * rpt = (struct report_leds *)data->buf;
+      uint32_t values[WM_LEDS_VALUES];
+      wm_unpack_leds(data->buf, values);
 
-      state->sys.led_1 = rpt->led_1;
-      state->sys.led_2 = rpt->led_2;
-      state->sys.led_3 = rpt->led_3;
-      state->sys.led_4 = rpt->led_4;
+      state->sys.led_1 = values[WM_LEDS_LED_1];
+      state->sys.led_2 = values[WM_LEDS_LED_2];
+      state->sys.led_3 = values[WM_LEDS_LED_3];
+      state->sys.led_4 = values[WM_LEDS_LED_4];
 
       report_queue_push_ack(state, data->type, 0x00);
       break;
     }
     case 0x12: //data reporting mode
     {
-      struct report_mode * rpt = (struct report_mode *)data->buf;
+      uint32_t values[WM_MODE_VALUES];
+      wm_unpack_mode(data->buf, values);
 
-      state->sys.reporting_continuous = rpt->continuous;
-      state->sys.reporting_mode = rpt->mode;
+      state->sys.reporting_continuous = values[WM_MODE_CONTINUOUS];
+      state->sys.reporting_mode = values[WM_MODE_MODE];
+
+      //a new mode starts a new pair
+      state->pair.interleaved_pending = 0;
+      state->pair.passthrough_type = 0;
 
       report_queue_push_ack(state, data->type, 0x00);
       break;
@@ -54,9 +96,10 @@ int process_report(struct wiimote_state *state, const uint8_t * buf, int len)
     case 0x13:
     case 0x1a: //ir camera enable
     {
-      struct report_ir_enable * rpt = (struct report_ir_enable *)data->buf;
+      uint32_t values[WM_IR_ENABLE_VALUES];
+      wm_unpack_ir_enable(data->buf, values);
 
-      state->sys.ircam_enabled = rpt->enabled;
+      state->sys.ircam_enabled = values[WM_IR_ENABLE_ENABLED];
 
       report_queue_push_ack(state, data->type, 0x00);
       break;
@@ -64,9 +107,10 @@ int process_report(struct wiimote_state *state, const uint8_t * buf, int len)
     case 0x14:
     case 0x19: //speaker enable
     {
-      struct report_speaker_enable * rpt = (struct report_speaker_enable *)data->buf;
+      uint32_t values[WM_SPEAKER_ENABLE_VALUES];
+      wm_unpack_speaker_enable(data->buf, values);
 
-      state->sys.speaker_enabled = !rpt->muted;
+      state->sys.speaker_enabled = !values[WM_SPEAKER_ENABLE_MUTED];
 
       report_queue_push_ack(state, data->type, 0x00);
       break;
@@ -77,31 +121,44 @@ int process_report(struct wiimote_state *state, const uint8_t * buf, int len)
       break;
     case 0x16: //write memory
     {
-      struct report_mem_write * rpt = (struct report_mem_write *)data->buf;
+      uint32_t values[WM_MEM_WRITE_VALUES];
+      const uint8_t * write_data = data->buf + WM_MEM_WRITE_DATA;
+      wm_unpack_mem_write(data->buf, values);
 
-      if (rpt->source0 || rpt->source1)
+      if (values[WM_MEM_WRITE_SOURCE])
       {
-        write_register(state, ntohl(OFFSET24(rpt->offset)), rpt->size, rpt->data);
+        write_register(state, values[WM_MEM_WRITE_OFFSET], values[WM_MEM_WRITE_SIZE], write_data);
       }
       else
       {
-        write_eeprom(state, ntohl(OFFSET24(rpt->offset)), rpt->size, rpt->data);
+        write_eeprom(state, values[WM_MEM_WRITE_OFFSET], values[WM_MEM_WRITE_SIZE], write_data);
       }
       break;
     }
     case 0x17: //read memory
     {
-      struct report_mem_read * rpt = (struct report_mem_read *)data->buf;
+      uint32_t values[WM_MEM_READ_VALUES];
+      struct queued_report * tail = state->sys.queue_end;
+      wm_unpack_mem_read(data->buf, values);
+
+      if (wm_read_cache_serve(state, values[WM_MEM_READ_SOURCE],
+        values[WM_MEM_READ_OFFSET], values[WM_MEM_READ_SIZE]))
+      {
+        break;
+      }
 
-      if (rpt->source0 || rpt->source1)
+      if (values[WM_MEM_READ_SOURCE])
       {
-        read_register(state, ntohl(OFFSET24(rpt->offset)), ntohs(rpt->size));
+        read_register(state, values[WM_MEM_READ_OFFSET], values[WM_MEM_READ_SIZE]);
       }
       else
       {
-        read_eeprom(state, ntohl(OFFSET24(rpt->offset)), ntohs(rpt->size));
+        read_eeprom(state, values[WM_MEM_READ_OFFSET], values[WM_MEM_READ_SIZE]);
       }
 
+      wm_read_cache_learn(state, values[WM_MEM_READ_SOURCE], values[WM_MEM_READ_OFFSET],
+        values[WM_MEM_READ_SIZE], (tail != NULL) ? tail->next : state->sys.queue);
+
       break;
     }
   }
@@ -109,6 +166,11 @@ int process_report(struct wiimote_state *state, const uint8_t * buf, int len)
   return 0;
 }
 
+bool wiimote_is_data_mode(uint8_t mode)
+{
+  return (mode >= 0x30 && mode <= 0x37) || (mode >= 0x3d && mode <= 0x3f);
+}
+
 int generate_report(struct wiimote_state * state, uint8_t * buf)
 {
   int len;
@@ -116,18 +178,29 @@ int generate_report(struct wiimote_state * state, uint8_t * buf)
   struct report_data * data = (struct report_data *)buf;
   uint8_t * contents;
 
+  if (state->sys.timers_armed)
+  {
+    wiimote_run_timers(state);
+  }
+
+  //the host is idle, get the next read ready
+  if (state->sys.read_cache_stale && state->sys.queue == NULL)
+  {
+    wm_read_cache_prepare(state);
+  }
+
   if (state->usr.connected_extension_type != state->sys.connected_extension_type)
   {
     if (state->sys.extension_connected)
     {
       state->sys.extension_connected = 0;
       state->sys.connected_extension_type = NoExtension;
-      state->sys.extension_hotplug_timer = 30;
+      wiimote_start_timer(state, &state->sys.timers->hotplug, WIIMOTE_HOTPLUG_DELAY_US);
       report_queue_push_status(state);
     }
 
     bool extension_connected = (state->usr.connected_extension_type != NoExtension);
-    if (extension_connected && --state->sys.extension_hotplug_timer <= 0)
+    if (extension_connected && !state->sys.timers->hotplug.armed)
     {
       state->sys.extension_connected = extension_connected;
       state->sys.connected_extension_type = state->usr.connected_extension_type;
@@ -264,14 +337,15 @@ void read_eeprom(struct wiimote_state * state, uint32_t offset, uint16_t size)
   //equivalent to ceil(size / 0x10)
   int total_packets = (size + 0x10 - 1) / 0x10;
 
-  //allocate all the needed reports
+  //allocate all the needed reports, after any already queued
+  struct queued_report * queue_item = state->sys.queue_end;
   for (i = 0; i < total_packets; i++)
   {
     report_queue_push(state);
   }
 
   //copy packet data
-  struct queued_report * queue_item = state->sys.queue;
+  queue_item = (queue_item != NULL) ? queue_item->next : state->sys.queue;
 
   for (i = 0; i < total_packets; i++)
   {
@@ -289,6 +363,8 @@ void write_eeprom(struct wiimote_state * state, uint32_t offset, uint8_t size, c
   FILE * file;
   struct report * rpt;
 
+  wm_read_cache_invalidate(state, WM_READ_EEPROM);
+
   file = fopen("eeprom.bin", "rb");
   if (!file)
   {
@@ -315,72 +391,72 @@ void write_eeprom(struct wiimote_state * state, uint32_t offset, uint8_t size, c
   report_queue_push_ack(state, 0x16, 0x00);
 }
 
+// Register block an address falls in (for 0xa4, whichever is mapped there)
+// and its size, NULL for one that doesn't exist
+static uint8_t * register_block(struct wiimote_state *state, uint32_t offset, size_t *size)
+{
+  struct wiimote_registers * registers = state->sys.registers;
+
+  switch ((offset >> 16) & 0xfe) //select register, ignore lsb
+  {
+    case 0xa2: //speaker
+      *size = sizeof(registers->a2);
+      return registers->a2;
+    case 0xa4: //extension
+      *size = sizeof(registers->a4);
+      return wmp_mapped(state) ? registers->a6 : registers->a4;
+    case 0xa6: //motionplus
+      *size = sizeof(registers->a6);
+      return registers->a6;
+    case 0xb0: //ir camera
+      *size = sizeof(registers->b0);
+      return registers->b0;
+    default: //???
+      return NULL;
+  }
+}
+
 void read_register(struct wiimote_state *state, uint32_t offset, uint16_t size)
 {
   uint8_t * buffer;
+  size_t block_size;
   struct report * rpt;
   int i;
   bool encrypt = false;
 
-  switch ((offset >> 16) & 0xfe) //select register, ignore lsb
+  if (((offset >> 16) & 0xfe) == 0xa6 && wmp_mapped(state))
   {
-    case 0xa2: //speaker
-      buffer = state->sys.register_a2 + (offset & 0xff);
-      break;
-    case 0xa4: //extension
-      if (state->sys.wmp_state == 1)
-      {
-        //i guess this isn't needed after all
-        //^^this is an old comment, so is this needed or not?
-        if (((offset & 0xff) == 0xf6) || ((offset & 0xff) == 0xf7))
-        {
-          tries += 1;
-          printf("%d \n", tries);
-          if (tries == 5)
-          {
-            state->sys.register_a6[0xf7] = 0x0e;
-          }
-        }
-
-        buffer = state->sys.register_a6 + (offset & 0xff);
-      }
-      else
-      {
-        buffer = state->sys.register_a4 + (offset & 0xff);
-      }
+    rpt = report_queue_push(state);
+    report_format_mem_resp(state, rpt, 0x10, 0x7, offset, NULL, false);
+    return;
+  }
 
-      if (state->sys.extension_encrypted)
-      {
-        encrypt = true;
-      }
+  //the host's offset and size must stay within the block
+  buffer = register_block(state, offset, &block_size);
+  if (buffer == NULL || (offset & 0xff) + size > block_size)
+  {
+    rpt = report_queue_push(state);
+    report_format_mem_resp(state, rpt, 0x10, 0x8, offset, NULL, false);
+    return;
+  }
+  buffer += offset & 0xff;
 
-      break;
-    case 0xa6: //motionplus
-      if (state->sys.wmp_state == 1)
-      {
-         rpt = report_queue_push(state);
-         report_format_mem_resp(state, rpt, 0x10, 0x7, offset, NULL, false);
-         return;
-      }
-      buffer = state->sys.register_a6 + (offset & 0xff);
-      break;
-    case 0xb0: //ir camera
-      buffer = state->sys.register_b0 + (offset & 0xff);
-      break;
-    default: //???
-      break;
+  if (((offset >> 16) & 0xfe) == 0xa4 && state->sys.extension_encrypted)
+  {
+    encrypt = true;
   }
 
   //equivalent to ceil(size / 0x10)
   int total_packets = (size + 0x10 - 1) / 0x10;
 
-  //allocate all the needed reports
+  //allocate all the needed reports, after any already queued
+  struct queued_report * queue_item = state->sys.queue_end;
   for (i = 0; i < total_packets; i++)
   {
     report_queue_push(state);
   }
 
-  struct queued_report * queue_item = state->sys.queue;
+  queue_item = (queue_item != NULL) ? queue_item->next : state->sys.queue;
 
   for (i = 0; i < total_packets; i++)
   {
@@ -394,47 +470,34 @@ void read_register(struct wiimote_state *state, uint32_t offset, uint16_t size)
 void write_register(struct wiimote_state *state, uint32_t offset, uint8_t size, const uint8_t * buf)
 {
   uint8_t * reg;
+  size_t block_size;
   int result = 0x00;
+  int region = wm_read_region(1, offset);
 
-  switch ((offset >> 16) & 0xfe) //select register, ignore lsb
+  //the host's offset and size must stay within the block
+  reg = register_block(state, offset, &block_size);
+  if (reg == NULL || (offset & 0xff) + size > block_size)
   {
-    case 0xa2: //speaker
-      reg = state->sys.register_a2;
-      memcpy(reg + (offset & 0xff), buf, size);
-      break;
-    case 0xa4: //extension
-      reg = (state->sys.wmp_state == 1) ? state->sys.register_a6 : state->sys.register_a4;
-
-      memcpy(reg + (offset & 0xff), buf, size);
+    report_queue_push_ack(state, 0x16, 0x08);
+    return;
+  }
 
-      //TODO: double check what this does, the buf location it's looking for
-      if (((offset & 0xff) == 0xf0) && (buf[0] == 0x55) && (state->sys.wmp_state == 1)) //deactivate wmp
-      {
-        state->sys.wmp_state = 3;
+  if (region >= 0)
+  {
+    wm_read_cache_invalidate(state, region);
+  }
 
-        init_extension(state);
+  memcpy(reg + (offset & 0xff), buf, size);
 
-        report_queue_push_ack(state, 0x16, 0x00);
-        state->sys.extension_connected = 0;
-        report_queue_push_status(state);
-        state->sys.extension_connected = 1;
-        report_queue_push_status(state);
-        return;
-      }
-      else if (((offset & 0xff) == 0xfe) && (buf[0] == 0x00) && (state->sys.wmp_state == 1)) //also deactivate wmp?
+  switch ((offset >> 16) & 0xfe)
+  {
+    case 0xa4: //extension
+      if (wmp_register_written(state, offset, buf[0]))
       {
-        state->sys.wmp_state = 0;
-
-        init_extension(state);
-
-        report_queue_push_ack(state, 0x16, 0x00);
-        state->sys.extension_connected = 0;
-        report_queue_push_status(state);
-        state->sys.extension_connected = 1;
-        report_queue_push_status(state);
-        return;
+        return; //deactivated
       }
-      else if ((offset & 0xff) == 0x4c) //last part of encryption code
+
+      if ((offset & 0xff) == 0x4c) //last part of encryption code
       {
         ext_generate_tables(&state->sys.extension_crypto_state, &reg[0x40]);
         state->sys.extension_encrypted = 1;
@@ -450,107 +513,14 @@ void write_register(struct wiimote_state *state, uint32_t offset, uint8_t size,
           state->sys.extension_encrypted = 0;
         }
       }
-      else if ((offset & 0xff) == 0xf1)
-      {
-        state->sys.register_a6[0xf7] = 0x1a;
-
-        //idk why or how, but sometimes this must be updated
-        state->sys.register_a6[0x50] = 0xe7;
-        state->sys.register_a6[0x51] = 0x98;
-        state->sys.register_a6[0x52] = 0x31;
-        state->sys.register_a6[0x53] = 0x8a;
-        state->sys.register_a6[0x54] = 0x18;
-        state->sys.register_a6[0x55] = 0x82;
-        state->sys.register_a6[0x56] = 0x37;
-        state->sys.register_a6[0x57] = 0x5e;
-        state->sys.register_a6[0x58] = 0x02;
-        state->sys.register_a6[0x59] = 0x4f;
-        state->sys.register_a6[0x5a] = 0x68;
-        state->sys.register_a6[0x5b] = 0x47;
-        state->sys.register_a6[0x5c] = 0x78;
-        state->sys.register_a6[0x5d] = 0xef;
-        state->sys.register_a6[0x5e] = 0xbb;
-        state->sys.register_a6[0x5f] = 0xd7;
-
-        state->sys.register_a6[0x60] = 0x86;
-        state->sys.register_a6[0x61] = 0xc8;
-        state->sys.register_a6[0x62] = 0x95;
-        state->sys.register_a6[0x63] = 0xbd;
-        state->sys.register_a6[0x64] = 0x20;
-        state->sys.register_a6[0x65] = 0x9b;
-        state->sys.register_a6[0x66] = 0xeb;
-        state->sys.register_a6[0x67] = 0x8b;
-        state->sys.register_a6[0x68] = 0x79;
-        state->sys.register_a6[0x69] = 0x81;
-        state->sys.register_a6[0x6a] = 0xdc;
-        state->sys.register_a6[0x6b] = 0x61;
-        state->sys.register_a6[0x6c] = 0x13;
-        state->sys.register_a6[0x6d] = 0x54;
-        state->sys.register_a6[0x6e] = 0x79;
-        state->sys.register_a6[0x6f] = 0x4c;
-
-        state->sys.register_a6[0x70] = 0xb7;
-        state->sys.register_a6[0x71] = 0x26;
-        state->sys.register_a6[0x72] = 0x82;
-        state->sys.register_a6[0x73] = 0x17;
-        state->sys.register_a6[0x74] = 0xe8;
-        state->sys.register_a6[0x75] = 0x0f;
-        state->sys.register_a6[0x76] = 0xa9;
-        state->sys.register_a6[0x77] = 0xb5;
-        state->sys.register_a6[0x78] = 0x45;
-        state->sys.register_a6[0x79] = 0xa0;
-        state->sys.register_a6[0x7a] = 0x38;
-        state->sys.register_a6[0x7b] = 0x8e;
-        state->sys.register_a6[0x7c] = 0x9e;
-        state->sys.register_a6[0x7d] = 0x86;
-        state->sys.register_a6[0x7e] = 0x72;
-        state->sys.register_a6[0x7f] = 0x55;
-
-        state->sys.register_a6[0x80] = 0x3d;
-        state->sys.register_a6[0x81] = 0x46;
-        state->sys.register_a6[0x82] = 0x2e;
-        state->sys.register_a6[0x83] = 0x3e;
-        state->sys.register_a6[0x84] = 0x10;
-        state->sys.register_a6[0x85] = 0x1f;
-        state->sys.register_a6[0x86] = 0x8e;
-        state->sys.register_a6[0x87] = 0x0c;
-        state->sys.register_a6[0x88] = 0xf4;
-        state->sys.register_a6[0x89] = 0x04;
-        state->sys.register_a6[0x8a] = 0x89;
-        state->sys.register_a6[0x8b] = 0x4c;
-        state->sys.register_a6[0x8c] = 0xca;
-        state->sys.register_a6[0x8d] = 0x3e;
-        state->sys.register_a6[0x8e] = 0x9f;
-        state->sys.register_a6[0x8f] = 0x36;
-      }
 
       break;
     case 0xa6: //motionplus
-      reg = state->sys.register_a6;
-      memcpy(reg + (offset & 0xff), buf, size);
-
-      if (((offset & 0xff) == 0xfe) && ((buf[0] >> 2) & 0x1)) //activate wmp
+      if (wmp_register_written(state, offset, buf[0]))
       {
-        state->sys.wmp_state = 1;
-        state->sys.extension_report_type = (buf[0] & 0x7);
-        printf("activate wmp\n");
-
-        init_extension(state);
-
-        report_queue_push_ack(state, 0x16, 0x00);
-        state->sys.extension_connected = 0;
-        report_queue_push_status(state);
-        state->sys.extension_connected = 1;
-        report_queue_push_status(state);
-        return;
+        return; //activated
       }
 
-      break;
-    case 0xb0: //ir camera
-      reg = state->sys.register_b0;
-      memcpy(reg + (offset & 0xff), buf, size);
-      break;
-    default: //???
       break;
   }
 
@@ -582,6 +552,7 @@ void reset_input_classic(struct wiimote_classic * classic)
 {
   memset(classic, 0, sizeof(struct wiimote_classic));
 
+  classic->buttons = CLASSIC_BUTTONS_RELEASED;
   classic->ls_x = 32;
   classic->ls_y = 32;
   classic->rs_x = 15;
@@ -602,219 +573,219 @@ void reset_input_motionplus(struct wiimote_motionplus * motionplus)
 
 void init_extension(struct wiimote_state * state)
 {
+  wm_read_cache_invalidate(state, WM_READ_EXTENSION);
+
   if (state->sys.connected_extension_type == NoExtension)
   {
-    memset(state->sys.register_a4, 0xff, sizeof(state->sys.register_a4));
+    memset(state->sys.registers->a4, 0xff, sizeof(state->sys.registers->a4));
   }
   else
   {
-    memset(state->sys.register_a4, 0, sizeof(state->sys.register_a4));
+    memset(state->sys.registers->a4, 0, sizeof(state->sys.registers->a4));
   }
 
-  if (state->sys.wmp_state == 1)
+  if (wmp_mapped(state))
   {
-    //register_a6[0xfa] = 0x00;
-    //register_a6[0xfb] = 0x00;
-    //register_a6[0xfc] = 0xa4;
-    //register_a6[0xfd] = 0x20;
-    //this might not be needed now that memory is proper
-    //register_a6[0xfe] = state->sys.extension_report_type;
-    //register_a6[0xff] = 0x05;
-    state->sys.register_a6[0xfc] = 0xa4;
+    //id of an active motionplus: 0000 a420 0405, 0505 or 0705
+    state->sys.registers->a6[0xfa] = 0x00;
+    state->sys.registers->a6[0xfb] = 0x00;
+    state->sys.registers->a6[0xfc] = 0xa4;
+    state->sys.registers->a6[0xfd] = 0x20;
+    state->sys.registers->a6[0xfe] = state->sys.extension_report_type;
+    state->sys.registers->a6[0xff] = 0x05;
 
     state->sys.extension_encrypted = 0;
 
     //random guess, pulled from wiimote, not sure what this is for
-    state->sys.register_a6[0xf0] = 0x55;
-    state->sys.register_a6[0xf1] = 0xff;
-    state->sys.register_a6[0xf2] = 0xff;
-    state->sys.register_a6[0xf3] = 0xff;
-    state->sys.register_a6[0xf4] = 0xff;
-    state->sys.register_a6[0xf5] = 0xff;
-    state->sys.register_a6[0xf6] = 0x00;
+    state->sys.registers->a6[0xf0] = 0x55;
+    state->sys.registers->a6[0xf1] = 0xff;
+    state->sys.registers->a6[0xf2] = 0xff;
+    state->sys.registers->a6[0xf3] = 0xff;
+    state->sys.registers->a6[0xf4] = 0xff;
+    state->sys.registers->a6[0xf5] = 0xff;
+    state->sys.registers->a6[0xf6] = 0x00;
 
     //a4 40 post init
-    // state->sys.register_a6[0x40] = 0x81;
-    // state->sys.register_a6[0x41] = 0x80;
-    // state->sys.register_a6[0x42] = 0x80;
-    // state->sys.register_a6[0x43] = 0x28;
-    // state->sys.register_a6[0x44] = 0xb4;
-    // state->sys.register_a6[0x45] = 0xb3;
-    // state->sys.register_a6[0x46] = 0xb3;
-    // state->sys.register_a6[0x47] = 0x26;
-    // state->sys.register_a6[0x48] = 0xe3;
-    // state->sys.register_a6[0x49] = 0x22;
-    // state->sys.register_a6[0x4a] = 0x7a;
-    // state->sys.register_a6[0x4b] = 0xd8;
-    // state->sys.register_a6[0x4c] = 0x1b;
-    // state->sys.register_a6[0x4d] = 0x81;
-    // state->sys.register_a6[0x4e] = 0x31;
-    // state->sys.register_a6[0x4f] = 0x86;
-
-    state->sys.register_a6[0x20] = 0x7c;
-    state->sys.register_a6[0x21] = 0x97;
-    state->sys.register_a6[0x22] = 0x7f;
-    state->sys.register_a6[0x23] = 0x0a;
-    state->sys.register_a6[0x24] = 0x7c;
-    state->sys.register_a6[0x25] = 0xa8;
-    state->sys.register_a6[0x26] = 0x33;
-    state->sys.register_a6[0x27] = 0xb7;
-    state->sys.register_a6[0x28] = 0xcc;
-    state->sys.register_a6[0x29] = 0x12;
-    state->sys.register_a6[0x2a] = 0x33;
-    state->sys.register_a6[0x2b] = 0x08;
-    state->sys.register_a6[0x2c] = 0xc8;
-    state->sys.register_a6[0x2d] = 0x01;
-    state->sys.register_a6[0x2e] = 0x72;
-    state->sys.register_a6[0x2f] = 0xd4;
-
-    state->sys.register_a6[0x30] = 0x7c;
-    state->sys.register_a6[0x31] = 0x53;
-    state->sys.register_a6[0x32] = 0x87;
-    state->sys.register_a6[0x33] = 0x58;
-    state->sys.register_a6[0x34] = 0x7c;
-    state->sys.register_a6[0x35] = 0x9f;
-    state->sys.register_a6[0x36] = 0x36;
-    state->sys.register_a6[0x37] = 0xb2;
-    state->sys.register_a6[0x38] = 0xc9;
-    state->sys.register_a6[0x39] = 0x34;
-    state->sys.register_a6[0x3a] = 0x35;
-    state->sys.register_a6[0x3b] = 0xf8;
-    state->sys.register_a6[0x3c] = 0x2d;
-    state->sys.register_a6[0x3d] = 0x60;
-    state->sys.register_a6[0x3e] = 0xd7;
-    state->sys.register_a6[0x3f] = 0xd5;
+    // state->sys.registers->a6[0x40] = 0x81;
+    // state->sys.registers->a6[0x41] = 0x80;
+    // state->sys.registers->a6[0x42] = 0x80;
+    // state->sys.registers->a6[0x43] = 0x28;
+    // state->sys.registers->a6[0x44] = 0xb4;
+    // state->sys.registers->a6[0x45] = 0xb3;
+    // state->sys.registers->a6[0x46] = 0xb3;
+    // state->sys.registers->a6[0x47] = 0x26;
+    // state->sys.registers->a6[0x48] = 0xe3;
+    // state->sys.registers->a6[0x49] = 0x22;
+    // state->sys.registers->a6[0x4a] = 0x7a;
+    // state->sys.registers->a6[0x4b] = 0xd8;
+    // state->sys.registers->a6[0x4c] = 0x1b;
+    // state->sys.registers->a6[0x4d] = 0x81;
+    // state->sys.registers->a6[0x4e] = 0x31;
+    // state->sys.registers->a6[0x4f] = 0x86;
+
+    state->sys.registers->a6[0x20] = 0x7c;
+    state->sys.registers->a6[0x21] = 0x97;
+    state->sys.registers->a6[0x22] = 0x7f;
+    state->sys.registers->a6[0x23] = 0x0a;
+    state->sys.registers->a6[0x24] = 0x7c;
+    state->sys.registers->a6[0x25] = 0xa8;
+    state->sys.registers->a6[0x26] = 0x33;
+    state->sys.registers->a6[0x27] = 0xb7;
+    state->sys.registers->a6[0x28] = 0xcc;
+    state->sys.registers->a6[0x29] = 0x12;
+    state->sys.registers->a6[0x2a] = 0x33;
+    state->sys.registers->a6[0x2b] = 0x08;
+    state->sys.registers->a6[0x2c] = 0xc8;
+    state->sys.registers->a6[0x2d] = 0x01;
+    state->sys.registers->a6[0x2e] = 0x72;
+    state->sys.registers->a6[0x2f] = 0xd4;
+
+    state->sys.registers->a6[0x30] = 0x7c;
+    state->sys.registers->a6[0x31] = 0x53;
+    state->sys.registers->a6[0x32] = 0x87;
+    state->sys.registers->a6[0x33] = 0x58;
+    state->sys.registers->a6[0x34] = 0x7c;
+    state->sys.registers->a6[0x35] = 0x9f;
+    state->sys.registers->a6[0x36] = 0x36;
+    state->sys.registers->a6[0x37] = 0xb2;
+    state->sys.registers->a6[0x38] = 0xc9;
+    state->sys.registers->a6[0x39] = 0x34;
+    state->sys.registers->a6[0x3a] = 0x35;
+    state->sys.registers->a6[0x3b] = 0xf8;
+    state->sys.registers->a6[0x3c] = 0x2d;
+    state->sys.registers->a6[0x3d] = 0x60;
+    state->sys.registers->a6[0x3e] = 0xd7;
+    state->sys.registers->a6[0x3f] = 0xd5;
 
     //not sure block, this may not be needed
-    state->sys.register_a6[0x50] = 0x15;
-    state->sys.register_a6[0x51] = 0x6d;
-    state->sys.register_a6[0x52] = 0xe0;
-    state->sys.register_a6[0x53] = 0x23;
-    state->sys.register_a6[0x54] = 0x20;
-    state->sys.register_a6[0x55] = 0x79;
-    state->sys.register_a6[0x56] = 0xd3;
-    state->sys.register_a6[0x57] = 0x73;
-    state->sys.register_a6[0x58] = 0x01;
-    state->sys.register_a6[0x59] = 0xa9;
-    state->sys.register_a6[0x5a] = 0xf0;
-    state->sys.register_a6[0x5b] = 0x25;
-    state->sys.register_a6[0x5c] = 0xb0;
-    state->sys.register_a6[0x5d] = 0xbc;
-    state->sys.register_a6[0x5e] = 0xff;
-    state->sys.register_a6[0x5f] = 0xe1;
-
-    state->sys.register_a6[0x60] = 0xd8;
-    state->sys.register_a6[0x61] = 0x3f;
-    state->sys.register_a6[0x62] = 0x82;
-    state->sys.register_a6[0x63] = 0x52;
-    state->sys.register_a6[0x64] = 0x75;
-    state->sys.register_a6[0x65] = 0x99;
-    state->sys.register_a6[0x66] = 0xbe;
-    state->sys.register_a6[0x67] = 0xdb;
-    state->sys.register_a6[0x68] = 0xcb;
-    state->sys.register_a6[0x69] = 0x61;
-    state->sys.register_a6[0x6a] = 0x60;
-    state->sys.register_a6[0x6b] = 0x0f;
-    state->sys.register_a6[0x6c] = 0x35;
-    state->sys.register_a6[0x6d] = 0xbd;
-    state->sys.register_a6[0x6e] = 0xd4;
-    state->sys.register_a6[0x6f] = 0x4d;
-
-    state->sys.register_a6[0x70] = 0x5c;
-    state->sys.register_a6[0x71] = 0x9f;
-    state->sys.register_a6[0x72] = 0x5d;
-    state->sys.register_a6[0x73] = 0x81;
-    state->sys.register_a6[0x74] = 0x71;
-    state->sys.register_a6[0x75] = 0xde;
-    state->sys.register_a6[0x76] = 0x22;
-    state->sys.register_a6[0x77] = 0xe6;
-    state->sys.register_a6[0x78] = 0xb9;
-    state->sys.register_a6[0x79] = 0x23;
-    state->sys.register_a6[0x7a] = 0xa4;
-    state->sys.register_a6[0x7b] = 0x58;
-    state->sys.register_a6[0x7c] = 0xb7;
-    state->sys.register_a6[0x7d] = 0x62;
-    state->sys.register_a6[0x7e] = 0x33;
-    state->sys.register_a6[0x7f] = 0xa4;
-
-    state->sys.register_a6[0x80] = 0xcd;
-    state->sys.register_a6[0x81] = 0x8b;
-    state->sys.register_a6[0x82] = 0x3a;
-    state->sys.register_a6[0x83] = 0xfe;
-    state->sys.register_a6[0x84] = 0x98;
-    state->sys.register_a6[0x85] = 0xf0;
-    state->sys.register_a6[0x86] = 0xd9;
-    state->sys.register_a6[0x87] = 0x57;
-    state->sys.register_a6[0x88] = 0x0c;
-    state->sys.register_a6[0x89] = 0xe8;
-    state->sys.register_a6[0x8a] = 0x27;
-    state->sys.register_a6[0x8b] = 0x51;
-    state->sys.register_a6[0x8c] = 0xb6;
-    state->sys.register_a6[0x8d] = 0xea;
-    state->sys.register_a6[0x8e] = 0xe5;
-    state->sys.register_a6[0x8f] = 0x78;
-
-
-    //init progress byte, set it to done
-    state->sys.register_a6[0xf7] = 0x0c;
-    state->sys.register_a6[0xf8] = 0x00;
-    state->sys.register_a6[0xf9] = 0x00;
+    state->sys.registers->a6[0x50] = 0x15;
+    state->sys.registers->a6[0x51] = 0x6d;
+    state->sys.registers->a6[0x52] = 0xe0;
+    state->sys.registers->a6[0x53] = 0x23;
+    state->sys.registers->a6[0x54] = 0x20;
+    state->sys.registers->a6[0x55] = 0x79;
+    state->sys.registers->a6[0x56] = 0xd3;
+    state->sys.registers->a6[0x57] = 0x73;
+    state->sys.registers->a6[0x58] = 0x01;
+    state->sys.registers->a6[0x59] = 0xa9;
+    state->sys.registers->a6[0x5a] = 0xf0;
+    state->sys.registers->a6[0x5b] = 0x25;
+    state->sys.registers->a6[0x5c] = 0xb0;
+    state->sys.registers->a6[0x5d] = 0xbc;
+    state->sys.registers->a6[0x5e] = 0xff;
+    state->sys.registers->a6[0x5f] = 0xe1;
+
+    state->sys.registers->a6[0x60] = 0xd8;
+    state->sys.registers->a6[0x61] = 0x3f;
+    state->sys.registers->a6[0x62] = 0x82;
+    state->sys.registers->a6[0x63] = 0x52;
+    state->sys.registers->a6[0x64] = 0x75;
+    state->sys.registers->a6[0x65] = 0x99;
+    state->sys.registers->a6[0x66] = 0xbe;
+    state->sys.registers->a6[0x67] = 0xdb;
+    state->sys.registers->a6[0x68] = 0xcb;
+    state->sys.registers->a6[0x69] = 0x61;
+    state->sys.registers->a6[0x6a] = 0x60;
+    state->sys.registers->a6[0x6b] = 0x0f;
+    state->sys.registers->a6[0x6c] = 0x35;
+    state->sys.registers->a6[0x6d] = 0xbd;
+    state->sys.registers->a6[0x6e] = 0xd4;
+    state->sys.registers->a6[0x6f] = 0x4d;
+
+    state->sys.registers->a6[0x70] = 0x5c;
+    state->sys.registers->a6[0x71] = 0x9f;
+    state->sys.registers->a6[0x72] = 0x5d;
+    state->sys.registers->a6[0x73] = 0x81;
+    state->sys.registers->a6[0x74] = 0x71;
+    state->sys.registers->a6[0x75] = 0xde;
+    state->sys.registers->a6[0x76] = 0x22;
+    state->sys.registers->a6[0x77] = 0xe6;
+    state->sys.registers->a6[0x78] = 0xb9;
+    state->sys.registers->a6[0x79] = 0x23;
+    state->sys.registers->a6[0x7a] = 0xa4;
+    state->sys.registers->a6[0x7b] = 0x58;
+    state->sys.registers->a6[0x7c] = 0xb7;
+    state->sys.registers->a6[0x7d] = 0x62;
+    state->sys.registers->a6[0x7e] = 0x33;
+    state->sys.registers->a6[0x7f] = 0xa4;
+
+    state->sys.registers->a6[0x80] = 0xcd;
+    state->sys.registers->a6[0x81] = 0x8b;
+    state->sys.registers->a6[0x82] = 0x3a;
+    state->sys.registers->a6[0x83] = 0xfe;
+    state->sys.registers->a6[0x84] = 0x98;
+    state->sys.registers->a6[0x85] = 0xf0;
+    state->sys.registers->a6[0x86] = 0xd9;
+    state->sys.registers->a6[0x87] = 0x57;
+    state->sys.registers->a6[0x88] = 0x0c;
+    state->sys.registers->a6[0x89] = 0xe8;
+    state->sys.registers->a6[0x8a] = 0x27;
+    state->sys.registers->a6[0x8b] = 0x51;
+    state->sys.registers->a6[0x8c] = 0xb6;
+    state->sys.registers->a6[0x8d] = 0xea;
+    state->sys.registers->a6[0x8e] = 0xe5;
+    state->sys.registers->a6[0x8f] = 0x78;
+
+
+    //the init progress byte (0xf7) belongs to wm_wmp.c
+    state->sys.registers->a6[0xf8] = 0x00;
+    state->sys.registers->a6[0xf9] = 0x00;
   }
   else
   {
-    //state->sys.register_a6[0xf7] = 0x0c;
-
-    state->sys.register_a6[0xf0] = 0x55;
-    state->sys.register_a6[0xf1] = 0xff;
-    state->sys.register_a6[0xf2] = 0xff;
-    state->sys.register_a6[0xf3] = 0xff;
-    state->sys.register_a6[0xf4] = 0xff;
-    state->sys.register_a6[0xf5] = 0xff;
-    state->sys.register_a6[0xf6] = 0xff;
-    state->sys.register_a6[0xf7] = 0x02;
-    state->sys.register_a6[0xf8] = 0xff;
-    state->sys.register_a6[0xf9] = 0xff;
-    state->sys.register_a6[0xfa] = 0x01;
-    state->sys.register_a6[0xfb] = 0x00;
-    state->sys.register_a6[0xfc] = 0xa6;
-    state->sys.register_a6[0xfd] = 0x20;
-    state->sys.register_a6[0xfe] = 0x00;
-    state->sys.register_a6[0xff] = 0x05;
+    //state->sys.registers->a6[0xf7] = 0x0c;
+
+    state->sys.registers->a6[0xf0] = 0x55;
+    state->sys.registers->a6[0xf1] = 0xff;
+    state->sys.registers->a6[0xf2] = 0xff;
+    state->sys.registers->a6[0xf3] = 0xff;
+    state->sys.registers->a6[0xf4] = 0xff;
+    state->sys.registers->a6[0xf5] = 0xff;
+    state->sys.registers->a6[0xf6] = 0xff;
+    state->sys.registers->a6[0xf7] = 0x02;
+    state->sys.registers->a6[0xf8] = 0xff;
+    state->sys.registers->a6[0xf9] = 0xff;
+    state->sys.registers->a6[0xfa] = 0x01;
+    state->sys.registers->a6[0xfb] = 0x00;
+    state->sys.registers->a6[0xfc] = 0xa6;
+    state->sys.registers->a6[0xfd] = 0x20;
+    state->sys.registers->a6[0xfe] = 0x00;
+    state->sys.registers->a6[0xff] = 0x05;
 
     if (state->sys.connected_extension_type == NoExtension)
     {
       return;
     }
 
-    memset(&state->sys.register_a4[0xf0], 0x0, 0x10);
+    memset(&state->sys.registers->a4[0xf0], 0x0, 0x10);
 
-    state->sys.register_a4[0xf0] = 0x55;
-    state->sys.register_a4[0xfc] = 0xa4;
-    state->sys.register_a4[0xfd] = 0x20;
+    state->sys.registers->a4[0xf0] = 0x55;
+    state->sys.registers->a4[0xfc] = 0xa4;
+    state->sys.registers->a4[0xfd] = 0x20;
 
     switch (state->sys.connected_extension_type)
     {
       default:
       case Nunchuk:
-        state->sys.register_a4[0xfe] = 0x00;
-        state->sys.register_a4[0xff] = 0x00;
-        memcpy(&state->sys.register_a4[0x20], nunchuk_calibration, 0x10);
-        memcpy(&state->sys.register_a4[0x30], nunchuk_calibration, 0x10);
+        state->sys.registers->a4[0xfe] = 0x00;
+        state->sys.registers->a4[0xff] = 0x00;
+        memcpy(&state->sys.registers->a4[0x20], nunchuk_calibration, 0x10);
+        memcpy(&state->sys.registers->a4[0x30], nunchuk_calibration, 0x10);
         break;
       case Classic:
-        state->sys.register_a4[0xfe] = 0x01;
-        state->sys.register_a4[0xff] = 0x01;
-        memcpy(&state->sys.register_a4[0x20], classic_calibration, 0x10);
-        memcpy(&state->sys.register_a4[0x30], classic_calibration, 0x10);
+        state->sys.registers->a4[0xfe] = 0x01;
+        state->sys.registers->a4[0xff] = 0x01;
+        memcpy(&state->sys.registers->a4[0x20], classic_calibration, 0x10);
+        memcpy(&state->sys.registers->a4[0x30], classic_calibration, 0x10);
         break;
       case BalanceBoard:
-        state->sys.register_a4[0xfe] = 0x04;
-        state->sys.register_a4[0xff] = 0x02;
+        state->sys.registers->a4[0xfe] = 0x04;
+        state->sys.registers->a4[0xff] = 0x02;
         break;
     }
 
-    state->sys.extension_report_type = state->sys.register_a4[0xfe];
-    state->sys.extension_type = state->sys.register_a4[0xff];
+    state->sys.extension_report_type = state->sys.registers->a4[0xfe];
+    state->sys.extension_type = state->sys.registers->a4[0xff];
   }
 }
 
@@ -826,12 +797,27 @@ void wiimote_destroy(struct wiimote_state *state)
     state->sys.queue = rpt->next;
     free(rpt);
   }
+
+  free(state->sys.registers);
+  state->sys.registers = NULL;
+
+  free(state->sys.timers);
+  state->sys.timers = NULL;
 }
 
-void wiimote_init(struct wiimote_state *state)
+int wiimote_init(struct wiimote_state *state)
 {
   memset(state, 0, sizeof(struct wiimote_state));
 
+  state->sys.registers = (struct wiimote_registers *)calloc(1, sizeof(struct wiimote_registers));
+  state->sys.timers = (struct wiimote_timers *)malloc(sizeof(struct wiimote_timers));
+  if (state->sys.registers == NULL || state->sys.timers == NULL)
+  {
+    wiimote_destroy(state);
+    return -1;
+  }
+  wm_timer_wheel_init(&state->sys.timers->wheel, NULL, NULL);
+
   //flat
   state->usr.accel_x = 0x82 << 2;
   state->usr.accel_y = 0x82 << 2;
@@ -851,11 +837,28 @@ void wiimote_init(struct wiimote_state *state)
   rpt->len = 4;
   rpt->data.io = 0xa1;
   rpt->data.type = 0x30;
+
+  return 0;
 }
 
 void wiimote_reset(struct wiimote_state *state)
 {
+  struct wiimote_registers * registers = state->sys.registers;
+  struct wiimote_timers * timers = state->sys.timers;
+  struct wm_read_cache * read_cache = state->sys.read_cache;
+
   memset(&state->sys, 0, sizeof(struct wiimote_state_sys));
+  memset(registers, 0, sizeof(struct wiimote_registers));
+  state->sys.registers = registers;
+
+  //keeps the clock
+  wm_timer_wheel_clear(&timers->wheel);
+  wm_timer_init(&timers->hotplug, NULL, state); //only polled
+  state->sys.timers = timers;
+  wmp_reset(state);
+
+  //the learned reads outlive a reset, their responses don't
+  wiimote_set_read_cache(state, read_cache);
 
   state->sys.reporting_mode = 0x30;
   state->sys.battery_level = 0xff;
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "wm_crypto.h"
+#include "wm_timer.h"
 
 enum wiimote_connected_extension_type
 {
@@ -36,23 +37,30 @@ struct wiimote_nunchuk
   bool z;
 };
 
+//classic controller buttons in wire order (report bytes 4 and 5 of the
+//extension data), active low: a clear bit is a pressed button
+#define CLASSIC_BUTTON_RTRIGGER 0x0002
+#define CLASSIC_BUTTON_PLUS     0x0004
+#define CLASSIC_BUTTON_HOME     0x0008
+#define CLASSIC_BUTTON_MINUS    0x0010
+#define CLASSIC_BUTTON_LTRIGGER 0x0020
+#define CLASSIC_BUTTON_DOWN     0x0040
+#define CLASSIC_BUTTON_RIGHT    0x0080
+#define CLASSIC_BUTTON_UP       0x0100
+#define CLASSIC_BUTTON_LEFT     0x0200
+#define CLASSIC_BUTTON_RZ       0x0400
+#define CLASSIC_BUTTON_X        0x0800
+#define CLASSIC_BUTTON_A        0x1000
+#define CLASSIC_BUTTON_Y        0x2000
+#define CLASSIC_BUTTON_B        0x4000
+#define CLASSIC_BUTTON_LZ       0x8000
+
+//nothing pressed, bit 0 is unused and always set
+#define CLASSIC_BUTTONS_RELEASED 0xffff
+
 struct wiimote_classic
 {
-  bool a;
-  bool b;
-  bool x;
-  bool y;
-  bool minus;
-  bool plus;
-  bool rtrigger;
-  bool ltrigger;
-  bool home;
-  bool rz;
-  bool lz;
-  bool up;
-  bool down;
-  bool left;
-  bool right;
+  uint16_t buttons;
   uint8_t ls_x;
   uint8_t ls_y;
   uint8_t rs_x;
@@ -72,23 +80,26 @@ struct wiimote_motionplus
   bool pitch_slow;
 };
 
+//core buttons in wire order (report bytes 0 and 1), a set bit is pressed
+#define WIIMOTE_BUTTON_LEFT  0x0001
+#define WIIMOTE_BUTTON_RIGHT 0x0002
+#define WIIMOTE_BUTTON_DOWN  0x0004
+#define WIIMOTE_BUTTON_UP    0x0008
+#define WIIMOTE_BUTTON_PLUS  0x0010
+#define WIIMOTE_BUTTON_TWO   0x0100
+#define WIIMOTE_BUTTON_ONE   0x0200
+#define WIIMOTE_BUTTON_B     0x0400
+#define WIIMOTE_BUTTON_A     0x0800
+#define WIIMOTE_BUTTON_MINUS 0x1000
+#define WIIMOTE_BUTTON_HOME  0x8000
+
+//the other bits of those bytes carry accelerometer LSBs
+#define WIIMOTE_BUTTONS_MASK 0x9f1f
+
 struct wiimote_state_usr
 {
-  bool a;
-  bool b;
-  bool minus;
-  bool plus;
-  bool home;
-  bool one;
-  bool two;
-  bool up;
-  bool down;
-  bool left;
-  bool right;
-
-  //special buttons
-  bool sync;
-  bool power;
+  //read for every data report, kept together at the front
+  uint16_t buttons;
 
   //accelerometer (10 bit range)
   //0 acceleration is approximately 0x200
@@ -98,11 +109,16 @@ struct wiimote_state_usr
 
   struct wiimote_ir_object ir_object[4];
 
-  enum wiimote_connected_extension_type connected_extension_type;
-
+  //only read in extension reporting modes
   struct wiimote_nunchuk nunchuk;
   struct wiimote_classic classic;
   struct wiimote_motionplus motionplus;
+
+  enum wiimote_connected_extension_type connected_extension_type;
+
+  //special buttons
+  bool sync;
+  bool power;
 };
 
 void reset_ir_object(struct wiimote_ir_object * object);
@@ -111,56 +127,110 @@ void reset_input_nunchuk(struct wiimote_nunchuk * nunchuk);
 void reset_input_classic(struct wiimote_classic * classic);
 void reset_input_motionplus(struct wiimote_motionplus * motionplus);
 
-struct wiimote_state_sys
+struct wm_read_cache;
+
+//register memory, only touched by register reads/writes and extension set up
+struct wiimote_registers
 {
-  bool led_1;
-  bool led_2;
-  bool led_3;
-  bool led_4;
+  uint8_t a2[10]; //speaker
+  uint8_t a4[256]; //extension
+  uint8_t a6[256]; //wii motion plus
+  uint8_t b0[52]; //ir camera
+};
 
-  bool rumble;
+//how long an extension stays unplugged before a new one is reported
+#define WIIMOTE_HOTPLUG_DELAY_US 300000
+//how long motionplus takes to set up encryption after 0xa400f1 is written
+#define WIIMOTE_WMP_INIT_DELAY_US 20000
 
-  bool ircam_enabled;
-  bool speaker_enabled;
+//delayed state transitions, run from generate_report
+struct wiimote_timers
+{
+  struct wm_timer_wheel wheel;
 
-  uint8_t battery_level;
-  bool low_battery;
+  struct wm_timer hotplug; //armed while a new extension has to wait
+  struct wm_timer wmp_init; //armed while motionplus reports init in progress
+};
 
-  int extension_hotplug_timer;
-  bool extension_connected;
-  enum wiimote_connected_extension_type connected_extension_type;
+struct wiimote_state_sys
+{
+  //fields used while generating every report come first
+  uint8_t reporting_mode;
+  bool reporting_continuous;
+  bool report_changed;
 
-  struct ext_crypto_state extension_crypto_state;
   bool extension_report;
   bool extension_encrypted;
   uint8_t extension_report_type;
+  bool extension_connected;
+  bool timers_armed; //timers has something to run
+  enum wiimote_connected_extension_type connected_extension_type;
   uint8_t extension_type;
-  uint8_t wmp_state; //0 inactive, 1 active, 2 deactivated
+  uint8_t wmp_state; //enum wmp_state
 
-  uint8_t reporting_mode;
-  bool reporting_continuous;
-  bool report_changed;
+  uint8_t battery_level;
+  bool low_battery;
 
   struct queued_report * queue;
   struct queued_report * queue_end;
 
-  uint8_t register_a2[10]; //speaker
-  uint8_t register_a4[256]; //extension
-  uint8_t register_a6[256]; //wii motion plus
-  uint8_t register_b0[52]; //ir camera
+  struct ext_crypto_state extension_crypto_state;
+
+  bool led_1;
+  bool led_2;
+  bool led_3;
+  bool led_4;
+
+  bool rumble;
+
+  bool ircam_enabled;
+  bool speaker_enabled;
+
+  bool read_cache_stale; //read_cache has responses to rebuild
+
+  struct wm_read_cache * read_cache; //optional, see wiimote_set_read_cache
+  struct wiimote_registers * registers; //allocated by wiimote_init
+  struct wiimote_timers * timers; //allocated by wiimote_init
 };
 
+//the second report of a pair, encoded together with the first from the same
+//usr state so the host never combines halves of different inputs
+struct wiimote_state_pair
+{
+  bool interleaved_pending; //interleaved holds the 0x3f half
+  uint8_t passthrough_type; //extension report type of passthrough, 0 if none
+  uint8_t interleaved[21]; //report contents, buttons included
+  uint8_t passthrough[6]; //next extension frame, not yet encrypted
+};
+
+//aligned so the hot fields of sys and usr share the first two cache lines
 struct wiimote_state
 {
   struct wiimote_state_sys sys;
   struct wiimote_state_usr usr;
-};
+  struct wiimote_state_pair pair;
+} __attribute__((aligned(64)));
 
-void wiimote_init(struct wiimote_state *state);
+// Returns -1 if the registers or timers can't be allocated
+int wiimote_init(struct wiimote_state *state);
 void wiimote_destroy(struct wiimote_state *state);
 
 void wiimote_reset(struct wiimote_state *state);
 
+// The clock the state's timers run on, wm_clock_monotonic if clock is NULL
+void wiimote_set_clock(struct wiimote_state *state, wm_clock_fn clock, void * clock_data);
+// Runs the timers that are due, generate_report does this for every report
+void wiimote_run_timers(struct wiimote_state *state);
+void wiimote_start_timer(struct wiimote_state *state, struct wm_timer * timer, uint64_t delay_us);
+
+// Answers repeated memory reads from prepared responses, see wm_read_cache.h.
+// The cache is kept by the caller and may outlive connections, NULL turns
+// it off.
+void wiimote_set_read_cache(struct wiimote_state *state, struct wm_read_cache * cache);
+
+// Whether mode is one of the data reporting modes a host can ask for
+bool wiimote_is_data_mode(uint8_t mode);
+
 int process_report(struct wiimote_state *state, const uint8_t *buf, int len);
 int generate_report(struct wiimote_state * state, uint8_t * buf);
 
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "wm_batch.h"
+#include "wm_reports.h"
+
+// Controllers are encoded a block at a time: first every payload byte is
+// computed for the whole block as its own column (straight-line loops over
+// the arrays that the compiler can vectorize), then the columns are
+// interleaved into the reports.
+#define WM_BATCH_BLOCK 64
+
+#define PAYLOAD_33 (2 + 3 + 12)
+#define PAYLOAD_37 (2 + 3 + 10 + 6)
+
+int wm_batch_init(struct wm_batch * batch, int capacity)
+{
+  int i, ok = 1;
+
+  memset(batch, 0, sizeof(struct wm_batch));
+
+  batch->capacity = capacity;
+  batch->buttons = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+  batch->accel_x = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+  batch->accel_y = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+  batch->accel_z = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+  ok = batch->buttons && batch->accel_x && batch->accel_y && batch->accel_z;
+
+  for (i = 0; i < 4; i++)
+  {
+    batch->ir_x[i] = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+    batch->ir_y[i] = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+    batch->ir_size[i] = (uint8_t *)calloc(capacity, sizeof(uint8_t));
+    ok = ok && batch->ir_x[i] && batch->ir_y[i] && batch->ir_size[i];
+  }
+
+  if (!ok)
+  {
+    wm_batch_free(batch);
+    return -1;
+  }
+
+  return 0;
+}
+
+void wm_batch_free(struct wm_batch * batch)
+{
+  int i;
+
+  free(batch->buttons);
+  free(batch->accel_x);
+  free(batch->accel_y);
+  free(batch->accel_z);
+
+  for (i = 0; i < 4; i++)
+  {
+    free(batch->ir_x[i]);
+    free(batch->ir_y[i]);
+    free(batch->ir_size[i]);
+  }
+
+  memset(batch, 0, sizeof(struct wm_batch));
+}
+
+void wm_batch_load(struct wm_batch * batch, int i, const struct wiimote_state * state)
+{
+  const struct wiimote_state_usr * usr = &state->usr;
+  int j;
+
+  batch->buttons[i] = usr->buttons;
+
+  batch->accel_x[i] = usr->accel_x;
+  batch->accel_y[i] = usr->accel_y;
+  batch->accel_z[i] = usr->accel_z;
+
+  for (j = 0; j < 4; j++)
+  {
+    batch->ir_x[j][i] = usr->ir_object[j].x;
+    batch->ir_y[j][i] = usr->ir_object[j].y;
+    batch->ir_size[j][i] = usr->ir_object[j].size;
+  }
+
+  if (i >= batch->count)
+  {
+    batch->count = i + 1;
+  }
+}
+
+//buttons with the accelerometer LSBs and the three accelerometer bytes
+static void encode_core(const struct wm_batch * batch, int base, int n,
+  uint8_t col[][WM_BATCH_BLOCK])
+{
+  const uint16_t * restrict buttons = batch->buttons + base;
+  const uint16_t * restrict ax = batch->accel_x + base;
+  const uint16_t * restrict ay = batch->accel_y + base;
+  const uint16_t * restrict az = batch->accel_z + base;
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    uint16_t b = buttons[i] & WIIMOTE_BUTTONS_MASK;
+
+    col[0][i] = (b & 0xff) | ((ax[i] & 0x3) << 5);
+    col[1][i] = (b >> 8) | ((((az[i] & 0x2) | ((ay[i] >> 1) & 0x1)) & 0x3) << 5);
+    col[2][i] = ax[i] >> 2;
+    col[3][i] = ay[i] >> 2;
+    col[4][i] = az[i] >> 2;
+  }
+}
+
+//extended ir, 3 bytes per object (WM_IR_EXTENDED_LAYOUT)
+static void encode_ir_12(const struct wm_batch * batch, int base, int n,
+  uint8_t col[][WM_BATCH_BLOCK])
+{
+  int i, j;
+
+  for (j = 0; j < 4; j++)
+  {
+    const uint16_t * restrict x = batch->ir_x[j] + base;
+    const uint16_t * restrict y = batch->ir_y[j] + base;
+    const uint8_t * restrict size = batch->ir_size[j] + base;
+    uint8_t * restrict x_lo = col[3 * j];
+    uint8_t * restrict y_lo = col[3 * j + 1];
+    uint8_t * restrict hi = col[3 * j + 2];
+
+    for (i = 0; i < n; i++)
+    {
+      x_lo[i] = x[i];
+      y_lo[i] = y[i];
+      hi[i] = (size[i] & 0xf) | (((x[i] >> 8) & 0x3) << 4) | (((y[i] >> 8) & 0x3) << 6);
+    }
+  }
+}
+
+//basic ir, two objects per 5 bytes (WM_IR_BASIC_LAYOUT)
+static void encode_ir_10(const struct wm_batch * batch, int base, int n,
+  uint8_t col[][WM_BATCH_BLOCK])
+{
+  int i, j;
+
+  for (j = 0; j < 2; j++)
+  {
+    const uint16_t * restrict x1 = batch->ir_x[2 * j] + base;
+    const uint16_t * restrict y1 = batch->ir_y[2 * j] + base;
+    const uint16_t * restrict x2 = batch->ir_x[2 * j + 1] + base;
+    const uint16_t * restrict y2 = batch->ir_y[2 * j + 1] + base;
+    uint8_t (* restrict c)[WM_BATCH_BLOCK] = col + 5 * j;
+
+    for (i = 0; i < n; i++)
+    {
+      c[0][i] = x1[i];
+      c[1][i] = y1[i];
+      c[2][i] = ((x2[i] >> 8) & 0x3) | (((y2[i] >> 8) & 0x3) << 2) |
+        (((x1[i] >> 8) & 0x3) << 4) | (((y1[i] >> 8) & 0x3) << 6);
+      c[3][i] = x2[i];
+      c[4][i] = y2[i];
+    }
+  }
+}
+
+int wm_batch_encode(const struct wm_batch * batch, uint8_t mode,
+  struct wiimote_state * const states[], uint8_t * out, size_t stride)
+{
+  uint8_t col[PAYLOAD_33][WM_BATCH_BLOCK];
+  int payload, columns, base, n, i, k;
+
+  switch (mode)
+  {
+    case 0x33:
+      payload = PAYLOAD_33;
+      columns = PAYLOAD_33;
+      break;
+    case 0x37:
+      payload = PAYLOAD_37;
+      columns = PAYLOAD_37 - 6;
+      break;
+    default:
+      return -1;
+  }
+
+  for (base = 0; base < batch->count; base += WM_BATCH_BLOCK)
+  {
+    n = batch->count - base;
+    if (n > WM_BATCH_BLOCK)
+    {
+      n = WM_BATCH_BLOCK;
+    }
+
+    encode_core(batch, base, n, col);
+    if (mode == 0x33)
+    {
+      encode_ir_12(batch, base, n, col + 5);
+    }
+    else
+    {
+      encode_ir_10(batch, base, n, col + 5);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      uint8_t * dst = out + (base + i) * stride;
+
+      dst[0] = 0xa1;
+      dst[1] = mode;
+      for (k = 0; k < columns; k++)
+      {
+        dst[2 + k] = col[k][i];
+      }
+
+      if (mode == 0x37)
+      {
+        memset(dst + 2 + columns, 0, 6);
+        if (states != NULL)
+        {
+          report_append_extension(states[base + i], dst + 2 + columns, 6);
+        }
+      }
+    }
+  }
+
+  return 2 + payload;
+}
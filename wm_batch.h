@@ -0,0 +1,44 @@
+#ifndef WM_BATCH_H
+#define WM_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "wiimote.h"
+
+/*
+ * Hot input fields for many controllers kept as structure-of-arrays, so the
+ * 0x33 and 0x37 data reports of all of them can be encoded in one pass.
+ * Entry i of every array belongs to controller i.
+ */
+struct wm_batch
+{
+  int count;
+  int capacity;
+
+  uint16_t * buttons; //core buttons, wire order (byte 0 low, byte 1 high)
+  uint16_t * accel_x; //10 bit
+  uint16_t * accel_y;
+  uint16_t * accel_z;
+
+  uint16_t * ir_x[4];
+  uint16_t * ir_y[4];
+  uint8_t * ir_size[4];
+};
+
+int wm_batch_init(struct wm_batch * batch, int capacity);
+void wm_batch_free(struct wm_batch * batch);
+
+// Copies controller i's input out of its wiimote_state
+void wm_batch_load(struct wm_batch * batch, int i, const struct wiimote_state * state);
+
+/*
+ * Writes one complete data report (0xa1, mode, payload) per controller to
+ * out, stride bytes apart, and returns the report length or -1 for modes
+ * other than 0x33 and 0x37. For 0x37 the extension bytes still come from
+ * each controller's state (they depend on its extension and encryption),
+ * states may be NULL to leave them zeroed.
+ */
+int wm_batch_encode(const struct wm_batch * batch, uint8_t mode,
+  struct wiimote_state * const states[], uint8_t * out, size_t stride);
+
+#endif /* WM_BATCH_H */
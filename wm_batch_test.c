@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiimote.h"
+#include "wm_reports.h"
+#include "wm_batch.h"
+
+// Differential test: the batch encoder must produce byte for byte the same
+// 0x33/0x37 reports as generate_report on the same controllers.
+
+#define CONTROLLERS 150 //more than two encoder blocks, last one partial
+#define ROUNDS 200
+#define STRIDE 24
+
+static const uint8_t extension_types[] = { 0x00, 0x01, 0x04, 0x05, 0x07 };
+
+static void randomize(struct wiimote_state * state)
+{
+  struct wiimote_state_usr * usr = &state->usr;
+  uint8_t key[16];
+  int i;
+
+  usr->buttons = rand() & WIIMOTE_BUTTONS_MASK;
+
+  usr->accel_x = rand() & 0x3ff;
+  usr->accel_y = rand() & 0x3ff;
+  usr->accel_z = rand() & 0x3ff;
+
+  for (i = 0; i < 4; i++)
+  {
+    //1023 is the "no object" value the scalar path sends most often
+    usr->ir_object[i].x = (rand() & 7) ? rand() & 0x3ff : 0x3ff;
+    usr->ir_object[i].y = (rand() & 7) ? rand() & 0x3ff : 0x3ff;
+    usr->ir_object[i].size = rand() & 0xf;
+  }
+
+  usr->nunchuk.x = rand();
+  usr->nunchuk.y = rand();
+  usr->nunchuk.accel_x = rand() & 0x3ff;
+  usr->nunchuk.c = rand() & 1;
+  usr->classic.ls_x = rand() & 0x3f;
+  usr->classic.buttons = rand() | 0x0001;
+  usr->motionplus.yaw_down = rand() & 0x3fff;
+
+  state->sys.extension_report_type = extension_types[rand() % sizeof(extension_types)];
+  state->sys.extension_encrypted = rand() & 1;
+  if (state->sys.extension_encrypted)
+  {
+    for (i = 0; i < 16; i++)
+    {
+      key[i] = rand();
+    }
+    ext_generate_tables(&state->sys.extension_crypto_state, key);
+  }
+}
+
+static void drain_queue(struct wiimote_state * state)
+{
+  while (state->sys.queue != NULL)
+  {
+    report_queue_pop(state);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  static struct wiimote_state scalar[CONTROLLERS], batched[CONTROLLERS];
+  struct wiimote_state * batched_ptrs[CONTROLLERS];
+  static uint8_t out[CONTROLLERS * STRIDE];
+  uint8_t expected[sizeof(struct report_data)];
+  struct wm_batch batch;
+  const uint8_t modes[] = { 0x33, 0x37 };
+  int round, m, i, len, expected_len, failures = 0;
+
+  srand(1234);
+
+  if (wm_batch_init(&batch, CONTROLLERS) < 0)
+  {
+    printf("out of memory\n");
+    return 1;
+  }
+
+  for (i = 0; i < CONTROLLERS; i++)
+  {
+    wiimote_init(&scalar[i]);
+    drain_queue(&scalar[i]);
+    scalar[i].sys.reporting_continuous = 1;
+  }
+
+  for (round = 0; round < ROUNDS; round++)
+  {
+    m = round % 2;
+
+    for (i = 0; i < CONTROLLERS; i++)
+    {
+      randomize(&scalar[i]);
+      scalar[i].sys.reporting_mode = modes[m];
+
+      //the extension encoder changes passthrough state, keep a twin in step
+      batched[i] = scalar[i];
+      batched_ptrs[i] = &batched[i];
+
+      wm_batch_load(&batch, i, &batched[i]);
+    }
+
+    memset(out, 0xee, sizeof(out));
+    len = wm_batch_encode(&batch, modes[m], batched_ptrs, out, STRIDE);
+
+    for (i = 0; i < CONTROLLERS; i++)
+    {
+      memset(expected, 0, sizeof(expected));
+      expected_len = generate_report(&scalar[i], expected);
+
+      if (len != expected_len || memcmp(out + i * STRIDE, expected, len) != 0)
+      {
+        if (failures++ < 5)
+        {
+          printf("mode 0x%02x round %d controller %d differs (len %d vs %d)\n",
+            modes[m], round, i, len, expected_len);
+        }
+      }
+    }
+  }
+
+  if (wm_batch_encode(&batch, 0x31, NULL, out, STRIDE) != -1)
+  {
+    printf("unsupported mode was accepted\n");
+    failures++;
+  }
+
+  for (i = 0; i < CONTROLLERS; i++)
+  {
+    wiimote_destroy(&scalar[i]);
+  }
+  wm_batch_free(&batch);
+
+  if (failures > 0)
+  {
+    printf("%d report(s) differ\n", failures);
+    return 1;
+  }
+
+  printf("batch encoder matches generate_report for %d reports\n", ROUNDS * CONTROLLERS);
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include "wm_fixtures.h"
+#include "wm_reports.h"
+#include "wm_crypto.h"
+
+#include <string.h>
+
+#define EXTENSION_CASES(mode) \
+  { mode, 0x00, 0 }, { mode, 0x00, 1 }, \
+  { mode, 0x01, 0 }, { mode, 0x01, 1 }, \
+  { mode, 0x04, 0 }, { mode, 0x04, 1 }, \
+  { mode, 0x05, 0 }, { mode, 0x05, 1 }, \
+  { mode, 0x07, 0 }, { mode, 0x07, 1 },
+
+const struct wm_fixture_case wm_fixture_cases[] =
+{
+  { 0x30, 0x00, 0 },
+  { 0x31, 0x00, 0 },
+  EXTENSION_CASES(0x32)
+  { 0x33, 0x00, 0 },
+  EXTENSION_CASES(0x34)
+  EXTENSION_CASES(0x35)
+  EXTENSION_CASES(0x36)
+  EXTENSION_CASES(0x37)
+  EXTENSION_CASES(0x3d)
+  { 0x3e, 0x00, 0 }, //alternates with 0x3f
+};
+
+const int wm_fixture_case_count = sizeof(wm_fixture_cases) / sizeof(wm_fixture_cases[0]);
+
+const struct wm_fixture_report wm_fixture_host_traffic[] =
+{
+  { 3, { 0xa2, 0x11, 0x10 } }, //player 1 led
+  { 3, { 0xa2, 0x15, 0x00 } }, //status request
+  { 8, { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0xfa, 0x00, 0x06 } }, //extension id
+  { 23, { 0xa2, 0x16, 0x04, 0xa4, 0x00, 0xf0, 0x01, 0x55 } }, //extension init
+  { 23, { 0xa2, 0x16, 0x04, 0xa4, 0x00, 0xfb, 0x01, 0x00 } },
+  { 8, { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0xfa, 0x00, 0x06 } },
+  { 8, { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0x20, 0x00, 0x10 } }, //calibration
+  { 4, { 0xa2, 0x12, 0x00, 0x32 } }, //buttons + extension on change
+  { 3, { 0xa2, 0x13, 0x04 } }, //ir pixel clock
+  { 3, { 0xa2, 0x1a, 0x04 } }, //ir camera
+  { 23, { 0xa2, 0x16, 0x04, 0xb0, 0x00, 0x30, 0x01, 0x01 } },
+  { 23, { 0xa2, 0x16, 0x04, 0xb0, 0x00, 0x00, 0x09, 0x02, 0x00, 0x00, 0x71, 0x01, 0x00, 0xaa, 0x00, 0x64 } },
+  { 23, { 0xa2, 0x16, 0x04, 0xb0, 0x00, 0x1a, 0x02, 0x63, 0x03 } },
+  { 23, { 0xa2, 0x16, 0x04, 0xb0, 0x00, 0x33, 0x01, 0x03 } },
+  { 23, { 0xa2, 0x16, 0x04, 0xb0, 0x00, 0x30, 0x01, 0x08 } },
+  //encryption key in three writes, the last one turns encryption on
+  { 23, { 0xa2, 0x16, 0x04, 0xa4, 0x00, 0x40, 0x06, 0x3e, 0x1c, 0x8a, 0x04, 0xf7, 0x52 } },
+  { 23, { 0xa2, 0x16, 0x04, 0xa4, 0x00, 0x46, 0x06, 0x91, 0x2b, 0x6d, 0xe0, 0x15, 0xc4 } },
+  { 23, { 0xa2, 0x16, 0x04, 0xa4, 0x00, 0x4c, 0x04, 0x07, 0xb9, 0x38, 0x5a } },
+  { 8, { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0xfa, 0x00, 0x06 } },
+  { 3, { 0xa2, 0x14, 0x04 } }, //speaker
+  { 3, { 0xa2, 0x19, 0x04 } }, //speaker mute
+  { 3, { 0xa2, 0x10, 0x01 } }, //rumble
+  { 4, { 0xa2, 0x12, 0x04, 0x37 } }, //continuous buttons + accelerometer + ir + extension
+  { 3, { 0xa2, 0x15, 0x00 } },
+};
+
+const int wm_fixture_host_traffic_count =
+  sizeof(wm_fixture_host_traffic) / sizeof(wm_fixture_host_traffic[0]);
+
+uint32_t wm_fixture_random(uint32_t * seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+static void drain_queue(struct wiimote_state * state)
+{
+  while (state->sys.queue != NULL)
+  {
+    report_queue_pop(state);
+  }
+}
+
+void wm_fixture_init(struct wiimote_state * state, const struct wm_fixture_case * fixture,
+  uint32_t seed)
+{
+  uint8_t key[16];
+  int i;
+
+  wiimote_init(state);
+  drain_queue(state);
+
+  state->sys.reporting_continuous = 1;
+  state->sys.reporting_mode = fixture->mode;
+  state->sys.extension_report_type = fixture->extension;
+
+  if (fixture->encrypted)
+  {
+    for (i = 0; i < 16; i++)
+    {
+      key[i] = wm_fixture_random(&seed);
+    }
+    ext_generate_tables(&state->sys.extension_crypto_state, key);
+    state->sys.extension_encrypted = 1;
+  }
+
+  wm_fixture_step(state, &seed);
+}
+
+void wm_fixture_step(struct wiimote_state * state, uint32_t * seed)
+{
+  struct wiimote_state_usr * usr = &state->usr;
+  int i;
+
+  usr->buttons = wm_fixture_random(seed) & WIIMOTE_BUTTONS_MASK;
+  usr->accel_x = wm_fixture_random(seed) & 0x3ff;
+  usr->accel_y = wm_fixture_random(seed) & 0x3ff;
+  usr->accel_z = wm_fixture_random(seed) & 0x3ff;
+
+  for (i = 0; i < 4; i++)
+  {
+    struct wiimote_ir_object * object = &usr->ir_object[i];
+
+    //1023 is "no object", common on the wire
+    object->x = (wm_fixture_random(seed) & 3) ? wm_fixture_random(seed) & 0x3ff : 0x3ff;
+    object->y = (wm_fixture_random(seed) & 3) ? wm_fixture_random(seed) & 0x3ff : 0x3ff;
+    object->size = wm_fixture_random(seed) & 0xf;
+    object->xmin = wm_fixture_random(seed) & 0x7f;
+    object->ymin = wm_fixture_random(seed) & 0x7f;
+    object->xmax = wm_fixture_random(seed) & 0x7f;
+    object->ymax = wm_fixture_random(seed) & 0x7f;
+    object->intensity = wm_fixture_random(seed);
+  }
+
+  usr->nunchuk.x = wm_fixture_random(seed);
+  usr->nunchuk.y = wm_fixture_random(seed);
+  usr->nunchuk.accel_x = wm_fixture_random(seed) & 0x3ff;
+  usr->nunchuk.accel_y = wm_fixture_random(seed) & 0x3ff;
+  usr->nunchuk.accel_z = wm_fixture_random(seed) & 0x3ff;
+  usr->nunchuk.c = wm_fixture_random(seed) & 1;
+  usr->nunchuk.z = wm_fixture_random(seed) & 1;
+
+  usr->classic.buttons = wm_fixture_random(seed) | 0x0001;
+  usr->classic.ls_x = wm_fixture_random(seed) & 0x3f;
+  usr->classic.ls_y = wm_fixture_random(seed) & 0x3f;
+  usr->classic.rs_x = wm_fixture_random(seed) & 0x1f;
+  usr->classic.rs_y = wm_fixture_random(seed) & 0x1f;
+  usr->classic.lt = wm_fixture_random(seed) & 0x1f;
+  usr->classic.rt = wm_fixture_random(seed) & 0x1f;
+
+  usr->motionplus.yaw_down = wm_fixture_random(seed) & 0x3fff;
+  usr->motionplus.roll_left = wm_fixture_random(seed) & 0x3fff;
+  usr->motionplus.pitch_left = wm_fixture_random(seed) & 0x3fff;
+  usr->motionplus.yaw_slow = wm_fixture_random(seed) & 1;
+  usr->motionplus.roll_slow = wm_fixture_random(seed) & 1;
+  usr->motionplus.pitch_slow = wm_fixture_random(seed) & 1;
+}
+
+void wm_fixture_init_host(struct wiimote_state * state)
+{
+  uint8_t buf[sizeof(struct report_data)];
+  int i;
+
+  wiimote_init(state);
+  drain_queue(state);
+
+  state->usr.connected_extension_type = Nunchuk;
+  for (i = 0; i < 100 && !state->sys.extension_connected; i++)
+  {
+    generate_report(state, buf);
+  }
+
+  drain_queue(state);
+}
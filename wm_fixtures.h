@@ -0,0 +1,52 @@
+#ifndef WM_FIXTURES_H
+#define WM_FIXTURES_H
+
+#include <stdint.h>
+#include "wiimote.h"
+
+/*
+ * Deterministic controller states and host traffic shared by the golden
+ * report corpus (wm_golden_test) and the benchmarks (wmbench). Everything
+ * comes from a fixed seed through a local generator, so the same fixture
+ * gives the same bytes on every machine.
+ */
+
+struct wm_fixture_case
+{
+  uint8_t mode;
+  uint8_t extension; //extension report type, see report_append_extension
+  int encrypted;
+};
+
+//every data reporting mode, extension modes once per extension type and
+//with and without encryption
+extern const struct wm_fixture_case wm_fixture_cases[];
+extern const int wm_fixture_case_count;
+
+struct wm_fixture_report
+{
+  int len;
+  uint8_t data[23]; //0xa2, type, payload
+};
+
+//what a Wii sends while connecting a remote with a nunchuk: leds, status,
+//extension id and calibration reads, extension init and encryption key,
+//ir camera set up and data reporting mode
+extern const struct wm_fixture_report wm_fixture_host_traffic[];
+extern const int wm_fixture_host_traffic_count;
+
+uint32_t wm_fixture_random(uint32_t * seed);
+
+// Fresh state for a case: queue drained, continuous reporting in the
+// case's mode and extension report type, encryption keyed if asked
+void wm_fixture_init(struct wiimote_state * state, const struct wm_fixture_case * fixture,
+  uint32_t seed);
+
+// Moves every input (buttons, accelerometer, ir, extensions) to new values
+void wm_fixture_step(struct wiimote_state * state, uint32_t * seed);
+
+// Fresh state with a nunchuk plugged in and past its hotplug delay, ready
+// for wm_fixture_host_traffic
+void wm_fixture_init_host(struct wiimote_state * state);
+
+#endif
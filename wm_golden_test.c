@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiimote.h"
+#include "wm_reports.h"
+#include "wm_fixtures.h"
+
+// Golden report corpus: every fixture case and the recorded host traffic
+// are run through the emulator and the wire bytes compared with the checked
+// in corpus, so optimizations can't silently change what the Wii receives.
+// Run with -w to rewrite the corpus after an intended change.
+
+#define DEFAULT_CORPUS "golden_reports.txt"
+#define REPORTS_PER_CASE 4
+
+static void print_hex(FILE * out, const char * prefix, const uint8_t * buf, int len)
+{
+  int i;
+
+  fprintf(out, "%s", prefix);
+  for (i = 0; i < len; i++)
+  {
+    fprintf(out, " %02x", buf[i]);
+  }
+  fprintf(out, "\n");
+}
+
+static void write_corpus(FILE * out)
+{
+  struct wiimote_state state;
+  uint8_t buf[sizeof(struct report_data)];
+  uint32_t seed;
+  int c, i, len;
+
+  for (c = 0; c < wm_fixture_case_count; c++)
+  {
+    const struct wm_fixture_case * fixture = &wm_fixture_cases[c];
+
+    fprintf(out, "case %02x %02x %s\n", fixture->mode, fixture->extension,
+      fixture->encrypted ? "encrypted" : "plain");
+
+    seed = c + 1;
+    wm_fixture_init(&state, fixture, seed);
+    for (i = 0; i < REPORTS_PER_CASE; i++)
+    {
+      wm_fixture_step(&state, &seed);
+      memset(buf, 0, sizeof(buf));
+      len = generate_report(&state, buf);
+      print_hex(out, " ", buf, len);
+    }
+    wiimote_destroy(&state);
+  }
+
+  fprintf(out, "host traffic\n");
+
+  wm_fixture_init_host(&state);
+  for (c = 0; c < wm_fixture_host_traffic_count; c++)
+  {
+    const struct wm_fixture_report * rpt = &wm_fixture_host_traffic[c];
+
+    print_hex(out, "<", rpt->data, rpt->len);
+    process_report(&state, rpt->data, rpt->len);
+
+    while (state.sys.queue != NULL)
+    {
+      memset(buf, 0, sizeof(buf));
+      len = generate_report(&state, buf);
+      print_hex(out, ">", buf, len);
+    }
+  }
+  wiimote_destroy(&state);
+}
+
+int main(int argc, char *argv[])
+{
+  const char * path = DEFAULT_CORPUS;
+  int rewrite = 0;
+  char * expected = NULL, * actual = NULL;
+  size_t expected_size = 0, actual_size = 0;
+  FILE * file;
+  int i, line;
+
+  for (i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-w") == 0)
+    {
+      rewrite = 1;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+
+  if (rewrite)
+  {
+    file = fopen(path, "w");
+    if (!file)
+    {
+      printf("can't write %s\n", path);
+      return 1;
+    }
+    write_corpus(file);
+    fclose(file);
+    printf("wrote %s\n", path);
+    return 0;
+  }
+
+  file = open_memstream(&actual, &actual_size);
+  write_corpus(file);
+  fclose(file);
+
+  file = fopen(path, "r");
+  if (!file)
+  {
+    printf("can't read %s\n", path);
+    return 1;
+  }
+  expected = (char *)malloc(actual_size + 1);
+  expected_size = fread(expected, 1, actual_size + 1, file);
+  fclose(file);
+
+  if (expected_size == actual_size && memcmp(expected, actual, actual_size) == 0)
+  {
+    printf("wire output matches %s\n", path);
+    free(expected);
+    free(actual);
+    return 0;
+  }
+
+  //report the first line that changed
+  for (i = 0, line = 1; i < actual_size && i < expected_size && expected[i] == actual[i]; i++)
+  {
+    if (actual[i] == '\n')
+    {
+      line++;
+    }
+  }
+  printf("wire output differs from %s at line %d\n", path, line);
+
+  free(expected);
+  free(actual);
+  return 1;
+}
@@ -0,0 +1,72 @@
+#include "wm_layout.h"
+
+#include <string.h>
+
+#define WM_LAYOUT_FIELD(report, value, value_shift, byte, shift, width, invert) \
+  { WM_##report##_##value, value_shift, byte, shift, width, invert },
+#define WM_LAYOUT_NAME(report, value) #value,
+#define WM_LAYOUT_DEFINE(report, name) \
+  static const struct wm_field name##_fields[] = \
+  { \
+    WM_##report##_LAYOUT(WM_LAYOUT_IGNORE, WM_LAYOUT_FIELD) \
+  }; \
+  static const char * const name##_names[] = \
+  { \
+    WM_##report##_LAYOUT(WM_LAYOUT_NAME, WM_LAYOUT_IGNORE) \
+  }; \
+  const struct wm_layout wm_layout_##name = \
+  { \
+    #report, name##_fields, sizeof(name##_fields) / sizeof(name##_fields[0]), \
+    name##_names, WM_##report##_VALUES \
+  };
+
+WM_LAYOUTS(WM_LAYOUT_DEFINE)
+
+#define WM_LAYOUT_POINTER(report, name) &wm_layout_##name,
+
+const struct wm_layout * const wm_layouts[] =
+{
+  WM_LAYOUTS(WM_LAYOUT_POINTER)
+};
+
+const int wm_layout_count = sizeof(wm_layouts) / sizeof(wm_layouts[0]);
+
+#define WM_LAYOUT_CHECK_VALUES(report, name) \
+  _Static_assert(WM_##report##_VALUES <= WM_LAYOUT_MAX_VALUES, \
+    "WM_LAYOUT_MAX_VALUES is too small for " #report);
+
+WM_LAYOUTS(WM_LAYOUT_CHECK_VALUES)
+
+// Same arithmetic as WM_LAYOUT_PACK_FIELD/WM_LAYOUT_UNPACK_FIELD, with the
+// field read from the table: the mask comes from the width and inversion is
+// an xor, so nothing branches on the table contents.
+
+void wm_pack(const struct wm_layout * layout, uint8_t * buf, const uint32_t * values)
+{
+  const struct wm_field * field = layout->fields;
+  const struct wm_field * end = field + layout->field_count;
+
+  for (; field < end; field++)
+  {
+    uint32_t mask = WM_FIELD_MASK(field->width);
+    uint32_t bits = ((values[field->value] >> field->value_shift) ^ -(uint32_t)field->invert) & mask;
+
+    buf[field->byte] = (buf[field->byte] & ~(mask << field->shift)) | (bits << field->shift);
+  }
+}
+
+void wm_unpack(const struct wm_layout * layout, const uint8_t * buf, uint32_t * values)
+{
+  const struct wm_field * field = layout->fields;
+  const struct wm_field * end = field + layout->field_count;
+
+  memset(values, 0, layout->value_count * sizeof(uint32_t));
+
+  for (; field < end; field++)
+  {
+    uint32_t mask = WM_FIELD_MASK(field->width);
+    uint32_t bits = ((buf[field->byte] >> field->shift) ^ -(uint32_t)field->invert) & mask;
+
+    values[field->value] |= bits << field->value_shift;
+  }
+}
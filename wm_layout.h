@@ -0,0 +1,422 @@
+#ifndef WM_LAYOUT_H
+#define WM_LAYOUT_H
+
+#include <stdint.h>
+
+/*
+ * Report layouts as explicit field tables instead of compiler bitfields, so
+ * the wire format doesn't depend on the compiler's bit order or endianness.
+ *
+ * A report carries a few values (an accelerometer axis, a stick, the button
+ * mask, ...). Each value is stored in one or more fields, a field being a
+ * run of bits inside a single payload byte holding bits value_shift and up
+ * of the value. Every layout is one list below:
+ *
+ *   V(report, value)
+ *   F(report, value, value_shift, byte, shift, width, invert)
+ *
+ * listed in WM_LAYOUTS at the bottom. Byte offsets are relative to the
+ * buffer the layout is packed into (see the notes per layout).
+ */
+
+struct wm_field
+{
+  uint8_t value;       //index into the values array
+  uint8_t value_shift; //lowest value bit stored in this field
+  uint8_t byte;
+  uint8_t shift;       //lowest bit of the field within the byte
+  uint8_t width;       //1 to 8, never crossing a byte
+  uint8_t invert;      //1 for active low bits
+};
+
+struct wm_layout
+{
+  const char * name;
+  const struct wm_field * fields;
+  int field_count;
+  const char * const * value_names;
+  int value_count;
+};
+
+/* Output reports (from controller), offsets into the report payload */
+
+//core buttons, also at the start of most other reports
+#define WM_BUTTONS_LAYOUT(V, F) \
+  V(BUTTONS, BUTTONS) \
+  F(BUTTONS, BUTTONS, 0, 0, 0, 5, 0) \
+  F(BUTTONS, BUTTONS, 8, 1, 0, 5, 0) \
+  F(BUTTONS, BUTTONS, 15, 1, 7, 1, 0)
+
+//10 bit axes, the LSBs share the button bytes
+#define WM_ACCELEROMETER_LAYOUT(V, F) \
+  V(ACCELEROMETER, X) \
+  V(ACCELEROMETER, Y) \
+  V(ACCELEROMETER, Z) \
+  F(ACCELEROMETER, X, 0, 0, 5, 2, 0) \
+  F(ACCELEROMETER, Y, 1, 1, 5, 1, 0) \
+  F(ACCELEROMETER, Z, 1, 1, 6, 1, 0) \
+  F(ACCELEROMETER, X, 2, 2, 0, 8, 0) \
+  F(ACCELEROMETER, Y, 2, 3, 0, 8, 0) \
+  F(ACCELEROMETER, Z, 2, 4, 0, 8, 0)
+
+//basic ir, 10 bytes for four objects, offsets into the ir bytes
+#define WM_IR_BASIC_LAYOUT(V, F) \
+  V(IR_BASIC, X1) \
+  V(IR_BASIC, Y1) \
+  V(IR_BASIC, X2) \
+  V(IR_BASIC, Y2) \
+  V(IR_BASIC, X3) \
+  V(IR_BASIC, Y3) \
+  V(IR_BASIC, X4) \
+  V(IR_BASIC, Y4) \
+  F(IR_BASIC, X1, 0, 0, 0, 8, 0) \
+  F(IR_BASIC, Y1, 0, 1, 0, 8, 0) \
+  F(IR_BASIC, X2, 8, 2, 0, 2, 0) \
+  F(IR_BASIC, Y2, 8, 2, 2, 2, 0) \
+  F(IR_BASIC, X1, 8, 2, 4, 2, 0) \
+  F(IR_BASIC, Y1, 8, 2, 6, 2, 0) \
+  F(IR_BASIC, X2, 0, 3, 0, 8, 0) \
+  F(IR_BASIC, Y2, 0, 4, 0, 8, 0) \
+  F(IR_BASIC, X3, 0, 5, 0, 8, 0) \
+  F(IR_BASIC, Y3, 0, 6, 0, 8, 0) \
+  F(IR_BASIC, X4, 8, 7, 0, 2, 0) \
+  F(IR_BASIC, Y4, 8, 7, 2, 2, 0) \
+  F(IR_BASIC, X3, 8, 7, 4, 2, 0) \
+  F(IR_BASIC, Y3, 8, 7, 6, 2, 0) \
+  F(IR_BASIC, X4, 0, 8, 0, 8, 0) \
+  F(IR_BASIC, Y4, 0, 9, 0, 8, 0)
+
+//extended ir, one 3 byte object
+#define WM_IR_EXTENDED_LAYOUT(V, F) \
+  V(IR_EXTENDED, X) \
+  V(IR_EXTENDED, Y) \
+  V(IR_EXTENDED, SIZE) \
+  F(IR_EXTENDED, X, 0, 0, 0, 8, 0) \
+  F(IR_EXTENDED, Y, 0, 1, 0, 8, 0) \
+  F(IR_EXTENDED, SIZE, 0, 2, 0, 4, 0) \
+  F(IR_EXTENDED, X, 8, 2, 4, 2, 0) \
+  F(IR_EXTENDED, Y, 8, 2, 6, 2, 0)
+
+//full ir, one 9 byte object
+#define WM_IR_FULL_LAYOUT(V, F) \
+  V(IR_FULL, X) \
+  V(IR_FULL, Y) \
+  V(IR_FULL, SIZE) \
+  V(IR_FULL, X_MIN) \
+  V(IR_FULL, Y_MIN) \
+  V(IR_FULL, X_MAX) \
+  V(IR_FULL, Y_MAX) \
+  V(IR_FULL, INTENSITY) \
+  F(IR_FULL, X, 0, 0, 0, 8, 0) \
+  F(IR_FULL, Y, 0, 1, 0, 8, 0) \
+  F(IR_FULL, SIZE, 0, 2, 0, 4, 0) \
+  F(IR_FULL, X, 8, 2, 4, 2, 0) \
+  F(IR_FULL, Y, 8, 2, 6, 2, 0) \
+  F(IR_FULL, X_MIN, 0, 3, 0, 7, 0) \
+  F(IR_FULL, Y_MIN, 0, 4, 0, 7, 0) \
+  F(IR_FULL, X_MAX, 0, 5, 0, 7, 0) \
+  F(IR_FULL, Y_MAX, 0, 6, 0, 7, 0) \
+  F(IR_FULL, INTENSITY, 0, 8, 0, 8, 0)
+
+//accelerometer part of an interleaved 0x3e/0x3f report, each half carries
+//4 bits of z in the button bytes and one more axis
+#define WM_INTERLEAVED_LAYOUT(V, F) \
+  V(INTERLEAVED, Z) \
+  V(INTERLEAVED, ACCEL) \
+  F(INTERLEAVED, Z, 0, 0, 5, 2, 0) \
+  F(INTERLEAVED, Z, 2, 1, 5, 2, 0) \
+  F(INTERLEAVED, ACCEL, 2, 2, 0, 8, 0)
+
+#define WM_STATUS_LAYOUT(V, F) \
+  V(STATUS, LOW_BATTERY) \
+  V(STATUS, EXTENSION_CONNECTED) \
+  V(STATUS, SPEAKER_ENABLED) \
+  V(STATUS, IRCAM_ENABLED) \
+  V(STATUS, LED_1) \
+  V(STATUS, LED_2) \
+  V(STATUS, LED_3) \
+  V(STATUS, LED_4) \
+  V(STATUS, BATTERY_LEVEL) \
+  F(STATUS, LOW_BATTERY, 0, 2, 0, 1, 0) \
+  F(STATUS, EXTENSION_CONNECTED, 0, 2, 1, 1, 0) \
+  F(STATUS, SPEAKER_ENABLED, 0, 2, 2, 1, 0) \
+  F(STATUS, IRCAM_ENABLED, 0, 2, 3, 1, 0) \
+  F(STATUS, LED_1, 0, 2, 4, 1, 0) \
+  F(STATUS, LED_2, 0, 2, 5, 1, 0) \
+  F(STATUS, LED_3, 0, 2, 6, 1, 0) \
+  F(STATUS, LED_4, 0, 2, 7, 1, 0) \
+  F(STATUS, BATTERY_LEVEL, 0, 5, 0, 8, 0)
+
+//data follows at WM_MEM_RESP_DATA, address is big endian
+#define WM_MEM_RESP_LAYOUT(V, F) \
+  V(MEM_RESP, ERROR) \
+  V(MEM_RESP, SIZE) \
+  V(MEM_RESP, ADDR) \
+  F(MEM_RESP, ERROR, 0, 2, 0, 4, 0) \
+  F(MEM_RESP, SIZE, 0, 2, 4, 4, 0) \
+  F(MEM_RESP, ADDR, 8, 3, 0, 8, 0) \
+  F(MEM_RESP, ADDR, 0, 4, 0, 8, 0)
+
+#define WM_MEM_RESP_DATA 5
+
+#define WM_ACK_LAYOUT(V, F) \
+  V(ACK, REPORT) \
+  V(ACK, RESULT) \
+  F(ACK, REPORT, 0, 2, 0, 8, 0) \
+  F(ACK, RESULT, 0, 3, 0, 8, 0)
+
+/* Extension data, offsets into the extension bytes */
+
+#define WM_NUNCHUK_LAYOUT(V, F) \
+  V(NUNCHUK, X) \
+  V(NUNCHUK, Y) \
+  V(NUNCHUK, ACCEL_X) \
+  V(NUNCHUK, ACCEL_Y) \
+  V(NUNCHUK, ACCEL_Z) \
+  V(NUNCHUK, Z) \
+  V(NUNCHUK, C) \
+  F(NUNCHUK, X, 0, 0, 0, 8, 0) \
+  F(NUNCHUK, Y, 0, 1, 0, 8, 0) \
+  F(NUNCHUK, ACCEL_X, 2, 2, 0, 8, 0) \
+  F(NUNCHUK, ACCEL_Y, 2, 3, 0, 8, 0) \
+  F(NUNCHUK, ACCEL_Z, 2, 4, 0, 8, 0) \
+  F(NUNCHUK, Z, 0, 5, 0, 1, 1) \
+  F(NUNCHUK, C, 0, 5, 1, 1, 1) \
+  F(NUNCHUK, ACCEL_X, 0, 5, 2, 2, 0) \
+  F(NUNCHUK, ACCEL_Y, 0, 5, 4, 2, 0) \
+  F(NUNCHUK, ACCEL_Z, 0, 5, 6, 2, 0)
+
+//nunchuk interleaved with motionplus data (passthrough mode)
+#define WM_NUNCHUK_PT_LAYOUT(V, F) \
+  V(NUNCHUK_PT, X) \
+  V(NUNCHUK_PT, Y) \
+  V(NUNCHUK_PT, ACCEL_X) \
+  V(NUNCHUK_PT, ACCEL_Y) \
+  V(NUNCHUK_PT, ACCEL_Z) \
+  V(NUNCHUK_PT, Z) \
+  V(NUNCHUK_PT, C) \
+  V(NUNCHUK_PT, EXT) \
+  F(NUNCHUK_PT, X, 0, 0, 0, 8, 0) \
+  F(NUNCHUK_PT, Y, 0, 1, 0, 8, 0) \
+  F(NUNCHUK_PT, ACCEL_X, 2, 2, 0, 8, 0) \
+  F(NUNCHUK_PT, ACCEL_Y, 2, 3, 0, 8, 0) \
+  F(NUNCHUK_PT, ACCEL_Z, 3, 4, 0, 7, 0) \
+  F(NUNCHUK_PT, EXT, 0, 4, 7, 1, 0) \
+  F(NUNCHUK_PT, Z, 0, 5, 2, 1, 1) \
+  F(NUNCHUK_PT, C, 0, 5, 3, 1, 1) \
+  F(NUNCHUK_PT, ACCEL_X, 1, 5, 4, 1, 0) \
+  F(NUNCHUK_PT, ACCEL_Y, 1, 5, 5, 1, 0) \
+  F(NUNCHUK_PT, ACCEL_Z, 1, 5, 6, 2, 0)
+
+//buttons are already active low in wire order (CLASSIC_BUTTON_*)
+#define WM_CLASSIC_LAYOUT(V, F) \
+  V(CLASSIC, LX) \
+  V(CLASSIC, LY) \
+  V(CLASSIC, RX) \
+  V(CLASSIC, RY) \
+  V(CLASSIC, LT) \
+  V(CLASSIC, RT) \
+  V(CLASSIC, BUTTONS) \
+  F(CLASSIC, LX, 0, 0, 0, 6, 0) \
+  F(CLASSIC, RX, 3, 0, 6, 2, 0) \
+  F(CLASSIC, LY, 0, 1, 0, 6, 0) \
+  F(CLASSIC, RX, 1, 1, 6, 2, 0) \
+  F(CLASSIC, RY, 0, 2, 0, 5, 0) \
+  F(CLASSIC, LT, 3, 2, 5, 2, 0) \
+  F(CLASSIC, RX, 0, 2, 7, 1, 0) \
+  F(CLASSIC, RT, 0, 3, 0, 5, 0) \
+  F(CLASSIC, LT, 0, 3, 5, 3, 0) \
+  F(CLASSIC, BUTTONS, 0, 4, 0, 8, 0) \
+  F(CLASSIC, BUTTONS, 8, 5, 0, 8, 0)
+
+//classic controller in passthrough mode, up and left move to the stick
+//bytes and the sticks lose their LSB
+#define WM_CLASSIC_PT_LAYOUT(V, F) \
+  V(CLASSIC_PT, LX) \
+  V(CLASSIC_PT, LY) \
+  V(CLASSIC_PT, RX) \
+  V(CLASSIC_PT, RY) \
+  V(CLASSIC_PT, LT) \
+  V(CLASSIC_PT, RT) \
+  V(CLASSIC_PT, BUTTONS) \
+  V(CLASSIC_PT, EXT) \
+  F(CLASSIC_PT, BUTTONS, 8, 0, 0, 1, 0) \
+  F(CLASSIC_PT, LX, 1, 0, 1, 5, 0) \
+  F(CLASSIC_PT, RX, 3, 0, 6, 2, 0) \
+  F(CLASSIC_PT, BUTTONS, 9, 1, 0, 1, 0) \
+  F(CLASSIC_PT, LY, 1, 1, 1, 5, 0) \
+  F(CLASSIC_PT, RX, 1, 1, 6, 2, 0) \
+  F(CLASSIC_PT, RY, 0, 2, 0, 5, 0) \
+  F(CLASSIC_PT, LT, 3, 2, 5, 2, 0) \
+  F(CLASSIC_PT, RX, 0, 2, 7, 1, 0) \
+  F(CLASSIC_PT, LT, 0, 3, 0, 3, 0) \
+  F(CLASSIC_PT, RT, 0, 3, 3, 5, 0) \
+  F(CLASSIC_PT, EXT, 0, 4, 0, 1, 0) \
+  F(CLASSIC_PT, BUTTONS, 1, 4, 1, 7, 0) \
+  F(CLASSIC_PT, BUTTONS, 10, 5, 2, 6, 0)
+
+//DATA is always set, it tells motionplus and passthrough data apart
+#define WM_MOTIONPLUS_LAYOUT(V, F) \
+  V(MOTIONPLUS, YAW) \
+  V(MOTIONPLUS, ROLL) \
+  V(MOTIONPLUS, PITCH) \
+  V(MOTIONPLUS, YAW_SLOW) \
+  V(MOTIONPLUS, ROLL_SLOW) \
+  V(MOTIONPLUS, PITCH_SLOW) \
+  V(MOTIONPLUS, EXT) \
+  V(MOTIONPLUS, DATA) \
+  F(MOTIONPLUS, YAW, 0, 0, 0, 8, 0) \
+  F(MOTIONPLUS, ROLL, 0, 1, 0, 8, 0) \
+  F(MOTIONPLUS, PITCH, 0, 2, 0, 8, 0) \
+  F(MOTIONPLUS, PITCH_SLOW, 0, 3, 0, 1, 0) \
+  F(MOTIONPLUS, YAW_SLOW, 0, 3, 1, 1, 0) \
+  F(MOTIONPLUS, YAW, 8, 3, 2, 6, 0) \
+  F(MOTIONPLUS, EXT, 0, 4, 0, 1, 0) \
+  F(MOTIONPLUS, ROLL_SLOW, 0, 4, 1, 1, 0) \
+  F(MOTIONPLUS, ROLL, 8, 4, 2, 6, 0) \
+  F(MOTIONPLUS, DATA, 0, 5, 1, 1, 0) \
+  F(MOTIONPLUS, PITCH, 8, 5, 2, 6, 0)
+
+/* Input reports (from wii), offsets into the report payload */
+
+#define WM_RUMBLE_LAYOUT(V, F) \
+  V(RUMBLE, RUMBLE) \
+  F(RUMBLE, RUMBLE, 0, 0, 0, 1, 0)
+
+#define WM_LEDS_LAYOUT(V, F) \
+  V(LEDS, RUMBLE) \
+  V(LEDS, LED_1) \
+  V(LEDS, LED_2) \
+  V(LEDS, LED_3) \
+  V(LEDS, LED_4) \
+  F(LEDS, RUMBLE, 0, 0, 0, 1, 0) \
+  F(LEDS, LED_1, 0, 0, 4, 1, 0) \
+  F(LEDS, LED_2, 0, 0, 5, 1, 0) \
+  F(LEDS, LED_3, 0, 0, 6, 1, 0) \
+  F(LEDS, LED_4, 0, 0, 7, 1, 0)
+
+#define WM_MODE_LAYOUT(V, F) \
+  V(MODE, RUMBLE) \
+  V(MODE, CONTINUOUS) \
+  V(MODE, MODE) \
+  F(MODE, RUMBLE, 0, 0, 0, 1, 0) \
+  F(MODE, CONTINUOUS, 0, 0, 2, 1, 0) \
+  F(MODE, MODE, 0, 1, 0, 8, 0)
+
+//ir camera enable (0x13, 0x1a)
+#define WM_IR_ENABLE_LAYOUT(V, F) \
+  V(IR_ENABLE, RUMBLE) \
+  V(IR_ENABLE, ACK_REQUESTED) \
+  V(IR_ENABLE, ENABLED) \
+  F(IR_ENABLE, RUMBLE, 0, 0, 0, 1, 0) \
+  F(IR_ENABLE, ACK_REQUESTED, 0, 0, 1, 1, 0) \
+  F(IR_ENABLE, ENABLED, 0, 0, 2, 1, 0)
+
+//speaker enable (0x14) and mute (0x19)
+#define WM_SPEAKER_ENABLE_LAYOUT(V, F) \
+  V(SPEAKER_ENABLE, RUMBLE) \
+  V(SPEAKER_ENABLE, MUTED) \
+  F(SPEAKER_ENABLE, RUMBLE, 0, 0, 0, 1, 0) \
+  F(SPEAKER_ENABLE, MUTED, 0, 0, 2, 1, 0)
+
+//SOURCE is 0 for eeprom, offset and size are big endian
+#define WM_MEM_READ_LAYOUT(V, F) \
+  V(MEM_READ, RUMBLE) \
+  V(MEM_READ, SOURCE) \
+  V(MEM_READ, OFFSET) \
+  V(MEM_READ, SIZE) \
+  F(MEM_READ, RUMBLE, 0, 0, 0, 1, 0) \
+  F(MEM_READ, SOURCE, 0, 0, 2, 2, 0) \
+  F(MEM_READ, OFFSET, 16, 1, 0, 8, 0) \
+  F(MEM_READ, OFFSET, 8, 2, 0, 8, 0) \
+  F(MEM_READ, OFFSET, 0, 3, 0, 8, 0) \
+  F(MEM_READ, SIZE, 8, 4, 0, 8, 0) \
+  F(MEM_READ, SIZE, 0, 5, 0, 8, 0)
+
+//data follows at WM_MEM_WRITE_DATA
+#define WM_MEM_WRITE_LAYOUT(V, F) \
+  V(MEM_WRITE, RUMBLE) \
+  V(MEM_WRITE, SOURCE) \
+  V(MEM_WRITE, OFFSET) \
+  V(MEM_WRITE, SIZE) \
+  F(MEM_WRITE, RUMBLE, 0, 0, 0, 1, 0) \
+  F(MEM_WRITE, SOURCE, 0, 0, 2, 2, 0) \
+  F(MEM_WRITE, OFFSET, 16, 1, 0, 8, 0) \
+  F(MEM_WRITE, OFFSET, 8, 2, 0, 8, 0) \
+  F(MEM_WRITE, OFFSET, 0, 3, 0, 8, 0) \
+  F(MEM_WRITE, SIZE, 0, 4, 0, 8, 0)
+
+#define WM_MEM_WRITE_DATA 5
+
+//every layout, X(report, name)
+#define WM_LAYOUTS(X) \
+  X(BUTTONS, buttons) \
+  X(ACCELEROMETER, accelerometer) \
+  X(IR_BASIC, ir_basic) \
+  X(IR_EXTENDED, ir_extended) \
+  X(IR_FULL, ir_full) \
+  X(INTERLEAVED, interleaved) \
+  X(STATUS, status) \
+  X(MEM_RESP, mem_resp) \
+  X(ACK, ack) \
+  X(NUNCHUK, nunchuk) \
+  X(NUNCHUK_PT, nunchuk_pt) \
+  X(CLASSIC, classic) \
+  X(CLASSIC_PT, classic_pt) \
+  X(MOTIONPLUS, motionplus) \
+  X(RUMBLE, rumble) \
+  X(LEDS, leds) \
+  X(MODE, mode) \
+  X(IR_ENABLE, ir_enable) \
+  X(SPEAKER_ENABLE, speaker_enable) \
+  X(MEM_READ, mem_read) \
+  X(MEM_WRITE, mem_write)
+
+#define WM_LAYOUT_IGNORE(...)
+#define WM_LAYOUT_ENUM(report, value) WM_##report##_##value,
+
+#define WM_FIELD_MASK(width) ((1u << (width)) - 1)
+#define WM_LAYOUT_PACK_FIELD(report, value, value_shift, byte, shift, width, invert) \
+  buf[byte] = (buf[byte] & ~(WM_FIELD_MASK(width) << (shift))) | \
+    ((((values[WM_##report##_##value] >> (value_shift)) ^ -(uint32_t)(invert)) & WM_FIELD_MASK(width)) << (shift));
+#define WM_LAYOUT_CLEAR_VALUE(report, value) values[WM_##report##_##value] = 0;
+#define WM_LAYOUT_UNPACK_FIELD(report, value, value_shift, byte, shift, width, invert) \
+  values[WM_##report##_##value] |= \
+    (((buf[byte] >> (shift)) ^ -(uint32_t)(invert)) & WM_FIELD_MASK(width)) << (value_shift);
+
+/*
+ * Per layout: the WM_<report>_* value indices, the wm_layout_<name> table
+ * and wm_pack_<name>/wm_unpack_<name>, the same layout expanded into
+ * straight-line code with every shift and mask a constant. The encoders use
+ * those, the tables are for code that walks any layout (printing, tests).
+ */
+#define WM_LAYOUT_DECLARE(report, name) \
+  enum { WM_##report##_LAYOUT(WM_LAYOUT_ENUM, WM_LAYOUT_IGNORE) WM_##report##_VALUES }; \
+  extern const struct wm_layout wm_layout_##name; \
+  static inline void wm_pack_##name(uint8_t * buf, const uint32_t * values) \
+  { \
+    WM_##report##_LAYOUT(WM_LAYOUT_IGNORE, WM_LAYOUT_PACK_FIELD) \
+  } \
+  static inline void wm_unpack_##name(const uint8_t * buf, uint32_t * values) \
+  { \
+    WM_##report##_LAYOUT(WM_LAYOUT_CLEAR_VALUE, WM_LAYOUT_IGNORE) \
+    WM_##report##_LAYOUT(WM_LAYOUT_IGNORE, WM_LAYOUT_UNPACK_FIELD) \
+  }
+
+WM_LAYOUTS(WM_LAYOUT_DECLARE)
+
+//the most values any layout has, enough for a values array of any of them
+#define WM_LAYOUT_MAX_VALUES 9
+
+extern const struct wm_layout * const wm_layouts[];
+extern const int wm_layout_count;
+
+// Table driven versions of the above for any layout. wm_pack stores
+// values[] into buf, leaving bits outside the layout's fields alone, value
+// bits above a field's width are dropped.
+void wm_pack(const struct wm_layout * layout, uint8_t * buf, const uint32_t * values);
+
+// Reads every value of the layout from buf into values[]
+void wm_unpack(const struct wm_layout * layout, const uint8_t * buf, uint32_t * values);
+
+#endif
@@ -1,23 +1,41 @@
 #include "wm_print.h"
 #include "wm_reports.h" //for now
+#include "wm_layout.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/time.h>
 
-int show_reports = 0;
-int reports_truncated = 0;
+void print_init(struct print_state * print)
+{
+  print->show_reports = 0;
+  print->reports_truncated = 0;
+  print->verbose_reports = 0;
+
+  print->next_report_ts = 0;
+  print->report_timeout_us = 500000;
+}
 
-uint64_t next_report_ts = 0;
-uint64_t report_timeout_us = 500000;
+//prints every value of a layout as NAME=value
+static void print_values(const struct wm_layout * layout, const uint8_t * buf)
+{
+  uint32_t values[WM_LAYOUT_MAX_VALUES];
+  int i;
 
-int verbose_reports = 0;
+  wm_unpack(layout, buf, values);
+
+  for (i = 0; i < layout->value_count; i++)
+  {
+    printf(" %s=%u", layout->value_names[i], values[i]);
+  }
+}
 
-void print_report(const uint8_t * buf, int len)
+void print_report(struct print_state * print, const uint8_t * buf, int len)
 {
   struct timeval tv;
   int i;
   struct report_data * data = (struct report_data *)buf;
+  uint32_t values[WM_LAYOUT_MAX_VALUES];
   uint64_t ts;
 
   if (len == 0) return;
@@ -34,43 +52,43 @@ void print_report(const uint8_t * buf, int len)
     {
       case 0x10:
       {
-        struct report_rumble * rpt = (struct report_rumble *)data->buf;
+        wm_unpack_rumble(data->buf, values);
 
-        printf("(set rumble %u)", rpt->rumble & 1);
+        printf("(set rumble %u)", values[WM_RUMBLE_RUMBLE]);
         break;
       }
       case 0x12: //data reporting mode
       {
-        struct report_mode * rpt = (struct report_mode *)data->buf;
+        wm_unpack_mode(data->buf, values);
 
-        printf("(set reporting mode %02x, cont: %u)", rpt->mode, rpt->continuous & 1);
+        printf("(set reporting mode %02x, cont: %u)", values[WM_MODE_MODE], values[WM_MODE_CONTINUOUS]);
 
         break;
       }
       case 0x11: //player LEDs
       {
-        struct report_leds * rpt = (struct report_leds *)data->buf;
+        wm_unpack_leds(data->buf, values);
 
-        printf("(set player leds %u %u %u %u)", rpt->led_1 & 1, rpt->led_2 & 1,
-          rpt->led_3 & 1, rpt->led_4 & 1);
+        printf("(set player leds %u %u %u %u)", values[WM_LEDS_LED_1], values[WM_LEDS_LED_2],
+          values[WM_LEDS_LED_3], values[WM_LEDS_LED_4]);
         break;
       }
       case 0x13:
       case 0x1a: //ir camera enable
       {
-        struct report_ir_enable * rpt = (struct report_ir_enable *)data->buf;
+        wm_unpack_ir_enable(data->buf, values);
 
         printf("%02x %02x ", buf[2], buf[3]);
-        printf("(set ir cam enable %u)", rpt->enabled & 1);
+        printf("(set ir cam enable %u)", values[WM_IR_ENABLE_ENABLED]);
 
         break;
       }
       case 0x14:
       case 0x19: //speaker enable
       {
-        struct report_speaker_enable * rpt = (struct report_speaker_enable *)data->buf;
+        wm_unpack_speaker_enable(data->buf, values);
 
-        printf("(set speaker enable %u)", !rpt->muted & 1);
+        printf("(set speaker enable %u)", !values[WM_SPEAKER_ENABLE_MUTED]);
 
         break;
       }
@@ -80,14 +98,14 @@ void print_report(const uint8_t * buf, int len)
         break;
       case 0x16: //write memory
       {
-        struct report_mem_write * rpt = (struct report_mem_write *)data->buf;
+        wm_unpack_mem_write(data->buf, values);
 
         printf("\x1B[35m%02x \x1B[32m%02x %02x %02x \x1B[36m%02x\033[0m ", buf[2], buf[3], buf[4], buf[5], buf[6]);
         for (i = 7; i < len; i++) printf("%02x ", buf[i]);
 
-        if (rpt->source0 || rpt->source1)
+        if (values[WM_MEM_WRITE_SOURCE])
         {
-          switch (rpt->offset & 0xfe)
+          switch ((values[WM_MEM_WRITE_OFFSET] >> 16) & 0xfe)
           {
             case 0xa2: printf("(write speaker register a2)"); break;
             case 0xa4: printf("(write ext register a4)"); break;
@@ -103,13 +121,13 @@ void print_report(const uint8_t * buf, int len)
       }
       case 0x17: //read memory
       {
-        struct report_mem_read * rpt = (struct report_mem_read *)data->buf;
+        wm_unpack_mem_read(data->buf, values);
 
         printf("\x1B[35m%02x \x1B[32m%02x %02x %02x \x1B[36m%02x %02x\033[0m ", buf[2], buf[3], buf[4], buf[5], buf[6], buf[7]);
 
-        if (rpt->source0 || rpt->source1)
+        if (values[WM_MEM_READ_SOURCE])
         {
-          switch (rpt->offset & 0xfe)
+          switch ((values[WM_MEM_READ_OFFSET] >> 16) & 0xfe)
           {
             case 0xa2: printf("(read speaker register a2)"); break;
             case 0xa4: printf("(read ext register a4)"); break;
@@ -136,9 +154,9 @@ void print_report(const uint8_t * buf, int len)
   }
   else
   {
-    if (buf[1] < 0x30 || show_reports)
+    if (buf[1] < 0x30 || print->show_reports)
     {
-      if (ts >= next_report_ts)
+      if (ts >= print->next_report_ts)
       {
         printf("\e[2;37m%ld.%06ld \e[1;34mWiimote:\e[0m ", tv.tv_sec, tv.tv_usec);
         printf("\e[33m%02x\e[0m \e[0;34m%02x %02x\e[0m ", buf[1], buf[2], buf[3]);
@@ -174,51 +192,37 @@ void print_report(const uint8_t * buf, int len)
 
         printf("\e[0m\n");
 
-        if (verbose_reports)
+        if (print->verbose_reports && len >= 2 + 5)
         {
-          struct report_accelerometer * report_accel = (struct report_accelerometer *)(buf + 2);
-          printf("  accel %02x %02x, %02x %02x, %02x %02x\n",
-            report_accel->x, report_accel->buttons.accel_0 & 0x3,
-            report_accel->y, (report_accel->buttons.accel_1 & 0x1) << 1,
-            report_accel->z, (report_accel->buttons.accel_1 & 0x2));
+          printf("  accel");
+          print_values(&wm_layout_accelerometer, buf + 2);
+          printf("\n");
 
           if (buf[1] == 0x33)
           {
-            struct report_ir_ext * report_ir = (struct report_ir_ext *)(buf + 2 + 5);
-            for (int i = 0; i < 4; i++)
+            for (i = 0; i < 4; i++)
             {
-              printf("  object %d: %d, %d [%d]\n", i,
-                (((unsigned int)report_ir->obj[i].x_hi & 0x3) << 8 | report_ir->obj[i].x_lo),
-                (((unsigned int)report_ir->obj[i].y_hi & 0x3) << 8 | report_ir->obj[i].y_lo),
-                report_ir->obj[i].size);
+              printf("  object %d:", i);
+              print_values(&wm_layout_ir_extended, buf + 2 + 5 + 3 * i);
+              printf("\n");
             }
           }
 
           if (buf[1] == 0x37)
           {
-            struct report_ir_basic * report_ir = (struct report_ir_basic *)(buf + 2 + 5);
-            printf("  object %d: %d, %d\n", 0,
-              (((unsigned int)report_ir->x1_hi & 0x3) << 8 | report_ir->x1_lo),
-              (((unsigned int)report_ir->y1_hi & 0x3) << 8 | report_ir->y1_lo));
-            printf("  object %d: %d, %d\n", 1,
-              (((unsigned int)report_ir->x2_hi & 0x3) << 8 | report_ir->x2_lo),
-              (((unsigned int)report_ir->y2_hi & 0x3) << 8 | report_ir->y2_lo));
-            printf("  object %d: %d, %d\n", 2,
-              (((unsigned int)report_ir->x3_hi & 0x3) << 8 | report_ir->x3_lo),
-              (((unsigned int)report_ir->y3_hi & 0x3) << 8 | report_ir->y3_lo));
-            printf("  object %d: %d, %d\n", 3,
-              (((unsigned int)report_ir->x4_hi & 0x3) << 8 | report_ir->x4_lo),
-              (((unsigned int)report_ir->y4_hi & 0x3) << 8 | report_ir->y4_lo));
+            printf("  ir");
+            print_values(&wm_layout_ir_basic, buf + 2 + 5);
+            printf("\n");
           }
         }
 
-        reports_truncated = 0;
-        next_report_ts = ts + report_timeout_us;
+        print->reports_truncated = 0;
+        print->next_report_ts = ts + print->report_timeout_us;
       }
     }
     else
     {
-      if (!reports_truncated)
+      if (!print->reports_truncated)
       {
         printf("                           \x1B[2;37mReporting 0x%x ", buf[1]);
         switch (buf[1])
@@ -258,7 +262,7 @@ void print_report(const uint8_t * buf, int len)
             break;
         }
         printf("\e[0m\n");
-        reports_truncated = 1;
+        print->reports_truncated = 1;
       }
     }
   }
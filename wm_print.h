@@ -3,9 +3,17 @@
 
 #include <stdint.h>
 
-extern int show_reports;
-extern int reports_truncated;
+struct print_state
+{
+  int show_reports;
+  int reports_truncated;
+  int verbose_reports;
 
-void print_report(const uint8_t * buf, int len);
+  uint64_t next_report_ts;
+  uint64_t report_timeout_us;
+};
+
+void print_init(struct print_state * print);
+void print_report(struct print_state * print, const uint8_t * buf, int len);
 
 #endif
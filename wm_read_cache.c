@@ -0,0 +1,229 @@
+#include "wm_read_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CACHED_SIZE (WM_READ_CACHE_MAX_REPORTS * 0x10)
+
+void wm_read_cache_init(struct wm_read_cache * cache)
+{
+  memset(cache, 0, sizeof(struct wm_read_cache));
+}
+
+int wm_read_region(uint8_t source, uint32_t offset)
+{
+  if (!source)
+  {
+    return WM_READ_EEPROM;
+  }
+
+  switch ((offset >> 16) & 0xfe)
+  {
+    case 0xa2:
+      return WM_READ_SPEAKER;
+    case 0xa4:
+    case 0xa6:
+      return WM_READ_EXTENSION;
+    case 0xb0:
+      return WM_READ_IRCAM;
+    default:
+      return -1;
+  }
+}
+
+static struct wm_read_cache_entry * find_entry(struct wm_read_cache * cache,
+  uint8_t source, uint32_t offset, uint16_t size)
+{
+  int i;
+
+  for (i = 0; i < cache->entry_count; i++)
+  {
+    struct wm_read_cache_entry * entry = &cache->entries[i];
+
+    if (entry->offset == offset && entry->size == size && entry->source == source)
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+//keeps count reports starting at first in the entry
+static void store_reports(struct wm_read_cache * cache, struct wm_read_cache_entry * entry,
+  const struct queued_report * first)
+{
+  int count = 0;
+
+  for (; first != NULL && count < WM_READ_CACHE_MAX_REPORTS; first = first->next)
+  {
+    entry->reports[count++] = first->rpt;
+  }
+
+  entry->count = count;
+  entry->generation = cache->generation[entry->region];
+}
+
+int wm_read_cache_serve(struct wiimote_state * state, uint8_t source, uint32_t offset, uint16_t size)
+{
+  struct wm_read_cache * cache = state->sys.read_cache;
+  struct wm_read_cache_entry * entry;
+  int i;
+
+  if (cache == NULL)
+  {
+    return 0;
+  }
+
+  entry = find_entry(cache, source, offset, size);
+  if (entry == NULL || entry->count == 0 || entry->generation != cache->generation[entry->region])
+  {
+    return 0;
+  }
+
+  for (i = 0; i < entry->count; i++)
+  {
+    *report_queue_push(state) = entry->reports[i];
+  }
+
+  entry->hits++;
+  cache->served++;
+  return 1;
+}
+
+void wm_read_cache_learn(struct wiimote_state * state, uint8_t source, uint32_t offset,
+  uint16_t size, const struct queued_report * first)
+{
+  struct wm_read_cache * cache = state->sys.read_cache;
+  struct wm_read_cache_entry * entry;
+  int region, i;
+
+  region = wm_read_region(source, offset);
+  if (cache == NULL || region < 0 || size == 0 || size > MAX_CACHED_SIZE)
+  {
+    return;
+  }
+
+  entry = find_entry(cache, source, offset, size);
+  if (entry == NULL)
+  {
+    if (cache->entry_count < WM_READ_CACHE_ENTRIES)
+    {
+      entry = &cache->entries[cache->entry_count++];
+    }
+    else
+    {
+      //replace the read seen least
+      entry = &cache->entries[0];
+      for (i = 1; i < WM_READ_CACHE_ENTRIES; i++)
+      {
+        if (cache->entries[i].hits < entry->hits)
+        {
+          entry = &cache->entries[i];
+        }
+      }
+    }
+
+    memset(entry, 0, sizeof(struct wm_read_cache_entry));
+    entry->source = source;
+    entry->region = region;
+    entry->offset = offset;
+    entry->size = size;
+  }
+
+  entry->hits++;
+  if (entry->hits >= WM_READ_CACHE_LEARN_HITS)
+  {
+    store_reports(cache, entry, first);
+  }
+}
+
+void wm_read_cache_invalidate(struct wiimote_state * state, enum wm_read_region region)
+{
+  struct wm_read_cache * cache = state->sys.read_cache;
+  int i;
+
+  if (cache == NULL)
+  {
+    return;
+  }
+
+  cache->generation[region]++;
+
+  for (i = 0; i < cache->entry_count; i++)
+  {
+    if (cache->entries[i].region == region && cache->entries[i].hits >= WM_READ_CACHE_LEARN_HITS)
+    {
+      state->sys.read_cache_stale = 1;
+      return;
+    }
+  }
+}
+
+//drops the reports queued after tail
+static void truncate_queue(struct wiimote_state * state, struct queued_report * tail)
+{
+  struct queued_report * rpt = (tail != NULL) ? tail->next : state->sys.queue;
+
+  while (rpt != NULL)
+  {
+    struct queued_report * next = rpt->next;
+    free(rpt);
+    rpt = next;
+  }
+
+  if (tail != NULL)
+  {
+    tail->next = NULL;
+  }
+  else
+  {
+    state->sys.queue = NULL;
+  }
+  state->sys.queue_end = tail;
+}
+
+int wm_read_cache_prepare(struct wiimote_state * state)
+{
+  struct wm_read_cache * cache = state->sys.read_cache;
+  struct wm_read_cache_entry * entry;
+  struct queued_report * tail;
+  int i, prepared = 0;
+
+  state->sys.read_cache_stale = 0;
+
+  if (cache == NULL)
+  {
+    return 0;
+  }
+
+  for (i = 0; i < cache->entry_count; i++)
+  {
+    entry = &cache->entries[i];
+
+    if (entry->hits < WM_READ_CACHE_LEARN_HITS ||
+      entry->generation == cache->generation[entry->region])
+    {
+      continue;
+    }
+
+    //the normal read path, with its responses taken back off the queue
+    tail = state->sys.queue_end;
+    if (entry->source)
+    {
+      read_register(state, entry->offset, entry->size);
+    }
+    else
+    {
+      read_eeprom(state, entry->offset, entry->size);
+    }
+
+    store_reports(cache, entry, (tail != NULL) ? tail->next : state->sys.queue);
+    truncate_queue(state, tail);
+
+    prepared++;
+  }
+
+  cache->prepared += prepared;
+  return prepared;
+}
@@ -0,0 +1,83 @@
+#ifndef WM_READ_CACHE_H
+#define WM_READ_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "wiimote.h"
+#include "wm_reports.h"
+
+/*
+ * Prepared 0x21 responses for the memory reads every host repeats while
+ * connecting (extension id and calibration, motionplus registers, eeprom
+ * calibration). The cache remembers which reads it has seen, across
+ * connections as long as the caller keeps it, and once a read has come
+ * twice its responses are kept ready, encrypted if the extension is, so the
+ * next one is answered with a copy instead of a register walk or a file
+ * read.
+ *
+ * Anything that changes what a region returns (a write, the extension being
+ * set up again, a new key) makes that region's responses stale; they are
+ * rebuilt by the next generate_report that has no other reports waiting,
+ * between the host's requests. The cache is owned by the caller and optional, see
+ * wiimote_set_read_cache.
+ */
+
+#define WM_READ_CACHE_ENTRIES 16
+#define WM_READ_CACHE_MAX_REPORTS 4 //reads up to 64 bytes
+#define WM_READ_CACHE_LEARN_HITS 2 //times a read is seen before it is kept
+
+enum wm_read_region
+{
+  WM_READ_EEPROM = 0,
+  WM_READ_SPEAKER, //0xa2
+  WM_READ_EXTENSION, //0xa4 and 0xa6, motionplus moves between them
+  WM_READ_IRCAM, //0xb0
+  WM_READ_REGIONS
+};
+
+struct wm_read_cache_entry
+{
+  uint8_t source; //0x17 source bits, 0 eeprom
+  uint8_t region;
+  uint16_t size;
+  uint32_t offset;
+
+  uint32_t hits;
+  uint32_t generation; //of the region when the reports were made
+  int count; //prepared reports, 0 for none
+
+  struct report reports[WM_READ_CACHE_MAX_REPORTS];
+};
+
+struct wm_read_cache
+{
+  uint32_t generation[WM_READ_REGIONS];
+
+  int entry_count;
+  struct wm_read_cache_entry entries[WM_READ_CACHE_ENTRIES];
+
+  //counters for wmbench and tests
+  uint32_t served;
+  uint32_t prepared;
+};
+
+void wm_read_cache_init(struct wm_read_cache * cache);
+
+int wm_read_region(uint8_t source, uint32_t offset);
+
+// Queues the prepared responses for a read and returns 1, or returns 0 if
+// there are none up to date
+int wm_read_cache_serve(struct wiimote_state * state, uint8_t source, uint32_t offset, uint16_t size);
+
+// Counts a read that wasn't served, first is the first of the responses it
+// queued, kept if the read has been seen often enough
+void wm_read_cache_learn(struct wiimote_state * state, uint8_t source, uint32_t offset,
+  uint16_t size, const struct queued_report * first);
+
+// Everything prepared for the region is stale
+void wm_read_cache_invalidate(struct wiimote_state * state, enum wm_read_region region);
+
+// Rebuilds the responses of every stale learned read, returns how many
+int wm_read_cache_prepare(struct wiimote_state * state);
+
+#endif /* WM_READ_CACHE_H */
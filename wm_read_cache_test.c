@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiimote.h"
+#include "wm_reports.h"
+#include "wm_read_cache.h"
+#include "wm_fixtures.h"
+#include "test.h"
+
+// Differential test for prepared read responses: several connections with
+// the same host traffic go to a state with a read cache and to one without,
+// and every report sent must be the same. Once each read has been seen
+// twice, from the third connection on, they have to come from the cache.
+
+#define SESSIONS 4
+
+//reads the fixture handshake doesn't do: eeprom calibration, motionplus
+//id and registers, ir camera, more than one response, out of range
+static const struct wm_fixture_report extra_reads[] =
+{
+  { 8, { 0xa2, 0x17, 0x00, 0x00, 0x00, 0x16, 0x00, 0x0a } },
+  { 8, { 0xa2, 0x17, 0x04, 0xa6, 0x00, 0xfa, 0x00, 0x06 } },
+  { 8, { 0xa2, 0x17, 0x04, 0xa6, 0x00, 0xf0, 0x00, 0x10 } },
+  { 8, { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0x20, 0x00, 0x20 } },
+  { 8, { 0xa2, 0x17, 0x04, 0xb0, 0x00, 0x00, 0x00, 0x09 } },
+  { 8, { 0xa2, 0x17, 0x00, 0x00, 0x16, 0xf8, 0x00, 0x10 } },
+  { 23, { 0xa2, 0x16, 0x04, 0xb0, 0x00, 0x00, 0x01, 0x07 } },
+  { 8, { 0xa2, 0x17, 0x04, 0xb0, 0x00, 0x00, 0x00, 0x09 } },
+  { 8, { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0xfa, 0x00, 0x06 } },
+};
+
+#define EXTRA_READ_COUNT (sizeof(extra_reads) / sizeof(extra_reads[0]))
+
+static void session_start(struct wiimote_state * state)
+{
+  uint8_t buf[sizeof(struct report_data)];
+  int i;
+
+  wiimote_reset(state);
+  while (state->sys.queue != NULL)
+  {
+    report_queue_pop(state);
+  }
+
+  state->usr.connected_extension_type = Nunchuk;
+  for (i = 0; i < 100 && !state->sys.extension_connected; i++)
+  {
+    generate_report(state, buf);
+  }
+}
+
+// Sends one host report to both states and compares everything they send
+// back, plus one idle report
+static void exchange(struct wiimote_state * cached, struct wiimote_state * plain,
+  const struct wm_fixture_report * rpt)
+{
+  uint8_t a[sizeof(struct report_data)], b[sizeof(struct report_data)];
+  int len_a, len_b, reports = 0;
+
+  process_report(cached, rpt->data, rpt->len);
+  process_report(plain, rpt->data, rpt->len);
+
+  do
+  {
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    len_a = generate_report(cached, a);
+    len_b = generate_report(plain, b);
+
+    if (len_a != len_b || memcmp(a, b, len_a) != 0)
+    {
+      if (failures++ < 5)
+      {
+        printf("request %02x %02x %02x %02x: response %d differs\n",
+          rpt->data[1], rpt->data[3], rpt->data[4], rpt->data[5], reports);
+      }
+    }
+    reports++;
+  } while (plain->sys.queue != NULL || cached->sys.queue != NULL);
+
+  //the host takes a report period before its next request
+  generate_report(cached, a);
+  generate_report(plain, b);
+}
+
+// Host accesses past the end of a register block are refused, and the read
+// cache, which lives after the registers, keeps working
+static void test_out_of_range(struct wiimote_state * state, struct wm_read_cache * cache)
+{
+  static const struct wm_fixture_report past_b0 =
+    { 23, { 0xa2, 0x16, 0x04, 0xb0, 0x00, 0xf0, 0x10, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
+  static const struct wm_fixture_report past_a2 =
+    { 23, { 0xa2, 0x16, 0x04, 0xa2, 0x00, 0x08, 0x04, 0x01, 0x02, 0x03, 0x04 } };
+  static const struct wm_fixture_report read_past_b0 =
+    { 8, { 0xa2, 0x17, 0x04, 0xb0, 0x00, 0x30, 0x00, 0x10 } };
+  uint8_t buf[sizeof(struct report_data)];
+  uint32_t served = cache->served;
+
+  session_start(state);
+
+  process_report(state, past_b0.data, past_b0.len);
+  CHECK(generate_report(state, buf) > 0);
+  CHECK(buf[1] == 0x22 && buf[4] == 0x16 && buf[5] == 0x08);
+
+  process_report(state, past_a2.data, past_a2.len);
+  CHECK(generate_report(state, buf) > 0);
+  CHECK(buf[1] == 0x22 && buf[4] == 0x16 && buf[5] == 0x08);
+
+  process_report(state, read_past_b0.data, read_past_b0.len);
+  CHECK(generate_report(state, buf) > 0);
+  CHECK(buf[1] == 0x21 && (buf[4] & 0x0f) == 0x08);
+  CHECK(state->sys.queue == NULL);
+
+  CHECK(state->sys.read_cache == cache);
+  process_report(state, extra_reads[0].data, extra_reads[0].len);
+  while (state->sys.queue != NULL)
+  {
+    generate_report(state, buf);
+  }
+  CHECK(cache->served == served + 1);
+}
+
+int main(int argc, char *argv[])
+{
+  struct wiimote_state cached, plain;
+  struct wm_read_cache cache;
+  uint32_t served = 0;
+  char passed[96];
+  int session, i;
+
+  wiimote_init(&cached);
+  wiimote_init(&plain);
+  wm_read_cache_init(&cache);
+  wiimote_set_read_cache(&cached, &cache);
+
+  for (session = 0; session < SESSIONS; session++)
+  {
+    session_start(&cached);
+    session_start(&plain);
+
+    for (i = 0; i < wm_fixture_host_traffic_count; i++)
+    {
+      exchange(&cached, &plain, &wm_fixture_host_traffic[i]);
+    }
+    for (i = 0; i < EXTRA_READ_COUNT; i++)
+    {
+      exchange(&cached, &plain, &extra_reads[i]);
+    }
+
+    if (session == 0)
+    {
+      //nothing has been seen twice yet, except the repeated id read
+      CHECK(cache.served <= 2);
+    }
+    else if (session == 1)
+    {
+      //reads seen once per connection are kept from their second time on
+      CHECK(cache.served - served > 2);
+    }
+    else
+    {
+      CHECK(cache.served - served >= 8);
+    }
+    served = cache.served;
+  }
+
+  CHECK(cache.prepared > 0);
+  CHECK(!cached.sys.read_cache_stale || cached.sys.queue == NULL);
+
+  test_out_of_range(&cached, &cache);
+  served = cache.served;
+
+  //a cache dropped by the caller is no longer used
+  wiimote_set_read_cache(&cached, NULL);
+  session_start(&cached);
+  session_start(&plain);
+  for (i = 0; i < EXTRA_READ_COUNT; i++)
+  {
+    exchange(&cached, &plain, &extra_reads[i]);
+  }
+  CHECK(cache.served == served);
+
+  wiimote_destroy(&cached);
+  wiimote_destroy(&plain);
+
+  snprintf(passed, sizeof(passed),
+    "prepared responses match over %d connections, %u reads served from the cache",
+    SESSIONS, cache.served);
+  return test_result(passed);
+}
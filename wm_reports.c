@@ -3,7 +3,6 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <arpa/inet.h>
 #include <sys/time.h>
 
 struct report * report_queue_push(struct wiimote_state * state)
@@ -61,9 +60,10 @@ void report_queue_push_ack(struct wiimote_state *state, uint8_t report, uint8_t
   rpt->data.io = 0xa1;
   rpt->data.type = 0x22;
 
-  struct report_ack * ack = (struct report_ack *)rpt->data.buf;
-  ack->report = report;
-  ack->result = result;
+  uint32_t values[WM_ACK_VALUES];
+  values[WM_ACK_REPORT] = report;
+  values[WM_ACK_RESULT] = result;
+  wm_pack_ack(rpt->data.buf, values);
 }
 
 void report_queue_push_status(struct wiimote_state * state)
@@ -74,164 +74,215 @@ void report_queue_push_status(struct wiimote_state * state)
   rpt->data.io = 0xa1;
   rpt->data.type = 0x20;
 
-  struct report_status * status = (struct report_status *)rpt->data.buf;
-  status->low_battery         = state->sys.low_battery;
-  status->extension_connected = state->sys.extension_connected;
-  status->speaker_enabled     = state->sys.speaker_enabled;
-  status->ircam_enabled       = state->sys.ircam_enabled;
-  status->led_1               = state->sys.led_1;
-  status->led_2               = state->sys.led_2;
-  status->led_3               = state->sys.led_3;
-  status->led_4               = state->sys.led_4;
-  status->battery_level       = state->sys.battery_level;
+  uint32_t values[WM_STATUS_VALUES];
+  values[WM_STATUS_LOW_BATTERY]         = state->sys.low_battery;
+  values[WM_STATUS_EXTENSION_CONNECTED] = state->sys.extension_connected;
+  values[WM_STATUS_SPEAKER_ENABLED]     = state->sys.speaker_enabled;
+  values[WM_STATUS_IRCAM_ENABLED]       = state->sys.ircam_enabled;
+  values[WM_STATUS_LED_1]               = state->sys.led_1;
+  values[WM_STATUS_LED_2]               = state->sys.led_2;
+  values[WM_STATUS_LED_3]               = state->sys.led_3;
+  values[WM_STATUS_LED_4]               = state->sys.led_4;
+  values[WM_STATUS_BATTERY_LEVEL]       = state->sys.battery_level;
+  wm_pack_status(rpt->data.buf, values);
 }
 
 void report_format_mem_resp(struct wiimote_state * state, struct report * rpt,
   int size, int error, uint16_t addr, uint8_t * buf, bool encrypt)
 {
-  struct report_mem_resp * resp = (struct report_mem_resp *)rpt->data.buf;
+  uint8_t * data = rpt->data.buf + WM_MEM_RESP_DATA;
+  uint32_t values[WM_MEM_RESP_VALUES];
 
   rpt->len = 23;
   rpt->data.io = 0xa1;
   rpt->data.type = 0x21;
 
-  resp->size = size - 1;
-  resp->error = error;
-  resp->addr = htons(addr);
+  values[WM_MEM_RESP_ERROR] = error;
+  values[WM_MEM_RESP_SIZE] = size - 1;
+  values[WM_MEM_RESP_ADDR] = addr;
+  wm_pack_mem_resp(rpt->data.buf, values);
+
   if (buf != NULL) //buf will be null for error reports
   {
-    memcpy(resp->data, buf, size);
+    memcpy(data, buf, size);
 
     if (encrypt)
     {
-      ext_encrypt_bytes(&state->sys.extension_crypto_state, resp->data, addr & 0x7, size);
+      ext_encrypt_bytes(&state->sys.extension_crypto_state, data, addr & 0x7, size);
     }
   }
 }
 
 void report_append_buttons(struct wiimote_state * state, uint8_t * buf)
 {
-  struct report_buttons * rpt = (struct report_buttons *)buf;
-
-  rpt->left  = state->usr.left;
-  rpt->right = state->usr.right;
-  rpt->down  = state->usr.down;
-  rpt->up    = state->usr.up;
-  rpt->one   = state->usr.one;
-  rpt->two   = state->usr.two;
-  rpt->a     = state->usr.a;
-  rpt->b     = state->usr.b;
-  rpt->plus  = state->usr.plus;
-  rpt->minus = state->usr.minus;
-  rpt->home  = state->usr.home;
+  //the accelerometer bits are filled in afterwards
+  uint32_t buttons = state->usr.buttons;
+
+  wm_pack_buttons(buf, &buttons);
 }
 
 void report_append_accelerometer(struct wiimote_state * state, uint8_t * buf)
 {
-  struct report_accelerometer * rpt = (struct report_accelerometer *)buf;
-
-  rpt->buttons.accel_0 = state->usr.accel_x;
-  rpt->buttons.accel_1 = (state->usr.accel_z & 0x2) |
-                         ((state->usr.accel_y >> 1) & 0x1);
+  uint32_t values[WM_ACCELEROMETER_VALUES];
 
-  rpt->x = state->usr.accel_x >> 2;
-  rpt->y = state->usr.accel_y >> 2;
-  rpt->z = state->usr.accel_z >> 2;
+  values[WM_ACCELEROMETER_X] = state->usr.accel_x;
+  values[WM_ACCELEROMETER_Y] = state->usr.accel_y;
+  values[WM_ACCELEROMETER_Z] = state->usr.accel_z;
+  wm_pack_accelerometer(buf, values);
 }
 
 void report_append_ir_10(struct wiimote_state * state, uint8_t * buf)
 {
-  struct report_ir_basic * rpt = (struct report_ir_basic *)buf;
-
-  rpt->x1_lo = state->usr.ir_object[0].x;
-  rpt->y1_lo = state->usr.ir_object[0].y;
-  rpt->x1_hi = state->usr.ir_object[0].x >> 8;
-  rpt->y1_hi = state->usr.ir_object[0].y >> 8;
-
-  rpt->x2_lo = state->usr.ir_object[1].x;
-  rpt->y2_lo = state->usr.ir_object[1].y;
-  rpt->x2_hi = state->usr.ir_object[1].x >> 8;
-  rpt->y2_hi = state->usr.ir_object[1].y >> 8;
-
-  rpt->x3_lo = state->usr.ir_object[2].x;
-  rpt->y3_lo = state->usr.ir_object[2].y;
-  rpt->x3_hi = state->usr.ir_object[2].x >> 8;
-  rpt->y3_hi = state->usr.ir_object[2].y >> 8;
-
-  rpt->x4_lo = state->usr.ir_object[3].x;
-  rpt->y4_lo = state->usr.ir_object[3].y;
-  rpt->x4_hi = state->usr.ir_object[3].x >> 8;
-  rpt->y4_hi = state->usr.ir_object[3].y >> 8;
-
+  uint32_t values[WM_IR_BASIC_VALUES];
+
+  values[WM_IR_BASIC_X1] = state->usr.ir_object[0].x;
+  values[WM_IR_BASIC_Y1] = state->usr.ir_object[0].y;
+  values[WM_IR_BASIC_X2] = state->usr.ir_object[1].x;
+  values[WM_IR_BASIC_Y2] = state->usr.ir_object[1].y;
+  values[WM_IR_BASIC_X3] = state->usr.ir_object[2].x;
+  values[WM_IR_BASIC_Y3] = state->usr.ir_object[2].y;
+  values[WM_IR_BASIC_X4] = state->usr.ir_object[3].x;
+  values[WM_IR_BASIC_Y4] = state->usr.ir_object[3].y;
+  wm_pack_ir_basic(buf, values);
 }
 
 void report_append_ir_12(struct wiimote_state * state, uint8_t * buf)
 {
-  struct report_ir_ext * rpt = (struct report_ir_ext *)buf;
+  uint32_t values[WM_IR_EXTENDED_VALUES];
   int i;
 
   for (i=0; i<4; i++)
   {
-    rpt->obj[i].x_lo = state->usr.ir_object[i].x;
-    rpt->obj[i].y_lo = state->usr.ir_object[i].y;
-    rpt->obj[i].x_hi = state->usr.ir_object[i].x >> 8;
-    rpt->obj[i].y_hi = state->usr.ir_object[i].y >> 8;
-    rpt->obj[i].size = state->usr.ir_object[i].size;
+    values[WM_IR_EXTENDED_X] = state->usr.ir_object[i].x;
+    values[WM_IR_EXTENDED_Y] = state->usr.ir_object[i].y;
+    values[WM_IR_EXTENDED_SIZE] = state->usr.ir_object[i].size;
+    wm_pack_ir_extended(buf + 3 * i, values);
   }
 
 }
 
-void report_append_interleaved(struct wiimote_state * state, uint8_t * buf)
+static void append_interleaved_half(struct wiimote_state * state, uint8_t * buf, int second)
 {
-  struct report_interleaved * rpt = (struct report_interleaved *)buf;
+  uint32_t values[WM_IR_FULL_VALUES];
+  uint32_t accel[WM_INTERLEAVED_VALUES];
+  const struct wiimote_ir_object * object;
   int i;
 
+  //the first half carries objects 0 and 1, the second 2 and 3
+  if (!second)
+  {
+    accel[WM_INTERLEAVED_Z] = state->usr.accel_z >> 4;
+    accel[WM_INTERLEAVED_ACCEL] = state->usr.accel_x;
+    object = &state->usr.ir_object[0];
+  }
+  else
+  {
+    accel[WM_INTERLEAVED_Z] = state->usr.accel_z;
+    accel[WM_INTERLEAVED_ACCEL] = state->usr.accel_y;
+    object = &state->usr.ir_object[2];
+  }
+
+  wm_pack_interleaved(buf, accel);
+
+  for (i=0; i<2; i++)
+  {
+    values[WM_IR_FULL_X] = object[i].x;
+    values[WM_IR_FULL_Y] = object[i].y;
+    values[WM_IR_FULL_SIZE] = object[i].size;
+    values[WM_IR_FULL_X_MIN] = object[i].xmin;
+    values[WM_IR_FULL_Y_MIN] = object[i].ymin;
+    values[WM_IR_FULL_X_MAX] = object[i].xmax;
+    values[WM_IR_FULL_Y_MAX] = object[i].ymax;
+    values[WM_IR_FULL_INTENSITY] = object[i].intensity;
+    wm_pack_ir_full(buf + 3 + 9 * i, values);
+  }
+}
+
+void report_append_interleaved(struct wiimote_state * state, uint8_t * buf)
+{
+  //both halves are encoded from the usr state of the 0x3e tick, the 0x3f
+  //half is held back and sent as is on the next one
   if (state->sys.reporting_mode == 0x3e)
   {
-    rpt->buttons.accel_0 = state->usr.accel_z >> 4;
-    rpt->buttons.accel_1 = state->usr.accel_z >> 6;
-    rpt->accel = state->usr.accel_x >> 2;
+    append_interleaved_half(state, buf, 0);
 
-    for (i=0; i<2; i++)
-    {
-      rpt->obj[i].x_lo = state->usr.ir_object[i].x;
-      rpt->obj[i].y_lo = state->usr.ir_object[i].y;
-      rpt->obj[i].x_hi = state->usr.ir_object[i].x >> 8;
-      rpt->obj[i].y_hi = state->usr.ir_object[i].y >> 8;
-      rpt->obj[i].size = state->usr.ir_object[i].size;
-      rpt->obj[i].x_min = state->usr.ir_object[i].xmin;
-      rpt->obj[i].y_min = state->usr.ir_object[i].ymin;
-      rpt->obj[i].y_max = state->usr.ir_object[i].xmax;
-      rpt->obj[i].y_max = state->usr.ir_object[i].ymax;
-      rpt->obj[i].intensity = state->usr.ir_object[i].intensity;
-    }
+    memset(state->pair.interleaved, 0, sizeof(state->pair.interleaved));
+    report_append_buttons(state, state->pair.interleaved);
+    append_interleaved_half(state, state->pair.interleaved, 1);
+    state->pair.interleaved_pending = 1;
 
     state->sys.reporting_mode = 0x3f;
   }
   else
   {
-    rpt->buttons.accel_0 = state->usr.accel_z;
-    rpt->buttons.accel_1 = state->usr.accel_z >> 2;
-    rpt->accel = state->usr.accel_y >> 2;
-
-    for (i=0; i<2; i++)
+    if (state->pair.interleaved_pending)
     {
-      rpt->obj[i].x_lo = state->usr.ir_object[i+2].x;
-      rpt->obj[i].y_lo = state->usr.ir_object[i+2].y;
-      rpt->obj[i].x_hi = state->usr.ir_object[i+2].x >> 8;
-      rpt->obj[i].y_hi = state->usr.ir_object[i+2].y >> 8;
-      rpt->obj[i].size = state->usr.ir_object[i+2].size;
-      rpt->obj[i].x_min = state->usr.ir_object[i+2].xmin;
-      rpt->obj[i].y_min = state->usr.ir_object[i+2].ymin;
-      rpt->obj[i].y_max = state->usr.ir_object[i+2].xmax;
-      rpt->obj[i].y_max = state->usr.ir_object[i+2].ymax;
-      rpt->obj[i].intensity = state->usr.ir_object[i+2].intensity;
+      memcpy(buf, state->pair.interleaved, sizeof(state->pair.interleaved));
+      state->pair.interleaved_pending = 0;
+    }
+    else
+    {
+      //the host asked for 0x3f without a first half
+      append_interleaved_half(state, buf, 1);
     }
 
     state->sys.reporting_mode = 0x3e;
   }
 }
 
+static void append_motionplus(struct wiimote_state * state, uint8_t * buf, int ext)
+{
+  uint32_t values[WM_MOTIONPLUS_VALUES];
+
+  values[WM_MOTIONPLUS_YAW] = state->usr.motionplus.yaw_down;
+  values[WM_MOTIONPLUS_ROLL] = state->usr.motionplus.roll_left;
+  values[WM_MOTIONPLUS_PITCH] = state->usr.motionplus.pitch_left;
+  values[WM_MOTIONPLUS_YAW_SLOW] = state->usr.motionplus.yaw_slow;
+  values[WM_MOTIONPLUS_ROLL_SLOW] = state->usr.motionplus.roll_slow;
+  values[WM_MOTIONPLUS_PITCH_SLOW] = state->usr.motionplus.pitch_slow;
+  values[WM_MOTIONPLUS_EXT] = ext;
+  values[WM_MOTIONPLUS_DATA] = 1;
+  wm_pack_motionplus(buf, values);
+}
+
+//one frame of motionplus passthrough: motionplus data or the passed
+//through extension's
+static void append_passthrough_frame(struct wiimote_state * state, uint8_t * buf, int motionplus)
+{
+  if (motionplus)
+  {
+    append_motionplus(state, buf, 1);
+  }
+  else if (state->sys.extension_report_type == 0x05)
+  {
+    uint32_t values[WM_NUNCHUK_PT_VALUES];
+
+    values[WM_NUNCHUK_PT_X] = state->usr.nunchuk.x;
+    values[WM_NUNCHUK_PT_Y] = state->usr.nunchuk.y;
+    values[WM_NUNCHUK_PT_ACCEL_X] = state->usr.nunchuk.accel_x;
+    values[WM_NUNCHUK_PT_ACCEL_Y] = state->usr.nunchuk.accel_y;
+    values[WM_NUNCHUK_PT_ACCEL_Z] = state->usr.nunchuk.accel_z;
+    values[WM_NUNCHUK_PT_C] = state->usr.nunchuk.c;
+    values[WM_NUNCHUK_PT_Z] = state->usr.nunchuk.z;
+    values[WM_NUNCHUK_PT_EXT] = 1;
+    wm_pack_nunchuk_pt(buf, values);
+  }
+  else
+  {
+    uint32_t values[WM_CLASSIC_PT_VALUES];
+
+    values[WM_CLASSIC_PT_LX] = state->usr.classic.ls_x;
+    values[WM_CLASSIC_PT_LY] = state->usr.classic.ls_y;
+    values[WM_CLASSIC_PT_RX] = state->usr.classic.rs_x;
+    values[WM_CLASSIC_PT_RY] = state->usr.classic.rs_y;
+    values[WM_CLASSIC_PT_LT] = state->usr.classic.lt;
+    values[WM_CLASSIC_PT_RT] = state->usr.classic.rt;
+    values[WM_CLASSIC_PT_BUTTONS] = state->usr.classic.buttons;
+    values[WM_CLASSIC_PT_EXT] = 1;
+    wm_pack_classic_pt(buf, values);
+  }
+}
+
 void report_append_extension(struct wiimote_state * state, uint8_t * buf, uint8_t bytes)
 {
   //a600fe = 0x04 activate motionplus, 0x05 activate nunchuk passthrough, 0x07 activate classic passthrough
@@ -259,177 +310,56 @@ void report_append_extension(struct wiimote_state * state, uint8_t * buf, uint8_
   {
     case 0x00: //nunchuk
     {
-      struct report_ext_nunchuk * rpt = (struct report_ext_nunchuk *)buf;
-
-      rpt->x = state->usr.nunchuk.x;
-      rpt->y = state->usr.nunchuk.y;
+      uint32_t values[WM_NUNCHUK_VALUES];
 
-      rpt->accel_x_hi = state->usr.nunchuk.accel_x >> 2;
-      rpt->accel_y_hi = state->usr.nunchuk.accel_y >> 2;
-      rpt->accel_z_hi = state->usr.nunchuk.accel_z >> 2;
-      rpt->accel_x_lo = state->usr.nunchuk.accel_x;
-      rpt->accel_y_lo = state->usr.nunchuk.accel_y;
-      rpt->accel_z_lo = state->usr.nunchuk.accel_z;
-
-      rpt->c = !state->usr.nunchuk.c;
-      rpt->z = !state->usr.nunchuk.z;
+      values[WM_NUNCHUK_X] = state->usr.nunchuk.x;
+      values[WM_NUNCHUK_Y] = state->usr.nunchuk.y;
+      values[WM_NUNCHUK_ACCEL_X] = state->usr.nunchuk.accel_x;
+      values[WM_NUNCHUK_ACCEL_Y] = state->usr.nunchuk.accel_y;
+      values[WM_NUNCHUK_ACCEL_Z] = state->usr.nunchuk.accel_z;
+      values[WM_NUNCHUK_C] = state->usr.nunchuk.c;
+      values[WM_NUNCHUK_Z] = state->usr.nunchuk.z;
+      wm_pack_nunchuk(buf, values);
 
       break;
     }
     case 0x01: //classic
     {
-      struct report_ext_classic * rpt = (struct report_ext_classic *)buf;
-
-      rpt->lx = state->usr.classic.ls_x;
-      rpt->ly = state->usr.classic.ls_y;
-      rpt->rx_hi = state->usr.classic.rs_x >> 3;
-      rpt->rx_m = state->usr.classic.rs_x >> 1;
-      rpt->rx_lo = state->usr.classic.rs_x;
-      rpt->ry = state->usr.classic.rs_y;
-
-      rpt->lt_hi = state->usr.classic.lt >> 3;
-      rpt->lt_lo = state->usr.classic.lt;
-      rpt->rt = state->usr.classic.rt;
-
-      rpt->left = !state->usr.classic.left;
-      rpt->right = !state->usr.classic.right;
-      rpt->up = !state->usr.classic.up;
-      rpt->down = !state->usr.classic.down;
-      rpt->ltrigger = !state->usr.classic.ltrigger;
-      rpt->rtrigger = !state->usr.classic.rtrigger;
-      rpt->lz = !state->usr.classic.lz;
-      rpt->rz = !state->usr.classic.rz;
-      rpt->a = !state->usr.classic.a;
-      rpt->b = !state->usr.classic.b;
-      rpt->x = !state->usr.classic.x;
-      rpt->y = !state->usr.classic.y;
-      rpt->plus = !state->usr.classic.plus;
-      rpt->minus = !state->usr.classic.minus;
-      rpt->home = !state->usr.classic.home;
-
-      rpt->unused = 1;
+      uint32_t values[WM_CLASSIC_VALUES];
+
+      values[WM_CLASSIC_LX] = state->usr.classic.ls_x;
+      values[WM_CLASSIC_LY] = state->usr.classic.ls_y;
+      values[WM_CLASSIC_RX] = state->usr.classic.rs_x;
+      values[WM_CLASSIC_RY] = state->usr.classic.rs_y;
+      values[WM_CLASSIC_LT] = state->usr.classic.lt;
+      values[WM_CLASSIC_RT] = state->usr.classic.rt;
+      //already active low and in wire order, bit 0 is unused and always set
+      values[WM_CLASSIC_BUTTONS] = state->usr.classic.buttons | 0x0001;
+      wm_pack_classic(buf, values);
 
       break;
     }
     case 0x04: //motionplus
-    {
-      struct report_ext_motionplus * rpt = (struct report_ext_motionplus *)buf;
-
-      rpt->yaw_hi = state->usr.motionplus.yaw_down >> 8;
-      rpt->yaw_lo = state->usr.motionplus.yaw_down;
-      rpt->roll_hi = state->usr.motionplus.roll_left >> 8;
-      rpt->roll_lo = state->usr.motionplus.roll_left;
-      rpt->pitch_hi = state->usr.motionplus.pitch_left >> 8;
-      rpt->pitch_lo = state->usr.motionplus.pitch_left;
-
-      rpt->yaw_slow = state->usr.motionplus.yaw_slow;
-      rpt->pitch_slow = state->usr.motionplus.pitch_slow;
-      rpt->roll_slow = state->usr.motionplus.roll_slow;
-
-      rpt->ext = 0;
-      rpt->unused_0 = 1;
-
+      append_motionplus(state, buf, 0);
       break;
-    }
     case 0x05: //motionplus + nunchuk
-      if (state->sys.extension_report)
-      {
-        struct report_ext_motionplus * rpt = (struct report_ext_motionplus *)buf;
-
-        rpt->yaw_hi = state->usr.motionplus.yaw_down >> 8;
-        rpt->yaw_lo = state->usr.motionplus.yaw_down;
-        rpt->roll_hi = state->usr.motionplus.roll_left >> 8;
-        rpt->roll_lo = state->usr.motionplus.roll_left;
-        rpt->pitch_hi = state->usr.motionplus.pitch_left >> 8;
-        rpt->pitch_lo = state->usr.motionplus.pitch_left;
-
-        rpt->yaw_slow = state->usr.motionplus.yaw_slow;
-        rpt->pitch_slow = state->usr.motionplus.pitch_slow;
-        rpt->roll_slow = state->usr.motionplus.roll_slow;
-
-        rpt->ext = 1;
-        rpt->unused_0 = 1;
-
-        state->sys.extension_report = 0;
-      }
-      else
-      {
-        struct report_ext_nunchuk_pt * rpt = (struct report_ext_nunchuk_pt *)buf;
-
-        rpt->x = state->usr.nunchuk.x;
-        rpt->y = state->usr.nunchuk.y;
-
-        rpt->accel_x_hi = state->usr.nunchuk.accel_x >> 2;
-        rpt->accel_y_hi = state->usr.nunchuk.accel_y >> 2;
-        rpt->accel_z_hi = state->usr.nunchuk.accel_z >> 3;
-        rpt->accel_x_lo = state->usr.nunchuk.accel_x >> 1;
-        rpt->accel_y_lo = state->usr.nunchuk.accel_y >> 1;
-        rpt->accel_z_lo = state->usr.nunchuk.accel_z >> 1;
-
-        rpt->c = !state->usr.nunchuk.c;
-        rpt->z = !state->usr.nunchuk.z;
-
-        rpt->ext = 1;
-
-        state->sys.extension_report = 1;
-      }
-      break;
     case 0x07: //motionplus + classic
-      if (state->sys.extension_report)
+      //the wmp and extension frames of a pair are encoded from the same usr
+      //state, the second is held back and sent on the next report
+      if (state->pair.passthrough_type == state->sys.extension_report_type)
       {
-        struct report_ext_motionplus * rpt = (struct report_ext_motionplus *)buf;
-
-        rpt->yaw_hi = state->usr.motionplus.yaw_down >> 8;
-        rpt->yaw_lo = state->usr.motionplus.yaw_down;
-        rpt->roll_hi = state->usr.motionplus.roll_left >> 8;
-        rpt->roll_lo = state->usr.motionplus.roll_left;
-        rpt->pitch_hi = state->usr.motionplus.pitch_left >> 8;
-        rpt->pitch_lo = state->usr.motionplus.pitch_left;
-
-        rpt->yaw_slow = state->usr.motionplus.yaw_slow;
-        rpt->pitch_slow = state->usr.motionplus.pitch_slow;
-        rpt->roll_slow = state->usr.motionplus.roll_slow;
-
-        rpt->ext = 1;
-        rpt->unused_0 = 1;
-
-        state->sys.extension_report = 0;
+        memcpy(buf, state->pair.passthrough, sizeof(state->pair.passthrough));
+        state->pair.passthrough_type = 0;
       }
       else
       {
-        struct report_ext_classic_pt * rpt = (struct report_ext_classic_pt *)buf;
-
-        rpt->lx = state->usr.classic.ls_x >> 1;
-        rpt->ly = state->usr.classic.ls_y >> 1;
-        rpt->rx_hi = state->usr.classic.rs_x >> 3;
-        rpt->rx_m = state->usr.classic.rs_x >> 1;
-        rpt->rx_lo = state->usr.classic.rs_x;
-        rpt->ry = state->usr.classic.rs_y;
-
-        rpt->lt_hi = state->usr.classic.lt >> 3;
-        rpt->lt_lo = state->usr.classic.lt;
-        rpt->rt = state->usr.classic.rt;
-
-        rpt->left = !state->usr.classic.left;
-        rpt->right = !state->usr.classic.right;
-        rpt->up = !state->usr.classic.up;
-        rpt->down = !state->usr.classic.down;
-        rpt->ltrigger = !state->usr.classic.ltrigger;
-        rpt->rtrigger = !state->usr.classic.rtrigger;
-        rpt->lz = !state->usr.classic.lz;
-        rpt->rz = !state->usr.classic.rz;
-        rpt->a = !state->usr.classic.a;
-        rpt->b = !state->usr.classic.b;
-        rpt->x = !state->usr.classic.x;
-        rpt->y = !state->usr.classic.y;
-        rpt->plus = !state->usr.classic.plus;
-        rpt->minus = !state->usr.classic.minus;
-        rpt->home = !state->usr.classic.home;
-
-        rpt->ext = 1;
-
-        state->sys.extension_report = 1;
+        append_passthrough_frame(state, buf, state->sys.extension_report);
+        memset(state->pair.passthrough, 0, sizeof(state->pair.passthrough));
+        append_passthrough_frame(state, state->pair.passthrough, !state->sys.extension_report);
+        state->pair.passthrough_type = state->sys.extension_report_type;
       }
+
+      state->sys.extension_report = !state->sys.extension_report;
       break;
   }
 
@@ -0,0 +1,170 @@
+#include "wm_timer.h"
+
+#include <string.h>
+#include <time.h>
+
+uint64_t wm_clock_monotonic(void * data)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t)1000000 + ts.tv_nsec / 1000;
+}
+
+void wm_timer_wheel_init(struct wm_timer_wheel * wheel, wm_clock_fn clock, void * clock_data)
+{
+  memset(wheel, 0, sizeof(struct wm_timer_wheel));
+  wm_timer_wheel_set_clock(wheel, clock, clock_data);
+}
+
+void wm_timer_wheel_set_clock(struct wm_timer_wheel * wheel, wm_clock_fn clock, void * clock_data)
+{
+  wheel->clock = (clock != NULL) ? clock : wm_clock_monotonic;
+  wheel->clock_data = clock_data;
+  wheel->tick = wm_timer_wheel_now(wheel) / WM_TIMER_TICK_US;
+}
+
+uint64_t wm_timer_wheel_now(struct wm_timer_wheel * wheel)
+{
+  return wheel->clock(wheel->clock_data);
+}
+
+static void unlink_timer(struct wm_timer_wheel * wheel, struct wm_timer * timer)
+{
+  struct wm_timer ** link = &wheel->slots[(timer->expires / WM_TIMER_TICK_US) & (WM_TIMER_SLOTS - 1)];
+
+  while (*link != NULL && *link != timer)
+  {
+    link = &(*link)->next;
+  }
+
+  if (*link == timer)
+  {
+    *link = timer->next;
+    wheel->armed--;
+  }
+
+  timer->next = NULL;
+  timer->armed = 0;
+}
+
+void wm_timer_wheel_run(struct wm_timer_wheel * wheel)
+{
+  uint64_t now, tick, last;
+  struct wm_timer ** link;
+  struct wm_timer * timer;
+
+  if (wheel->armed == 0)
+  {
+    return;
+  }
+
+  now = wm_timer_wheel_now(wheel);
+  last = now / WM_TIMER_TICK_US;
+
+  //after a long gap every slot is visited once
+  tick = wheel->tick;
+  if (last < tick)
+  {
+    return; //the injected clock went backwards
+  }
+  if (last - tick >= WM_TIMER_SLOTS)
+  {
+    tick = last - (WM_TIMER_SLOTS - 1);
+  }
+
+  for (; tick <= last && wheel->armed > 0; tick++)
+  {
+    link = &wheel->slots[tick & (WM_TIMER_SLOTS - 1)];
+
+    while (*link != NULL)
+    {
+      timer = *link;
+      if (timer->expires > now)
+      {
+        link = &timer->next;
+        continue;
+      }
+
+      *link = timer->next;
+      wheel->armed--;
+      timer->next = NULL;
+      timer->armed = 0;
+
+      //may start this or any other timer, so the slot is walked from
+      //the link again
+      if (timer->fire != NULL)
+      {
+        timer->fire(wheel, timer);
+      }
+    }
+  }
+
+  wheel->tick = last;
+}
+
+void wm_timer_wheel_clear(struct wm_timer_wheel * wheel)
+{
+  struct wm_timer * timer;
+  int i;
+
+  for (i = 0; i < WM_TIMER_SLOTS; i++)
+  {
+    while (wheel->slots[i] != NULL)
+    {
+      timer = wheel->slots[i];
+      wheel->slots[i] = timer->next;
+      timer->next = NULL;
+      timer->armed = 0;
+    }
+  }
+
+  wheel->armed = 0;
+}
+
+void wm_timer_init(struct wm_timer * timer,
+  void (*fire)(struct wm_timer_wheel * wheel, struct wm_timer * timer), void * data)
+{
+  memset(timer, 0, sizeof(struct wm_timer));
+  timer->fire = fire;
+  timer->data = data;
+}
+
+void wm_timer_start(struct wm_timer_wheel * wheel, struct wm_timer * timer, uint64_t delay_us)
+{
+  struct wm_timer ** slot;
+  uint64_t now;
+
+  if (timer->armed)
+  {
+    unlink_timer(wheel, timer);
+  }
+
+  now = wm_timer_wheel_now(wheel);
+  timer->expires = now + delay_us;
+
+  //an idle wheel has nothing to catch up on
+  if (wheel->armed == 0)
+  {
+    wheel->tick = now / WM_TIMER_TICK_US;
+  }
+
+  //never behind the tick the wheel has already run
+  if (timer->expires / WM_TIMER_TICK_US < wheel->tick)
+  {
+    timer->expires = wheel->tick * WM_TIMER_TICK_US;
+  }
+
+  slot = &wheel->slots[(timer->expires / WM_TIMER_TICK_US) & (WM_TIMER_SLOTS - 1)];
+  timer->next = *slot;
+  *slot = timer;
+  timer->armed = 1;
+  wheel->armed++;
+}
+
+void wm_timer_stop(struct wm_timer_wheel * wheel, struct wm_timer * timer)
+{
+  if (timer->armed)
+  {
+    unlink_timer(wheel, timer);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef WM_TIMER_H
+#define WM_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Hashed timer wheel for delayed state transitions (extension hotplug,
+ * motionplus init progress, reconnect backoff). Times are microseconds on
+ * the wheel's clock, CLOCK_MONOTONIC unless another one is injected (tests,
+ * replays). Timers are owned by the caller and linked into the slot of the
+ * tick they expire on; a timer further out than one turn of the wheel just
+ * stays in its slot until it is due.
+ */
+
+#define WM_TIMER_SLOTS 64 //power of two
+#define WM_TIMER_TICK_US 1000
+
+typedef uint64_t (*wm_clock_fn)(void * data);
+
+struct wm_timer_wheel;
+
+struct wm_timer
+{
+  struct wm_timer * next;
+  uint64_t expires;
+  bool armed;
+
+  //NULL for timers that are only checked through armed
+  void (*fire)(struct wm_timer_wheel * wheel, struct wm_timer * timer);
+  void * data;
+};
+
+struct wm_timer_wheel
+{
+  wm_clock_fn clock;
+  void * clock_data;
+
+  uint64_t tick; //last tick run
+  int armed; //timers linked into the wheel
+
+  struct wm_timer * slots[WM_TIMER_SLOTS];
+};
+
+uint64_t wm_clock_monotonic(void * data);
+
+// An empty wheel on clock, wm_clock_monotonic if NULL
+void wm_timer_wheel_init(struct wm_timer_wheel * wheel, wm_clock_fn clock, void * clock_data);
+void wm_timer_wheel_set_clock(struct wm_timer_wheel * wheel, wm_clock_fn clock, void * clock_data);
+uint64_t wm_timer_wheel_now(struct wm_timer_wheel * wheel);
+
+// Fires every timer that has expired by the wheel's clock, in slot order.
+// A timer is unlinked before its callback, which may start it again.
+void wm_timer_wheel_run(struct wm_timer_wheel * wheel);
+
+// Unlinks every timer, their callbacks aren't called
+void wm_timer_wheel_clear(struct wm_timer_wheel * wheel);
+
+void wm_timer_init(struct wm_timer * timer,
+  void (*fire)(struct wm_timer_wheel * wheel, struct wm_timer * timer), void * data);
+
+// (Re)starts timer to fire delay_us from now
+void wm_timer_start(struct wm_timer_wheel * wheel, struct wm_timer * timer, uint64_t delay_us);
+void wm_timer_stop(struct wm_timer_wheel * wheel, struct wm_timer * timer);
+
+#endif /* WM_TIMER_H */
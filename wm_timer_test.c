@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiimote.h"
+#include "wm_reports.h"
+#include "wm_timer.h"
+#include "wm_wmp.h"
+#include "test.h"
+
+// Checks the timer wheel on a virtual clock, and that the extension hotplug
+// delay and the motionplus init progress follow the clock rather than the
+// number of reports generated.
+
+static uint64_t virtual_now = 0;
+
+static uint64_t virtual_clock(void * data)
+{
+  return virtual_now;
+}
+
+struct fired
+{
+  int count;
+  uint64_t at;
+};
+
+static void record_fire(struct wm_timer_wheel * wheel, struct wm_timer * timer)
+{
+  struct fired * fired = (struct fired *)timer->data;
+
+  fired->count++;
+  fired->at = wm_timer_wheel_now(wheel);
+}
+
+//restarts itself every 10ms, three times
+static void restart_fire(struct wm_timer_wheel * wheel, struct wm_timer * timer)
+{
+  struct fired * fired = (struct fired *)timer->data;
+
+  if (++fired->count < 3)
+  {
+    wm_timer_start(wheel, timer, 10000);
+  }
+}
+
+static void test_wheel()
+{
+  const uint64_t delays[] = { 0, 999, 1000, 1500, 63999, 64000, 200000, 1000000 };
+  const int count = sizeof(delays) / sizeof(delays[0]);
+  struct wm_timer_wheel wheel;
+  struct wm_timer timers[8], stopped, restarted;
+  struct fired fired[8], stopped_fired, restarted_fired;
+  int i;
+
+  virtual_now = 5000123;
+  wm_timer_wheel_init(&wheel, virtual_clock, NULL);
+
+  memset(fired, 0, sizeof(fired));
+  for (i = 0; i < count; i++)
+  {
+    wm_timer_init(&timers[i], record_fire, &fired[i]);
+    wm_timer_start(&wheel, &timers[i], delays[i]);
+  }
+
+  memset(&stopped_fired, 0, sizeof(stopped_fired));
+  wm_timer_init(&stopped, record_fire, &stopped_fired);
+  wm_timer_start(&wheel, &stopped, 20000);
+  wm_timer_stop(&wheel, &stopped);
+  CHECK(!stopped.armed);
+
+  memset(&restarted_fired, 0, sizeof(restarted_fired));
+  wm_timer_init(&restarted, restart_fire, &restarted_fired);
+  wm_timer_start(&wheel, &restarted, 10000);
+
+  CHECK(wheel.armed == count + 1);
+
+  //uneven steps, some longer than a turn of the wheel
+  for (i = 0; i < 400; i++)
+  {
+    virtual_now += (i % 7 == 0) ? 70000 : 333;
+    wm_timer_wheel_run(&wheel);
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    CHECK(fired[i].count == 1);
+    CHECK(fired[i].at >= timers[i].expires);
+    CHECK(!timers[i].armed);
+  }
+  CHECK(stopped_fired.count == 0);
+  CHECK(restarted_fired.count == 3);
+  CHECK(wheel.armed == 0);
+
+  //never late by more than a run: step exactly one tick at a time
+  wm_timer_start(&wheel, &timers[0], 2500);
+  fired[0].count = 0;
+  for (i = 0; i < 5; i++)
+  {
+    virtual_now += 1000;
+    wm_timer_wheel_run(&wheel);
+    CHECK(fired[0].count == (i >= 2));
+  }
+
+  wm_timer_start(&wheel, &timers[1], 1000);
+  wm_timer_wheel_clear(&wheel);
+  CHECK(!timers[1].armed);
+  CHECK(wheel.armed == 0);
+}
+
+static void drain_queue(struct wiimote_state * state)
+{
+  while (state->sys.queue != NULL)
+  {
+    report_queue_pop(state);
+  }
+}
+
+static void generate(struct wiimote_state * state, int reports)
+{
+  uint8_t buf[sizeof(struct report_data)];
+  int i;
+
+  for (i = 0; i < reports; i++)
+  {
+    generate_report(state, buf);
+  }
+}
+
+static void test_hotplug()
+{
+  struct wiimote_state state;
+
+  virtual_now = 1000000;
+  wiimote_init(&state);
+  wiimote_set_clock(&state, virtual_clock, NULL);
+  drain_queue(&state);
+
+  //the first extension connects straight away
+  state.usr.connected_extension_type = Nunchuk;
+  generate(&state, 1);
+  CHECK(state.sys.extension_connected);
+  CHECK(state.sys.connected_extension_type == Nunchuk);
+
+  //a swap waits for the delay however many reports go out
+  state.usr.connected_extension_type = Classic;
+  generate(&state, 1000);
+  CHECK(!state.sys.extension_connected);
+
+  virtual_now += WIIMOTE_HOTPLUG_DELAY_US - 1;
+  generate(&state, 1);
+  CHECK(!state.sys.extension_connected);
+
+  virtual_now += 1000;
+  generate(&state, 1);
+  CHECK(state.sys.extension_connected);
+  CHECK(state.sys.connected_extension_type == Classic);
+  CHECK(!state.sys.timers_armed);
+
+  //with no reports in between, the delay is already over
+  state.usr.connected_extension_type = NoExtension;
+  generate(&state, 1);
+  CHECK(!state.sys.extension_connected);
+  virtual_now += WIIMOTE_HOTPLUG_DELAY_US + 1000;
+  state.usr.connected_extension_type = Nunchuk;
+  generate(&state, 1);
+  CHECK(state.sys.extension_connected);
+
+  wiimote_destroy(&state);
+}
+
+static void test_wmp_init()
+{
+  struct wiimote_state state;
+  const uint8_t activate = 0x04, init = 0x00;
+  int i;
+
+  virtual_now = 1000000;
+  wiimote_init(&state);
+  wiimote_set_clock(&state, virtual_clock, NULL);
+
+  write_register(&state, 0xa600fe, 1, &activate);
+  CHECK(state.sys.wmp_state == WMP_ACTIVE);
+
+  write_register(&state, 0xa400f1, 1, &init);
+  CHECK(state.sys.registers->a6[0xf7] == 0x1a);
+
+  //polling the progress byte doesn't hurry it
+  for (i = 0; i < 20; i++)
+  {
+    read_register(&state, 0xa400f7, 1);
+  }
+  generate(&state, 100);
+  CHECK(state.sys.registers->a6[0xf7] == 0x1a);
+
+  virtual_now += WIIMOTE_WMP_INIT_DELAY_US + 1000;
+  generate(&state, 1);
+  CHECK(state.sys.registers->a6[0xf7] == 0x0e);
+
+  wiimote_destroy(&state);
+}
+
+int main(int argc, char *argv[])
+{
+  test_wheel();
+  test_hotplug();
+  test_wmp_init();
+
+  return test_result("timers passed");
+}
@@ -0,0 +1,162 @@
+#include "wm_wmp.h"
+#include "wm_reports.h"
+#include "wm_read_cache.h"
+
+#include <string.h>
+
+//the extension port is replugged: registers laid out again for the new
+//mapping, then an unplugged and a plugged status report
+#define WMP_REPLUG 0x01
+//the report type comes from the value written (0xa600fe)
+#define WMP_SET_MODE 0x02
+//the init data block is loaded (0xa400f1)
+#define WMP_LOAD_INIT_DATA 0x04
+
+struct wmp_transition
+{
+  uint8_t from;
+  uint8_t event;
+  uint8_t to;
+  uint8_t progress; //0xa400f7 afterwards, 0 leaves it alone
+  uint32_t timer_us; //starts the init timer, 0 stops it
+  uint8_t actions;
+};
+
+static const struct wmp_transition transitions[] =
+{
+  { WMP_INACTIVE, WMP_EVENT_ACTIVATE, WMP_ACTIVE, 0x0c, 0, WMP_REPLUG | WMP_SET_MODE },
+  //switching between plain and passthrough modes starts over
+  { WMP_ACTIVE, WMP_EVENT_ACTIVATE, WMP_ACTIVE, 0x0c, 0, WMP_REPLUG | WMP_SET_MODE },
+  { WMP_INITIALIZING, WMP_EVENT_ACTIVATE, WMP_ACTIVE, 0x0c, 0, WMP_REPLUG | WMP_SET_MODE },
+  { WMP_READY, WMP_EVENT_ACTIVATE, WMP_ACTIVE, 0x0c, 0, WMP_REPLUG | WMP_SET_MODE },
+
+  { WMP_ACTIVE, WMP_EVENT_DEACTIVATE, WMP_INACTIVE, 0, 0, WMP_REPLUG },
+  { WMP_INITIALIZING, WMP_EVENT_DEACTIVATE, WMP_INACTIVE, 0, 0, WMP_REPLUG },
+  { WMP_READY, WMP_EVENT_DEACTIVATE, WMP_INACTIVE, 0, 0, WMP_REPLUG },
+
+  //a new init request restarts the timer
+  { WMP_ACTIVE, WMP_EVENT_START_INIT, WMP_INITIALIZING, 0x1a, WIIMOTE_WMP_INIT_DELAY_US, WMP_LOAD_INIT_DATA },
+  { WMP_INITIALIZING, WMP_EVENT_START_INIT, WMP_INITIALIZING, 0x1a, WIIMOTE_WMP_INIT_DELAY_US, WMP_LOAD_INIT_DATA },
+  { WMP_READY, WMP_EVENT_START_INIT, WMP_INITIALIZING, 0x1a, WIIMOTE_WMP_INIT_DELAY_US, WMP_LOAD_INIT_DATA },
+
+  { WMP_INITIALIZING, WMP_EVENT_INIT_DONE, WMP_READY, 0x0e, 0, 0 },
+};
+
+#define TRANSITION_COUNT (sizeof(transitions) / sizeof(transitions[0]))
+
+//0xa40050-0xa4008f once init has started, pulled from a wiimote
+static const uint8_t init_data[64] =
+{
+  0xe7, 0x98, 0x31, 0x8a, 0x18, 0x82, 0x37, 0x5e, 0x02, 0x4f, 0x68, 0x47, 0x78, 0xef, 0xbb, 0xd7,
+  0x86, 0xc8, 0x95, 0xbd, 0x20, 0x9b, 0xeb, 0x8b, 0x79, 0x81, 0xdc, 0x61, 0x13, 0x54, 0x79, 0x4c,
+  0xb7, 0x26, 0x82, 0x17, 0xe8, 0x0f, 0xa9, 0xb5, 0x45, 0xa0, 0x38, 0x8e, 0x9e, 0x86, 0x72, 0x55,
+  0x3d, 0x46, 0x2e, 0x3e, 0x10, 0x1f, 0x8e, 0x0c, 0xf4, 0x04, 0x89, 0x4c, 0xca, 0x3e, 0x9f, 0x36
+};
+
+static void init_timer_fire(struct wm_timer_wheel * wheel, struct wm_timer * timer)
+{
+  wmp_event((struct wiimote_state *)timer->data, WMP_EVENT_INIT_DONE, 0);
+}
+
+void wmp_reset(struct wiimote_state * state)
+{
+  state->sys.wmp_state = WMP_INACTIVE;
+  wm_timer_init(&state->sys.timers->wmp_init, init_timer_fire, state);
+}
+
+int wmp_event(struct wiimote_state * state, enum wmp_event event, uint8_t value)
+{
+  const struct wmp_transition * transition = NULL;
+  int i;
+
+  for (i = 0; i < TRANSITION_COUNT; i++)
+  {
+    if (transitions[i].from == state->sys.wmp_state && transitions[i].event == event)
+    {
+      transition = &transitions[i];
+      break;
+    }
+  }
+
+  if (transition == NULL)
+  {
+    return 0;
+  }
+
+  state->sys.wmp_state = transition->to;
+  wm_read_cache_invalidate(state, WM_READ_EXTENSION);
+
+  if (transition->actions & WMP_SET_MODE)
+  {
+    state->sys.extension_report_type = value & 0x7;
+  }
+
+  if (transition->timer_us > 0)
+  {
+    wiimote_start_timer(state, &state->sys.timers->wmp_init, transition->timer_us);
+  }
+  else
+  {
+    wm_timer_stop(&state->sys.timers->wheel, &state->sys.timers->wmp_init);
+  }
+
+  if (transition->actions & WMP_REPLUG)
+  {
+    init_extension(state);
+  }
+
+  if (transition->actions & WMP_LOAD_INIT_DATA)
+  {
+    memcpy(&state->sys.registers->a6[0x50], init_data, sizeof(init_data));
+  }
+
+  if (transition->progress != 0)
+  {
+    state->sys.registers->a6[0xf7] = transition->progress;
+  }
+
+  if (transition->actions & WMP_REPLUG)
+  {
+    report_queue_push_ack(state, 0x16, 0x00);
+    state->sys.extension_connected = 0;
+    report_queue_push_status(state);
+    state->sys.extension_connected = 1;
+    report_queue_push_status(state);
+    return 1;
+  }
+
+  return 0;
+}
+
+int wmp_register_written(struct wiimote_state * state, uint32_t offset, uint8_t value)
+{
+  switch (offset & 0xfeffff)
+  {
+    case 0xa600fe:
+      if (value & 0x04)
+      {
+        return wmp_event(state, WMP_EVENT_ACTIVATE, value);
+      }
+      break;
+    case 0xa400f0:
+      if (value == 0x55 && wmp_mapped(state))
+      {
+        return wmp_event(state, WMP_EVENT_DEACTIVATE, value);
+      }
+      break;
+    case 0xa400fe:
+      if (value == 0x00 && wmp_mapped(state))
+      {
+        return wmp_event(state, WMP_EVENT_DEACTIVATE, value);
+      }
+      break;
+    case 0xa400f1:
+      if (wmp_mapped(state))
+      {
+        return wmp_event(state, WMP_EVENT_START_INIT, value);
+      }
+      break;
+  }
+
+  return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef WM_WMP_H
+#define WM_WMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "wiimote.h"
+
+/*
+ * Wii MotionPlus activation and init as a state machine. Register writes and
+ * the init timer become events, and a transition table says what each one
+ * does in each state: the next state, the init progress byte (0xa400f7 while
+ * mapped), whether the init timer starts and whether the extension port is
+ * replugged so the host sees the new id at 0xa400fa.
+ */
+
+enum wmp_state
+{
+  WMP_INACTIVE = 0, //at 0xa6, a plugged in extension at 0xa4
+  WMP_ACTIVE, //mapped to 0xa4, waiting for the host to start init
+  WMP_INITIALIZING, //init started by a write to 0xa400f1, progress 0x1a
+  WMP_READY, //init done, progress 0x0e
+};
+
+enum wmp_event
+{
+  WMP_EVENT_ACTIVATE, //0x04, 0x05 or 0x07 written to 0xa600fe
+  WMP_EVENT_DEACTIVATE, //0x55 to 0xa400f0 or 0x00 to 0xa400fe while mapped
+  WMP_EVENT_START_INIT, //anything written to 0xa400f1 while mapped
+  WMP_EVENT_INIT_DONE, //the init timer ran out
+};
+
+static inline bool wmp_mapped(const struct wiimote_state * state)
+{
+  return state->sys.wmp_state != WMP_INACTIVE;
+}
+
+// Inactive, with the init timer set up on the state's wheel
+void wmp_reset(struct wiimote_state * state);
+
+// Feeds a register write to the state machine, called after the bytes are
+// stored. Returns 1 if the extension was replugged, the acknowledgement and
+// the two status reports are then already queued.
+int wmp_register_written(struct wiimote_state * state, uint32_t offset, uint8_t value);
+
+// Runs one event, events without a transition from the current state are
+// ignored. Returns 1 if the extension was replugged.
+int wmp_event(struct wiimote_state * state, enum wmp_event event, uint8_t value);
+
+#endif /* WM_WMP_H */
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiimote.h"
+#include "wm_reports.h"
+#include "wm_wmp.h"
+#include "test.h"
+
+// Host simulator for the motionplus handshake: like a Wii it activates
+// motionplus, polls the id at 0xa400fa until it changes, starts init and
+// polls the progress byte at 0xa400f7 until it reads done, one request per
+// report period on a virtual clock. Checks the register transitions on the
+// way and counts the 0x17 polls each step needs.
+
+#define REPORT_PERIOD_US 5000
+#define MAX_POLLS 200
+
+//what the host tolerates before the handshake counts as slow
+#define EXPECTED_MAX_ID_POLLS 2
+#define EXPECTED_MAX_PROGRESS_POLLS 8
+
+static uint64_t virtual_now = 0;
+
+static uint64_t virtual_clock(void * data)
+{
+  return virtual_now;
+}
+
+static void write_byte(struct wiimote_state * state, uint32_t addr, uint8_t value)
+{
+  uint8_t buf[23] = { 0xa2, 0x16, 0x04, addr >> 16, addr >> 8, addr, 0x01, value };
+
+  process_report(state, buf, sizeof(buf));
+}
+
+// One report period per generated report until a read response comes back,
+// returns the response contents or NULL if none came
+static const uint8_t * read_bytes(struct wiimote_state * state, uint32_t addr, int size)
+{
+  static uint8_t buf[sizeof(struct report_data)];
+  const uint8_t request[8] = { 0xa2, 0x17, 0x04, addr >> 16, addr >> 8, addr, 0x00, size };
+  int i;
+
+  process_report(state, request, sizeof(request));
+
+  for (i = 0; i < 16; i++)
+  {
+    virtual_now += REPORT_PERIOD_US;
+    generate_report(state, buf);
+
+    if (buf[1] == 0x21)
+    {
+      return buf + 7;
+    }
+  }
+
+  return NULL;
+}
+
+// Sends reports until the queue is empty, one report period each
+static void settle(struct wiimote_state * state)
+{
+  uint8_t buf[sizeof(struct report_data)];
+
+  do
+  {
+    virtual_now += REPORT_PERIOD_US;
+    generate_report(state, buf);
+  } while (state->sys.queue != NULL);
+}
+
+static int poll_id(struct wiimote_state * state, const uint8_t * id)
+{
+  const uint8_t * data;
+  int polls;
+
+  for (polls = 1; polls <= MAX_POLLS; polls++)
+  {
+    data = read_bytes(state, 0xa400fa, 6);
+    if (data != NULL && memcmp(data, id, 6) == 0)
+    {
+      return polls;
+    }
+  }
+
+  return -1;
+}
+
+static int poll_progress(struct wiimote_state * state)
+{
+  const uint8_t * data;
+  int polls;
+
+  for (polls = 1; polls <= MAX_POLLS; polls++)
+  {
+    data = read_bytes(state, 0xa400f7, 1);
+    if (data != NULL && data[0] == 0x0e)
+    {
+      return polls;
+    }
+  }
+
+  return -1;
+}
+
+// Activation, id check, init and progress polls for one motionplus mode
+static void handshake(struct wiimote_state * state, uint8_t mode)
+{
+  const uint8_t id[6] = { 0x00, 0x00, 0xa4, 0x20, mode, 0x05 };
+  uint64_t start;
+  int id_polls, progress_polls;
+
+  write_byte(state, 0xa600fe, mode);
+  CHECK(state->sys.wmp_state == WMP_ACTIVE);
+  CHECK(state->sys.extension_report_type == mode);
+  settle(state);
+
+  id_polls = poll_id(state, id);
+  CHECK(id_polls > 0 && id_polls <= EXPECTED_MAX_ID_POLLS);
+
+  start = virtual_now;
+  write_byte(state, 0xa400f1, 0x00);
+  CHECK(state->sys.wmp_state == WMP_INITIALIZING);
+  settle(state);
+
+  progress_polls = poll_progress(state);
+  CHECK(progress_polls > 0 && progress_polls <= EXPECTED_MAX_PROGRESS_POLLS);
+  CHECK(state->sys.wmp_state == WMP_READY);
+  CHECK(virtual_now - start >= WIIMOTE_WMP_INIT_DELAY_US);
+
+  printf("mode 0x%02x: id after %d poll(s), init done after %d progress poll(s), %d ms\n",
+    mode, id_polls, progress_polls, (int)((virtual_now - start) / 1000));
+}
+
+static void test_handshakes()
+{
+  const uint8_t nunchuk_id[6] = { 0x00, 0x00, 0xa4, 0x20, 0x00, 0x00 };
+  struct wiimote_state state;
+
+  virtual_now = 1000000;
+  wiimote_init(&state);
+  wiimote_set_clock(&state, virtual_clock, NULL);
+  state.usr.connected_extension_type = Nunchuk;
+  settle(&state);
+  CHECK(state.sys.extension_connected);
+
+  handshake(&state, 0x04);
+
+  //deactivating gives the nunchuk its port back
+  write_byte(&state, 0xa400f0, 0x55);
+  CHECK(state.sys.wmp_state == WMP_INACTIVE);
+  settle(&state);
+  CHECK(poll_id(&state, nunchuk_id) == 1);
+
+  //the next activation goes through init again
+  handshake(&state, 0x05);
+  handshake(&state, 0x04);
+
+  wiimote_destroy(&state);
+}
+
+static void test_ignored_events()
+{
+  struct wiimote_state state;
+
+  virtual_now = 1000000;
+  wiimote_init(&state);
+  wiimote_set_clock(&state, virtual_clock, NULL);
+
+  //init and deactivation mean nothing while motionplus is at 0xa6
+  CHECK(wmp_event(&state, WMP_EVENT_START_INIT, 0) == 0);
+  CHECK(wmp_event(&state, WMP_EVENT_DEACTIVATE, 0) == 0);
+  CHECK(wmp_event(&state, WMP_EVENT_INIT_DONE, 0) == 0);
+  CHECK(state.sys.wmp_state == WMP_INACTIVE);
+  CHECK(state.sys.registers->a6[0xf7] == 0x02);
+
+  //a late timer after reactivation doesn't skip init
+  CHECK(wmp_event(&state, WMP_EVENT_ACTIVATE, 0x04) == 1);
+  CHECK(wmp_event(&state, WMP_EVENT_START_INIT, 0) == 0);
+  CHECK(wmp_event(&state, WMP_EVENT_ACTIVATE, 0x04) == 1);
+  CHECK(!state.sys.timers->wmp_init.armed);
+  CHECK(wmp_event(&state, WMP_EVENT_INIT_DONE, 0) == 0);
+  CHECK(state.sys.wmp_state == WMP_ACTIVE);
+  CHECK(state.sys.registers->a6[0xf7] == 0x0c);
+
+  wiimote_destroy(&state);
+}
+
+int main(int argc, char *argv[])
+{
+  test_handshakes();
+  test_ignored_events();
+
+  return test_result("motionplus handshakes passed");
+}
@@ -0,0 +1,682 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/perf_event.h>
+
+#include "wiimote.h"
+#include "wm_reports.h"
+#include "wm_crypto.h"
+#include "wm_read_cache.h"
+#include "wm_fixtures.h"
+#include "input.h"
+#include "input_socket.h"
+#include "motion.h"
+
+// Micro-benchmarks for the emulator core hot paths. Each benchmark runs its
+// operation a fixed number of times on the deterministic fixtures shared
+// with wm_golden_test, and the results are printed as JSON: average time
+// and wire bytes (produced or consumed) per call, plus cycles, instructions,
+// branch and cache misses per call when perf events are available (-n skips
+// them).
+
+#define DEFAULT_ITERATIONS 1000000
+#define MAX_BENCHES 128
+
+//instances cycled through by the multiplexed benchmarks, enough that their
+//states don't stay in L2
+#define MULTIPLEXED_INSTANCES 4096
+
+//loopback port of the socket input benchmarks, and the datagrams a client
+//sends between two polls
+#define SOCKET_BENCH_PORT 47041
+#define SOCKET_BENCH_BURST 64
+
+struct bench
+{
+  char name[48];
+  //returns the wire bytes handled over all iterations
+  long (*run)(const struct bench * bench, long iterations);
+  const struct wm_fixture_case * fixture;
+};
+
+static struct bench benches[MAX_BENCHES];
+static int bench_count = 0;
+
+static struct wiimote_state state;
+static struct input_state input;
+static struct input_axis_map axis_map;
+static uint8_t buf[sizeof(struct report_data)];
+
+//keeps results alive so the compiler can't drop the work
+static volatile uint8_t sink;
+
+static struct wiimote_state * instances;
+
+// Hardware counters read around every benchmark, reported per call. Each
+// one is opened on its own so a PMU with few counters still gives whatever
+// it can; when the kernel has to multiplex them the count is scaled by the
+// time the counter actually ran.
+struct counter
+{
+  const char * name;
+  uint32_t type;
+  uint64_t config;
+  int fd; //-1 when not available
+  int64_t value; //-1 when not available
+};
+
+#define CACHE_EVENT(cache, op, result) \
+  ((cache) | ((op) << 8) | ((result) << 16))
+
+static struct counter counters[] =
+{
+  { "cycles_per_op", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, -1 },
+  { "instructions_per_op", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, -1 },
+  { "branch_misses_per_op", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, -1 },
+  { "l1d_misses_per_op", PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D,
+    PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), -1, -1 },
+  { "llc_misses_per_op", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, -1 },
+};
+
+#define COUNTER_COUNT (sizeof(counters) / sizeof(counters[0]))
+
+static int perf_open(uint32_t type, uint64_t config)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counters_open()
+{
+  int i;
+
+  for (i = 0; i < COUNTER_COUNT; i++)
+  {
+    counters[i].fd = perf_open(counters[i].type, counters[i].config);
+  }
+}
+
+static void counters_close()
+{
+  int i;
+
+  for (i = 0; i < COUNTER_COUNT; i++)
+  {
+    if (counters[i].fd >= 0)
+    {
+      close(counters[i].fd);
+      counters[i].fd = -1;
+    }
+  }
+}
+
+static void counters_start()
+{
+  int i;
+
+  for (i = 0; i < COUNTER_COUNT; i++)
+  {
+    if (counters[i].fd >= 0)
+    {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+static void counters_stop()
+{
+  //value, time enabled, time running
+  uint64_t data[3];
+  int i;
+
+  for (i = 0; i < COUNTER_COUNT; i++)
+  {
+    if (counters[i].fd >= 0)
+    {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  for (i = 0; i < COUNTER_COUNT; i++)
+  {
+    counters[i].value = -1;
+
+    if (counters[i].fd < 0 || read(counters[i].fd, data, sizeof(data)) != sizeof(data) ||
+      data[2] == 0)
+    {
+      continue;
+    }
+
+    counters[i].value = data[0];
+    if (data[2] < data[1])
+    {
+      counters[i].value = (int64_t)((double)data[0] * data[1] / data[2]);
+    }
+  }
+}
+
+static uint64_t time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+static void reset_state()
+{
+  wiimote_destroy(&state);
+  wiimote_init(&state);
+  input_init(&input, &axis_map);
+
+  while (state.sys.queue != NULL)
+  {
+    report_queue_pop(&state);
+  }
+
+  state.sys.reporting_continuous = 1;
+}
+
+static long bench_append_buttons(const struct bench * bench, long iterations)
+{
+  long i;
+
+  reset_state();
+
+  for (i = 0; i < iterations; i++)
+  {
+    state.usr.buttons = i & WIIMOTE_BUTTONS_MASK;
+    report_append_buttons(&state, buf);
+    sink = buf[1];
+  }
+
+  return iterations * 2;
+}
+
+static long bench_button_events(const struct bench * bench, long iterations)
+{
+  struct input_event event;
+  long i;
+
+  reset_state();
+
+  memset(&event, 0, sizeof(event));
+  event.type = INPUT_EVENT_TYPE_BUTTON;
+
+  for (i = 0; i < iterations; i++)
+  {
+    //alternate core and classic buttons, press then release
+    event.button_event.button = (i & 2) ? INPUT_BUTTON_CLASSIC_B : INPUT_BUTTON_WIIMOTE_A;
+    event.button_event.pressed = !(i & 1);
+    input_process_event(&state, &input, &event);
+  }
+
+  sink = state.usr.buttons;
+  return 0;
+}
+
+//a high rate analog stream, every axis moves and a report period takes 16
+//samples
+static long bench_axis_events(const struct bench * bench, long iterations)
+{
+  struct input_event event;
+  long i;
+
+  reset_state();
+
+  memset(&event, 0, sizeof(event));
+  event.type = INPUT_EVENT_TYPE_ANALOG_AXIS;
+
+  for (i = 0; i < iterations; i++)
+  {
+    event.analog_axis_event.axis = i % INPUT_ANALOG_AXIS_COUNT;
+    event.analog_axis_event.value = (float)(i % 2001) / 1000.0f - 1.0f;
+    input_process_event(&state, &input, &event);
+    if (i % 16 == 15)
+    {
+      input_tick(&state, &input);
+    }
+  }
+
+  sink = state.usr.classic.rs_x;
+  return 0;
+}
+
+//one fixture case, the buttons change every report
+static long bench_report(const struct bench * bench, long iterations)
+{
+  long i, bytes = 0;
+
+  wiimote_destroy(&state);
+  wm_fixture_init(&state, bench->fixture, 1);
+
+  for (i = 0; i < iterations; i++)
+  {
+    state.usr.buttons ^= WIIMOTE_BUTTON_A;
+    bytes += generate_report(&state, buf);
+  }
+
+  sink = buf[2];
+  return bytes;
+}
+
+//round robin over many controllers, like one process serving a farm
+static long bench_report_0x33_multiplexed(const struct bench * bench, long iterations)
+{
+  long i, bytes = 0;
+  int n;
+
+  for (n = 0; n < MULTIPLEXED_INSTANCES; n++)
+  {
+    instances[n].sys.reporting_mode = 0x33;
+    instances[n].sys.reporting_continuous = 1;
+  }
+
+  for (i = 0, n = 0; i < iterations; i++)
+  {
+    instances[n].usr.buttons ^= WIIMOTE_BUTTON_A;
+    bytes += generate_report(&instances[n], buf);
+
+    if (++n == MULTIPLEXED_INSTANCES)
+    {
+      n = 0;
+    }
+  }
+
+  sink = buf[2];
+  return bytes;
+}
+
+//the recorded connection handshake, over and over, responses discarded
+static long bench_process_report(const struct bench * bench, long iterations)
+{
+  const struct wm_fixture_report * rpt;
+  long i, bytes = 0;
+  int n;
+
+  wiimote_destroy(&state);
+  wm_fixture_init_host(&state);
+
+  for (i = 0, n = 0; i < iterations; i++)
+  {
+    rpt = &wm_fixture_host_traffic[n];
+    process_report(&state, rpt->data, rpt->len);
+    bytes += rpt->len;
+
+    while (state.sys.queue != NULL)
+    {
+      report_queue_pop(&state);
+    }
+
+    if (++n == wm_fixture_host_traffic_count)
+    {
+      n = 0;
+    }
+  }
+
+  return bytes;
+}
+
+//the handshake reads every host repeats: extension id and calibration,
+//eeprom calibration
+static const uint8_t memory_reads[][8] =
+{
+  { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0xfa, 0x00, 0x06 },
+  { 0xa2, 0x17, 0x04, 0xa4, 0x00, 0x20, 0x00, 0x10 },
+  { 0xa2, 0x17, 0x00, 0x00, 0x00, 0x16, 0x00, 0x0a },
+};
+
+#define MEMORY_READ_COUNT (sizeof(memory_reads) / sizeof(memory_reads[0]))
+
+//0x17 requests on the connected handshake state, responses discarded
+static long bench_read_memory(const struct bench * bench, long iterations,
+  struct wm_read_cache * cache)
+{
+  long i, bytes = 0;
+  int n;
+
+  wiimote_destroy(&state);
+  wm_fixture_init_host(&state);
+  wiimote_set_read_cache(&state, cache);
+
+  for (i = 0, n = 0; i < iterations; i++)
+  {
+    process_report(&state, memory_reads[n], sizeof(memory_reads[n]));
+
+    while (state.sys.queue != NULL)
+    {
+      bytes += state.sys.queue->rpt.len;
+      report_queue_pop(&state);
+    }
+
+    if (++n == MEMORY_READ_COUNT)
+    {
+      n = 0;
+    }
+  }
+
+  wiimote_set_read_cache(&state, NULL);
+  return bytes;
+}
+
+static long bench_read_memory_uncached(const struct bench * bench, long iterations)
+{
+  return bench_read_memory(bench, iterations, NULL);
+}
+
+static long bench_read_memory_cached(const struct bench * bench, long iterations)
+{
+  static struct wm_read_cache cache;
+
+  wm_read_cache_init(&cache);
+  return bench_read_memory(bench, iterations, &cache);
+}
+
+static int socket_client = -1;
+static struct sockaddr_in socket_address;
+
+// Events sent over loopback UDP in bursts and drained through the socket
+// input source, one iteration per event
+static long bench_socket_events(const struct bench * bench, long iterations, int binary)
+{
+  struct input_socket_record records[INPUT_SOCKET_MAX_RECORDS];
+  uint8_t datagram[INPUT_SOCKET_DATAGRAM_SIZE];
+  struct input_socket_header header = { INPUT_SOCKET_MAGIC, INPUT_SOCKET_VERSION,
+    htole16(INPUT_SOCKET_MAX_RECORDS) };
+  struct input_event event;
+  long sent = 0, received = 0, bytes = 0;
+  size_t len;
+  int i;
+
+  if (socket_client < 0)
+  {
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons(SOCKET_BENCH_PORT);
+    socket_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    input_socket_init((struct sockaddr *)&socket_address, sizeof(socket_address));
+    socket_client = socket(AF_INET, SOCK_DGRAM, 0);
+  }
+
+  if (binary)
+  {
+    for (i = 0; i < INPUT_SOCKET_MAX_RECORDS; i++)
+    {
+      records[i] = (struct input_socket_record){ INPUT_EVENT_TYPE_ANALOG_MOTION, 0, 1,
+        INPUT_ANALOG_MOTION_POINTER, 0.001f * i, -0.001f * i, 0.0f, i };
+    }
+    memcpy(datagram, &header, sizeof(header));
+    memcpy(datagram + sizeof(header), records, sizeof(records));
+    len = sizeof(header) + sizeof(records);
+  }
+  else
+  {
+    len = snprintf((char *)datagram, sizeof(datagram), "analog_motion 1 IR_UP");
+  }
+
+  while (sent < iterations)
+  {
+    for (i = 0; i < SOCKET_BENCH_BURST && sent < iterations; i++)
+    {
+      sendto(socket_client, datagram, len, 0, (struct sockaddr *)&socket_address,
+        sizeof(socket_address));
+      sent += binary ? INPUT_SOCKET_MAX_RECORDS : 1;
+      bytes += len;
+    }
+
+    while (input_source_socket.poll_event(&event))
+    {
+      received++;
+    }
+  }
+
+  sink = received;
+  return bytes;
+}
+
+static long bench_socket_text_events(const struct bench * bench, long iterations)
+{
+  return bench_socket_events(bench, iterations, 0);
+}
+
+static long bench_socket_binary_events(const struct bench * bench, long iterations)
+{
+  return bench_socket_events(bench, iterations, 1);
+}
+
+static long bench_ext_encrypt(const struct bench * bench, long iterations, int bytes)
+{
+  struct ext_crypto_state crypto;
+  uint8_t key[16];
+  long i;
+
+  for (i = 0; i < 16; i++)
+  {
+    key[i] = i * 17;
+  }
+  ext_generate_tables(&crypto, key);
+  memset(buf, 0, sizeof(buf));
+
+  for (i = 0; i < iterations; i++)
+  {
+    ext_encrypt_bytes(&crypto, buf, 0x08, bytes);
+  }
+
+  sink = buf[0];
+  return iterations * bytes;
+}
+
+static long bench_ext_encrypt_6(const struct bench * bench, long iterations)
+{
+  return bench_ext_encrypt(bench, iterations, 6);
+}
+
+static long bench_ext_encrypt_21(const struct bench * bench, long iterations)
+{
+  return bench_ext_encrypt(bench, iterations, 21);
+}
+
+static long bench_set_motion_state(const struct bench * bench, long iterations)
+{
+  long i;
+
+  reset_state();
+
+  for (i = 0; i < iterations; i++)
+  {
+    //sweep the pointer across the screen
+    float t = (i & 1023) / 1024.0f;
+    set_motion_state(&state, t * 2.0f - 1.0f, 1.0f - t * 2.0f);
+  }
+
+  sink = state.usr.ir_object[0].x;
+  return 0;
+}
+
+static const char * extension_name(uint8_t extension)
+{
+  switch (extension)
+  {
+    case 0x00: return "nunchuk";
+    case 0x01: return "classic";
+    case 0x04: return "motionplus";
+    case 0x05: return "motionplus_nunchuk";
+    case 0x07: return "motionplus_classic";
+    default: return "unknown";
+  }
+}
+
+static int has_extension_bytes(uint8_t mode)
+{
+  return mode == 0x32 || (mode >= 0x34 && mode <= 0x37) || mode == 0x3d;
+}
+
+static void add_bench(const char * name, long (*run)(const struct bench *, long),
+  const struct wm_fixture_case * fixture)
+{
+  struct bench * bench = &benches[bench_count++];
+
+  snprintf(bench->name, sizeof(bench->name), "%s", name);
+  bench->run = run;
+  bench->fixture = fixture;
+}
+
+static void add_benches()
+{
+  char name[sizeof(benches[0].name)];
+  int c;
+
+  add_bench("append_buttons", bench_append_buttons, NULL);
+  add_bench("button_events", bench_button_events, NULL);
+  add_bench("axis_events", bench_axis_events, NULL);
+
+  for (c = 0; c < wm_fixture_case_count; c++)
+  {
+    const struct wm_fixture_case * fixture = &wm_fixture_cases[c];
+
+    if (has_extension_bytes(fixture->mode))
+    {
+      snprintf(name, sizeof(name), "report_0x%02x_%s_%s", fixture->mode,
+        extension_name(fixture->extension), fixture->encrypted ? "encrypted" : "plain");
+    }
+    else
+    {
+      snprintf(name, sizeof(name), "report_0x%02x", fixture->mode);
+    }
+    add_bench(name, bench_report, fixture);
+  }
+
+  add_bench("report_0x33_multiplexed", bench_report_0x33_multiplexed, NULL);
+  add_bench("process_report", bench_process_report, NULL);
+  add_bench("read_memory", bench_read_memory_uncached, NULL);
+  add_bench("read_memory_cached", bench_read_memory_cached, NULL);
+  add_bench("socket_text_events", bench_socket_text_events, NULL);
+  add_bench("socket_binary_events", bench_socket_binary_events, NULL);
+  add_bench("ext_encrypt_bytes_6", bench_ext_encrypt_6, NULL);
+  add_bench("ext_encrypt_bytes_21", bench_ext_encrypt_21, NULL);
+  add_bench("set_motion_state", bench_set_motion_state, NULL);
+}
+
+static void print_per_op(const char * name, int64_t count, long iterations)
+{
+  if (count < 0)
+  {
+    printf(", \"%s\": null", name);
+  }
+  else
+  {
+    printf(", \"%s\": %.3f", name, count / (double)iterations);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  long iterations = DEFAULT_ITERATIONS;
+  const char * filter = NULL;
+  int use_counters = 1;
+  uint64_t start, end;
+  long bytes;
+  int i, n, first = 1;
+
+  if (argc > 1 && strcmp(argv[1], "-n") == 0)
+  {
+    use_counters = 0;
+    argc--;
+    argv++;
+  }
+
+  if (argc > 1)
+  {
+    iterations = atol(argv[1]);
+    if (iterations <= 0)
+    {
+      printf("usage: %s [-n] [ <iterations> [ <name filter> ] ]\n", *argv);
+      return 1;
+    }
+  }
+  if (argc > 2)
+  {
+    filter = argv[2];
+  }
+
+  add_benches();
+
+  input_axis_map_init(&axis_map);
+  wiimote_init(&state);
+
+  instances = (struct wiimote_state *)aligned_alloc(64,
+    MULTIPLEXED_INSTANCES * sizeof(struct wiimote_state));
+  for (n = 0; n < MULTIPLEXED_INSTANCES; n++)
+  {
+    wiimote_init(&instances[n]);
+    while (instances[n].sys.queue != NULL)
+    {
+      report_queue_pop(&instances[n]);
+    }
+  }
+
+  if (use_counters)
+  {
+    counters_open();
+  }
+
+  printf("{\n  \"iterations\": %ld,\n  \"benchmarks\": [", iterations);
+
+  for (i = 0; i < bench_count; i++)
+  {
+    if (filter != NULL && strstr(benches[i].name, filter) == NULL)
+    {
+      continue;
+    }
+
+    counters_start();
+    start = time_ns();
+    bytes = benches[i].run(&benches[i], iterations);
+    end = time_ns();
+    counters_stop();
+
+    printf("%s\n    { \"name\": \"%s\", \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, "
+      "\"bytes_per_op\": %.2f", first ? "" : ",", benches[i].name,
+      (end - start) / (double)iterations, iterations * 1e9 / (end - start),
+      bytes / (double)iterations);
+    for (n = 0; n < COUNTER_COUNT; n++)
+    {
+      print_per_op(counters[n].name, counters[n].value, iterations);
+    }
+    printf(" }");
+    fflush(stdout);
+
+    first = 0;
+  }
+
+  printf("\n  ]\n}\n");
+
+  counters_close();
+
+  for (n = 0; n < MULTIPLEXED_INSTANCES; n++)
+  {
+    wiimote_destroy(&instances[n]);
+  }
+  free(instances);
+
+  wiimote_destroy(&state);
+
+  return 0;
+}
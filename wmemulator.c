@@ -4,7 +4,6 @@
 #include <errno.h>
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/l2cap.h>
-#include <sys/time.h>
 #include <signal.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -16,9 +15,14 @@
 
 #include "sdp.h"
 #include "wiimote.h"
+#include "wm_read_cache.h"
 #include "input.h"
 #include "input_sdl.h"
 #include "input_socket.h"
+#include "input_shm.h"
+#include "input_evdev.h"
+#include "input_replay.h"
+#include "input_mux.h"
 #include "adapter.h"
 #include "wm_print.h"
 
@@ -26,13 +30,42 @@
 #define PSM_CTRL 0x11
 #define PSM_INT 0x13
 
-bdaddr_t host_bdaddr;
-int has_host = 0;
+#define MAX_CONTROLLERS INPUT_MAX_PLAYERS
 
-int sdp_fd, ctrl_fd, int_fd;
-int sock_sdp_fd, sock_ctrl_fd, sock_int_fd;
+//listening sockets for one local adapter, shared by the players using it
+struct listener
+{
+  struct adapter * adapter;
+  bdaddr_t bdaddr;
+  int sdp_fd, ctrl_fd, int_fd;
+};
+
+struct controller
+{
+  int player; //0-based slot
+  struct listener * listener;
+
+  struct wiimote_state state;
+  struct input_state input;
+  struct sdp_state sdp;
+
+  bdaddr_t host_bdaddr;
+  int has_host;
+  int is_connected;
+  int failure;
+  struct wm_timer reconnect; //armed while waiting to retry, on the state's wheel
+  struct wm_read_cache read_cache; //kept across the host's reconnects
+
+  int sdp_fd, ctrl_fd, int_fd;
+};
+
+static struct controller controllers[MAX_CONTROLLERS];
+static int controller_count = 1;
+static struct input_axis_map axis_map;
 
-static int is_connected = 0;
+static struct adapter adapters[MAX_CONTROLLERS];
+static struct listener listeners[MAX_CONTROLLERS];
+static int listener_count = 0;
 
 //signal handler to break out of main loop
 static int running = 1;
@@ -74,7 +107,7 @@ int create_socket()
   return fd;
 }
 
-int l2cap_connect(bdaddr_t bdaddr, int psm)
+int l2cap_connect(bdaddr_t device_bdaddr, bdaddr_t bdaddr, int psm)
 {
   int fd;
   struct sockaddr_l2 addr;
@@ -85,6 +118,21 @@ int l2cap_connect(bdaddr_t bdaddr, int psm)
     return -1;
   }
 
+  //go out through the chosen adapter, several players may share it so the
+  //local psm is left for the kernel to pick
+  if (bacmp(&device_bdaddr, BDADDR_ANY))
+  {
+    memset(&addr, 0, sizeof(addr));
+    addr.l2_family = AF_BLUETOOTH;
+    addr.l2_bdaddr = device_bdaddr;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      close(fd);
+      return -1;
+    }
+  }
+
   memset(&addr, 0, sizeof(addr));
   addr.l2_family = AF_BLUETOOTH;
   addr.l2_psm    = htobs(psm);
@@ -99,7 +147,7 @@ int l2cap_connect(bdaddr_t bdaddr, int psm)
   return fd;
 }
 
-int l2cap_listen(int psm)
+int l2cap_listen(bdaddr_t device_bdaddr, int psm)
 {
   int fd;
   struct sockaddr_l2 addr;
@@ -113,7 +161,7 @@ int l2cap_listen(int psm)
   memset(&addr, 0, sizeof(addr));
   addr.l2_family = AF_BLUETOOTH;
   addr.l2_psm = htobs(psm);
-  addr.l2_bdaddr = *BDADDR_ANY;
+  addr.l2_bdaddr = device_bdaddr;
 
   if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
   {
@@ -130,26 +178,26 @@ int l2cap_listen(int psm)
   return fd;
 }
 
-int listen_for_connections()
+int listen_for_connections(struct listener * listener)
 {
 #ifdef SDP_SERVER
-  sock_sdp_fd = l2cap_listen(PSM_SDP);
-  if (sock_sdp_fd < 0)
+  listener->sdp_fd = l2cap_listen(listener->bdaddr, PSM_SDP);
+  if (listener->sdp_fd < 0)
   {
     printf("can't listen on psm %d: %s\n", PSM_SDP, strerror(errno));
     return -1;
   }
 #endif
 
-  sock_ctrl_fd = l2cap_listen(PSM_CTRL);
-  if (sock_ctrl_fd < 0)
+  listener->ctrl_fd = l2cap_listen(listener->bdaddr, PSM_CTRL);
+  if (listener->ctrl_fd < 0)
   {
     printf("can't listen on psm %d: %s\n", PSM_CTRL, strerror(errno));
     return -1;
   }
 
-  sock_int_fd = l2cap_listen(PSM_INT);
-  if (sock_int_fd < 0)
+  listener->int_fd = l2cap_listen(listener->bdaddr, PSM_INT);
+  if (listener->int_fd < 0)
   {
     printf("can't listen on psm %d: %s\n", PSM_INT, strerror(errno));
     return -1;
@@ -178,58 +226,229 @@ int accept_connection(int socket_fd, bdaddr_t * bdaddr)
   return fd;
 }
 
-int connect_to_host()
+int connect_to_host(struct controller * controller)
 {
-  ctrl_fd = l2cap_connect(host_bdaddr, PSM_CTRL);
-  if (ctrl_fd < 0)
+  controller->ctrl_fd = l2cap_connect(controller->listener->bdaddr, controller->host_bdaddr, PSM_CTRL);
+  if (controller->ctrl_fd < 0)
   {
     printf("can't connect to host psm %d: %s\n", PSM_CTRL, strerror(errno));
     return -1;
   }
 
-  int_fd = l2cap_connect(host_bdaddr, PSM_INT);
-  if (int_fd < 0)
+  controller->int_fd = l2cap_connect(controller->listener->bdaddr, controller->host_bdaddr, PSM_INT);
+  if (controller->int_fd < 0)
   {
     printf("can't connect to host psm %d: %s\n", PSM_INT, strerror(errno));
+    close(controller->ctrl_fd);
+    controller->ctrl_fd = -1;
     return -1;
   }
 
   return 0;
 }
 
-void disconnect()
+void disconnect(struct controller * controller)
 {
-  shutdown(sdp_fd, SHUT_RDWR);
-  shutdown(ctrl_fd, SHUT_RDWR);
-  shutdown(int_fd, SHUT_RDWR);
+  shutdown(controller->sdp_fd, SHUT_RDWR);
+  shutdown(controller->ctrl_fd, SHUT_RDWR);
+  shutdown(controller->int_fd, SHUT_RDWR);
+
+  close(controller->sdp_fd);
+  close(controller->ctrl_fd);
+  close(controller->int_fd);
+
+  controller->sdp_fd = -1;
+  controller->ctrl_fd = -1;
+  controller->int_fd = -1;
+
+  controller->is_connected = 0;
+}
+
+//the first slot on an adapter still waiting for a host, incoming connections
+//on that adapter are given to it
+struct controller * pending_controller(struct listener * listener)
+{
+  int i;
+
+  for (i = 0; i < controller_count; i++)
+  {
+    if (controllers[i].listener == listener &&
+      !controllers[i].is_connected && !controllers[i].has_host)
+    {
+      return &controllers[i];
+    }
+  }
+
+  return NULL;
+}
+
+int accept_pending(int socket_fd, int * out_fd, bdaddr_t * bdaddr)
+{
+  int fd = accept_connection(socket_fd, bdaddr);
+  if (fd < 0)
+  {
+    return -1;
+  }
+
+  if (out_fd == NULL)
+  {
+    //every slot is taken
+    close(fd);
+    return 0;
+  }
+
+  if (*out_fd >= 0)
+  {
+    close(*out_fd);
+  }
+  *out_fd = fd;
+
+  return 0;
+}
 
-  close(sdp_fd);
-  close(ctrl_fd);
-  close(int_fd);
+// Sets up the input source named by argv[0] with its arguments. Returns -1
+// if they aren't valid, 1 if the source can't be set up.
+int init_input_source(int argc, char *argv[], struct input_source * input_source)
+{
+  if (argc == 1 && strcmp(argv[0], "gui") == 0)
+  {
+    input_sdl_init();
+    *input_source = input_source_sdl;
+  }
+  else if (argc == 2 && strcmp(argv[0], "unix") == 0)
+  {
+    input_socket_init_unix_at_path(argv[1]);
+    *input_source = input_source_socket;
+  }
+  else if (argc == 2 && strcmp(argv[0], "ip") == 0)
+  {
+    input_socket_init_ip_on_port(argv[1]);
+    *input_source = input_source_socket;
+  }
+  else if (argc == 2 && strcmp(argv[0], "shm") == 0)
+  {
+    input_shm_init(argv[1]);
+    *input_source = input_source_shm;
+  }
+  else if (argc > 1 && strcmp(argv[0], "evdev") == 0)
+  {
+    if (input_evdev_init((char const * const *)&argv[1], argc - 1))
+    {
+      return 1;
+    }
+    *input_source = input_source_evdev;
+  }
+  else if (argc == 2 && strcmp(argv[0], "replay") == 0)
+  {
+    //at the pace it was recorded at
+    if (input_replay_init(argv[1], true))
+    {
+      return 1;
+    }
+    *input_source = input_source_replay;
+  }
+  else
+  {
+    return -1;
+  }
 
-  sdp_fd = 0;
-  ctrl_fd = 0;
-  int_fd = 0;
+  return 0;
 }
 
 void print_usage(char *argv0)
 {
-  printf("usage: %s [ <wii-bdaddr> [ gui | unix <path> | ip <port> ] ]\n", argv0);
+  printf("usage: %s [ -p <players> ] [ -d <dev> ]... [ -l <ms> ] [ -w <file> ] [ <wii-bdaddr> [ gui | unix <path> | ip <port> | shm <name> | evdev <device>... | replay <file> ] [ + <source> ]... ]\n", argv0);
+  printf("  -w records the input to a file that replay plays back\n");
+  printf("  sources joined by + are all read at once, the first ones win a held button or axis\n");
+  printf("  each -d binds the next player to an adapter, given as an index, hciN or its address\n");
+  printf("  players without one share the first adapter (default hci0)\n");
 }
 
 int main(int argc, char *argv[])
 {
   struct input_source input_source;
 
-  struct pollfd pfd[6];
+  struct pollfd pfd[3 * MAX_CONTROLLERS + 3 * MAX_CONTROLLERS];
+  struct pollfd * cpfd;
   unsigned char buf[256];
   ssize_t len;
 
-  struct wiimote_state state;
+  struct wiimote_state * states[MAX_CONTROLLERS];
+  struct input_state * inputs[MAX_CONTROLLERS];
+  struct print_state print;
+
+  struct controller * controller;
+  struct controller * pending[MAX_CONTROLLERS];
+  struct listener * listener;
+  bdaddr_t host_bdaddr;
+  int has_host = 0;
+
+  const char * dev_strs[MAX_CONTROLLERS];
+  int dev_count = 0;
 
   int send_report_now = 1;
   int input_result;
-  int failure = 0;
+  uint64_t sample_delay_us = 0;
+  const char * record_path = NULL;
+  int source_count, result;
+  int i, j, opt;
+
+  while ((opt = getopt(argc, argv, "+p:d:l:w:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'p':
+        controller_count = atoi(optarg);
+        if (controller_count < 1 || controller_count > MAX_CONTROLLERS)
+        {
+          printf("players must be between 1 and %d\n", MAX_CONTROLLERS);
+          return 1;
+        }
+        break;
+      case 'd':
+        if (dev_count >= MAX_CONTROLLERS)
+        {
+          printf("at most %d adapters can be given\n", MAX_CONTROLLERS);
+          return 1;
+        }
+        dev_strs[dev_count++] = optarg;
+        break;
+      case 'l':
+        //reports look this far back at stamped pointer and axis input
+        if (atoi(optarg) < 0 || atoi(optarg) > 1000)
+        {
+          printf("input delay must be between 0 and 1000 ms\n");
+          return 1;
+        }
+        sample_delay_us = atoi(optarg) * 1000ULL;
+        break;
+      case 'w':
+        record_path = optarg;
+        break;
+      default:
+        print_usage(*argv);
+        return 1;
+    }
+  }
+
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if (dev_count > controller_count)
+  {
+    controller_count = dev_count;
+  }
+
+  for (i = 0; i < controller_count; i++)
+  {
+    adapter_init(&adapters[i], NULL);
+    if (adapter_select(&adapters[i], (i < dev_count) ? dev_strs[i] :
+      (dev_count > 0) ? dev_strs[0] : NULL) < 0)
+    {
+      printf("failed to find Bluetooth adapter for player %d\n", i + 1);
+      return 1;
+    }
+  }
 
   if (argc > 1)
   {
@@ -248,25 +467,56 @@ int main(int argc, char *argv[])
         return 1;
     }
   }
-  if (argc <= 2 || strcmp(argv[2], "gui") == 0)
+  if (argc <= 2)
   {
     input_sdl_init();
     input_source = input_source_sdl;
   }
-  else if (argc > 3 && strcmp(argv[2], "unix") == 0)
-  {
-    input_socket_init_unix_at_path(argv[3]);
-    input_source = input_source_socket;
-  }
-  else if (argc > 3 && strcmp(argv[3], "ip") == 0)
+  else
   {
-    input_socket_init_ip_on_port(argv[3]);
-    input_source = input_source_socket;
+    //sources separated by +, merged when there are several
+    for (i = 2, source_count = 0; i < argc; i = j + 1, source_count++)
+    {
+      for (j = i; j < argc && strcmp(argv[j], "+") != 0; j++)
+      {
+      }
+
+      result = init_input_source(j - i, &argv[i], &input_source);
+      if (result < 0)
+      {
+        print_usage(*argv);
+      }
+      if (result)
+      {
+        return 1;
+      }
+
+      //SDL only takes events on the thread that opened the window
+      if ((j < argc || source_count > 0) &&
+        (strcmp(argv[i], "gui") == 0 || input_mux_add(&input_source)))
+      {
+        printf("%s input can't be used with other sources\n", argv[i]);
+        return 1;
+      }
+    }
+
+    if (source_count > 1)
+    {
+      if (input_mux_start())
+      {
+        return 1;
+      }
+      input_source = input_source_mux;
+    }
   }
-  else
+
+  if (record_path != NULL)
   {
-    print_usage(*argv);
-    return 1;
+    if (input_replay_record_init(record_path, &input_source))
+    {
+      return 1;
+    }
+    input_source = input_source_record;
   }
 
   //set up unload signals
@@ -274,48 +524,111 @@ int main(int argc, char *argv[])
   signal(SIGTERM, sig_handler);
   signal(SIGHUP, sig_handler);
   
-  if (set_up_device(NULL) < 0)
+  if (set_up_devices(adapters, controller_count) < 0)
   {
     printf("failed to set up Bluetooth device\n");
     return 1;
   }
 
+  //one set of listening sockets per distinct adapter
+  for (i = 0; i < controller_count; i++)
+  {
+    for (j = 0; j < listener_count; j++)
+    {
+      if (listeners[j].adapter->device_id == adapters[i].device_id)
+      {
+        break;
+      }
+    }
+
+    if (j == listener_count)
+    {
+      listener = &listeners[listener_count++];
+      listener->adapter = &adapters[i];
+      listener->sdp_fd = -1;
+      listener->ctrl_fd = -1;
+      listener->int_fd = -1;
+
+      //with a single adapter, keep accepting on any address like before
+      listener->bdaddr = (dev_count > 0) ? adapters[i].bdaddr : *BDADDR_ANY;
+    }
+
+    controllers[i].listener = &listeners[j];
+  }
+
 #ifndef SDP_SERVER
   if (register_wiimote_sdp_record() < 0)
   {
     printf("failed to add Wiimote SDP record\n");
-    restore_device();
+    restore_devices(adapters, controller_count);
     return 1;
   }
 #endif
 
-  wiimote_init(&state);
+  print_init(&print);
+  input_axis_map_init(&axis_map);
 
-  if (has_host)
+  for (i = 0; i < controller_count; i++)
   {
-    printf("connecting to host...\n");
-    if (connect_to_host() < 0)
+    controller = &controllers[i];
+
+    controller->player = i;
+    if (wiimote_init(&controller->state))
     {
-      printf("couldn't connect\n");
-      running = 0;
+      printf("out of memory\n");
+      return 1;
     }
-    else
+    wm_read_cache_init(&controller->read_cache);
+    wiimote_set_read_cache(&controller->state, &controller->read_cache);
+    wm_timer_init(&controller->reconnect, NULL, controller);
+    input_init(&controller->input, &axis_map);
+    controller->input.sample_delay_us = sample_delay_us;
+    sdp_init(&controller->sdp);
+
+    controller->host_bdaddr = host_bdaddr;
+    controller->has_host = has_host;
+    controller->sdp_fd = -1;
+    controller->ctrl_fd = -1;
+    controller->int_fd = -1;
+
+    states[i] = &controller->state;
+    inputs[i] = &controller->input;
+  }
+
+  if (has_host)
+  {
+    for (i = 0; i < controller_count; i++)
     {
+      controller = &controllers[i];
+
+      printf("player %d connecting to host...\n", i + 1);
+      if (connect_to_host(controller) < 0)
+      {
+        printf("couldn't connect\n");
+        running = 0;
+        break;
+      }
+
       char straddr[18];
-      ba2str(&host_bdaddr, straddr);
-      printf("connected to %s\n", straddr);
+      ba2str(&controller->host_bdaddr, straddr);
+      printf("player %d connected to %s\n", i + 1, straddr);
 
-      is_connected = 1;
+      controller->is_connected = 1;
     }
   }
   else
   {
-    if (listen_for_connections() < 0)
+    for (j = 0; j < listener_count; j++)
     {
-      printf("couldn't listen\n");
-      running = 0;
+      if (listen_for_connections(&listeners[j]) < 0)
+      {
+        printf("couldn't listen on hci%d\n", listeners[j].adapter->device_id);
+        running = 0;
+        break;
+      }
     }
-    else
+
+    if (running)
     {
       printf("listening for connections... (press wii's sync button)\n");
     }
@@ -325,179 +638,256 @@ int main(int argc, char *argv[])
   {
     memset(&pfd, 0, sizeof(pfd));
 
-    pfd[0].fd = sock_sdp_fd;
-    pfd[1].fd = sock_ctrl_fd;
-    pfd[2].fd = sock_int_fd;
+    for (j = 0; j < listener_count; j++)
+    {
+      cpfd = &pfd[3 * j];
+      pending[j] = pending_controller(&listeners[j]);
 
-    pfd[3].fd = sdp_fd;
+      cpfd[0].fd = listeners[j].sdp_fd;
+      cpfd[1].fd = listeners[j].ctrl_fd;
+      cpfd[2].fd = listeners[j].int_fd;
 
-    pfd[4].fd = ctrl_fd;
-    pfd[5].fd = int_fd;
+      if (pending[j] != NULL)
+      {
+        cpfd[0].events = POLLIN;
+        cpfd[1].events = POLLIN;
+        cpfd[2].events = POLLIN;
+      }
+    }
 
-    if (!is_connected)
+    for (i = 0; i < controller_count; i++)
     {
-      pfd[0].events = POLLIN;
-      pfd[1].events = POLLIN;
-      pfd[2].events = POLLIN;
+      cpfd = &pfd[3 * listener_count + 3 * i];
 
-      pfd[3].events = POLLIN | POLLOUT;
-    }
-    else
-    {
-      pfd[4].events = POLLIN;
-      pfd[5].events = POLLIN;
+      cpfd[0].fd = controllers[i].sdp_fd;
+      cpfd[1].fd = controllers[i].ctrl_fd;
+      cpfd[2].fd = controllers[i].int_fd;
 
-      pfd[5].events |= POLLOUT;
+      if (!controllers[i].is_connected)
+      {
+        cpfd[0].events = POLLIN | POLLOUT;
+      }
+      else
+      {
+        cpfd[1].events = POLLIN;
+        cpfd[2].events = POLLIN | POLLOUT;
+      }
     }
 
-    if (poll(pfd, 6, 20) < 0)
+    if (poll(pfd, 3 * listener_count + 3 * controller_count, 20) < 0)
     {
       printf("poll error\n");
       break;
     }
 
-    if (pfd[4].revents & POLLERR)
+    for (j = 0; j < listener_count; j++)
     {
-      printf("error on ctrl psm\n");
-      break;
+      cpfd = &pfd[3 * j];
+      controller = pending[j];
+
+      if (cpfd[0].revents & POLLIN)
+      {
+        if (accept_pending(cpfd[0].fd, controller ? &controller->sdp_fd : NULL, NULL) < 0)
+        {
+          printf("error accepting sdp connection\n");
+          running = 0;
+        }
+      }
+      if (cpfd[1].revents & POLLIN)
+      {
+        if (accept_pending(cpfd[1].fd, controller ? &controller->ctrl_fd : NULL, NULL) < 0)
+        {
+          printf("error accepting ctrl connection\n");
+          running = 0;
+        }
+      }
+      if (cpfd[2].revents & POLLIN)
+      {
+        if (accept_pending(cpfd[2].fd, controller ? &controller->int_fd : NULL,
+          controller ? &controller->host_bdaddr : NULL) < 0)
+        {
+          printf("error accepting int connection\n");
+          running = 0;
+        }
+        else if (controller != NULL)
+        {
+          char straddr[18];
+          ba2str(&controller->host_bdaddr, straddr);
+          printf("player %d connected to %s\n", controller->player + 1, straddr);
+
+          controller->is_connected = 1;
+          controller->has_host = 1;
+        }
+      }
     }
-    if (pfd[5].revents & POLLERR)
+
+    if (!running)
     {
-      printf("error on data psm\n");
       break;
     }
 
-    if (pfd[0].revents & POLLIN)
+    for (i = 0; i < controller_count; i++)
     {
-      sdp_fd = accept_connection(pfd[0].fd, NULL);
-      if (sdp_fd < 0)
+      cpfd = &pfd[3 * listener_count + 3 * i];
+      controller = &controllers[i];
+
+      if (cpfd[1].revents & POLLERR)
       {
-        printf("error accepting sdp connection\n");
-        break;
+        printf("player %d: error on ctrl psm\n", i + 1);
+        disconnect(controller);
+        continue;
       }
-    }
-    if (pfd[1].revents & POLLIN)
-    {
-      ctrl_fd = accept_connection(pfd[1].fd, NULL);
-      if (ctrl_fd < 0)
+      if (cpfd[2].revents & POLLERR)
       {
-        printf("error accepting ctrl connection\n");
-        break;
+        printf("player %d: error on data psm\n", i + 1);
+        disconnect(controller);
+        continue;
       }
-    }
-    if (pfd[2].revents & POLLIN)
-    {
-      int_fd = accept_connection(pfd[2].fd, &host_bdaddr);
-      if (int_fd < 0)
+
+      if (cpfd[0].revents & POLLIN)
       {
-        printf("error accepting int connection\n");
-        break;
+        len = recv(controller->sdp_fd, buf, 32, MSG_DONTWAIT);
+        if (len > 0)
+        {
+          sdp_recv_data(&controller->sdp, buf, len);
+        }
       }
-
-      char straddr[18];
-      ba2str(&host_bdaddr, straddr);
-      printf("connected to %s\n", straddr);
-
-      is_connected = 1;
-      has_host = 1;
-    }
-
-    if (pfd[3].revents & POLLIN)
-    {
-      len = recv(sdp_fd, buf, 32, MSG_DONTWAIT);
-      if (len > 0)
+      if (cpfd[0].revents & POLLOUT)
       {
-        sdp_recv_data(buf, len);
+        len = sdp_get_data(&controller->sdp, buf);
+        if (len > 0)
+        {
+          send(controller->sdp_fd, buf, len, MSG_DONTWAIT);
+        }
       }
-    }
-    if (pfd[3].revents & POLLOUT)
-    {
-      len = sdp_get_data(buf);
-      if (len > 0)
+
+      if (cpfd[2].revents & POLLIN)
       {
-        send(sdp_fd, buf, len, MSG_DONTWAIT);
+        len = recv(controller->int_fd, buf, 32, MSG_DONTWAIT);
+        if (len > 0)
+        {
+          print_report(&print, buf, len);
+          process_report(&controller->state, buf, len);
+        }
       }
     }
 
-    if (pfd[5].revents & POLLIN)
+    input_result = input_update_players(states, inputs, controller_count, &input_source);
+
+    print.show_reports = 0;
+    for (i = 0; i < controller_count; i++)
     {
-      len = recv(int_fd, buf, 32, MSG_DONTWAIT);
-      if (len > 0)
-      {
-        print_report(buf, len);
-        process_report(&state, buf, len);
-      }
+      print.show_reports |= controllers[i].input.show_reports;
     }
 
-    input_result = input_update(&state, &input_source);
     if (input_result)
     {
       running = 0;
-      if (input_result == -2)
+      for (i = 0; i < controller_count; i++)
       {
-        power_off_host(&host_bdaddr);
-      }
-      else
-      {
-        disconnect(&host_bdaddr);
+        if (!controllers[i].is_connected)
+        {
+          continue;
+        }
+
+        if (input_result == -2)
+        {
+          //once per host, however many of its players are connected
+          for (j = 0; j < i; j++)
+          {
+            if (controllers[j].is_connected &&
+              controllers[j].listener->adapter == controllers[i].listener->adapter &&
+              !bacmp(&controllers[j].host_bdaddr, &controllers[i].host_bdaddr))
+            {
+              break;
+            }
+          }
+          if (j == i)
+          {
+            power_off_host(controllers[i].listener->adapter, &controllers[i].host_bdaddr);
+          }
+        }
+        else
+        {
+          disconnect(&controllers[i]);
+        }
       }
     }
 
-    if (is_connected && send_report_now)
+    for (i = 0; i < controller_count; i++)
     {
-      if (pfd[5].revents & POLLOUT)
+      cpfd = &pfd[3 * listener_count + 3 * i];
+      controller = &controllers[i];
+
+      if (controller->is_connected && send_report_now)
       {
-        len = generate_report(&state, buf);
-        if (len > 0)
+        if (cpfd[2].revents & POLLOUT)
         {
-          print_report(buf, len);
-          send(int_fd, buf, len, MSG_DONTWAIT);
+          len = generate_report(&controller->state, buf);
+          if (len > 0)
+          {
+            print_report(&print, buf, len);
+            send(controller->int_fd, buf, len, MSG_DONTWAIT);
+          }
+
+          controller->failure = 0;
         }
-
-        failure = 0;
-      }
-      else
-      {
-        if (++failure > 5)
+        else
         {
-          printf("connection timed out, attemping to reconnect...\n");
-          disconnect();
-          is_connected = 0;
+          if (++controller->failure > 5)
+          {
+            printf("player %d: connection timed out, attemping to reconnect...\n", i + 1);
+            disconnect(controller);
+          }
         }
       }
-    }
 
-    if (has_host && !is_connected)
-    {
-      if (connect_to_host() < 0)
+      if (running && controller->has_host && !controller->is_connected)
       {
-        usleep(500*1000);
+        wiimote_run_timers(&controller->state);
       }
-      else
+
+      if (running && controller->has_host && !controller->is_connected &&
+        !controller->reconnect.armed)
       {
-        printf("connected to host\n");
-        is_connected = 1;
+        if (connect_to_host(controller) < 0)
+        {
+          wm_timer_start(&controller->state.sys.timers->wheel, &controller->reconnect, 500*1000);
+        }
+        else
+        {
+          printf("player %d connected to host\n", i + 1);
+          controller->is_connected = 1;
+        }
       }
     }
   }
 
   printf("cleaning up...\n");
 
-  disconnect();
+  for (i = 0; i < controller_count; i++)
+  {
+    disconnect(&controllers[i]);
+  }
 
-  close(sock_sdp_fd);
-  close(sock_ctrl_fd);
-  close(sock_int_fd);
+  for (j = 0; j < listener_count; j++)
+  {
+    close(listeners[j].sdp_fd);
+    close(listeners[j].ctrl_fd);
+    close(listeners[j].int_fd);
+  }
 
-  restore_device();
+  restore_devices(adapters, controller_count);
 
 #ifndef SDP_SERVER
   unregister_wiimote_sdp_record();
 #endif
 
-  wiimote_destroy(&state);
+  for (i = 0; i < controller_count; i++)
+  {
+    wiimote_destroy(&controllers[i].state);
+  }
   input_source.unload();
 
   return 0;
 }
-
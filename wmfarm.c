@@ -0,0 +1,456 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "wiimote.h"
+#include "input.h"
+#include "loopback.h"
+
+// Load generator: runs many emulated controllers over loopback links,
+// sharded across one pinned worker thread per core, and measures what a
+// host would see (report rate, inter-report jitter).
+
+#define JITTER_MAX_US 100000
+
+struct farm_instance
+{
+  struct wiimote_state state;
+  struct input_state input;
+  struct loopback link;
+  int script_pos;
+
+  //host side bookkeeping
+  uint64_t last_rx_ts;
+};
+
+struct shard
+{
+  pthread_t worker;
+  pthread_t host;
+  int cpu;
+
+  struct farm_instance * instances;
+  int count;
+
+  //written by the worker
+  uint64_t reports_sent;
+  uint64_t send_failures;
+  uint64_t late_ticks;
+
+  //written by the host thread, on a cache line of its own
+  uint64_t reports_received __attribute__((aligned(64)));
+  //inter-report jitter histogram in microseconds, last bucket is overflow
+  uint32_t * jitter;
+} __attribute__((aligned(64)));
+
+static atomic_bool running = true;
+static uint64_t period_ns;
+//wide enough that -m can't wrap into range
+static long reporting_mode = 0x31;
+static struct input_axis_map axis_map;
+
+//scripted input, each instance starts at a different step so they don't
+//all press the same button on the same tick
+static const struct input_event script[] =
+{
+  { .type = INPUT_EVENT_TYPE_BUTTON, .button_event = { true, INPUT_BUTTON_WIIMOTE_A } },
+  { .type = INPUT_EVENT_TYPE_ANALOG_MOTION, .analog_motion_event = { true, 8, 4, 0, INPUT_ANALOG_MOTION_POINTER } },
+  { .type = INPUT_EVENT_TYPE_BUTTON, .button_event = { true, INPUT_BUTTON_WIIMOTE_RIGHT } },
+  { .type = INPUT_EVENT_TYPE_BUTTON, .button_event = { false, INPUT_BUTTON_WIIMOTE_A } },
+  { .type = INPUT_EVENT_TYPE_ANALOG_MOTION, .analog_motion_event = { true, -8, -4, 0, INPUT_ANALOG_MOTION_POINTER } },
+  { .type = INPUT_EVENT_TYPE_BUTTON, .button_event = { false, INPUT_BUTTON_WIIMOTE_RIGHT } },
+  { .type = INPUT_EVENT_TYPE_ANALOG_MOTION, .analog_motion_event = { true, 0, 0, 0, INPUT_ANALOG_MOTION_STEER_LEFT } },
+  { .type = INPUT_EVENT_TYPE_BUTTON, .button_event = { true, INPUT_BUTTON_WIIMOTE_B } },
+  { .type = INPUT_EVENT_TYPE_ANALOG_MOTION, .analog_motion_event = { false, 0, 0, 0, INPUT_ANALOG_MOTION_STEER_LEFT } },
+  { .type = INPUT_EVENT_TYPE_BUTTON, .button_event = { false, INPUT_BUTTON_WIIMOTE_B } },
+};
+
+#define SCRIPT_LEN (sizeof(script) / sizeof(script[0]))
+
+static uint64_t time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ts)
+{
+  struct timespec t = { .tv_sec = ts / 1000000000, .tv_nsec = ts % 1000000000 };
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
+}
+
+static long rss_bytes()
+{
+  long pages = 0, resident = 0;
+  FILE * f = fopen("/proc/self/statm", "r");
+
+  if (f == NULL)
+  {
+    return 0;
+  }
+
+  if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+  {
+    resident = 0;
+  }
+  fclose(f);
+
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void pin_to_cpu(pthread_t thread, int cpu)
+{
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+  {
+    printf("warning: couldn't pin worker to cpu %d\n", cpu);
+  }
+}
+
+static void * worker_run(void * arg)
+{
+  struct shard * shard = (struct shard *)arg;
+  struct farm_instance * instance;
+  uint8_t buf[64];
+  struct input_event event;
+  uint64_t next_ts = time_ns();
+  ssize_t len;
+  int i;
+
+  while (atomic_load_explicit(&running, memory_order_relaxed))
+  {
+    for (i = 0; i < shard->count; i++)
+    {
+      instance = &shard->instances[i];
+
+      //output reports from the host (reporting mode etc.)
+      while ((len = recv(instance->link.device_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      {
+        process_report(&instance->state, buf, len);
+      }
+
+      event = script[instance->script_pos];
+      if (++instance->script_pos == SCRIPT_LEN)
+      {
+        instance->script_pos = 0;
+      }
+      input_process_event(&instance->state, &instance->input, &event);
+      input_tick(&instance->state, &instance->input);
+
+      len = generate_report(&instance->state, buf);
+      if (len > 0)
+      {
+        if (send(instance->link.device_fd, buf, len, MSG_DONTWAIT) == len)
+        {
+          shard->reports_sent++;
+        }
+        else
+        {
+          shard->send_failures++;
+        }
+      }
+    }
+
+    if (period_ns == 0)
+    {
+      continue;
+    }
+
+    next_ts += period_ns;
+    if (time_ns() > next_ts)
+    {
+      //fell behind, don't try to catch up with a burst
+      shard->late_ticks++;
+      next_ts = time_ns();
+    }
+    else
+    {
+      sleep_until(next_ts);
+    }
+  }
+
+  return NULL;
+}
+
+static void * host_run(void * arg)
+{
+  struct shard * shard = (struct shard *)arg;
+  struct farm_instance * instance;
+  struct epoll_event ev, events[64];
+  uint8_t buf[64];
+  //continuous reporting in the chosen mode
+  uint8_t set_mode[] = { 0xa2, 0x12, 0x04, reporting_mode };
+  //the interleaved modes alternate both halves, one per report
+  uint8_t other_half = (reporting_mode == 0x3e) ? 0x3f :
+    (reporting_mode == 0x3f) ? 0x3e : reporting_mode;
+  uint64_t now, interval, jitter;
+  ssize_t len;
+  int epfd, n, i;
+
+  epfd = epoll_create1(0);
+  if (epfd < 0)
+  {
+    printf("epoll_create1: %s\n", strerror(errno));
+    return NULL;
+  }
+
+  for (i = 0; i < shard->count; i++)
+  {
+    instance = &shard->instances[i];
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = instance;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, instance->link.host_fd, &ev);
+
+    send(instance->link.host_fd, set_mode, sizeof(set_mode), MSG_DONTWAIT);
+  }
+
+  while (atomic_load_explicit(&running, memory_order_relaxed))
+  {
+    n = epoll_wait(epfd, events, 64, 100);
+
+    for (i = 0; i < n; i++)
+    {
+      instance = (struct farm_instance *)events[i].data.ptr;
+
+      while ((len = recv(instance->link.host_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      {
+        if (buf[0] != 0xa1 || (buf[1] != reporting_mode && buf[1] != other_half))
+        {
+          continue;
+        }
+
+        now = time_ns();
+        shard->reports_received++;
+
+        if (instance->last_rx_ts != 0)
+        {
+          interval = (now - instance->last_rx_ts) / 1000;
+          jitter = (period_ns == 0) ? interval :
+            (interval > period_ns / 1000 ? interval - period_ns / 1000 : period_ns / 1000 - interval);
+
+          shard->jitter[jitter < JITTER_MAX_US ? jitter : JITTER_MAX_US]++;
+        }
+        instance->last_rx_ts = now;
+      }
+    }
+  }
+
+  close(epfd);
+
+  return NULL;
+}
+
+static uint64_t percentile(const uint64_t * hist, uint64_t total, double p)
+{
+  uint64_t target = (uint64_t)(total * p), seen = 0;
+  int i;
+
+  for (i = 0; i <= JITTER_MAX_US; i++)
+  {
+    seen += hist[i];
+    if (seen > target)
+    {
+      return i;
+    }
+  }
+
+  return JITTER_MAX_US;
+}
+
+static void raise_fd_limit()
+{
+  struct rlimit rl;
+
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0)
+  {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
+
+void print_usage(char *argv0)
+{
+  printf("usage: %s [ -n <instances> ] [ -j <threads> ] [ -t <seconds> ] [ -r <reports/s per instance, 0 = unthrottled> ] [ -m <mode> ]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  int instance_count = 256;
+  int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  int seconds = 5;
+  int rate = 100;
+
+  struct shard * shards;
+  struct farm_instance * instances;
+  uint64_t * jitter;
+  uint64_t sent = 0, received = 0, send_failures = 0, late_ticks = 0, samples = 0;
+  long rss_before, rss_after;
+  char * end;
+  int i, j, first, opt;
+
+  while ((opt = getopt(argc, argv, "n:j:t:r:m:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n':
+        instance_count = atoi(optarg);
+        break;
+      case 'j':
+        thread_count = atoi(optarg);
+        break;
+      case 't':
+        seconds = atoi(optarg);
+        break;
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      case 'm':
+        reporting_mode = strtol(optarg, &end, 16);
+        if (end == optarg || *end != '\0')
+        {
+          reporting_mode = -1;
+        }
+        break;
+      default:
+        print_usage(*argv);
+        return 1;
+    }
+  }
+
+  if (instance_count < 1 || thread_count < 1 || seconds < 1 || rate < 0 ||
+    reporting_mode < 0x30 || reporting_mode > 0x3f || !wiimote_is_data_mode(reporting_mode))
+  {
+    print_usage(*argv);
+    return 1;
+  }
+
+  if (thread_count > instance_count)
+  {
+    thread_count = instance_count;
+  }
+
+  period_ns = (rate > 0) ? 1000000000 / rate : 0;
+
+  raise_fd_limit();
+
+  rss_before = rss_bytes();
+
+  //keep each state, and the counters of each thread, on their own cache lines
+  instances = (struct farm_instance *)aligned_alloc(64, instance_count * sizeof(struct farm_instance));
+  shards = (struct shard *)aligned_alloc(64, thread_count * sizeof(struct shard));
+  if (instances == NULL || shards == NULL)
+  {
+    printf("out of memory\n");
+    return 1;
+  }
+  memset(instances, 0, instance_count * sizeof(struct farm_instance));
+  memset(shards, 0, thread_count * sizeof(struct shard));
+
+  //one read-only mapping for every instance
+  input_axis_map_init(&axis_map);
+
+  for (i = 0; i < instance_count; i++)
+  {
+    if (wiimote_init(&instances[i].state))
+    {
+      printf("out of memory\n");
+      return 1;
+    }
+    input_init(&instances[i].input, &axis_map);
+    instances[i].script_pos = i % SCRIPT_LEN;
+
+    if (loopback_open(&instances[i].link) < 0)
+    {
+      printf("can't open loopback link %d: %s\n", i, strerror(errno));
+      return 1;
+    }
+  }
+
+  rss_after = rss_bytes();
+
+  //contiguous runs of instances per shard, remainder spread over the first ones
+  first = 0;
+  for (i = 0; i < thread_count; i++)
+  {
+    shards[i].cpu = i % sysconf(_SC_NPROCESSORS_ONLN);
+    shards[i].instances = &instances[first];
+    shards[i].count = instance_count / thread_count + (i < instance_count % thread_count);
+    shards[i].jitter = (uint32_t *)calloc(JITTER_MAX_US + 1, sizeof(uint32_t));
+    first += shards[i].count;
+  }
+
+  printf("%d instances on %d threads, %d reports/s each, mode 0x%02lx, %d s\n",
+    instance_count, thread_count, rate, reporting_mode, seconds);
+
+  for (i = 0; i < thread_count; i++)
+  {
+    pthread_create(&shards[i].host, NULL, host_run, &shards[i]);
+    pthread_create(&shards[i].worker, NULL, worker_run, &shards[i]);
+    pin_to_cpu(shards[i].worker, shards[i].cpu);
+  }
+
+  sleep(seconds);
+  atomic_store(&running, false);
+
+  jitter = (uint64_t *)calloc(JITTER_MAX_US + 1, sizeof(uint64_t));
+
+  for (i = 0; i < thread_count; i++)
+  {
+    pthread_join(shards[i].worker, NULL);
+    pthread_join(shards[i].host, NULL);
+
+    sent += shards[i].reports_sent;
+    received += shards[i].reports_received;
+    send_failures += shards[i].send_failures;
+    late_ticks += shards[i].late_ticks;
+
+    for (j = 0; j <= JITTER_MAX_US; j++)
+    {
+      jitter[j] += shards[i].jitter[j];
+      samples += shards[i].jitter[j];
+    }
+    free(shards[i].jitter);
+  }
+
+  printf("reports/s: sent %.0f received %.0f (send failures %llu, late ticks %llu)\n",
+    sent / (double)seconds, received / (double)seconds,
+    (unsigned long long)send_failures, (unsigned long long)late_ticks);
+  printf("%s us: p50 %llu p99 %llu%s\n",
+    (period_ns == 0) ? "inter-report interval" : "inter-report jitter",
+    (unsigned long long)percentile(jitter, samples, 0.50),
+    (unsigned long long)percentile(jitter, samples, 0.99),
+    percentile(jitter, samples, 0.99) >= JITTER_MAX_US ? "+" : "");
+  printf("memory per instance: %zu bytes state + %zu bytes registers, %ld bytes resident\n",
+    sizeof(struct farm_instance), sizeof(struct wiimote_registers),
+    (rss_after - rss_before) / instance_count);
+
+  for (i = 0; i < instance_count; i++)
+  {
+    loopback_close(&instances[i].link);
+    wiimote_destroy(&instances[i].state);
+  }
+
+  free(jitter);
+  free(shards);
+  free(instances);
+
+  return 0;
+}
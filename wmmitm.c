@@ -31,8 +31,6 @@ int sdp_fd, ctrl_fd, int_fd;
 int wm_ctrl_fd, wm_int_fd;
 int sock_sdp_fd, sock_ctrl_fd, sock_int_fd;
 
-extern int show_reports;
-
 static int has_host = 0;
 static int is_connected = 0;
 
@@ -256,6 +254,12 @@ void disconnect_from_wiimote()
   wm_int_fd = 0;
 }
 
+void print_usage(char *argv0)
+{
+  printf("usage: %s [ -H <host-dev> ] [ -W <wiimote-dev> ] [ <wiimote-bdaddr> [ <wii-bdaddr> ] ]\n", argv0);
+  printf("  devices are given as an index, hciN or the adapter's address (default hci0 and hci1)\n");
+}
+
 int main(int argc, char *argv[])
 {
   struct pollfd pfd[8];
@@ -270,13 +274,43 @@ int main(int argc, char *argv[])
   int failure = 0;
 
   int enable_report_printing = 0;
-  show_reports = 1;
+
+  struct sdp_state sdp;
+  struct print_state print;
+
+  sdp_init(&sdp);
+  print_init(&print);
+  print.show_reports = 1;
+
+  struct adapter host_adapter, wiimote_adapter;
+  const char * host_dev_str = NULL;
+  const char * wiimote_dev_str = "1";
+  int opt;
+
+  while ((opt = getopt(argc, argv, "+H:W:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'H':
+        host_dev_str = optarg;
+        break;
+      case 'W':
+        wiimote_dev_str = optarg;
+        break;
+      default:
+        print_usage(*argv);
+        return 1;
+    }
+  }
+
+  argc -= optind - 1;
+  argv += optind - 1;
 
   if (argc > 1)
   {
     if (bachk(argv[1]) < 0)
     {
-      printf("usage: %s <wiimote-bdaddr> <wii-bdaddr>\n", *argv);
+      print_usage(*argv);
       return 1;
     }
 
@@ -286,7 +320,7 @@ int main(int argc, char *argv[])
     {
       if (bachk(argv[2]) < 0)
       {
-        printf("usage: %s <wiimote-bdaddr> <wii-bdaddr>\n", *argv);
+        print_usage(*argv);
         return 1;
       }
 
@@ -295,28 +329,40 @@ int main(int argc, char *argv[])
     }
   }
 
+  adapter_init(&host_adapter, NULL);
+  adapter_init(&wiimote_adapter, NULL);
+
+  if (adapter_select(&host_adapter, host_dev_str) < 0)
+  {
+    printf("failed to find host Bluetooth adapter\n");
+    return 1;
+  }
+
   //set up unload signals
   signal(SIGINT, sig_handler);
   signal(SIGTERM, sig_handler);
   signal(SIGHUP, sig_handler);
 
-  if (set_up_device(NULL) < 0)
+  if (set_up_device(&host_adapter) < 0)
   {
     printf("failed to set up Bluetooth device\n");
     return 1;
   }
 
-  if (get_device_bdaddr(0, &host_device_bdaddr) < 0)
+  if (get_device_bdaddr(&host_adapter, &host_device_bdaddr) < 0)
   {
     printf("failed to get host Bluetooth adapter address\n");
-    restore_device();
+    restore_device(&host_adapter);
     return 1;
   }
 
-  if (get_device_bdaddr(1, &wiimote_device_bdaddr) < 0)
+  if (adapter_select(&wiimote_adapter, wiimote_dev_str) < 0 ||
+    get_device_bdaddr(&wiimote_adapter, &wiimote_device_bdaddr) < 0)
   {
     printf("failed to get Wiimote Bluetooth adapter address\n");
     printf("Warning: two Bluetooth adapters are required for proper functionality\n");
+    wiimote_adapter = host_adapter;
+    wiimote_adapter.is_set_up = 0;
     wiimote_device_bdaddr = host_device_bdaddr;
   }
 
@@ -324,7 +370,7 @@ int main(int argc, char *argv[])
   if (register_wiimote_sdp_record() < 0)
   {
     printf("failed to add Wiimote SDP record\n");
-    restore_device();
+    restore_device(&host_adapter);
     return 1;
   }
 #endif
@@ -336,17 +382,17 @@ int main(int argc, char *argv[])
     if (failure++ > 3)
     {
       printf("couldn't find a wiimote to connect to\n");
-      restore_device();
+      restore_device(&host_adapter);
       return 1;
     }
 
-    find_wiimote(&wiimote_bdaddr);
+    find_wiimote(&wiimote_adapter, &wiimote_bdaddr);
   }
 
   if (connect_to_wiimote() < 0)
   {
     printf("failed to connect to wiimote\n");
-    restore_device();
+    restore_device(&host_adapter);
     return 1;
   }
 
@@ -488,12 +534,12 @@ int main(int argc, char *argv[])
       len = recv(sdp_fd, buf, 32, MSG_DONTWAIT);
       if (len > 0)
       {
-        sdp_recv_data(buf, len);
+        sdp_recv_data(&sdp, buf, len);
       }
     }
     if (pfd[3].revents & POLLOUT)
     {
-      len = sdp_get_data(buf);
+      len = sdp_get_data(&sdp, buf);
       if (len > 0)
       {
         send(sdp_fd, buf, len, MSG_DONTWAIT);
@@ -507,7 +553,7 @@ int main(int argc, char *argv[])
         out_buf_len = recv(int_fd, out_buf, 32, MSG_DONTWAIT);
         if (enable_report_printing)
         {
-          print_report(out_buf, out_buf_len);
+          print_report(&print, out_buf, out_buf_len);
         }
       }
       if (pfd[5].revents & POLLOUT)
@@ -538,7 +584,7 @@ int main(int argc, char *argv[])
       in_buf_len = recv(wm_int_fd, in_buf, 32, MSG_DONTWAIT);
       if (enable_report_printing)
       {
-        print_report(in_buf, in_buf_len);
+        print_report(&print, in_buf, in_buf_len);
       }
     }
     if (out_buf_len > 0 && (pfd[7].revents & POLLOUT))
@@ -570,7 +616,7 @@ int main(int argc, char *argv[])
   close(sock_ctrl_fd);
   close(sock_int_fd);
 
-  restore_device();
+  restore_device(&host_adapter);
 
 #ifndef SDP_SERVER
   unregister_wiimote_sdp_record();
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "wiimote.h"
+#include "input.h"
+#include "input_replay.h"
+#include "loopback.h"
+
+// Replays a recording (wmemulator -w) against one emulated controller over
+// a loopback link on a virtual clock: every report period is a step of the
+// clock, not a wait, so a long session runs through as fast as the reports
+// can be made. Prints how long that took and a hash of the report stream,
+// which is the same on every run of the same recording and options.
+
+static void print_usage(char *argv0)
+{
+  printf("usage: %s [ -r <reports/s> ] [ -m <mode> ] [ -l <ms> ] [ -o <reports file> ] <recording>\n", argv0);
+}
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t * data, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+  {
+    hash = (hash ^ data[i]) * 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+int main(int argc, char *argv[])
+{
+  struct wiimote_state state;
+  struct input_state input;
+  struct input_axis_map axis_map;
+  struct wiimote_state * states[1] = { &state };
+  struct input_state * inputs[1] = { &input };
+  struct loopback link;
+  uint8_t buf[64];
+  long reporting_mode = 0x33;
+  uint8_t set_mode[4] = { 0xa2, 0x12, 0x04, 0 };
+  const char * output_path = NULL;
+  char * end;
+  FILE * output = NULL;
+  uint64_t period_us, start_us, end_us, wall_us, hash = 0xcbf29ce484222325ULL;
+  uint64_t reports = 0, sample_delay_us = 0, last_us;
+  int rate = 100, result = 0, opt;
+  ssize_t len;
+
+  while ((opt = getopt(argc, argv, "r:m:l:o:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      case 'm':
+        reporting_mode = strtol(optarg, &end, 16);
+        if (end == optarg || *end != '\0')
+        {
+          reporting_mode = -1;
+        }
+        break;
+      case 'l':
+        sample_delay_us = atoi(optarg) * 1000ULL;
+        break;
+      case 'o':
+        output_path = optarg;
+        break;
+      default:
+        print_usage(*argv);
+        return 1;
+    }
+  }
+
+  //at least a microsecond per report, or the clock never moves
+  if (optind != argc - 1 || rate < 1 || rate > 1000000 ||
+    reporting_mode < 0x30 || reporting_mode > 0x3f || !wiimote_is_data_mode(reporting_mode))
+  {
+    print_usage(*argv);
+    return 1;
+  }
+
+  if (input_replay_init(argv[optind], false))
+  {
+    return 1;
+  }
+
+  if (output_path != NULL && (output = fopen(output_path, "wb")) == NULL)
+  {
+    printf("can't write %s: %s\n", output_path, strerror(errno));
+    return 1;
+  }
+
+  if (loopback_open(&link) < 0)
+  {
+    printf("can't open loopback link: %s\n", strerror(errno));
+    return 1;
+  }
+
+  period_us = 1000000 / rate;
+
+  if (wiimote_init(&state))
+  {
+    printf("out of memory\n");
+    return 1;
+  }
+  wiimote_set_clock(&state, input_replay_clock, NULL);
+  input_axis_map_init(&axis_map);
+  input_init(&input, &axis_map);
+  input.sample_delay_us = sample_delay_us;
+
+  //the host asks for continuous reports in the chosen mode
+  set_mode[3] = reporting_mode;
+  send(link.host_fd, set_mode, sizeof(set_mode), MSG_DONTWAIT);
+
+  start_us = wm_clock_monotonic(NULL);
+
+  //until the reports have caught up with the last event
+  last_us = input_replay_now() + input_replay_duration_us() + sample_delay_us;
+  while (result == 0 && (input_replay_remaining() > 0 || input_replay_now() <= last_us))
+  {
+    while ((len = recv(link.device_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      process_report(&state, buf, len);
+    }
+
+    result = input_update_players_at(states, inputs, 1, &input_source_replay, input_replay_now());
+
+    len = generate_report(&state, buf);
+    if (len > 0)
+    {
+      send(link.device_fd, buf, len, MSG_DONTWAIT);
+    }
+
+    //the host side
+    while ((len = recv(link.host_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      hash = fnv1a(hash, buf, len);
+      reports++;
+      if (output != NULL)
+      {
+        fwrite(buf, 1, len, output);
+      }
+    }
+
+    input_replay_advance(period_us);
+  }
+
+  end_us = wm_clock_monotonic(NULL);
+  wall_us = (end_us > start_us) ? end_us - start_us : 1;
+
+  printf("%.1f s of input in %.3f s (%.0fx), %llu reports, %.0f reports/s\n",
+    input_replay_duration_us() / 1e6, wall_us / 1e6,
+    (double)input_replay_duration_us() / wall_us, (unsigned long long)reports,
+    reports * 1e6 / wall_us);
+  printf("report stream hash %016llx\n", (unsigned long long)hash);
+
+  if (output != NULL)
+  {
+    fclose(output);
+  }
+  input_source_replay.unload();
+  loopback_close(&link);
+  wiimote_destroy(&state);
+
+  return 0;
+}